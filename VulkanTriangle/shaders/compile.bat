@@ -1,4 +1,13 @@
-set vulkanGccPath="C:\Desarrollo\Programas\VulkanSDK\1.2.154.1\Bin\glslc.exe"
-C:\Desarrollo\Programas\VulkanSDK\1.2.154.1\Bin\glslc.exe shader.vert -o vert.spv
-C:\Desarrollo\Programas\VulkanSDK\1.2.154.1\Bin\glslc.exe shader.frag -o frag.spv
+set vulkanGccPath="C:\Desarrollo\Programas\VulkanSDK\1.3.204.1\Bin\glslc.exe"
+C:\Desarrollo\Programas\VulkanSDK\1.3.204.1\Bin\glslc.exe shader.vert -o vert.spv
+C:\Desarrollo\Programas\VulkanSDK\1.3.204.1\Bin\glslc.exe -DMULTIVIEW shader.vert -o multiview_vert.spv
+C:\Desarrollo\Programas\VulkanSDK\1.3.204.1\Bin\glslc.exe shader.frag -o frag.spv
+C:\Desarrollo\Programas\VulkanSDK\1.3.204.1\Bin\glslc.exe particle.comp -o particle_comp.spv
+C:\Desarrollo\Programas\VulkanSDK\1.3.204.1\Bin\glslc.exe particle.vert -o particle_vert.spv
+C:\Desarrollo\Programas\VulkanSDK\1.3.204.1\Bin\glslc.exe mesh.vert -o mesh_vert.spv
+C:\Desarrollo\Programas\VulkanSDK\1.3.204.1\Bin\glslc.exe -DMULTIVIEW mesh.vert -o mesh_multiview_vert.spv
+C:\Desarrollo\Programas\VulkanSDK\1.3.204.1\Bin\glslc.exe immediate.vert -o immediate_vert.spv
+C:\Desarrollo\Programas\VulkanSDK\1.3.204.1\Bin\glslc.exe immediate.frag -o immediate_frag.spv
+C:\Desarrollo\Programas\VulkanSDK\1.3.204.1\Bin\glslc.exe immediate_textured.vert -o immediate_textured_vert.spv
+C:\Desarrollo\Programas\VulkanSDK\1.3.204.1\Bin\glslc.exe immediate_textured.frag -o immediate_textured_frag.spv
 pause
\ No newline at end of file
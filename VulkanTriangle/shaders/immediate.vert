@@ -0,0 +1,18 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Overlay pixels to normalized device coordinates, y already points down in both
+layout(push_constant) uniform ImmediatePushConstants {
+    vec2 scale;
+    vec2 offset;
+} pushConstants;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec4 inColor;
+
+layout(location = 0) out vec4 fragColor;
+
+void main() {
+    gl_Position = vec4(inPosition * pushConstants.scale + pushConstants.offset, 0.0, 1.0);
+    fragColor = inColor;
+}
@@ -0,0 +1,44 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Also built with -DMULTIVIEW, every view of the pass then takes its own matrices
+#ifdef MULTIVIEW
+#extension GL_EXT_multiview : enable
+#define VIEW_INDEX gl_ViewIndex
+#else
+#define VIEW_INDEX 0
+#endif
+
+// MAX_VIEWS of VulkanEngine.h
+#define MAX_VIEWS 4
+
+layout(set = 0, binding = 0) uniform CameraUniforms {
+    mat4 view[MAX_VIEWS];
+    mat4 proj[MAX_VIEWS];
+} camera;
+
+// The model matrix also dequantizes the positions from the mesh bounds
+layout(set = 0, binding = 1) uniform DrawUniforms {
+    mat4 model;
+} draw;
+
+layout(push_constant) uniform DrawPushConstants {
+    vec4 tint;
+} pushConstants;
+
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec4 inNormal;
+layout(location = 2) in vec2 inUv;
+
+layout(location = 0) out vec3 fragColor;
+
+const vec3 lightDirection = normalize(vec3(0.4, -1.0, 0.3));
+
+void main() {
+    gl_Position = camera.proj[VIEW_INDEX] * camera.view[VIEW_INDEX] * draw.model * vec4(inPosition.xyz, 1.0);
+
+    // Non-uniform scales of the dequantization are undone by the inverse transpose
+    vec3 normal = normalize(transpose(inverse(mat3(draw.model))) * inNormal.xyz);
+    float diffuse = max(dot(normal, -lightDirection), 0.0) * 0.8 + 0.2;
+    fragColor = pushConstants.tint.rgb * diffuse;
+}
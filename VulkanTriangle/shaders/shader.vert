@@ -1,6 +1,30 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// Also built with -DMULTIVIEW, every view of the pass then takes its own matrices
+#ifdef MULTIVIEW
+#extension GL_EXT_multiview : enable
+#define VIEW_INDEX gl_ViewIndex
+#else
+#define VIEW_INDEX 0
+#endif
+
+// MAX_VIEWS of VulkanEngine.h
+#define MAX_VIEWS 4
+
+layout(set = 0, binding = 0) uniform CameraUniforms {
+    mat4 view[MAX_VIEWS];
+    mat4 proj[MAX_VIEWS];
+} camera;
+
+layout(set = 0, binding = 1) uniform DrawUniforms {
+    mat4 model;
+} draw;
+
+layout(push_constant) uniform DrawPushConstants {
+    vec4 tint;
+} pushConstants;
+
 layout(location = 0) out vec3 fragColor;
 
 vec2 positions[3] = vec2[](
@@ -16,6 +40,6 @@ vec3 colors[3] = vec3[](
 );
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
+    gl_Position = camera.proj[VIEW_INDEX] * camera.view[VIEW_INDEX] * draw.model * vec4(positions[gl_VertexIndex], 0.0, 1.0);
+    fragColor = colors[gl_VertexIndex] * pushConstants.tint.rgb;
 }
\ No newline at end of file
@@ -0,0 +1,330 @@
+#include "CommandBatchCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "Utils.h"
+
+// Draws are compared as raw memory to find the batches that changed
+static_assert(sizeof(DrawCommand) == sizeof(DrawUniforms) + sizeof(DrawPushConstants) + 4 * sizeof(uint32_t) + sizeof(uint64_t), "DrawCommand must not have padding");
+
+// End of the batch starting at begin: at most DRAW_BATCH_SIZE draws sharing its state
+static size_t getBatchEnd(const std::vector<DrawCommand>& drawList, size_t begin) {
+    uint64_t state = getDrawState(drawList[begin].sortKey);
+    size_t end = begin + 1;
+    while (end < drawList.size() && end - begin < DRAW_BATCH_SIZE && getDrawState(drawList[end].sortKey) == state) {
+        end++;
+    }
+    return end;
+}
+
+void CommandBatchCache::create(VulkanEngine& vkEngine, uint32_t batchCapacity) {
+    this->vkEngine = &vkEngine;
+    this->batchCapacity = batchCapacity;
+
+    QueueFamilyIndices queueFamilyIndices = Utils::findQueueFamilies(vkEngine, vkEngine.physicalDevice);
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    if (vkd.vkCreateCommandPool(vkEngine.device, &poolInfo, nullptr, commandPool.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create batch command pool!");
+    }
+
+    drawStride = (sizeof(DrawUniforms) + vkEngine.uniformRing.alignment - 1) & ~(vkEngine.uniformRing.alignment - 1);
+    createUniforms();
+    CaptureLayer::instance().trackMapping(uniformBuffer, uniformMapped);
+
+    batches.resize(vkEngine.MAX_FRAMES_IN_FLIGHT);
+    batchIndices.resize(vkEngine.MAX_FRAMES_IN_FLIGHT);
+}
+
+void CommandBatchCache::destroy(VkDevice device) {
+    if (uniformMapped != nullptr) {
+        vkd.vkUnmapMemory(device, uniformMemory);
+        uniformMapped = nullptr;
+    }
+    uniformBuffer.reset();
+    uniformMemory.reset();
+    descriptorPool.reset();
+    // Frees the secondary command buffers
+    commandPool.reset();
+    batches.clear();
+    batchIndices.clear();
+}
+
+void CommandBatchCache::prepare(uint32_t frameIndex, const std::vector<DrawCommand>& drawList, uint32_t cameraOffset, VkExtent2D extent, std::vector<VkCommandBuffer>& commandBuffers) {
+    std::vector<Batch>& frameBatches = batches[frameIndex];
+    prepareCount++;
+    stateRanks.clear();
+    stats.reused = 0;
+    stats.recorded = 0;
+    stats.draws = static_cast<uint32_t>(drawList.size());
+    stats.pipelineBinds = 0;
+    stats.descriptorBinds = 0;
+    stats.bufferBinds = 0;
+
+    // Every batch of the frame needs its own uniform region, grow before recording any of them
+    uint32_t batchCount = 0;
+    for (size_t begin = 0; begin < drawList.size(); begin = getBatchEnd(drawList, begin)) {
+        batchCount++;
+    }
+    if (batchCount > batchCapacity) {
+        grow(batchCount);
+    }
+
+    size_t begin = 0;
+    while (begin < drawList.size()) {
+        uint64_t state = getDrawState(drawList[begin].sortKey);
+        size_t end = getBatchEnd(drawList, begin);
+
+        uint64_t identity = state << 32 | stateRanks[state]++;
+        uint32_t batchIndex = acquireBatch(frameIndex, identity);
+        Batch& batch = frameBatches[batchIndex];
+
+        // The fence of this frame slot was waited on, its batches are not in use by the GPU
+        size_t drawCount = end - begin;
+        bool unchanged = batch.commandBuffer != VK_NULL_HANDLE && batch.cameraOffset == cameraOffset && batch.draws.size() == drawCount
+            && batch.extent.width == extent.width && batch.extent.height == extent.height
+            && memcmp(batch.draws.data(), &drawList[begin], drawCount * sizeof(DrawCommand)) == 0;
+        if (unchanged) {
+            stats.reused++;
+        }
+        else {
+            record(batch, frameIndex, batchIndex, &drawList[begin], drawCount, cameraOffset, extent);
+            stats.recorded++;
+        }
+
+        stats.pipelineBinds += batch.pipelineBinds;
+        stats.descriptorBinds += batch.descriptorBinds;
+        stats.bufferBinds += batch.bufferBinds;
+        commandBuffers.push_back(batch.commandBuffer);
+        begin = end;
+    }
+
+    stats.totalReused += stats.reused;
+    stats.totalRecorded += stats.recorded;
+    stats.totalDraws += stats.draws;
+    stats.totalPipelineBinds += stats.pipelineBinds;
+    stats.totalDescriptorBinds += stats.descriptorBinds;
+    stats.totalBufferBinds += stats.bufferBinds;
+    stats.frames++;
+}
+
+void CommandBatchCache::invalidate() {
+    for (std::vector<Batch>& frameBatches : batches) {
+        for (Batch& batch : frameBatches) {
+            batch.draws.clear();
+        }
+    }
+}
+
+/**
+    * Index of the batch with that identity in the frame slot. New identities take a new batch
+    * or, once batchCapacity exist, the first one this frame does not use. prepare grew the
+    * capacity to the batch count of the frame, there always is one.
+    **/
+uint32_t CommandBatchCache::acquireBatch(uint32_t frameIndex, uint64_t identity) {
+    std::vector<Batch>& frameBatches = batches[frameIndex];
+    std::unordered_map<uint64_t, uint32_t>& indices = batchIndices[frameIndex];
+
+    uint32_t batchIndex;
+    auto found = indices.find(identity);
+    if (found != indices.end()) {
+        batchIndex = found->second;
+    }
+    else if (frameBatches.size() < batchCapacity) {
+        batchIndex = static_cast<uint32_t>(frameBatches.size());
+        frameBatches.emplace_back();
+    }
+    else {
+        auto unused = std::find_if(frameBatches.begin(), frameBatches.end(), [this](const Batch& batch) { return batch.lastUsed != prepareCount; });
+        if (unused == frameBatches.end()) {
+            throw std::runtime_error("too many draw batches!");
+        }
+        batchIndex = static_cast<uint32_t>(unused - frameBatches.begin());
+        indices.erase(unused->identity);
+        // Different draws, forces the batch to be recorded again
+        unused->draws.clear();
+    }
+
+    Batch& batch = frameBatches[batchIndex];
+    batch.identity = identity;
+    batch.lastUsed = prepareCount;
+    indices[identity] = batchIndex;
+
+    return batchIndex;
+}
+
+void CommandBatchCache::record(Batch& batch, uint32_t frameIndex, uint32_t batchIndex, const DrawCommand* draws, size_t drawCount, uint32_t cameraOffset, VkExtent2D extent) {
+    if (batch.commandBuffer == VK_NULL_HANDLE) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+
+        if (vkd.vkAllocateCommandBuffers(vkEngine->device, &allocInfo, &batch.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate batch command buffer!");
+        }
+    }
+    else {
+        vkd.vkResetCommandBuffer(batch.commandBuffer, 0);
+    }
+
+    if (Utils::beginSceneCommandBuffer(*vkEngine, batch.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording batch command buffer!");
+    }
+
+    // Secondary command buffers inherit no state, every batch binds its own
+    batch.pipelineBinds = 0;
+    batch.descriptorBinds = 0;
+    batch.bufferBinds = 0;
+    Utils::setViewport(batch.commandBuffer, extent);
+    VkDeviceSize offsets[] = { 0 };
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    uint32_t boundMesh = NO_MESH;
+    VkDeviceSize batchOffset = (static_cast<VkDeviceSize>(frameIndex) * batchCapacity + batchIndex) * DRAW_BATCH_SIZE * drawStride;
+    for (size_t i = 0; i < drawCount; i++) {
+        const DrawCommand& draw = draws[i];
+        VkPipeline pipeline = draw.mesh == NO_MESH ? vkEngine->graphicsPipeline : vkEngine->meshPipeline;
+        if (pipeline != boundPipeline) {
+            CaptureLayer::cmdBindPipeline(batch.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            boundPipeline = pipeline;
+            batch.pipelineBinds++;
+        }
+        if (draw.mesh != NO_MESH && draw.mesh != boundMesh) {
+            const Mesh& mesh = vkEngine->meshes[draw.mesh];
+            CaptureLayer::cmdBindVertexBuffers(batch.commandBuffer, 0, 1, mesh.vertexBuffer.address(), offsets);
+            CaptureLayer::cmdBindIndexBuffer(batch.commandBuffer, mesh.indexBuffer, 0, mesh.indexType);
+            boundMesh = draw.mesh;
+            batch.bufferBinds++;
+        }
+
+        VkDeviceSize drawOffset = batchOffset + i * drawStride;
+        memcpy(uniformMapped + drawOffset, &draw.uniforms, sizeof(DrawUniforms));
+        CaptureLayer::instance().captureWrite(uniformBuffer, drawOffset, &draw.uniforms, sizeof(DrawUniforms));
+
+        // The draw uniforms offset differs for every draw, this bind can not be skipped
+        uint32_t dynamicOffsets[] = { cameraOffset, static_cast<uint32_t>(drawOffset) };
+        CaptureLayer::cmdBindDescriptorSets(batch.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkEngine->pipelineLayout, 0, 1, &descriptorSet, 2, dynamicOffsets);
+        batch.descriptorBinds++;
+        CaptureLayer::cmdPushConstants(batch.commandBuffer, vkEngine->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawPushConstants), &draw.pushConstants);
+        if (draw.mesh == NO_MESH) {
+            CaptureLayer::cmdDraw(batch.commandBuffer, draw.vertexCount, 1, 0, 0);
+        }
+        else {
+            const MeshLod& lod = vkEngine->meshes[draw.mesh].lods[draw.lod];
+            CaptureLayer::cmdDrawIndexed(batch.commandBuffer, lod.indexCount, 1, lod.firstIndex, 0, 0);
+        }
+    }
+
+    if (CaptureLayer::endCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record batch command buffer!");
+    }
+
+    batch.draws.assign(draws, draws + drawCount);
+    batch.cameraOffset = cameraOffset;
+    batch.extent = extent;
+}
+
+/**
+    * Moves the draw uniforms of every frame slot to a buffer holding at least requiredBatches
+    * per slot. The other frames in flight may still execute batches reading the old buffer
+    * through the old descriptor set, both are retired with this frame instead of waiting.
+    **/
+void CommandBatchCache::grow(uint32_t requiredBatches) {
+    UniqueBuffer oldUniformBuffer = std::move(uniformBuffer);
+    UniqueDeviceMemory oldUniformMemory = std::move(uniformMemory);
+    UniqueDescriptorPool oldDescriptorPool = std::move(descriptorPool);
+    VkDescriptorSet oldDescriptorSet = descriptorSet;
+
+    batchCapacity = std::max(requiredBatches, 2 * batchCapacity);
+    createUniforms();
+
+    // Captured frames keep the ids of the initialization, a replay creates its cache as large as it was when the capture started
+    CaptureLayer& capture = CaptureLayer::instance();
+    if (capture.isCapturing()) {
+        capture.stop();
+        std::cout << "capture stopped, the draw batches outgrew the captured cache\n";
+    }
+    capture.replace(CaptureObjectType::Buffer, oldUniformBuffer.get(), uniformBuffer.get());
+    capture.replace(CaptureObjectType::DescriptorSet, oldDescriptorSet, descriptorSet);
+    capture.trackMapping(uniformBuffer, uniformMapped);
+
+    // Freeing the memory unmaps it, the pool frees the old set
+    vkEngine->deletionQueue.retire(std::move(oldUniformBuffer), vkEngine->frameNumber);
+    vkEngine->deletionQueue.retire(std::move(oldUniformMemory), vkEngine->frameNumber);
+    vkEngine->deletionQueue.retire(std::move(oldDescriptorPool), vkEngine->frameNumber);
+
+    // Recorded batches point at the old buffer
+    invalidate();
+    std::cout << "draw batch cache grown to " << batchCapacity << " batches per frame\n";
+}
+
+// Buffer, mapping and descriptor set of batchCapacity batches per frame slot
+void CommandBatchCache::createUniforms() {
+    VkDeviceSize bufferSize = drawStride * DRAW_BATCH_SIZE * batchCapacity * vkEngine->MAX_FRAMES_IN_FLIGHT;
+    Utils::createBuffer(*vkEngine, bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, *uniformBuffer.put(vkEngine->device), *uniformMemory.put(vkEngine->device));
+
+    if (vkd.vkMapMemory(vkEngine->device, uniformMemory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&uniformMapped)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map batch uniform buffer!");
+    }
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSize.descriptorCount = 2;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    if (vkd.vkCreateDescriptorPool(vkEngine->device, &poolInfo, nullptr, descriptorPool.put(vkEngine->device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create batch descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = vkEngine->descriptorSetLayout.address();
+
+    if (vkd.vkAllocateDescriptorSets(vkEngine->device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate batch descriptor set!");
+    }
+    CaptureLayer::instance().track(CaptureObjectType::DescriptorSet, descriptorSet);
+
+    // The camera still comes from the uniform ring, its offset is the start of the frame region
+    VkDescriptorBufferInfo cameraInfo{};
+    cameraInfo.buffer = vkEngine->uniformRing.buffer;
+    cameraInfo.offset = 0;
+    cameraInfo.range = sizeof(CameraUniforms);
+
+    VkDescriptorBufferInfo drawInfo{};
+    drawInfo.buffer = uniformBuffer;
+    drawInfo.offset = 0;
+    drawInfo.range = sizeof(DrawUniforms);
+
+    VkWriteDescriptorSet descriptorWrites[2]{};
+    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[0].dstSet = descriptorSet;
+    descriptorWrites[0].dstBinding = 0;
+    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorWrites[0].descriptorCount = 1;
+    descriptorWrites[0].pBufferInfo = &cameraInfo;
+
+    descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[1].dstSet = descriptorSet;
+    descriptorWrites[1].dstBinding = 1;
+    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorWrites[1].descriptorCount = 1;
+    descriptorWrites[1].pBufferInfo = &drawInfo;
+
+    vkd.vkUpdateDescriptorSets(vkEngine->device, 2, descriptorWrites, 0, nullptr);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "VulkanHandle.h"
+
+class VulkanEngine;
+struct DrawCommand;
+
+// Draws per batch at most, a batch is the unit of re-recording
+const uint32_t DRAW_BATCH_SIZE = 64;
+// Batches per frame in flight the cache starts with, it grows when a frame needs more
+const uint32_t INITIAL_DRAW_BATCHES = 256;
+
+struct CommandBatchStats {
+	// Last frame
+	uint32_t reused = 0;
+	uint32_t recorded = 0;
+	uint32_t draws = 0;
+	uint32_t pipelineBinds = 0;
+	uint32_t descriptorBinds = 0;
+	uint32_t bufferBinds = 0;
+	// Since the last report
+	uint64_t totalReused = 0;
+	uint64_t totalRecorded = 0;
+	uint64_t totalDraws = 0;
+	uint64_t totalPipelineBinds = 0;
+	uint64_t totalDescriptorBinds = 0;
+	uint64_t totalBufferBinds = 0;
+	uint32_t frames = 0;
+};
+
+/**
+    * Secondary command buffers caching the sorted draw list, one set per frame in flight. The
+    * list is cut into batches of at most DRAW_BATCH_SIZE draws sharing the same state (see
+    * getDrawState), so each batch binds its pipeline and buffers once and every other
+    * redundant bind is skipped while recording. A batch is identified by its state and its rank
+    * among the batches of that state, so draws appearing elsewhere in the list do not
+    * invalidate it. Each batch writes its draw uniforms to its own fixed region of a persistently
+    * mapped buffer instead of the uniform ring, so a recorded batch stays valid for as long as
+    * its draws do not change: only the batches whose draws differ from the ones recorded in that
+    * frame slot are re-recorded, or when the render resolution changed. A frame cut into more
+    * batches than the regions hold gets a larger buffer, the old one is retired with that frame.
+    **/
+class CommandBatchCache {
+public:
+	void create(VulkanEngine& vkEngine, uint32_t batchCapacity);
+	void destroy(VkDevice device);
+
+	uint32_t getBatchCapacity() const {
+		return batchCapacity;
+	}
+
+	// Draws must be sorted by key. Appends the batches to execute inside the render pass, in order
+	void prepare(uint32_t frameIndex, const std::vector<DrawCommand>& drawList, uint32_t cameraOffset, VkExtent2D extent, std::vector<VkCommandBuffer>& commandBuffers);
+	// Every batch is recorded again by its next prepare, so a capture starting now sees the recording
+	void invalidate();
+
+	CommandBatchStats stats;
+
+private:
+	struct Batch {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		std::vector<DrawCommand> draws;
+		uint32_t cameraOffset = UINT32_MAX;
+		// Render extent the viewport was set to
+		VkExtent2D extent = { 0, 0 };
+		uint64_t identity = 0;
+		uint64_t lastUsed = 0;
+		// Binds recorded in the command buffer
+		uint32_t pipelineBinds = 0;
+		uint32_t descriptorBinds = 0;
+		uint32_t bufferBinds = 0;
+	};
+
+	uint32_t acquireBatch(uint32_t frameIndex, uint64_t identity);
+	void grow(uint32_t requiredBatches);
+	void createUniforms();
+	void record(Batch& batch, uint32_t frameIndex, uint32_t batchIndex, const DrawCommand* draws, size_t drawCount, uint32_t cameraOffset, VkExtent2D extent);
+
+	VulkanEngine* vkEngine = nullptr;
+	UniqueCommandPool commandPool;
+
+	// [frame in flight][batch], batchIndices maps batch identities to their index
+	std::vector<std::vector<Batch>> batches;
+	std::vector<std::unordered_map<uint64_t, uint32_t>> batchIndices;
+	// Batches started so far this frame per state
+	std::unordered_map<uint64_t, uint32_t> stateRanks;
+	uint64_t prepareCount = 0;
+
+	// Draw uniforms of batch b in frame f start at (f * batchCapacity + b) * DRAW_BATCH_SIZE * drawStride
+	uint32_t batchCapacity = 0;
+	UniqueBuffer uniformBuffer;
+	UniqueDeviceMemory uniformMemory;
+	uint8_t* uniformMapped = nullptr;
+	VkDeviceSize drawStride = 0;
+
+	// Same layout as VulkanEngine::descriptorSet, the draw binding points at uniformBuffer
+	UniqueDescriptorPool descriptorPool;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+};
@@ -0,0 +1,16 @@
+#include "DeferredDestructionQueue.h"
+
+void DeferredDestructionQueue::collect(uint64_t completedFrame) {
+    while (!retired.empty() && retired.front().frameNumber <= completedFrame) {
+        const RetiredObject& object = retired.front();
+        object.destroy(object.device, object.handle);
+        retired.pop_front();
+    }
+}
+
+void DeferredDestructionQueue::flush() {
+    for (const RetiredObject& object : retired) {
+        object.destroy(object.device, object.handle);
+    }
+    retired.clear();
+}
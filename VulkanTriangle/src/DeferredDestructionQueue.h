@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <deque>
+
+#include "VulkanHandle.h"
+
+/**
+    * Device objects replaced while frames in flight may still use them. Each one is retired
+    * with a frame number no earlier than the last frame recording it, and destroyed by collect
+    * once the fence of that frame has signaled, no device-wide wait. Frames complete in order,
+    * so the queue is sorted by frame and collect only pops from the front. flush destroys the
+    * rest once the device is idle, at shutdown.
+    **/
+class DeferredDestructionQueue {
+public:
+	template<typename Traits>
+	void retire(VulkanHandle<Traits>&& object, uint64_t frameNumber) {
+		if (object.get() == VK_NULL_HANDLE) {
+			return;
+		}
+		VkDevice device = object.getDevice();
+		retired.push_back({ frameNumber, device, (uint64_t)object.release(), &destroy<Traits> });
+	}
+
+	// Every frame up to completedFrame has finished executing on the GPU
+	void collect(uint64_t completedFrame);
+	void flush();
+
+	size_t size() const {
+		return retired.size();
+	}
+
+private:
+	struct RetiredObject {
+		uint64_t frameNumber;
+		VkDevice device;
+		uint64_t handle;
+		void (*destroy)(VkDevice device, uint64_t handle);
+	};
+
+	template<typename Traits>
+	static void destroy(VkDevice device, uint64_t handle) {
+		Traits::destroy(device, (typename Traits::Type)handle);
+	}
+
+	std::deque<RetiredObject> retired;
+};
@@ -0,0 +1,358 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "Utils.h"
+
+void DynamicResolution::create(VulkanEngine& vkEngine) {
+    // Headless engines replaying a capture render at the captured extent
+    maxExtent = vkEngine.outputs.empty() ? vkEngine.offscreenExtent : vkEngine.outputs[0].swapChainExtent;
+    renderExtent = maxExtent;
+    scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+    dynamicRendering = vkEngine.dynamicRendering;
+    renderPass = vkEngine.renderPass;
+    viewCount = vkEngine.viewCount;
+    viewMask = vkEngine.getViewMask();
+
+    // Same format as the primary swap chain, a copy is still possible when blits are not
+    VkFormatProperties formatProperties;
+    vki.vkGetPhysicalDeviceFormatProperties(vkEngine.physicalDevice, vkEngine.colorFormat, &formatProperties);
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    blitSupported = (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+    for (const WindowOutput& output : vkEngine.outputs) {
+        vki.vkGetPhysicalDeviceFormatProperties(vkEngine.physicalDevice, output.swapChainImageFormat, &formatProperties);
+        blitSupported = blitSupported && (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT) != 0;
+    }
+
+    size_t frameCount = vkEngine.MAX_FRAMES_IN_FLIGHT;
+    images.resize(frameCount);
+    imageMemories.resize(frameCount);
+    imageViews.resize(frameCount);
+    framebuffers.resize(frameCount);
+
+    for (size_t i = 0; i < frameCount; i++) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = maxExtent.width;
+        imageInfo.extent.height = maxExtent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        // A layer per view, the framebuffer itself stays single layer with multiview
+        imageInfo.arrayLayers = viewCount;
+        imageInfo.format = vkEngine.colorFormat;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkd.vkCreateImage(vkEngine.device, &imageInfo, nullptr, images[i].put(vkEngine.device)) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create scene target image!");
+        }
+        CaptureLayer::instance().trackImage(images[i], imageInfo);
+
+        VkMemoryRequirements memRequirements;
+        vkd.vkGetImageMemoryRequirements(vkEngine.device, images[i], &memRequirements);
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = Utils::findMemoryType(vkEngine, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        if (vkd.vkAllocateMemory(vkEngine.device, &allocInfo, nullptr, imageMemories[i].put(vkEngine.device)) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate scene target memory!");
+        }
+        vkd.vkBindImageMemory(vkEngine.device, images[i], imageMemories[i], 0);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = images[i];
+        viewInfo.viewType = viewCount > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = vkEngine.colorFormat;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = viewCount;
+
+        if (vkd.vkCreateImageView(vkEngine.device, &viewInfo, nullptr, imageViews[i].put(vkEngine.device)) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create scene target image view!");
+        }
+        CaptureLayer::instance().track(CaptureObjectType::ImageView, imageViews[i].get());
+
+        if (dynamicRendering) {
+            continue;
+        }
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = vkEngine.renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = imageViews[i].address();
+        framebufferInfo.width = maxExtent.width;
+        framebufferInfo.height = maxExtent.height;
+        framebufferInfo.layers = 1;
+
+        if (vkd.vkCreateFramebuffer(vkEngine.device, &framebufferInfo, nullptr, framebuffers[i].put(vkEngine.device)) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create scene framebuffer!");
+        }
+        CaptureLayer::instance().track(CaptureObjectType::Framebuffer, framebuffers[i].get());
+    }
+}
+
+void DynamicResolution::destroy() {
+    framebuffers.clear();
+    imageViews.clear();
+    images.clear();
+    imageMemories.clear();
+}
+
+bool DynamicResolution::update(double gpuFrameMs) {
+    if (!blitSupported) {
+        return false;
+    }
+
+    accumulatedMs += gpuFrameMs;
+    if (++samples < DYNAMIC_RESOLUTION_INTERVAL) {
+        return false;
+    }
+    double averageMs = accumulatedMs / samples;
+    accumulatedMs = 0.0;
+    samples = 0;
+
+    bool overBudget = averageMs > budgetMs;
+    bool underBudget = averageMs < budgetMs * DYNAMIC_RESOLUTION_HEADROOM;
+    if (averageMs <= 0.0 || (!overBudget && !underBudget)) {
+        return false;
+    }
+
+    // Time is proportional to the pixel count, the square of the scale. Steps are limited
+    // since the measure lags one interval behind, going up slower than down
+    float ratio = static_cast<float>(std::sqrt((overBudget ? budgetMs : budgetMs * DYNAMIC_RESOLUTION_HEADROOM) / averageMs));
+    float newScale = std::clamp(scale * std::clamp(ratio, 0.75f, 1.1f), DYNAMIC_RESOLUTION_MIN_SCALE, DYNAMIC_RESOLUTION_MAX_SCALE);
+
+    VkExtent2D newExtent = scaleExtent(newScale);
+    scale = newScale;
+    if (newExtent.width == renderExtent.width && newExtent.height == renderExtent.height) {
+        return false;
+    }
+
+    renderExtent = newExtent;
+    std::cout << "render resolution " << renderExtent.width << "x" << renderExtent.height << " (" << static_cast<int>(scale * 100.0f)
+        << "%), GPU " << averageMs << " ms for a " << budgetMs << " ms budget" << "\n";
+    return true;
+}
+
+void DynamicResolution::beginScene(VkCommandBuffer commandBuffer, uint32_t frameIndex, const VkClearValue& clearValue) {
+    VkRect2D renderArea{};
+    renderArea.offset = { 0, 0 };
+    renderArea.extent = renderExtent;
+
+    if (!dynamicRendering) {
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = framebuffers[frameIndex];
+        renderPassInfo.renderArea = renderArea;
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearValue;
+        CaptureLayer::cmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        return;
+    }
+
+    // The previous upscale of this frame slot's target has to be done reading it before it is cleared, as the render pass dependencies do
+    VkImageMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_COPY_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_NONE;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = images[frameIndex];
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, viewCount };
+
+    VkDependencyInfo dependencyInfo{};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.imageMemoryBarrierCount = 1;
+    dependencyInfo.pImageMemoryBarriers = &barrier;
+    CaptureLayer::cmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+    VkRenderingAttachmentInfo colorAttachment{};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    colorAttachment.imageView = imageViews[frameIndex];
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue = clearValue;
+
+    VkRenderingInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+    renderingInfo.renderArea = renderArea;
+    renderingInfo.layerCount = 1;
+    renderingInfo.viewMask = viewMask;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    CaptureLayer::cmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void DynamicResolution::endScene(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+    if (!dynamicRendering) {
+        CaptureLayer::cmdEndRenderPass(commandBuffer);
+        return;
+    }
+
+    CaptureLayer::cmdEndRendering(commandBuffer);
+
+    VkImageMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstStageMask = blitSupported ? VK_PIPELINE_STAGE_2_BLIT_BIT : VK_PIPELINE_STAGE_2_COPY_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = images[frameIndex];
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, viewCount };
+
+    VkDependencyInfo dependencyInfo{};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.imageMemoryBarrierCount = 1;
+    dependencyInfo.pImageMemoryBarriers = &barrier;
+    CaptureLayer::cmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+void DynamicResolution::recordUpscale(VkCommandBuffer commandBuffer, uint32_t frameIndex, const std::vector<WindowOutput>& outputs) {
+    if (dynamicRendering) {
+        recordUpscale2(commandBuffer, frameIndex, outputs);
+        return;
+    }
+
+    // The swap chain images are only available from the transfer stage, see the submit wait stages
+    barriers.clear();
+    for (const WindowOutput& output : outputs) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = output.swapChainImages[output.currentImageIndex];
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers.push_back(barrier);
+    }
+    CaptureLayer::cmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+        static_cast<uint32_t>(barriers.size()), barriers.data());
+
+    recordScale(commandBuffer, frameIndex, outputs);
+
+    for (VkImageMemoryBarrier& barrier : barriers) {
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+    }
+    CaptureLayer::cmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr,
+        static_cast<uint32_t>(barriers.size()), barriers.data());
+}
+
+// Same transitions with synchronization2, limited to the blit or copy stage instead of all the transfers
+void DynamicResolution::recordUpscale2(VkCommandBuffer commandBuffer, uint32_t frameIndex, const std::vector<WindowOutput>& outputs) {
+    VkPipelineStageFlags2 scaleStage = blitSupported ? VK_PIPELINE_STAGE_2_BLIT_BIT : VK_PIPELINE_STAGE_2_COPY_BIT;
+
+    barriers2.clear();
+    for (const WindowOutput& output : outputs) {
+        VkImageMemoryBarrier2 barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        barrier.srcStageMask = scaleStage;
+        barrier.srcAccessMask = VK_ACCESS_2_NONE;
+        barrier.dstStageMask = scaleStage;
+        barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = output.swapChainImages[output.currentImageIndex];
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        barriers2.push_back(barrier);
+    }
+
+    VkDependencyInfo dependencyInfo{};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(barriers2.size());
+    dependencyInfo.pImageMemoryBarriers = barriers2.data();
+    CaptureLayer::cmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+    recordScale(commandBuffer, frameIndex, outputs);
+
+    for (VkImageMemoryBarrier2& barrier : barriers2) {
+        barrier.srcStageMask = scaleStage;
+        barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+        barrier.dstAccessMask = VK_ACCESS_2_NONE;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    }
+    CaptureLayer::cmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+void DynamicResolution::recordScale(VkCommandBuffer commandBuffer, uint32_t frameIndex, const std::vector<WindowOutput>& outputs) {
+    // With an output per view each one shows its own layer, otherwise every output shows all of them side by side
+    bool layerPerOutput = outputs.size() == viewCount;
+
+    // The scene left the target in TRANSFER_SRC_OPTIMAL, each output gets it scaled to its own extent
+    for (size_t o = 0; o < outputs.size(); o++) {
+        const WindowOutput& output = outputs[o];
+        VkImage swapChainImage = output.swapChainImages[output.currentImageIndex];
+        uint32_t firstLayer = layerPerOutput ? static_cast<uint32_t>(o) : 0;
+        uint32_t layerCount = layerPerOutput ? 1 : viewCount;
+
+        for (uint32_t slot = 0; slot < layerCount; slot++) {
+            uint32_t layer = firstLayer + slot;
+            int32_t slotLeft = static_cast<int32_t>(output.swapChainExtent.width * slot / layerCount);
+            int32_t slotRight = static_cast<int32_t>(output.swapChainExtent.width * (slot + 1) / layerCount);
+            if (blitSupported) {
+                VkImageBlit blit{};
+                blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, layer, 1 };
+                blit.srcOffsets[1] = { static_cast<int32_t>(renderExtent.width), static_cast<int32_t>(renderExtent.height), 1 };
+                blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+                blit.dstOffsets[0] = { slotLeft, 0, 0 };
+                blit.dstOffsets[1] = { slotRight, static_cast<int32_t>(output.swapChainExtent.height), 1 };
+                CaptureLayer::cmdBlitImage(commandBuffer, images[frameIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapChainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    1, &blit, VK_FILTER_LINEAR);
+            }
+            else {
+                // Not scaled, each view is cropped to its slot
+                VkImageCopy copy{};
+                copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, layer, 1 };
+                copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+                copy.dstOffset = { slotLeft, 0, 0 };
+                copy.extent = { std::min(maxExtent.width, static_cast<uint32_t>(slotRight - slotLeft)), std::min(maxExtent.height, output.swapChainExtent.height), 1 };
+                CaptureLayer::cmdCopyImage(commandBuffer, images[frameIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapChainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    1, &copy);
+            }
+        }
+    }
+}
+
+VkExtent2D DynamicResolution::scaleExtent(float extentScale) const {
+    auto scaleDimension = [extentScale](uint32_t size) {
+        uint32_t scaled = static_cast<uint32_t>(size * extentScale) / DYNAMIC_RESOLUTION_GRANULARITY * DYNAMIC_RESOLUTION_GRANULARITY;
+        return std::clamp(scaled, std::min(size, DYNAMIC_RESOLUTION_GRANULARITY), size);
+    };
+    return { scaleDimension(maxExtent.width), scaleDimension(maxExtent.height) };
+}
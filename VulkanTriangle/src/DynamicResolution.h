@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+#include "VulkanHandle.h"
+#include "WindowOutput.h"
+
+class VulkanEngine;
+
+// GPU time of the graphics work the resolution is scaled to fit in
+const double DYNAMIC_RESOLUTION_BUDGET_MS = 14.0;
+const float DYNAMIC_RESOLUTION_MIN_SCALE = 0.5f;
+const float DYNAMIC_RESOLUTION_MAX_SCALE = 1.0f;
+// GPU time is averaged over that many frames before the scale can change again
+const uint32_t DYNAMIC_RESOLUTION_INTERVAL = 30;
+// The scale only goes up once the GPU time is below this share of the budget, so it does not oscillate
+const double DYNAMIC_RESOLUTION_HEADROOM = 0.85;
+// Render extents are rounded to a multiple of this
+const uint32_t DYNAMIC_RESOLUTION_GRANULARITY = 8;
+
+/**
+    * Offscreen scene targets and the resolution they are rendered at. The targets are allocated
+    * once at the swap chain extent and the scene only renders to the top left renderExtent of
+    * them, so changing the resolution costs nothing but the upscale: no image, memory or
+    * pipeline is created again (viewport and scissor are dynamic state). The scale follows the
+    * GPU frame time measured against budgetMs, pixel count being proportional to the time.
+    * With dynamic rendering the targets have no framebuffers and their layout transitions are
+    * synchronization2 barriers, recorded around the rendering instead of by the render pass.
+    * With multiview the targets have a layer per view, all rendered by the same pass.
+    **/
+class DynamicResolution {
+public:
+	void create(VulkanEngine& vkEngine);
+	void destroy();
+
+	// Returns true when renderExtent changed
+	bool update(double gpuFrameMs);
+	// Starts rendering the scene to renderExtent of the frame slot's target, the draws are executed from secondary command buffers
+	void beginScene(VkCommandBuffer commandBuffer, uint32_t frameIndex, const VkClearValue& clearValue);
+	// Leaves the target in TRANSFER_SRC_OPTIMAL for the upscale
+	void endScene(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+	// Scales the rendered area of the frame slot's target to the acquired image of every output and leaves them ready to present
+	void recordUpscale(VkCommandBuffer commandBuffer, uint32_t frameIndex, const std::vector<WindowOutput>& outputs);
+
+	VkExtent2D renderExtent = { 0, 0 };
+	double budgetMs = DYNAMIC_RESOLUTION_BUDGET_MS;
+
+private:
+	VkExtent2D scaleExtent(float extentScale) const;
+	void recordUpscale2(VkCommandBuffer commandBuffer, uint32_t frameIndex, const std::vector<WindowOutput>& outputs);
+	// Blits or copies the target to the swap chain images, in TRANSFER_DST_OPTIMAL
+	void recordScale(VkCommandBuffer commandBuffer, uint32_t frameIndex, const std::vector<WindowOutput>& outputs);
+
+	VkExtent2D maxExtent = { 0, 0 };
+	float scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+	// Without linear blits to every output format the targets are copied and never scaled
+	bool blitSupported = false;
+	// Render pass path when VK_NULL_HANDLE is not the render pass
+	bool dynamicRendering = false;
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	uint32_t viewCount = 1;
+	uint32_t viewMask = 0;
+
+	std::vector<UniqueImage> images;
+	std::vector<UniqueDeviceMemory> imageMemories;
+	std::vector<UniqueImageView> imageViews;
+	// Null handles with dynamic rendering
+	std::vector<UniqueFramebuffer> framebuffers;
+	std::vector<VkImageMemoryBarrier> barriers;
+	std::vector<VkImageMemoryBarrier2> barriers2;
+
+	double accumulatedMs = 0.0;
+	uint32_t samples = 0;
+};
@@ -0,0 +1,197 @@
+#include "ImmediateRenderer.h"
+
+#include <algorithm>
+
+#include "Utils.h"
+
+void ImmediateRenderer::create(VulkanEngine& vkEngine, uint32_t vertexCapacity, uint32_t frameCount) {
+    this->vkEngine = &vkEngine;
+    this->vertexCapacity = vertexCapacity;
+
+    VkDeviceSize bufferSize = static_cast<VkDeviceSize>(vertexCapacity) * frameCount * sizeof(ImmediateVertex);
+    Utils::createBuffer(vkEngine, bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, *buffer.put(vkEngine.device), *memory.put(vkEngine.device));
+
+    // Mapped once for the whole lifetime of the buffer
+    if (vkd.vkMapMemory(vkEngine.device, memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&mapped)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map immediate vertex buffer!");
+    }
+    CaptureLayer::instance().trackMapping(buffer, mapped);
+
+    // Image descriptor sets are written while building the frame, after its fence was waited on
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = IMMEDIATE_IMAGE_CAPACITY * frameCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = IMMEDIATE_IMAGE_CAPACITY * frameCount;
+
+    if (vkd.vkCreateDescriptorPool(vkEngine.device, &poolInfo, nullptr, descriptorPool.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create immediate descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(IMMEDIATE_IMAGE_CAPACITY * frameCount, vkEngine.imageDescriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+    allocInfo.pSetLayouts = layouts.data();
+
+    imageSets.resize(layouts.size());
+    if (vkd.vkAllocateDescriptorSets(vkEngine.device, &allocInfo, imageSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate immediate descriptor sets!");
+    }
+}
+
+void ImmediateRenderer::destroy(VkDevice device) {
+    if (mapped != nullptr) {
+        vkd.vkUnmapMemory(device, memory);
+        mapped = nullptr;
+    }
+    buffer.reset();
+    memory.reset();
+    descriptorPool.reset();
+}
+
+void ImmediateRenderer::beginFrame(uint32_t frameIndex, VkExtent2D extent) {
+    this->frameIndex = frameIndex;
+    this->extent = extent;
+    frameVertices = mapped + static_cast<size_t>(frameIndex) * vertexCapacity;
+    vertexCount = 0;
+    imageViews.clear();
+
+    batches.clear();
+    batches.push_back({ { { 0, 0 }, extent }, VK_NULL_HANDLE, 0 });
+}
+
+void ImmediateRenderer::setClipRect(int32_t x, int32_t y, uint32_t width, uint32_t height) {
+    setBatchState({ { x, y }, { width, height } }, batches.back().imageSet);
+}
+
+void ImmediateRenderer::image(VkImageView view, float x, float y, float width, float height, uint32_t color) {
+    VkRect2D clipRect = batches.back().clipRect;
+    setBatchState(clipRect, getImageSet(view));
+    quad({ x, y, color, 0.0f, 0.0f }, { x + width, y, color, 1.0f, 0.0f }, { x + width, y + height, color, 1.0f, 1.0f }, { x, y + height, color, 0.0f, 1.0f });
+    setBatchState(clipRect, VK_NULL_HANDLE);
+}
+
+void ImmediateRenderer::setBatchState(const VkRect2D& clipRect, VkDescriptorSet imageSet) {
+    // A run left without primitives takes the new state instead
+    if (batches.back().firstVertex == vertexCount) {
+        batches.pop_back();
+    }
+
+    // Back to the state of the current run, nothing changes
+    if (!batches.empty()) {
+        const Batch& current = batches.back();
+        if (current.clipRect.offset.x == clipRect.offset.x && current.clipRect.offset.y == clipRect.offset.y
+            && current.clipRect.extent.width == clipRect.extent.width && current.clipRect.extent.height == clipRect.extent.height
+            && current.imageSet == imageSet) {
+            return;
+        }
+    }
+    batches.push_back({ clipRect, imageSet, vertexCount });
+}
+
+VkDescriptorSet ImmediateRenderer::getImageSet(VkImageView view) {
+    VkDescriptorSet* frameSets = &imageSets[static_cast<size_t>(frameIndex) * IMMEDIATE_IMAGE_CAPACITY];
+    auto found = std::find(imageViews.begin(), imageViews.end(), view);
+    if (found != imageViews.end()) {
+        return frameSets[found - imageViews.begin()];
+    }
+    if (imageViews.size() == IMMEDIATE_IMAGE_CAPACITY) {
+        throw std::runtime_error("immediate image descriptor frame region overflow!");
+    }
+
+    // The previous frame using this slot is done, its sets can be written again
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.sampler = vkEngine->textures.sampler;
+    imageInfo.imageView = view;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = frameSets[imageViews.size()];
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+    vkd.vkUpdateDescriptorSets(vkEngine->device, 1, &descriptorWrite, 0, nullptr);
+
+    imageViews.push_back(view);
+    return descriptorWrite.dstSet;
+}
+
+void ImmediateRenderer::record(VkCommandBuffer commandBuffer, VkExtent2D renderExtent) {
+    stats.vertices = vertexCount;
+    stats.draws = 0;
+    if (vertexCount == 0 || extent.width == 0 || extent.height == 0) {
+        return;
+    }
+
+    // The vertices went straight to the mapped memory, a capture records the frame's region at once
+    VkDeviceSize frameOffset = static_cast<VkDeviceSize>(frameIndex) * vertexCapacity * sizeof(ImmediateVertex);
+    CaptureLayer::instance().captureWrite(buffer, frameOffset, frameVertices, static_cast<VkDeviceSize>(vertexCount) * sizeof(ImmediateVertex));
+
+    // Overlay pixels to normalized device coordinates, then to the pixels of the scaled scene target
+    ImmediatePushConstants pushConstants{};
+    pushConstants.scale[0] = 2.0f / extent.width;
+    pushConstants.scale[1] = 2.0f / extent.height;
+    pushConstants.offset[0] = -1.0f;
+    pushConstants.offset[1] = -1.0f;
+    float renderScaleX = static_cast<float>(renderExtent.width) / extent.width;
+    float renderScaleY = static_cast<float>(renderExtent.height) / extent.height;
+
+    Utils::setViewport(commandBuffer, renderExtent);
+    CaptureLayer::cmdBindVertexBuffers(commandBuffer, 0, 1, buffer.address(), &frameOffset);
+
+    bool pipelineBound = false;
+    bool texturedBound = false;
+    VkDescriptorSet boundSet = VK_NULL_HANDLE;
+    for (size_t i = 0; i < batches.size(); i++) {
+        const Batch& batch = batches[i];
+        uint32_t endVertex = i + 1 < batches.size() ? batches[i + 1].firstVertex : vertexCount;
+        if (endVertex == batch.firstVertex) {
+            continue;
+        }
+
+        // Both layouts have the same push constant range, pushed again anyway after every switch
+        bool textured = batch.imageSet != VK_NULL_HANDLE;
+        if (!pipelineBound || textured != texturedBound) {
+            VkPipelineLayout layout = textured ? vkEngine->immediateTexturedPipelineLayout : vkEngine->immediatePipelineLayout;
+            CaptureLayer::cmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, textured ? vkEngine->immediateTexturedPipeline : vkEngine->immediatePipeline);
+            CaptureLayer::cmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ImmediatePushConstants), &pushConstants);
+            pipelineBound = true;
+            texturedBound = textured;
+            boundSet = VK_NULL_HANDLE;
+        }
+        if (textured && batch.imageSet != boundSet) {
+            CaptureLayer::cmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkEngine->immediateTexturedPipelineLayout, 0, 1, &batch.imageSet, 0, nullptr);
+            boundSet = batch.imageSet;
+        }
+
+        // Scissors cannot have negative offsets or reach out of the target
+        float left = std::max(std::floor(batch.clipRect.offset.x * renderScaleX), 0.0f);
+        float top = std::max(std::floor(batch.clipRect.offset.y * renderScaleY), 0.0f);
+        float right = std::min(std::ceil((batch.clipRect.offset.x + static_cast<float>(batch.clipRect.extent.width)) * renderScaleX), static_cast<float>(renderExtent.width));
+        float bottom = std::min(std::ceil((batch.clipRect.offset.y + static_cast<float>(batch.clipRect.extent.height)) * renderScaleY), static_cast<float>(renderExtent.height));
+        if (right <= left || bottom <= top) {
+            continue;
+        }
+
+        VkRect2D scissor{};
+        scissor.offset = { static_cast<int32_t>(left), static_cast<int32_t>(top) };
+        scissor.extent = { static_cast<uint32_t>(right - left), static_cast<uint32_t>(bottom - top) };
+        CaptureLayer::cmdSetScissor(commandBuffer, 0, 1, &scissor);
+        CaptureLayer::cmdDraw(commandBuffer, endVertex - batch.firstVertex, 1, batch.firstVertex, 0);
+        stats.draws++;
+    }
+
+    stats.totalVertices += stats.vertices;
+    stats.totalDraws += stats.draws;
+    stats.frames++;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "VulkanHandle.h"
+
+class VulkanEngine;
+
+// Position in overlay pixels, origin at the top left, and color packed by immediateColor.
+// Texture coordinates are only read by image primitives
+struct ImmediateVertex {
+	float x;
+	float y;
+	uint32_t color;
+	float u;
+	float v;
+};
+
+// Maps overlay pixels to normalized device coordinates
+struct ImmediatePushConstants {
+	float scale[2];
+	float offset[2];
+};
+
+// Vertices each frame in flight can stream, 5 MB per frame
+const uint32_t IMMEDIATE_VERTEX_CAPACITY = 256 * 1024;
+// Distinct images each frame in flight can draw, one descriptor set each
+const uint32_t IMMEDIATE_IMAGE_CAPACITY = 16;
+const uint32_t IMMEDIATE_STATS_INTERVAL = 1000;
+
+// R8G8B8A8_UNORM, red in the lowest byte
+inline uint32_t immediateColor(float r, float g, float b, float a = 1.0f) {
+	auto toByte = [](float value) {
+		return static_cast<uint32_t>((value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value)) * 255.0f + 0.5f);
+	};
+	return toByte(r) | toByte(g) << 8 | toByte(b) << 16 | toByte(a) << 24;
+}
+
+struct ImmediateStats {
+	// Last frame
+	uint32_t vertices = 0;
+	uint32_t draws = 0;
+	// Since the last report
+	uint64_t totalVertices = 0;
+	uint64_t totalDraws = 0;
+	double totalBuildMs = 0.0;
+	uint32_t frames = 0;
+};
+
+/**
+    * Immediate mode 2D primitives for the overlays, streamed into a persistently mapped vertex
+    * buffer split in one region per frame in flight like UniformRingBuffer. Every primitive is
+    * written straight into the mapped region as a triangle list, lines included as quads of
+    * their width, so appending one costs a few stores and no state lookup. The only state is
+    * the clip rectangle and the image: primitives are drawn in submission order, one draw per
+    * run sharing both, with a single vertex buffer bind for the whole frame. Image runs switch
+    * to the textured pipeline and bind a descriptor set written for their view this frame.
+    **/
+class ImmediateRenderer {
+public:
+	void create(VulkanEngine& vkEngine, uint32_t vertexCapacity, uint32_t frameCount);
+	void destroy(VkDevice device);
+
+	// The frame slot's fence has signaled. Primitives are in pixels of an overlay extent wide
+	void beginFrame(uint32_t frameIndex, VkExtent2D extent);
+	// Primitives appended from now on are clipped to the rectangle, in overlay pixels
+	void setClipRect(int32_t x, int32_t y, uint32_t width, uint32_t height);
+	void resetClipRect() {
+		setClipRect(0, 0, extent.width, extent.height);
+	}
+	// Rectangle sampling the whole view, tinted by color. The view must stay alive until the frame is done
+	void image(VkImageView view, float x, float y, float width, float height, uint32_t color = 0xFFFFFFFF);
+
+	void triangle(const ImmediateVertex& a, const ImmediateVertex& b, const ImmediateVertex& c) {
+		ImmediateVertex* vertices = allocate(3);
+		vertices[0] = a;
+		vertices[1] = b;
+		vertices[2] = c;
+	}
+	// Corners in winding order, split along the a-c diagonal
+	void quad(const ImmediateVertex& a, const ImmediateVertex& b, const ImmediateVertex& c, const ImmediateVertex& d) {
+		ImmediateVertex* vertices = allocate(6);
+		vertices[0] = a;
+		vertices[1] = b;
+		vertices[2] = c;
+		vertices[3] = a;
+		vertices[4] = c;
+		vertices[5] = d;
+	}
+	void rect(float x, float y, float width, float height, uint32_t color) {
+		quad({ x, y, color }, { x + width, y, color }, { x + width, y + height, color }, { x, y + height, color });
+	}
+	// Quad of width pixels centered on the segment, nothing when both ends are the same
+	void line(const ImmediateVertex& a, const ImmediateVertex& b, float width = 1.0f) {
+		float dx = b.x - a.x;
+		float dy = b.y - a.y;
+		float lengthSquared = dx * dx + dy * dy;
+		if (lengthSquared == 0.0f) {
+			return;
+		}
+		float normalScale = 0.5f * width / std::sqrt(lengthSquared);
+		float nx = -dy * normalScale;
+		float ny = dx * normalScale;
+		quad({ a.x + nx, a.y + ny, a.color }, { b.x + nx, b.y + ny, b.color }, { b.x - nx, b.y - ny, b.color }, { a.x - nx, a.y - ny, a.color });
+	}
+
+	bool empty() const {
+		return vertexCount == 0;
+	}
+	// Draws the frame's primitives into a scene target renderExtent big, inside its rendering
+	void record(VkCommandBuffer commandBuffer, VkExtent2D renderExtent);
+
+	ImmediateStats stats;
+
+private:
+	struct Batch {
+		VkRect2D clipRect;
+		// VK_NULL_HANDLE for untextured primitives
+		VkDescriptorSet imageSet;
+		uint32_t firstVertex;
+	};
+
+	// Starts a run of primitives sharing the clip rectangle and the image
+	void setBatchState(const VkRect2D& clipRect, VkDescriptorSet imageSet);
+	VkDescriptorSet getImageSet(VkImageView view);
+
+	ImmediateVertex* allocate(uint32_t count) {
+		if (vertexCount + count > vertexCapacity) {
+			throw std::runtime_error("immediate vertex stream frame region overflow!");
+		}
+		ImmediateVertex* allocated = frameVertices + vertexCount;
+		vertexCount += count;
+		return allocated;
+	}
+
+	VulkanEngine* vkEngine = nullptr;
+
+	UniqueBuffer buffer;
+	UniqueDeviceMemory memory;
+	ImmediateVertex* mapped = nullptr;
+	uint32_t vertexCapacity = 0;
+
+	// Region of the current frame, written front to back and never read (the memory may be write combined)
+	uint32_t frameIndex = 0;
+	ImmediateVertex* frameVertices = nullptr;
+	uint32_t vertexCount = 0;
+	VkExtent2D extent = { 0, 0 };
+
+	// Runs of vertices sharing a clip rectangle and an image, each one ends where the next one starts
+	std::vector<Batch> batches;
+
+	// IMMEDIATE_IMAGE_CAPACITY sets per frame in flight, the first imageCount of the frame are written for imageViews
+	UniqueDescriptorPool descriptorPool;
+	std::vector<VkDescriptorSet> imageSets;
+	std::vector<VkImageView> imageViews;
+};
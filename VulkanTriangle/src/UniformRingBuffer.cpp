@@ -0,0 +1,51 @@
+#include "UniformRingBuffer.h"
+
+#include <cstring>
+
+#include "Utils.h"
+
+void UniformRingBuffer::create(VulkanEngine& vkEngine, VkDeviceSize frameSize, uint32_t frameCount) {
+    VkPhysicalDeviceProperties properties;
+    vki.vkGetPhysicalDeviceProperties(vkEngine.physicalDevice, &properties);
+    alignment = properties.limits.minUniformBufferOffsetAlignment;
+
+    // Keep every frame region aligned so the first push of a frame is a valid dynamic offset
+    this->frameSize = (frameSize + alignment - 1) & ~(alignment - 1);
+
+    Utils::createBuffer(vkEngine, this->frameSize * frameCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, *buffer.put(vkEngine.device), *memory.put(vkEngine.device));
+
+    // Mapped once for the whole lifetime of the buffer
+    if (vkd.vkMapMemory(vkEngine.device, memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&mapped)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map uniform ring buffer!");
+    }
+    CaptureLayer::instance().trackMapping(buffer, mapped);
+}
+
+void UniformRingBuffer::destroy(VkDevice device) {
+    if (mapped != nullptr) {
+        vkd.vkUnmapMemory(device, memory);
+        mapped = nullptr;
+    }
+    buffer.reset();
+    memory.reset();
+}
+
+void UniformRingBuffer::beginFrame(uint32_t frameIndex) {
+    frameBegin = frameSize * frameIndex;
+    head = frameBegin;
+}
+
+uint32_t UniformRingBuffer::push(const void* data, VkDeviceSize size) {
+    VkDeviceSize alignedSize = (size + alignment - 1) & ~(alignment - 1);
+    if (head + alignedSize > frameBegin + frameSize) {
+        throw std::runtime_error("uniform ring buffer frame region overflow!");
+    }
+
+    VkDeviceSize offset = head;
+    memcpy(mapped + offset, data, size);
+    CaptureLayer::instance().captureWrite(buffer, offset, data, size);
+    head += alignedSize;
+
+    return static_cast<uint32_t>(offset);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+#include "VulkanHandle.h"
+
+class VulkanEngine;
+
+/**
+    * Persistently mapped uniform buffer split in one region per frame in flight.
+    * Every push returns a dynamic offset (aligned to minUniformBufferOffsetAlignment)
+    * so per-draw data only costs a memcpy, no allocation and no map/unmap.
+    **/
+class UniformRingBuffer {
+public:
+	void create(VulkanEngine& vkEngine, VkDeviceSize frameSize, uint32_t frameCount);
+	void destroy(VkDevice device);
+
+	void beginFrame(uint32_t frameIndex);
+	uint32_t push(const void* data, VkDeviceSize size);
+
+	template<typename T>
+	uint32_t push(const T& data) {
+		return push(&data, sizeof(T));
+	}
+
+	// Pushes of size bytes still fitting in the current frame region
+	VkDeviceSize available(VkDeviceSize size) const {
+		VkDeviceSize alignedSize = (size + alignment - 1) & ~(alignment - 1);
+		return (frameBegin + frameSize - head) / alignedSize;
+	}
+
+	UniqueBuffer buffer;
+	UniqueDeviceMemory memory;
+	VkDeviceSize frameSize = 0;
+	VkDeviceSize alignment = 0;
+
+private:
+	uint8_t* mapped = nullptr;
+	VkDeviceSize frameBegin = 0;
+	VkDeviceSize head = 0;
+};
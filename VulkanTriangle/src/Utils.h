@@ -1,14 +1,17 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include "VulkanEngine.h"
+#include "capture/CaptureLayer.h"
+#include "log/AsyncLogger.h"
 
 class Utils {
 public:
 	static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData) {
-        std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
+        AsyncLogger::instance().log(messageSeverity, pCallbackData);
 
         return VK_FALSE;
     }
@@ -17,35 +20,198 @@ public:
         QueueFamilyIndices indices;
 
         uint32_t queueFamilyCount = 0;
-        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+        vki.vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
 
         std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+        vki.vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
 
         // Find Queue Family with graphics support
         int i = 0;
         for (const auto& queueFamily : queueFamilies) {
-            if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-                indices.graphicsFamily = i;
+            if (!indices.isComplete()) {
+                if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                    indices.graphicsFamily = i;
+                }
+
+                // All the outputs are presented at once, from a queue that supports every surface
+                VkBool32 presentSupport = !vkEngine.outputs.empty();
+                for (const WindowOutput& output : vkEngine.outputs) {
+                    VkBool32 surfaceSupport = false;
+                    vki.vkGetPhysicalDeviceSurfaceSupportKHR(device, i, output.surface, &surfaceSupport);
+                    presentSupport = presentSupport && surfaceSupport;
+                }
+
+                if (presentSupport) {
+                    indices.presentFamily = i;
+                }
             }
 
-            VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, vkEngine.surface, &presentSupport);
-
-            if (presentSupport) {
-                indices.presentFamily = i;
+            // Prefer a compute-only family so the simulation runs alongside the graphics work
+            if (!indices.computeFamily.has_value() && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+                indices.computeFamily = i;
             }
 
-            if (indices.isComplete()) {
+            if (indices.isComplete() && indices.computeFamily.has_value()) {
                 break;
             }
 
             i++;
         }
+
+        // Headless engines present nothing, the graphics family stands in for the present one
+        if (vkEngine.outputs.empty()) {
+            indices.presentFamily = indices.graphicsFamily;
+        }
+
+        // Graphics families always support compute, fall back to it when there is no async compute family
+        if (!indices.computeFamily.has_value()) {
+            indices.computeFamily = indices.graphicsFamily;
+        }
         return indices;
     }
 
+    static uint32_t findMemoryType(VulkanEngine& vkEngine, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vki.vkGetPhysicalDeviceMemoryProperties(vkEngine.physicalDevice, &memProperties);
+
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return i;
+            }
+        }
+
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    static void createBuffer(VulkanEngine& vkEngine, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, const std::vector<uint32_t>& queueFamilies = {}) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+
+        // Buffers shared between distinct queue families avoid ownership transfers by being concurrent
+        if (queueFamilies.size() > 1) {
+            bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+            bufferInfo.pQueueFamilyIndices = queueFamilies.data();
+        }
+        else {
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        }
+
+        if (vkd.vkCreateBuffer(vkEngine.device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create buffer!");
+        }
+        CaptureLayer::instance().track(CaptureObjectType::Buffer, buffer);
+
+        VkMemoryRequirements memRequirements;
+        vkd.vkGetBufferMemoryRequirements(vkEngine.device, buffer, &memRequirements);
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(vkEngine, memRequirements.memoryTypeBits, properties);
+
+        if (vkd.vkAllocateMemory(vkEngine.device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate buffer memory!");
+        }
+
+        vkd.vkBindBufferMemory(vkEngine.device, buffer, bufferMemory, 0);
+    }
+
+    static VkCommandBuffer beginSingleTimeCommands(VulkanEngine& vkEngine) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = vkEngine.commandPool;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkd.vkAllocateCommandBuffers(vkEngine.device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        return commandBuffer;
+    }
+
+    static void endSingleTimeCommands(VulkanEngine& vkEngine, VkCommandBuffer commandBuffer) {
+        vkd.vkEndCommandBuffer(commandBuffer);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+
+        vkd.vkQueueSubmit(vkEngine.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+        vkd.vkQueueWaitIdle(vkEngine.graphicsQueue);
+
+        vkd.vkFreeCommandBuffers(vkEngine.device, vkEngine.commandPool, 1, &commandBuffer);
+    }
+
+    static void copyBuffer(VulkanEngine& vkEngine, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+        VkCommandBuffer commandBuffer = beginSingleTimeCommands(vkEngine);
+
+        VkBufferCopy copyRegion{};
+        copyRegion.size = size;
+        vkd.vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+
+        endSingleTimeCommands(vkEngine, commandBuffer);
+    }
+
+    // Viewport and scissor are dynamic state of every graphics pipeline
+    static void setViewport(VkCommandBuffer commandBuffer, VkExtent2D extent) {
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = (float)extent.width;
+        viewport.height = (float)extent.height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        CaptureLayer::cmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+        VkRect2D scissor{};
+        scissor.offset = { 0, 0 };
+        scissor.extent = extent;
+        CaptureLayer::cmdSetScissor(commandBuffer, 0, 1, &scissor);
+    }
+
+    // Secondary command buffers executed in the scene target, inheriting the render pass or the dynamic rendering format
+    static VkResult beginSceneCommandBuffer(VulkanEngine& vkEngine, VkCommandBuffer commandBuffer) {
+        VkCommandBufferInheritanceRenderingInfo renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachmentFormats = &vkEngine.colorFormat;
+        renderingInfo.viewMask = vkEngine.getViewMask();
+        renderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        // No framebuffer, they are executed with whichever scene target the frame renders to
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.pNext = vkEngine.dynamicRendering ? &renderingInfo : nullptr;
+        inheritanceInfo.renderPass = vkEngine.renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+        return CaptureLayer::beginCommandBuffer(commandBuffer, &beginInfo);
+    }
+
+    // Seconds on a steady clock, valid without GLFW which headless engines never initialize
+    static double getTime() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
     static std::vector<char> readFile(const std::string& filename) {
         std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
@@ -0,0 +1,17 @@
+#include "VulkanDispatch.h"
+
+VulkanInstanceDispatch vki;
+VulkanDeviceDispatch vkd;
+
+void VulkanInstanceDispatch::load(VkInstance instance) {
+#define VULKAN_LOAD_INSTANCE_FUNCTION(name) name = (PFN_##name)vkGetInstanceProcAddr(instance, #name);
+    VULKAN_INSTANCE_FUNCTIONS(VULKAN_LOAD_INSTANCE_FUNCTION)
+#undef VULKAN_LOAD_INSTANCE_FUNCTION
+}
+
+void VulkanDeviceDispatch::load(VkDevice device) {
+    // Entry points of the driver, device functions of a disabled extension or version are null
+#define VULKAN_LOAD_DEVICE_FUNCTION(name) name = (PFN_##name)vki.vkGetDeviceProcAddr(device, #name);
+    VULKAN_DEVICE_FUNCTIONS(VULKAN_LOAD_DEVICE_FUNCTION)
+#undef VULKAN_LOAD_DEVICE_FUNCTION
+}
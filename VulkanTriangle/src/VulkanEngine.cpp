@@ -1,34 +1,324 @@
 #include "VulkanEngine.h"
 
-void VulkanEngine::drawFrame() {
-    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+#include <algorithm>
+#include <cmath>
+#include <iostream>
 
-    uint32_t imageIndex;
-    vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
-    // Check if a previous frame is using this image (i.e. there is its fence to wait on)
-    if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
-        vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Utils.h"
+#include "config/VulkanGraphicPipeline.h"
+#include "log/AsyncLogger.h"
+
+/**
+    * Builds the job graph of one frame. Simulation and culling of this frame only wait for the
+    * previous culling, so they overlap the recording and submission of the previous frame.
+    * Recording and submission stay ordered because they share the queues and per-frame slots.
+    **/
+FrameJobs VulkanEngine::scheduleFrame(const FrameJobs& previousFrame) {
+    size_t frameSlot = scheduledFrames++ % MAX_FRAMES_IN_FLIGHT;
+
+    JobHandle input = jobSystem.createJob([this, frameSlot]() { processInput(frameSlot); });
+    JobHandle simulate = jobSystem.createJob([this]() { simulateScene(); });
+    JobHandle cull = jobSystem.createJob([this, frameSlot]() { buildDrawList(frameSlot); });
+    JobHandle record = jobSystem.createJob([this]() { prepareFrame(); });
+    JobHandle submit = jobSystem.createJob([this]() { submitFrame(); });
+
+    jobSystem.addDependency(input, previousFrame.cull);
+    jobSystem.addDependency(simulate, input);
+    jobSystem.addDependency(simulate, previousFrame.cull);
+    jobSystem.addDependency(cull, simulate);
+    jobSystem.addDependency(record, cull);
+    jobSystem.addDependency(record, previousFrame.submit);
+    jobSystem.addDependency(submit, record);
+
+    for (const auto& job : { input, simulate, cull, record, submit }) {
+        jobSystem.submit(job);
+    }
+
+    return FrameJobs{ cull, submit };
+}
+
+/**
+    * Drains the events pushed by the main thread. Input jobs are chained through the previous
+    * frame's cull, so the render side stays the single consumer of inputQueue.
+    **/
+void VulkanEngine::processInput(size_t frameSlot) {
+    inputTimestamps[frameSlot] = 0.0;
+
+    InputEvent event;
+    while (inputQueue.pop(event)) {
+        if (inputTimestamps[frameSlot] == 0.0) {
+            inputTimestamps[frameSlot] = event.timestamp;
+        }
+
+        switch (event.type) {
+        case InputEventType::Key:
+            // Both calls are thread safe, the empty event wakes the main thread up
+            if (event.code == GLFW_KEY_ESCAPE && event.action == GLFW_PRESS) {
+                glfwSetWindowShouldClose(outputs[0].window, GLFW_TRUE);
+                glfwPostEmptyEvent();
+            }
+            if (event.code == GLFW_KEY_F12 && event.action == GLFW_PRESS && !capturePath.empty()) {
+                captureRequested = true;
+            }
+            if (event.code == GLFW_KEY_F5 && event.action == GLFW_PRESS) {
+                reloadRequested = true;
+            }
+            if (event.code == GLFW_KEY_F3 && event.action == GLFW_PRESS) {
+                overlayVisible = !overlayVisible;
+            }
+            break;
+        case InputEventType::MouseButton:
+            // The cursor enters a window before it can be clicked, its last position is in that window
+            if (event.code == GLFW_MOUSE_BUTTON_LEFT && event.action == GLFW_PRESS && event.window == cursorWindow) {
+                pickObject(event.window);
+            }
+            break;
+        case InputEventType::CursorPosition:
+            cursorWindow = event.window;
+            cursorX = event.x;
+            cursorY = event.y;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/**
+    * Casts a ray from the camera through the cursor into the scene BVH. The previous frame's
+    * cull is done and this frame's refit waits for the input job, so the BVH is not changing.
+    **/
+void VulkanEngine::pickObject(uint32_t window) {
+    VkExtent2D extent = outputs[window].swapChainExtent;
+    if (extent.width == 0 || extent.height == 0) {
+        return;
+    }
+
+    // Every window shows its own view when there are as many of them, all of them side by side otherwise
+    double viewX = cursorX / extent.width;
+    uint32_t pickedView = 0;
+    if (viewCount > 1 && outputs.size() == viewCount) {
+        pickedView = window;
+    }
+    else if (viewCount > 1) {
+        pickedView = std::min(static_cast<uint32_t>(viewX * viewCount), viewCount - 1);
+        viewX = viewX * viewCount - pickedView;
+    }
+
+    // Vulkan clip space has y pointing down like the window coordinates
+    float ndcX = static_cast<float>(viewX) * 2.0f - 1.0f;
+    float ndcY = static_cast<float>(cursorY / extent.height) * 2.0f - 1.0f;
+    glm::mat4 inverseViewProj = glm::inverse(camera.proj[pickedView] * camera.view[pickedView]);
+    glm::vec4 nearPoint = inverseViewProj * glm::vec4(ndcX, ndcY, 0.0f, 1.0f);
+    glm::vec4 farPoint = inverseViewProj * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+    glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+    glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - origin;
+
+    float distance;
+    uint32_t object = sceneBvh.pick(&origin[0], &direction[0], distance);
+    if (object == BVH_NO_OBJECT) {
+        std::cout << "picked nothing" << "\n";
+    }
+    else {
+        std::cout << "picked object " << object << " at distance " << distance << "\n";
+    }
+}
+
+void VulkanEngine::collectInputLatency(double latencyMs) {
+    inputLatencyStats.totalMs += latencyMs;
+    inputLatencyStats.maxMs = std::max(inputLatencyStats.maxMs, latencyMs);
+    inputLatencyStats.samples++;
+
+    if (inputLatencyStats.samples == INPUT_LATENCY_STATS_INTERVAL) {
+        std::cout << "input to present: average " << inputLatencyStats.totalMs / inputLatencyStats.samples << " ms, max "
+            << inputLatencyStats.maxMs << " ms, " << droppedInputEvents.load() << " events dropped" << "\n";
+        inputLatencyStats = InputLatencyStats{};
+    }
+}
+
+void VulkanEngine::simulateScene() {
+    simulatedFrames++;
+    for (uint32_t i = 0; i < movingObjectCount; i++) {
+        uint32_t object = firstMovingObject + i;
+        float angle = MOVING_OBJECT_SPEED * simulatedFrames + 6.2831853f * i / movingObjectCount;
+        scene.setPosition(object, MOVING_OBJECT_ORBIT_RADIUS * std::cos(angle), MOVING_OBJECT_ORBIT_RADIUS * std::sin(angle), 0.0f);
+        movedObjects.push_back(object);
+    }
+
+    jobSystem.parallelFor(scene.size(), SCENE_JOB_BATCH_SIZE, [this](size_t begin, size_t end) {
+        scene.updateLocalTransforms(begin, end);
+    });
+    scene.resolveHierarchy();
+    sceneBvh.update(scene, movedObjects);
+    movedObjects.clear();
+}
+
+void VulkanEngine::prepareFrame() {
+    vkd.vkWaitForFences(device, 1, inFlightFences[currentFrame].address(), VK_TRUE, UINT64_MAX);
+    // The fence of this slot was the one of the frame MAX_FRAMES_IN_FLIGHT frames ago, every frame up to it is done
+    if (frameNumber >= static_cast<uint64_t>(MAX_FRAMES_IN_FLIGHT)) {
+        deletionQueue.collect(frameNumber - MAX_FRAMES_IN_FLIGHT);
+    }
+    if (reloadRequested.exchange(false)) {
+        reloadPipelines();
+    }
+
+    // Cached command buffers were recorded before the capture, they are all recorded again so it holds them
+    if (captureRequested.exchange(false) && !CaptureLayer::instance().isCapturing()) {
+        CaptureHeader header;
+        header.colorFormat = colorFormat;
+        header.width = outputs[0].swapChainExtent.width;
+        header.height = outputs[0].swapChainExtent.height;
+        header.framesInFlight = MAX_FRAMES_IN_FLIGHT;
+        header.viewCount = viewCount;
+        header.drawBatchCapacity = commandBatches.getBatchCapacity();
+        CaptureLayer::instance().start(capturePath, header, meshPaths);
+
+        commandBatches.invalidate();
+        std::fill(particleCommandExtents.begin(), particleCommandExtents.end(), VkExtent2D{ 0, 0 });
+        capturedFrames = 0;
+        std::cout << "capturing " << captureFrames << " frames to " << capturePath << "\n";
+    }
+
+    double now = Utils::getTime();
+    float deltaTime = static_cast<float>(now - lastFrameTime);
+    if (frameNumber >= static_cast<uint64_t>(MAX_FRAMES_IN_FLIGHT)) {
+        collectOverlapStats((now - lastFrameTime) * 1000.0);
+    }
+    lastFrameTime = now;
+
+    vkd.vkResetCommandBuffer(computeCommandBuffers[currentFrame], 0);
+    recordComputeCommandBuffer(computeCommandBuffers[currentFrame], frameNumber == 0 ? 0.0f : deltaTime);
+
+    for (WindowOutput& output : outputs) {
+        vkd.vkAcquireNextImageKHR(device, output.swapChain, UINT64_MAX, output.imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &output.currentImageIndex);
+        // Check if a previous frame is using this image (i.e. there is its fence to wait on)
+        if (output.imagesInFlight[output.currentImageIndex] != VK_NULL_HANDLE) {
+            vkd.vkWaitForFences(device, 1, &output.imagesInFlight[output.currentImageIndex], VK_TRUE, UINT64_MAX);
+        }
+        // Mark the image as now being in use by this frame
+        output.imagesInFlight[output.currentImageIndex] = inFlightFences[currentFrame];
+    }
+
+    // The fence guarantees the GPU is done with this frame's ring region and command buffer
+    uniformRing.beginFrame(static_cast<uint32_t>(currentFrame));
+    immediate.beginFrame(static_cast<uint32_t>(currentFrame), outputs.empty() ? offscreenExtent : outputs[0].swapChainExtent);
+    vkd.vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+    recordCommandBuffer(commandBuffers[currentFrame]);
+}
+
+/**
+    * Creates the graphics pipelines again from the shaders on disk. The other frame in flight
+    * may still draw with the old ones, they are retired rather than waiting for the device.
+    * Pipelines failing to build leave the old ones in place.
+    **/
+void VulkanEngine::reloadPipelines() {
+    UniquePipelineLayout oldPipelineLayout = std::move(pipelineLayout);
+    UniquePipeline oldGraphicsPipeline = std::move(graphicsPipeline);
+    UniquePipeline oldMeshPipeline = std::move(meshPipeline);
+    UniquePipelineLayout oldParticlePipelineLayout = std::move(particlePipelineLayout);
+    UniquePipeline oldParticlePipeline = std::move(particlePipeline);
+    UniquePipelineLayout oldImmediatePipelineLayout = std::move(immediatePipelineLayout);
+    UniquePipeline oldImmediatePipeline = std::move(immediatePipeline);
+    UniquePipelineLayout oldImmediateTexturedPipelineLayout = std::move(immediateTexturedPipelineLayout);
+    UniquePipeline oldImmediateTexturedPipeline = std::move(immediateTexturedPipeline);
+
+    try {
+        VulkanGraphicPipeline::createPipelines(*this);
+    }
+    catch (const std::exception& e) {
+        CaptureLayer& capture = CaptureLayer::instance();
+        capture.untrack(CaptureObjectType::PipelineLayout, pipelineLayout.get());
+        capture.untrack(CaptureObjectType::Pipeline, graphicsPipeline.get());
+        capture.untrack(CaptureObjectType::Pipeline, meshPipeline.get());
+        capture.untrack(CaptureObjectType::PipelineLayout, particlePipelineLayout.get());
+        capture.untrack(CaptureObjectType::Pipeline, particlePipeline.get());
+        capture.untrack(CaptureObjectType::PipelineLayout, immediatePipelineLayout.get());
+        capture.untrack(CaptureObjectType::Pipeline, immediatePipeline.get());
+        capture.untrack(CaptureObjectType::PipelineLayout, immediateTexturedPipelineLayout.get());
+        capture.untrack(CaptureObjectType::Pipeline, immediateTexturedPipeline.get());
+
+        // Nothing recorded the new ones yet, they are destroyed right away
+        pipelineLayout = std::move(oldPipelineLayout);
+        graphicsPipeline = std::move(oldGraphicsPipeline);
+        meshPipeline = std::move(oldMeshPipeline);
+        particlePipelineLayout = std::move(oldParticlePipelineLayout);
+        particlePipeline = std::move(oldParticlePipeline);
+        immediatePipelineLayout = std::move(oldImmediatePipelineLayout);
+        immediatePipeline = std::move(oldImmediatePipeline);
+        immediateTexturedPipelineLayout = std::move(oldImmediateTexturedPipelineLayout);
+        immediateTexturedPipeline = std::move(oldImmediateTexturedPipeline);
+        std::cout << "failed to reload the pipelines: " << e.what() << "\n";
+        return;
+    }
+
+    // Captures refer to the pipelines by the ids of the initialization, a replay builds its own from the same shaders
+    CaptureLayer& capture = CaptureLayer::instance();
+    capture.replace(CaptureObjectType::PipelineLayout, oldPipelineLayout.get(), pipelineLayout.get());
+    capture.replace(CaptureObjectType::Pipeline, oldGraphicsPipeline.get(), graphicsPipeline.get());
+    capture.replace(CaptureObjectType::Pipeline, oldMeshPipeline.get(), meshPipeline.get());
+    capture.replace(CaptureObjectType::PipelineLayout, oldParticlePipelineLayout.get(), particlePipelineLayout.get());
+    capture.replace(CaptureObjectType::Pipeline, oldParticlePipeline.get(), particlePipeline.get());
+    capture.replace(CaptureObjectType::PipelineLayout, oldImmediatePipelineLayout.get(), immediatePipelineLayout.get());
+    capture.replace(CaptureObjectType::Pipeline, oldImmediatePipeline.get(), immediatePipeline.get());
+    capture.replace(CaptureObjectType::PipelineLayout, oldImmediateTexturedPipelineLayout.get(), immediateTexturedPipelineLayout.get());
+    capture.replace(CaptureObjectType::Pipeline, oldImmediateTexturedPipeline.get(), immediateTexturedPipeline.get());
+
+    deletionQueue.retire(std::move(oldPipelineLayout), frameNumber);
+    deletionQueue.retire(std::move(oldGraphicsPipeline), frameNumber);
+    deletionQueue.retire(std::move(oldMeshPipeline), frameNumber);
+    deletionQueue.retire(std::move(oldParticlePipelineLayout), frameNumber);
+    deletionQueue.retire(std::move(oldParticlePipeline), frameNumber);
+    deletionQueue.retire(std::move(oldImmediatePipelineLayout), frameNumber);
+    deletionQueue.retire(std::move(oldImmediatePipeline), frameNumber);
+    deletionQueue.retire(std::move(oldImmediateTexturedPipelineLayout), frameNumber);
+    deletionQueue.retire(std::move(oldImmediateTexturedPipeline), frameNumber);
+
+    // The cached secondary command buffers bind the old pipelines
+    commandBatches.invalidate();
+    std::fill(particleCommandExtents.begin(), particleCommandExtents.end(), VkExtent2D{ 0, 0 });
+    std::cout << "reloaded the pipelines, " << deletionQueue.size() << " objects waiting for destruction\n";
+}
+
+void VulkanEngine::submitFrame() {
+    // Submit the simulation first so it runs on the compute queue while the previous frame is still rendering
+    VkSubmitInfo computeSubmitInfo{};
+    computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    computeSubmitInfo.commandBufferCount = 1;
+    computeSubmitInfo.pCommandBuffers = &computeCommandBuffers[currentFrame];
+    computeSubmitInfo.signalSemaphoreCount = 1;
+    computeSubmitInfo.pSignalSemaphores = computeFinishedSemaphores[currentFrame].address();
+
+    if (CaptureLayer::queueSubmit(computeQueue, 1, &computeSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit compute command buffer!");
     }
-    // Mark the image as now being in use by this frame
-    imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
+    // The swap chain images are first touched by the upscale, the scene renders before they are acquired
+    frameWaitSemaphores.clear();
+    frameWaitStages.clear();
+    for (const WindowOutput& output : outputs) {
+        frameWaitSemaphores.push_back(output.imageAvailableSemaphores[currentFrame]);
+        frameWaitStages.push_back(VK_PIPELINE_STAGE_TRANSFER_BIT);
+    }
+    frameWaitSemaphores.push_back(computeFinishedSemaphores[currentFrame]);
+    frameWaitStages.push_back(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(frameWaitSemaphores.size());
+    submitInfo.pWaitSemaphores = frameWaitSemaphores.data();
+    submitInfo.pWaitDstStageMask = frameWaitStages.data();
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+    submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 
-    VkSemaphore signalSemaphores[] = { imageAvailableSemaphores[currentFrame] };
+    VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    vkResetFences(device, 1, &inFlightFences[currentFrame]);
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+    vkd.vkResetFences(device, 1, inFlightFences[currentFrame].address());
+    if (CaptureLayer::queueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
     }
 
@@ -37,62 +327,515 @@ void VulkanEngine::drawFrame() {
 
     presentInfo.waitSemaphoreCount = 1;
     presentInfo.pWaitSemaphores = signalSemaphores;
-    VkSwapchainKHR swapChains[] = { swapChain };
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = swapChains;
-    presentInfo.pImageIndices = &imageIndex;
+    // Every output is presented by the same call, the presentation engine can flip them together
+    presentSwapChains.clear();
+    presentImageIndices.clear();
+    for (const WindowOutput& output : outputs) {
+        presentSwapChains.push_back(output.swapChain);
+        presentImageIndices.push_back(output.currentImageIndex);
+    }
+    presentInfo.swapchainCount = static_cast<uint32_t>(presentSwapChains.size());
+    presentInfo.pSwapchains = presentSwapChains.data();
+    presentInfo.pImageIndices = presentImageIndices.data();
 
-    vkQueuePresentKHR(presentQueue, &presentInfo);
+    CaptureLayer::queuePresent(presentQueue, &presentInfo);
+
+    if (CaptureLayer::instance().isCapturing() && ++capturedFrames == captureFrames) {
+        CaptureLayer::instance().stop();
+        std::cout << "captured " << capturedFrames << " frames to " << capturePath << "\n";
+    }
 
-    vkQueueWaitIdle(presentQueue);
+    if (inputTimestamps[currentFrame] != 0.0) {
+        collectInputLatency((Utils::getTime() - inputTimestamps[currentFrame]) * 1000.0);
+    }
 
     currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    frameNumber++;
+}
+
+void VulkanEngine::buildDrawList(size_t frameSlot) {
+    buildDrawList(camera, outputs[0].swapChainExtent.height, drawLists[frameSlot]);
+}
+
+void VulkanEngine::buildDrawList(const CameraUniforms& view, uint32_t targetHeight, std::vector<DrawCommand>& drawList) {
+    // The LODs and the sort order follow the first view, the draws are the same for all of them
+    glm::mat4 viewProj = view.proj[0] * view.view[0];
+    // Size in pixels of a unit at unit distance
+    float pixelsPerUnit = std::abs(view.proj[0][1][1]) * targetHeight * 0.5f;
+    float planes[MAX_VIEWS][6][4];
+    for (uint32_t v = 0; v < viewCount; v++) {
+        glm::mat4 viewProjection = view.proj[v] * view.view[v];
+        SceneStore::extractFrustumPlanes(&viewProjection[0][0], planes[v]);
+    }
+
+    // Every subtree of the BVH root culls into its own list for every view, concatenated in order afterwards
+    uint32_t subtreeCount = sceneBvh.getRootChildCount();
+    visibleBatches.resize(static_cast<size_t>(subtreeCount) * viewCount);
+    jobSystem.parallelFor(visibleBatches.size(), 1, [this, &planes, subtreeCount](size_t begin, size_t end) {
+        for (size_t batch = begin; batch < end; batch++) {
+            visibleBatches[batch].clear();
+            sceneBvh.cullSubtree(planes[batch / subtreeCount], static_cast<uint32_t>(batch % subtreeCount), visibleBatches[batch]);
+        }
+    });
+    if (viewCount > 1) {
+        visibleMarks.resize(scene.size());
+        cullPass++;
+    }
+
+    // Only visible instances reach the command buffer, once however many views see them
+    unsortedDraws.clear();
+    drawKeys.clear();
+    drawOrder.clear();
+    for (const auto& visible : visibleBatches) {
+        for (uint32_t index : visible) {
+            if (viewCount > 1) {
+                if (visibleMarks[index] == cullPass) {
+                    continue;
+                }
+                visibleMarks[index] = cullPass;
+            }
+
+            unsortedDraws.emplace_back();
+            DrawCommand& draw = unsortedDraws.back();
+            draw.object = index;
+            scene.writeWorldMatrix(index, &draw.uniforms.model[0][0]);
+
+            glm::vec4 center = viewProj * draw.uniforms.model * glm::vec4(scene.boundsX[index], scene.boundsY[index], scene.boundsZ[index], 1.0f);
+            float depth = center.w > 0.0f ? center.z / center.w : 0.0f;
+
+            // The triangle pipeline blends, meshes are opaque
+            if (scene.meshes[index] != NO_MESH) {
+                selectMeshLod(draw, scene.meshes[index], viewProj, pixelsPerUnit);
+                draw.sortKey = makeDrawSortKey(DRAW_PASS_OPAQUE, DRAW_PIPELINE_MESH, 0, draw.mesh, depth);
+            }
+            else {
+                draw.sortKey = makeDrawSortKey(DRAW_PASS_BLENDED, DRAW_PIPELINE_TRIANGLE, 0, NO_MESH, depth);
+            }
+
+            drawKeys.push_back(draw.sortKey);
+            drawOrder.push_back(static_cast<uint32_t>(drawOrder.size()));
+        }
+    }
+
+    // Stable, draws with equal keys stay in scene order
+    drawSorter.sort(jobSystem, drawKeys, drawOrder);
+
+    drawList.resize(unsortedDraws.size());
+    for (size_t i = 0; i < drawOrder.size(); i++) {
+        drawList[i] = unsortedDraws[drawOrder[i]];
+    }
+}
+
+/**
+    * Picks the coarsest LOD whose simplification error, projected with the bounding sphere of
+    * the instance, stays under MESH_LOD_PIXEL_ERROR, then folds the dequantization of the
+    * positions into the model matrix.
+    **/
+void VulkanEngine::selectMeshLod(DrawCommand& draw, uint32_t meshIndex, const glm::mat4& viewProj, float pixelsPerUnit) {
+    const Mesh& mesh = meshes[meshIndex];
+    const glm::mat4& model = draw.uniforms.model;
+
+    float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+    glm::vec4 center = viewProj * model * glm::vec4(mesh.center[0], mesh.center[1], mesh.center[2], 1.0f);
+    float projectedRadius = mesh.radius * scale / std::max(center.w, 1e-4f) * pixelsPerUnit;
+
+    // Errors are relative to the bounds diagonal, twice the radius
+    draw.mesh = meshIndex;
+    draw.lod = 0;
+    for (uint32_t lod = 1; lod < mesh.lods.size(); lod++) {
+        if (mesh.lods[lod].error * 2.0f * projectedRadius > MESH_LOD_PIXEL_ERROR) {
+            break;
+        }
+        draw.lod = lod;
+    }
+
+    glm::vec3 boundsMin(mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2]);
+    glm::vec3 boundsExtent(mesh.boundsExtent[0], mesh.boundsExtent[1], mesh.boundsExtent[2]);
+    draw.uniforms.model = glm::scale(glm::translate(model, boundsMin), boundsExtent);
+}
+
+void VulkanEngine::recordCommandBuffer(VkCommandBuffer commandBuffer) {
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (CaptureLayer::beginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+
+    textures.recordUploads(commandBuffer, static_cast<uint32_t>(currentFrame), frameNumber);
+
+    // Only the scaled part of the scene target is rendered to
+    VkExtent2D renderExtent = dynamicResolution.renderExtent;
+
+    uint32_t firstQuery = static_cast<uint32_t>(currentFrame) * 4 + 2;
+    if (timestampQueryPool != VK_NULL_HANDLE) {
+        CaptureLayer::cmdResetQueryPool(commandBuffer, timestampQueryPool, firstQuery, 2);
+        CaptureLayer::cmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, firstQuery);
+    }
+
+    // The camera is the first push of the frame, its offset is the same every time this slot is used
+    uint32_t cameraOffset = uniformRing.push(camera);
+    secondaryCommandBuffers.clear();
+    commandBatches.prepare(static_cast<uint32_t>(currentFrame), drawLists[currentFrame], cameraOffset, renderExtent, secondaryCommandBuffers);
+    if (particleCommandExtents[currentFrame].width != renderExtent.width || particleCommandExtents[currentFrame].height != renderExtent.height) {
+        recordParticleCommandBuffer(static_cast<uint32_t>(currentFrame), renderExtent);
+    }
+    secondaryCommandBuffers.push_back(particleCommandBuffers[currentFrame]);
+    // Overlays are executed last, over the scene
+    if (overlayVisible && !outputs.empty()) {
+        drawOverlay();
+    }
+    // Captures do not record descriptor writes, a replay could not bind the panel's images
+    if (!panelTextures.empty() && !outputs.empty() && !CaptureLayer::instance().isCapturing()) {
+        drawTexturePanel();
+    }
+    if (!immediate.empty()) {
+        recordImmediateCommandBuffer(static_cast<uint32_t>(currentFrame), renderExtent);
+        secondaryCommandBuffers.push_back(immediateCommandBuffers[currentFrame]);
+    }
+    collectBatchStats();
+
+    VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
+    dynamicResolution.beginScene(commandBuffer, static_cast<uint32_t>(currentFrame), clearColor);
+    CaptureLayer::cmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
+    dynamicResolution.endScene(commandBuffer, static_cast<uint32_t>(currentFrame));
+
+    // Before the upscale, which waits for the swap chain image and would count the wait for it
+    if (timestampQueryPool != VK_NULL_HANDLE) {
+        CaptureLayer::cmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, firstQuery + 1);
+    }
+
+    dynamicResolution.recordUpscale(commandBuffer, static_cast<uint32_t>(currentFrame), outputs);
+
+    if (CaptureLayer::endCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record command buffer!");
+    }
+}
+
+/**
+    * The particle draw only depends on the frame slot and the render extent, it is recorded into
+    * a secondary command buffer executed by every frame using that slot until the extent changes.
+    **/
+void VulkanEngine::recordParticleCommandBuffer(uint32_t frameIndex, VkExtent2D extent) {
+    // The fence of this frame slot was waited on, beginning resets the command buffer
+    VkCommandBuffer commandBuffer = particleCommandBuffers[frameIndex];
+    if (Utils::beginSceneCommandBuffer(*this, commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording particle command buffer!");
+    }
+
+    VkDeviceSize offsets[] = { 0 };
+    Utils::setViewport(commandBuffer, extent);
+    CaptureLayer::cmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, particlePipeline);
+    CaptureLayer::cmdBindVertexBuffers(commandBuffer, 0, 1, particleBuffers[frameIndex].address(), offsets);
+    CaptureLayer::cmdDraw(commandBuffer, PARTICLE_COUNT, 1, 0, 0);
+
+    if (CaptureLayer::endCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record particle command buffer!");
+    }
+    particleCommandExtents[frameIndex] = extent;
+}
+
+/**
+    * GPU frame time graph of the last OVERLAY_HISTORY_SIZE frames against the dynamic resolution
+    * budget, and the render scale below it. Times over budget are drawn red.
+    **/
+void VulkanEngine::drawOverlay() {
+    double start = Utils::getTime();
+
+    const float left = 16.0f;
+    const float top = 16.0f;
+    const float graphWidth = 2.0f * OVERLAY_HISTORY_SIZE;
+    const float graphHeight = 100.0f;
+    const float barHeight = 8.0f;
+    const float padding = 4.0f;
+    // The budget sits at the middle of the graph
+    const float msToPixels = graphHeight / (2.0f * static_cast<float>(dynamicResolution.budgetMs));
+    const uint32_t underBudget = immediateColor(0.2f, 0.9f, 0.3f);
+    const uint32_t overBudget = immediateColor(1.0f, 0.2f, 0.2f);
+
+    immediate.rect(left - padding, top - padding, graphWidth + 2.0f * padding, graphHeight + barHeight + 3.0f * padding, immediateColor(0.0f, 0.0f, 0.0f, 0.6f));
+
+    // Spikes past twice the budget are clipped to the graph
+    float bottom = top + graphHeight;
+    immediate.setClipRect(static_cast<int32_t>(left), static_cast<int32_t>(top), static_cast<uint32_t>(graphWidth), static_cast<uint32_t>(graphHeight));
+    float budgetY = bottom - static_cast<float>(dynamicResolution.budgetMs) * msToPixels;
+    uint32_t budgetColor = immediateColor(1.0f, 0.9f, 0.2f, 0.5f);
+    immediate.line({ left, budgetY, budgetColor }, { left + graphWidth, budgetY, budgetColor });
+
+    // Oldest sample on the left
+    ImmediateVertex previous{};
+    for (uint32_t i = 0; i < OVERLAY_HISTORY_SIZE; i++) {
+        float frameMs = overlayFrameTimes[(overlayFrameIndex + i) % OVERLAY_HISTORY_SIZE];
+        ImmediateVertex current = { left + 2.0f * i, bottom - frameMs * msToPixels, frameMs > dynamicResolution.budgetMs ? overBudget : underBudget };
+        if (i > 0) {
+            immediate.line(previous, current, 1.5f);
+        }
+        previous = current;
+    }
+    immediate.resetClipRect();
+
+    float scale = static_cast<float>(dynamicResolution.renderExtent.width) / outputs[0].swapChainExtent.width;
+    float barTop = bottom + padding;
+    immediate.rect(left, barTop, graphWidth, barHeight, immediateColor(0.3f, 0.3f, 0.3f, 0.8f));
+    immediate.rect(left, barTop, graphWidth * scale, barHeight, immediateColor(0.3f, 0.6f, 1.0f));
+
+    immediate.stats.totalBuildMs += (Utils::getTime() - start) * 1000.0;
+}
+
+/**
+    * Textures given on the command line side by side along the bottom of the primary window.
+    * Touching them every frame asks the streamer for the mip matching TEXTURE_PANEL_SIZE, until
+    * their first mips are resident an outline stands in for them.
+    **/
+void VulkanEngine::drawTexturePanel() {
+    const float padding = 16.0f;
+    const float size = static_cast<float>(TEXTURE_PANEL_SIZE);
+    float top = outputs[0].swapChainExtent.height - padding - size;
+
+    for (size_t i = 0; i < panelTextures.size(); i++) {
+        TextureHandle texture = panelTextures[i];
+        textures.touch(texture, textures.findMip(texture, TEXTURE_PANEL_SIZE));
+
+        float left = padding + i * (size + padding);
+        VkImageView view = textures.getView(texture);
+        if (view != VK_NULL_HANDLE) {
+            immediate.image(view, left, top, size, size);
+        }
+        else {
+            uint32_t outline = immediateColor(0.5f, 0.5f, 0.5f, 0.8f);
+            immediate.line({ left, top, outline }, { left + size, top, outline });
+            immediate.line({ left + size, top, outline }, { left + size, top + size, outline });
+            immediate.line({ left + size, top + size, outline }, { left, top + size, outline });
+            immediate.line({ left, top + size, outline }, { left, top, outline });
+        }
+    }
+}
+
+/**
+    * The immediate primitives change every frame, their secondary command buffer is recorded
+    * again each time, a bind and one draw per clip rectangle.
+    **/
+void VulkanEngine::recordImmediateCommandBuffer(uint32_t frameIndex, VkExtent2D extent) {
+    VkCommandBuffer commandBuffer = immediateCommandBuffers[frameIndex];
+    if (Utils::beginSceneCommandBuffer(*this, commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording immediate command buffer!");
+    }
+
+    immediate.record(commandBuffer, extent);
+
+    if (CaptureLayer::endCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record immediate command buffer!");
+    }
+}
+
+void VulkanEngine::recordComputeCommandBuffer(VkCommandBuffer commandBuffer, float deltaTime) {
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (CaptureLayer::beginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording compute command buffer!");
+    }
+
+    uint32_t firstQuery = static_cast<uint32_t>(currentFrame) * 4;
+    if (timestampQueryPool != VK_NULL_HANDLE) {
+        CaptureLayer::cmdResetQueryPool(commandBuffer, timestampQueryPool, firstQuery, 2);
+        CaptureLayer::cmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, firstQuery);
+    }
+
+    // The previous step wrote the buffer this step reads, both submitted to the compute queue
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    CaptureLayer::cmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    ParticlePushConstants pushConstants{};
+    pushConstants.deltaTime = deltaTime;
+    pushConstants.particleCount = PARTICLE_COUNT;
+
+    CaptureLayer::cmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+    CaptureLayer::cmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 1, &computeDescriptorSets[currentFrame], 0, nullptr);
+    CaptureLayer::cmdPushConstants(commandBuffer, computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ParticlePushConstants), &pushConstants);
+    CaptureLayer::cmdDispatch(commandBuffer, (PARTICLE_COUNT + PARTICLE_WORKGROUP_SIZE - 1) / PARTICLE_WORKGROUP_SIZE, 1, 1);
+
+    if (timestampQueryPool != VK_NULL_HANDLE) {
+        CaptureLayer::cmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, firstQuery + 1);
+    }
+
+    if (CaptureLayer::endCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record compute command buffer!");
+    }
+}
+
+/**
+    * Reads back the timestamps of the frame that used this slot last time. When compute and
+    * graphics overlap, their summed GPU time exceeds the frame interval.
+    **/
+void VulkanEngine::collectBatchStats() {
+    CommandBatchStats& stats = commandBatches.stats;
+    if (stats.frames == COMMAND_BATCH_STATS_INTERVAL) {
+        double frames = stats.frames;
+        std::cout << "draw batches per frame: " << stats.totalReused / frames << " reused, " << stats.totalRecorded / frames << " re-recorded" << "\n";
+        // Without sorting and bind elision every draw would bind a pipeline, a descriptor set and its buffers
+        std::cout << "binds per frame for " << stats.totalDraws / frames << " draws: " << stats.totalPipelineBinds / frames << " pipeline, "
+            << stats.totalDescriptorBinds / frames << " descriptor set, " << stats.totalBufferBinds / frames << " vertex/index buffer" << "\n";
+        stats = CommandBatchStats{};
+    }
+
+    ImmediateStats& immediateStats = immediate.stats;
+    if (immediateStats.frames == IMMEDIATE_STATS_INTERVAL) {
+        double frames = immediateStats.frames;
+        double triangles = immediateStats.totalVertices / 3.0;
+        std::cout << "immediate primitives per frame: " << triangles / frames << " triangles in " << immediateStats.totalDraws / frames << " draws, "
+            << immediateStats.totalBuildMs * 1000000.0 / triangles << " ns per triangle" << "\n";
+        immediateStats = ImmediateStats{};
+    }
+}
+
+void VulkanEngine::collectOverlapStats(double frameMs) {
+    if (timestampQueryPool == VK_NULL_HANDLE) return;
+
+    uint64_t timestamps[4];
+    VkResult result = vkd.vkGetQueryPoolResults(device, timestampQueryPool, static_cast<uint32_t>(currentFrame) * 4, 4,
+        sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) return;
+
+    double graphicsMs = (timestamps[3] - timestamps[2]) * timestampPeriod / 1000000.0;
+    dynamicResolution.update(graphicsMs);
+    overlayFrameTimes[overlayFrameIndex] = static_cast<float>(graphicsMs);
+    overlayFrameIndex = (overlayFrameIndex + 1) % OVERLAY_HISTORY_SIZE;
+
+    overlapStats.computeMs += (timestamps[1] - timestamps[0]) * timestampPeriod / 1000000.0;
+    overlapStats.graphicsMs += graphicsMs;
+    overlapStats.frameMs += frameMs;
+    overlapStats.samples++;
+
+    if (overlapStats.samples == OVERLAP_STATS_INTERVAL) {
+        double averageComputeMs = overlapStats.computeMs / overlapStats.samples;
+        double averageGraphicsMs = overlapStats.graphicsMs / overlapStats.samples;
+        double averageFrameMs = overlapStats.frameMs / overlapStats.samples;
+        std::cout << PARTICLE_COUNT << " particles: compute " << averageComputeMs << " ms, graphics " << averageGraphicsMs
+            << " ms, frame " << averageFrameMs << " ms (serial would be " << averageComputeMs + averageGraphicsMs << " ms)" << "\n";
+        overlapStats = ComputeOverlapStats{};
+    }
+}
+
+void VulkanEngine::renderLoop() {
+    try {
+        // The render thread owns the job system and helps running jobs while it waits on them
+        jobSystem.start(std::max(2u, std::thread::hardware_concurrency()) - 1);
+
+        FrameJobs lastFrame;
+        while (renderRunning) {
+            FrameJobs frame = scheduleFrame(lastFrame);
+            // At most MAX_FRAMES_IN_FLIGHT frame graphs in flight, this thread runs jobs meanwhile
+            jobSystem.wait(lastFrame.submit);
+            lastFrame = frame;
+        }
+        jobSystem.wait(lastFrame.submit);
+    }
+    catch (...) {
+        renderException = std::current_exception();
+    }
+    jobSystem.stop();
+
+    renderRunning = false;
+    glfwPostEmptyEvent();
 }
 
 void VulkanEngine::mainLoop() {
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-        VulkanEngine::drawFrame();
+    renderRunning = true;
+    renderThread = std::thread(&VulkanEngine::renderLoop, this);
+
+    // Window manager stalls (moving, resizing) block here without holding back the render thread
+    // Closing any of the windows stops the engine
+    auto windowClosed = [this]() {
+        return std::any_of(outputs.begin(), outputs.end(), [](const WindowOutput& output) { return glfwWindowShouldClose(output.window); });
+    };
+    while (renderRunning && !windowClosed()) {
+        glfwWaitEvents();
     }
+
+    renderRunning = false;
+    renderThread.join();
+    if (renderException) {
+        std::rethrow_exception(renderException);
+    }
+
+    shutdown();
+}
+
+void VulkanEngine::shutdown() {
     // Wait until the devices is idle before cleaning up
-    vkDeviceWaitIdle(device);
+    vkd.vkDeviceWaitIdle(device);
     cleanup();
 }
 
 void VulkanEngine::cleanup() {
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-        vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(device, inFlightFences[i], nullptr);
+    CaptureLayer::instance().stop();
+    // The device is idle, retired objects no longer wait for their frame
+    deletionQueue.flush();
+    renderFinishedSemaphores.clear();
+    inFlightFences.clear();
+    computeFinishedSemaphores.clear();
+    particleBuffers.clear();
+    particleBuffersMemory.clear();
+    timestampQueryPool.reset();
+    computeCommandPool.reset();
+    computePipeline.reset();
+    computePipelineLayout.reset();
+    computeDescriptorPool.reset();
+    computeDescriptorSetLayout.reset();
+    particlePipeline.reset();
+    particlePipelineLayout.reset();
+    commandPool.reset();
+    descriptorPool.reset();
+    uniformRing.destroy(device);
+    immediate.destroy(device);
+    textures.destroy(device);
+    commandBatches.destroy(device);
+    meshes.clear();
+    dynamicResolution.destroy();
+    graphicsPipeline.reset();
+    meshPipeline.reset();
+    immediatePipeline.reset();
+    immediatePipelineLayout.reset();
+    immediateTexturedPipeline.reset();
+    immediateTexturedPipelineLayout.reset();
+    imageDescriptorSetLayout.reset();
+    pipelineLayout.reset();
+    descriptorSetLayout.reset();
+    renderPass.reset();
+    for (auto& output : outputs) {
+        output.imageAvailableSemaphores.clear();
+        output.swapChainImageViews.clear();
+        output.swapChain.reset();
     }
-    vkDestroyCommandPool(device, commandPool, nullptr);
-    for (auto framebuffer : swapChainFramebuffers) {
-        vkDestroyFramebuffer(device, framebuffer, nullptr);
-    }
-    vkDestroyPipeline(device, graphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-    vkDestroyRenderPass(device, renderPass, nullptr);
-    for (auto imageView : swapChainImageViews) {
-        vkDestroyImageView(device, imageView, nullptr);
-    }
-    vkDestroySwapchainKHR(device, swapChain, nullptr);
-    vkDestroyDevice(device, nullptr);
+    vkd.vkDestroyDevice(device, nullptr);
 
     if (enableValidationLayers) {
         DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
     }
 
-    vkDestroySurfaceKHR(instance, surface, nullptr);
-    vkDestroyInstance(instance, nullptr);
+    for (auto& output : outputs) {
+        vki.vkDestroySurfaceKHR(instance, output.surface, nullptr);
+    }
+    vki.vkDestroyInstance(instance, nullptr);
 
-    glfwDestroyWindow(window);
+    // Last callbacks can come from vkDestroyInstance
+    AsyncLogger::instance().stop();
+
+    for (auto& output : outputs) {
+        glfwDestroyWindow(output.window);
+    }
 
     glfwTerminate();
 }
 
 void VulkanEngine::DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator) {
-    auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
-    if (func != nullptr) {
-        func(instance, debugMessenger, pAllocator);
+    if (vki.vkDestroyDebugUtilsMessengerEXT != nullptr) {
+        vki.vkDestroyDebugUtilsMessengerEXT(instance, debugMessenger, pAllocator);
     }
 }
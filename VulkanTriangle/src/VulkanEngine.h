@@ -5,6 +5,30 @@
 #include <vulkan/vulkan.h>
 #include <vector>
 #include <optional>
+#include <atomic>
+#include <exception>
+#include <string>
+#include <thread>
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "CommandBatchCache.h"
+#include "DeferredDestructionQueue.h"
+#include "DynamicResolution.h"
+#include "ImmediateRenderer.h"
+#include "UniformRingBuffer.h"
+#include "VulkanDispatch.h"
+#include "VulkanHandle.h"
+#include "WindowOutput.h"
+#include "input/InputEvent.h"
+#include "input/SpscQueue.h"
+#include "jobs/JobSystem.h"
+#include "jobs/RadixSort.h"
+#include "mesh/MeshLoader.h"
+#include "scene/SceneBvh.h"
+#include "scene/SceneStore.h"
+#include "textures/TextureStreamer.h"
 
 struct SwapChainSupportDetails {
 	VkSurfaceCapabilitiesKHR capabilities;
@@ -15,6 +39,7 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	std::optional<uint32_t> computeFamily;
 
 	bool isComplete() {
 		return graphicsFamily.has_value() && presentFamily.has_value();
@@ -23,6 +48,132 @@ struct QueueFamilyIndices {
 
 
 
+// Views a multiview pass renders at once, see VulkanEngine::viewCount
+const uint32_t MAX_VIEWS = 4;
+// Distance between the stereo eyes, in scene units
+const float VIEW_EYE_SEPARATION = 0.064f;
+
+// Per-frame data, written once per frame into the uniform ring buffer (set 0, binding 0). One view and projection per view, indexed by gl_ViewIndex
+struct CameraUniforms {
+	glm::mat4 view[MAX_VIEWS] = { glm::mat4(1.0f), glm::mat4(1.0f), glm::mat4(1.0f), glm::mat4(1.0f) };
+	glm::mat4 proj[MAX_VIEWS] = { glm::mat4(1.0f), glm::mat4(1.0f), glm::mat4(1.0f), glm::mat4(1.0f) };
+};
+
+// Per-draw data, written once per draw into the uniform ring buffer (set 0, binding 1)
+struct DrawUniforms {
+	glm::mat4 model = glm::mat4(1.0f);
+};
+
+// Small per-draw values that go through vkCmdPushConstants
+struct DrawPushConstants {
+	glm::vec4 tint = glm::vec4(1.0f);
+};
+
+struct DrawCommand {
+	DrawUniforms uniforms;
+	DrawPushConstants pushConstants;
+	uint32_t vertexCount = 3;
+	// Indexed draw of a LOD of VulkanEngine::meshes, vertexCount is ignored
+	uint32_t mesh = NO_MESH;
+	uint32_t lod = 0;
+	// Scene object the draw comes from
+	uint32_t object = 0;
+	uint64_t sortKey = 0;
+};
+
+const uint32_t DRAW_PASS_OPAQUE = 0;
+const uint32_t DRAW_PASS_BLENDED = 1;
+const uint32_t DRAW_PIPELINE_TRIANGLE = 0;
+const uint32_t DRAW_PIPELINE_MESH = 1;
+
+/**
+    * 64-bit draw sort key, most significant bits first. Opaque draws come first, grouped by
+    * state then front to back. Blended draws are back to front, grouped by state where the
+    * depth ties:
+    *   opaque:  pass (2) | pipeline (6) | descriptor set (8) | mesh (16) | depth (16) | 0 (16)
+    *   blended: pass (2) | ~depth (16) | pipeline (6) | descriptor set (8) | mesh (16) | 0 (16)
+    * Depth is the normalized device depth of the bounding sphere center, 16 bits of buckets.
+    **/
+inline uint64_t makeDrawSortKey(uint32_t pass, uint32_t pipeline, uint32_t descriptorSet, uint32_t mesh, float depth) {
+	uint64_t state = static_cast<uint64_t>(pipeline & 0x3F) << 24 | static_cast<uint64_t>(descriptorSet & 0xFF) << 16 | (mesh & 0xFFFF);
+	float clampedDepth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+	uint64_t depthBucket = static_cast<uint64_t>(clampedDepth * 65535.0f);
+
+	if (pass == DRAW_PASS_OPAQUE) {
+		return static_cast<uint64_t>(pass) << 62 | state << 32 | depthBucket << 16;
+	}
+	return static_cast<uint64_t>(pass) << 62 | (0xFFFF - depthBucket) << 46 | state << 16;
+}
+
+// Pass and bound state of a key, consecutive draws with the same state need no bind in between
+inline uint64_t getDrawState(uint64_t sortKey) {
+	uint64_t pass = sortKey >> 62;
+	uint64_t state = pass == DRAW_PASS_OPAQUE ? sortKey >> 32 & 0x3FFFFFFF : sortKey >> 16 & 0x3FFFFFFF;
+	return pass << 30 | state;
+}
+
+// Coarsest LOD whose simplification error stays below this many pixels on screen
+const float MESH_LOD_PIXEL_ERROR = 1.0f;
+
+const VkDeviceSize UNIFORM_RING_FRAME_SIZE = 256 * 1024;
+const uint32_t COMMAND_BATCH_STATS_INTERVAL = 1000;
+
+// GPU particle simulation, updated on the compute queue and drawn as points
+struct Particle {
+	glm::vec2 position;
+	glm::vec2 velocity;
+	glm::vec4 color;
+};
+
+struct ParticlePushConstants {
+	float deltaTime;
+	uint32_t particleCount;
+};
+
+const uint32_t PARTICLE_COUNT = 1 << 20;
+const uint32_t PARTICLE_WORKGROUP_SIZE = 256;
+
+// Accumulated GPU timings used to report how much compute and graphics overlap
+struct ComputeOverlapStats {
+	double computeMs = 0.0;
+	double graphicsMs = 0.0;
+	double frameMs = 0.0;
+	uint32_t samples = 0;
+};
+
+const uint32_t OVERLAP_STATS_INTERVAL = 1000;
+// GPU frame times shown by the overlay graph
+const uint32_t OVERLAY_HISTORY_SIZE = 240;
+// Side in pixels of the textures shown by the texture panel
+const uint32_t TEXTURE_PANEL_SIZE = 128;
+
+// Time from an input event reaching the main thread to the present of the frame that consumed it
+struct InputLatencyStats {
+	double totalMs = 0.0;
+	double maxMs = 0.0;
+	uint32_t samples = 0;
+};
+
+const uint32_t INPUT_LATENCY_STATS_INTERVAL = 100;
+const size_t INPUT_QUEUE_CAPACITY = 1024;
+
+// Objects per job when transforming and culling the scene, a multiple of the SIMD width
+const size_t SCENE_JOB_BATCH_SIZE = 16384;
+
+// Moving objects are small triangles orbiting the center, see VulkanEngine::movingObjectCount
+const float MOVING_OBJECT_ORBIT_RADIUS = 0.8f;
+const float MOVING_OBJECT_SCALE = 0.05f;
+// Radians per simulated frame
+const float MOVING_OBJECT_SPEED = 0.01f;
+// Each one is a draw, the draw batch cache grows for them and its uniform offsets stay well within 32 bits
+const uint32_t MAX_MOVING_OBJECTS = 65536;
+
+// Jobs of a scheduled frame the next frame depends on
+struct FrameJobs {
+	JobHandle cull;
+	JobHandle submit;
+};
+
 const std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
@@ -39,68 +190,222 @@ public:
 		"VK_LAYER_KHRONOS_validation"
 	};
 
-	static SwapChainSupportDetails querySwapChainSupport(VulkanEngine& vkEngine, VkPhysicalDevice device) {
+	static SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface) {
 		SwapChainSupportDetails details;
 
-		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, vkEngine.surface, &details.capabilities);
+		vki.vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
 
 		uint32_t formatCount;
-		vkGetPhysicalDeviceSurfaceFormatsKHR(device, vkEngine.surface, &formatCount, nullptr);
+		vki.vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
 		if (formatCount != 0) {
 			details.formats.resize(formatCount);
-			vkGetPhysicalDeviceSurfaceFormatsKHR(device, vkEngine.surface, &formatCount, details.formats.data());
+			vki.vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, details.formats.data());
 		}
 
 		uint32_t presentModeCount;
-		vkGetPhysicalDeviceSurfacePresentModesKHR(device, vkEngine.surface, &presentModeCount, nullptr);
+		vki.vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
 		if (presentModeCount != 0) {
 			details.presentModes.resize(presentModeCount);
-			vkGetPhysicalDeviceSurfacePresentModesKHR(device, vkEngine.surface, &presentModeCount, details.presentModes.data());
+			vki.vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, details.presentModes.data());
 		}
 
 		return details;
 	}
 
 	void mainLoop();
+	// Waits for the device and destroys everything, for headless engines that never run mainLoop
+	void shutdown();
+	// Culls, picks the mesh LODs and sorts the scene seen from view into a target targetHeight pixels high
+	void buildDrawList(const CameraUniforms& view, uint32_t targetHeight, std::vector<DrawCommand>& drawList);
 	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
-	GLFWwindow* window;
 	VkInstance instance;
 	VkDebugUtilsMessengerEXT debugMessenger;
 
-	VkSurfaceKHR surface;
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 	VkDevice device;
+	bool memoryBudgetSupported = false;
+	// Instance version, the device renders without render pass objects when both are 1.3, see dynamicRendering
+	uint32_t apiVersion = VK_API_VERSION_1_0;
+	// Vulkan 1.3 dynamic rendering and synchronization2, enabled together. allowDynamicRendering keeps the render pass path for comparison
+	bool allowDynamicRendering = true;
+	bool dynamicRendering = false;
+	// Views rendered by a single multiview pass into the layers of the scene targets, the device needs Vulkan 1.1 above one.
+	// Shown one per window when there are as many windows, side by side in every window otherwise (stereo)
+	uint32_t viewCount = 1;
+	uint32_t getViewMask() const {
+		return viewCount > 1 ? (1u << viewCount) - 1 : 0;
+	}
 
 	VkQueue graphicsQueue;
 	VkQueue presentQueue;
+	VkQueue computeQueue;
 
-	// SwapChain
-	VkSwapchainKHR swapChain;
-	std::vector<VkImage> swapChainImages;
-	VkFormat swapChainImageFormat;
-	VkExtent2D swapChainExtent;
-	std::vector<VkImageView> swapChainImageViews;
+	// Windows and their swap chains, outputs[0] is the primary one. No window makes the engine headless
+	uint32_t windowCount = 1;
+	std::vector<WindowOutput> outputs;
+	// Format of the scene color targets, the primary swap chain format when there is one
+	VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	// Scene target extent of a headless engine rendering frames, a replay. Zero when it has no scene targets
+	VkExtent2D offscreenExtent = { 0, 0 };
+	// Reused every frame to wait on and present all the outputs at once
+	std::vector<VkSemaphore> frameWaitSemaphores;
+	std::vector<VkPipelineStageFlags> frameWaitStages;
+	std::vector<VkSwapchainKHR> presentSwapChains;
+	std::vector<uint32_t> presentImageIndices;
 	
-	// Drawing buffers
-	std::vector<VkFramebuffer> swapChainFramebuffers;
-	VkCommandPool commandPool;
+	// Drawing buffers, the scene renders offscreen at a resolution following the GPU frame time
+	DynamicResolution dynamicResolution;
+	UniqueCommandPool commandPool;
 	std::vector<VkCommandBuffer> commandBuffers;
+	// Scene draws are cached in secondary command buffers, the primary one only executes them
+	CommandBatchCache commandBatches;
+	// Batches per frame in flight the cache is created with, a replay creates it as large as the captured one
+	uint32_t drawBatchCapacity = INITIAL_DRAW_BATCHES;
+	// Secondary command buffers drawing the particles, one per frame in flight recorded for the extent next to it
+	std::vector<VkCommandBuffer> particleCommandBuffers;
+	std::vector<VkExtent2D> particleCommandExtents;
+	// Secondary command buffers drawing the frame's immediate primitives over the scene, recorded every frame
+	std::vector<VkCommandBuffer> immediateCommandBuffers;
+	std::vector<VkCommandBuffer> secondaryCommandBuffers;
 
 	// Graphics pipeline
-	VkPipelineLayout pipelineLayout;
-	VkRenderPass renderPass;
-	VkPipeline graphicsPipeline;
+	UniqueDescriptorSetLayout descriptorSetLayout;
+	UniquePipelineLayout pipelineLayout;
+	// VK_NULL_HANDLE with dynamic rendering, pipelines are then created for colorFormat
+	UniqueRenderPass renderPass;
+	UniquePipeline graphicsPipeline;
+	// VK_NULL_HANDLE without meshPaths, nothing draws meshes then
+	UniquePipeline meshPipeline;
+	UniquePipelineLayout immediatePipelineLayout;
+	UniquePipeline immediatePipeline;
+	// Image primitives of the immediate renderer, one combined image sampler (set 0, binding 0)
+	UniqueDescriptorSetLayout imageDescriptorSetLayout;
+	UniquePipelineLayout immediateTexturedPipelineLayout;
+	UniquePipeline immediateTexturedPipeline;
+
+	// Uniforms
+	UniformRingBuffer uniformRing;
+	UniqueDescriptorPool descriptorPool;
+	VkDescriptorSet descriptorSet;
+	CameraUniforms camera;
+	// One draw list per frame in flight, culling of the next frame overlaps recording of the current one
+	std::vector<std::vector<DrawCommand>> drawLists;
+
+	// Scene objects, transformed and culled every frame to build the draw lists
+	SceneStore scene;
+	// Culls the scene and picks objects under the cursor, refit for the objects whose transform changed
+	SceneBvh sceneBvh;
+	std::vector<uint32_t> movedObjects;
+	// Objects [firstMovingObject, firstMovingObject + movingObjectCount) move every simulated frame,
+	// they are the moved objects the BVH is refit for
+	uint32_t movingObjectCount = 0;
+	uint32_t firstMovingObject = 0;
+	uint64_t simulatedFrames = 0;
+	// Visible objects of every subtree of the BVH root in every view, culled by separate jobs
+	std::vector<std::vector<uint32_t>> visibleBatches;
+	// Cull pass that last added each object, an object seen by several views is drawn once
+	std::vector<uint32_t> visibleMarks;
+	uint32_t cullPass = 0;
+	// Draws in scene order and their sort keys, sorted into the draw list of the frame
+	std::vector<DrawCommand> unsortedDraws;
+	std::vector<uint64_t> drawKeys;
+	std::vector<uint32_t> drawOrder;
+	RadixSort drawSorter;
+
+	// .vmesh files loaded at startup, each one added as a scene object
+	std::vector<std::string> meshPaths;
+	std::vector<Mesh> meshes;
+
+	// 2D primitives of the overlays, appended while recording the frame
+	ImmediateRenderer immediate;
+	// F3 shows the GPU frame time overlay
+	std::atomic<bool> overlayVisible{ false };
+	std::vector<float> overlayFrameTimes;
+	uint32_t overlayFrameIndex = 0;
+
+	// Textures are uploaded at the start of the graphics command buffer, within the device memory budget
+	TextureStreamer textures;
+	// Files given on the command line, streamed in and shown side by side by the texture panel
+	std::vector<std::string> texturePaths;
+	std::vector<TextureHandle> panelTextures;
+
+	// F12 captures the next captureFrames frames to capturePath, see CaptureLayer
+	std::string capturePath;
+	uint32_t captureFrames = 0;
+	std::atomic<bool> captureRequested{ false };
+	uint32_t capturedFrames = 0;
+
+	// F5 creates the graphics pipelines again from the shaders on disk, the old ones are retired
+	std::atomic<bool> reloadRequested{ false };
+
+	// Runs the frame stages, see scheduleFrame
+	JobSystem jobSystem;
+
+	// Rendering runs on its own thread, the main thread only pumps GLFW events into inputQueue
+	std::thread renderThread;
+	std::atomic<bool> renderRunning{ false };
+	std::exception_ptr renderException;
+	SpscQueue<InputEvent, INPUT_QUEUE_CAPACITY> inputQueue;
+	std::atomic<uint32_t> droppedInputEvents{ 0 };
+	// Oldest event consumed by each frame in flight, 0 when none
+	std::vector<double> inputTimestamps;
+	InputLatencyStats inputLatencyStats;
+	// Last cursor position, in the pixels of the window it moved in
+	uint32_t cursorWindow = 0;
+	double cursorX = 0.0;
+	double cursorY = 0.0;
+
+	// Compute
+	UniqueCommandPool computeCommandPool;
+	std::vector<VkCommandBuffer> computeCommandBuffers;
+	std::vector<UniqueSemaphore> computeFinishedSemaphores;
+	std::vector<UniqueBuffer> particleBuffers;
+	std::vector<UniqueDeviceMemory> particleBuffersMemory;
+	UniqueDescriptorSetLayout computeDescriptorSetLayout;
+	UniqueDescriptorPool computeDescriptorPool;
+	std::vector<VkDescriptorSet> computeDescriptorSets;
+	UniquePipelineLayout computePipelineLayout;
+	UniquePipeline computePipeline;
+	UniquePipelineLayout particlePipelineLayout;
+	UniquePipeline particlePipeline;
+
+	// Compute/graphics overlap benchmark, 4 timestamps per frame in flight
+	UniqueQueryPool timestampQueryPool;
+	float timestampPeriod = 0.0f;
+	ComputeOverlapStats overlapStats;
+	double lastFrameTime = 0.0;
 
 	const int MAX_FRAMES_IN_FLIGHT = 2;
-	std::vector<VkSemaphore> imageAvailableSemaphores;
-	std::vector<VkSemaphore> renderFinishedSemaphores;
-	std::vector<VkFence> inFlightFences;
-	std::vector<VkFence> imagesInFlight;
+	// Signaled once by the graphics submit, waited on by the present of every output
+	std::vector<UniqueSemaphore> renderFinishedSemaphores;
+	std::vector<UniqueFence> inFlightFences;
 	size_t currentFrame = 0;
+	uint64_t frameNumber = 0;
+	// Objects replaced at run time, destroyed once the frames in flight are done with them
+	DeferredDestructionQueue deletionQueue;
+	uint64_t scheduledFrames = 0;
 
 private:
-	void drawFrame();
+	void renderLoop();
+	FrameJobs scheduleFrame(const FrameJobs& previousFrame);
+	void processInput(size_t frameSlot);
+	void pickObject(uint32_t window);
+	void collectInputLatency(double latencyMs);
+	void simulateScene();
+	void buildDrawList(size_t frameSlot);
+	void selectMeshLod(DrawCommand& draw, uint32_t meshIndex, const glm::mat4& viewProj, float pixelsPerUnit);
+	void prepareFrame();
+	void reloadPipelines();
+	void submitFrame();
+	void recordCommandBuffer(VkCommandBuffer commandBuffer);
+	void recordParticleCommandBuffer(uint32_t frameIndex, VkExtent2D extent);
+	void drawOverlay();
+	void drawTexturePanel();
+	void recordImmediateCommandBuffer(uint32_t frameIndex, VkExtent2D extent);
+	void recordComputeCommandBuffer(VkCommandBuffer commandBuffer, float deltaTime);
+	void collectOverlapStats(double frameMs);
+	void collectBatchStats();
 	void cleanup();
 	void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator);
 };
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <utility>
+
+#include "VulkanDispatch.h"
+
+/**
+    * Move-only owner of a device object, destroyed with its device when the owner goes away.
+    * The traits carry the handle type and the destroy function: non-dispatchable handles are all
+    * uint64_t on 32-bit platforms, so the handle type alone cannot pick the function.
+    * Objects the GPU may still use are not reset but handed to DeferredDestructionQueue::retire.
+    **/
+template<typename Traits>
+class VulkanHandle {
+public:
+	using Type = typename Traits::Type;
+
+	VulkanHandle() = default;
+	VulkanHandle(VkDevice owner, Type object) : device(owner), handle(object) {}
+	~VulkanHandle() {
+		reset();
+	}
+
+	VulkanHandle(const VulkanHandle&) = delete;
+	VulkanHandle& operator=(const VulkanHandle&) = delete;
+
+	VulkanHandle(VulkanHandle&& other) noexcept : device(other.device), handle(other.release()) {}
+	VulkanHandle& operator=(VulkanHandle&& other) noexcept {
+		if (this != &other) {
+			reset();
+			device = other.device;
+			handle = other.release();
+		}
+		return *this;
+	}
+
+	void reset() {
+		if (handle != VK_NULL_HANDLE) {
+			Traits::destroy(device, handle);
+			handle = VK_NULL_HANDLE;
+		}
+	}
+	// Gives up the ownership, the caller destroys the object
+	Type release() {
+		Type released = handle;
+		handle = VK_NULL_HANDLE;
+		return released;
+	}
+	// Output parameter of the vkCreate* call, owned by device once it returns
+	Type* put(VkDevice owner) {
+		reset();
+		device = owner;
+		return &handle;
+	}
+
+	Type get() const {
+		return handle;
+	}
+	// Single element array of the create infos, pSetLayouts and the like
+	const Type* address() const {
+		return &handle;
+	}
+	VkDevice getDevice() const {
+		return device;
+	}
+	operator Type() const {
+		return handle;
+	}
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	Type handle = VK_NULL_HANDLE;
+};
+
+#define VULKAN_HANDLE(Name, HandleType, destroyFunction) \
+	struct Name##Traits { \
+		using Type = HandleType; \
+		static void destroy(VkDevice device, HandleType handle) { \
+			vkd.destroyFunction(device, handle, nullptr); \
+		} \
+	}; \
+	using Unique##Name = VulkanHandle<Name##Traits>;
+
+VULKAN_HANDLE(Buffer, VkBuffer, vkDestroyBuffer)
+VULKAN_HANDLE(DeviceMemory, VkDeviceMemory, vkFreeMemory)
+VULKAN_HANDLE(Image, VkImage, vkDestroyImage)
+VULKAN_HANDLE(ImageView, VkImageView, vkDestroyImageView)
+VULKAN_HANDLE(Sampler, VkSampler, vkDestroySampler)
+VULKAN_HANDLE(RenderPass, VkRenderPass, vkDestroyRenderPass)
+VULKAN_HANDLE(Framebuffer, VkFramebuffer, vkDestroyFramebuffer)
+VULKAN_HANDLE(PipelineLayout, VkPipelineLayout, vkDestroyPipelineLayout)
+VULKAN_HANDLE(Pipeline, VkPipeline, vkDestroyPipeline)
+VULKAN_HANDLE(DescriptorSetLayout, VkDescriptorSetLayout, vkDestroyDescriptorSetLayout)
+VULKAN_HANDLE(DescriptorPool, VkDescriptorPool, vkDestroyDescriptorPool)
+VULKAN_HANDLE(CommandPool, VkCommandPool, vkDestroyCommandPool)
+VULKAN_HANDLE(QueryPool, VkQueryPool, vkDestroyQueryPool)
+VULKAN_HANDLE(Semaphore, VkSemaphore, vkDestroySemaphore)
+VULKAN_HANDLE(Fence, VkFence, vkDestroyFence)
+VULKAN_HANDLE(Swapchain, VkSwapchainKHR, vkDestroySwapchainKHR)
+
+#undef VULKAN_HANDLE
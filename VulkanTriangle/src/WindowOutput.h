@@ -0,0 +1,33 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+#include "VulkanHandle.h"
+
+const uint32_t MAX_WINDOW_OUTPUTS = 8;
+
+/**
+    * A window and its swap chain. Every output shows the same scene, rendered once on the shared
+    * device and scaled into each swap chain image; all outputs are submitted in one command
+    * buffer and presented by a single vkQueuePresentKHR. The first output is the primary one,
+    * its format and extent size the scene target.
+    **/
+struct WindowOutput {
+	GLFWwindow* window = nullptr;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
+
+	UniqueSwapchain swapChain;
+	std::vector<VkImage> swapChainImages;
+	VkFormat swapChainImageFormat = VK_FORMAT_UNDEFINED;
+	VkExtent2D swapChainExtent = { 0, 0 };
+	std::vector<UniqueImageView> swapChainImageViews;
+
+	// One per frame in flight, signaled by the acquire of this output
+	std::vector<UniqueSemaphore> imageAvailableSemaphores;
+	// One per swap chain image, fence of the frame using it
+	std::vector<VkFence> imagesInFlight;
+	uint32_t currentImageIndex = 0;
+};
@@ -0,0 +1,318 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+/**
+    * Binary Vulkan command stream written by CaptureLayer and read by CaptureReplayer, .vcap.
+    * A CaptureHeader is followed by records, each one a CaptureRecord and size bytes of payload.
+    * Objects are referred to by their creation index among the tracked objects of their type,
+    * so a replay re-initializing the same engine with the same meshes finds the same objects.
+    * Command buffer records hold the commands recorded between begin and end, as records too.
+    **/
+const uint32_t CAPTURE_MAGIC = 0x50414356; // "VCAP"
+const uint32_t CAPTURE_VERSION = 4;
+const uint32_t CAPTURE_NO_OBJECT = UINT32_MAX;
+// Set in the image ids of commands referring to swap chain images
+const uint32_t CAPTURE_SWAPCHAIN_IMAGE_BIT = 0x80000000;
+
+enum class CaptureObjectType : uint32_t {
+	Buffer,
+	Image,
+	// Swap chain images have no counterpart in a headless replay, it renders to images of its own
+	SwapchainImage,
+	DescriptorSet,
+	Pipeline,
+	PipelineLayout,
+	RenderPass,
+	Framebuffer,
+	QueryPool,
+	// Attachments of dynamic rendering
+	ImageView,
+	CommandBuffer,
+	Count
+};
+
+const uint32_t CAPTURE_OBJECT_TYPE_COUNT = static_cast<uint32_t>(CaptureObjectType::Count);
+
+enum class CaptureOp : uint32_t {
+	// Stream, in the order they are found in the file
+	MeshPath,
+	CreateImage,
+	Write,
+	CommandBuffer,
+	Submit,
+	Present,
+	// Commands, only within a CommandBuffer record
+	BeginRenderPass,
+	EndRenderPass,
+	ExecuteCommands,
+	BindPipeline,
+	BindVertexBuffers,
+	BindIndexBuffer,
+	BindDescriptorSets,
+	PushConstants,
+	Draw,
+	DrawIndexed,
+	Dispatch,
+	SetViewport,
+	SetScissor,
+	PipelineBarrier,
+	CopyBufferToImage,
+	CopyImage,
+	BlitImage,
+	ResetQueryPool,
+	WriteTimestamp,
+	BeginRendering,
+	EndRendering,
+	PipelineBarrier2
+};
+
+struct CaptureHeader {
+	uint32_t magic = CAPTURE_MAGIC;
+	uint32_t version = CAPTURE_VERSION;
+	// Scene target format and primary swap chain extent of the captured engine
+	uint32_t colorFormat = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t framesInFlight = 0;
+	// Multiview views of the scene targets, the replay renders as many layers
+	uint32_t viewCount = 1;
+	// Draw batches per frame in flight of the batch cache, the draw uniform offsets depend on it
+	uint32_t drawBatchCapacity = 0;
+	// Objects created by the engine initialization, the replay must create as many
+	uint32_t objectCounts[CAPTURE_OBJECT_TYPE_COUNT] = {};
+};
+
+struct CaptureRecord {
+	CaptureOp op;
+	uint32_t size;
+};
+
+// Stream records. MeshPath is the path itself, without terminator
+
+// An image created after initialization or a swap chain image, the replay creates its own
+struct CapturedImage {
+	CaptureObjectType type;
+	uint32_t id;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t mipLevels;
+	uint32_t arrayLayers;
+	uint32_t usage;
+};
+
+// Followed by size bytes written by the host to the mapped buffer
+struct CapturedWrite {
+	uint32_t buffer;
+	uint32_t reserved;
+	uint64_t offset;
+	uint64_t size;
+};
+
+// Followed by the commands
+struct CapturedCommandBuffer {
+	uint32_t id;
+	uint32_t level;
+	uint32_t flags;
+	// Inherited by secondary command buffers
+	uint32_t renderPass;
+	uint32_t subpass;
+	// Format of the single color attachment and view mask inherited from dynamic rendering, without render pass
+	uint32_t colorFormat;
+	uint32_t viewMask;
+};
+
+// Followed by the command buffer ids. The replay submits everything to its graphics queue, in order
+struct CapturedSubmit {
+	uint32_t commandBufferCount;
+};
+
+// Ends the frame
+struct CapturedPresent {
+	uint32_t swapchainCount;
+};
+
+// Commands
+
+// Followed by the clear values
+struct CapturedBeginRenderPass {
+	uint32_t renderPass;
+	uint32_t framebuffer;
+	VkRect2D renderArea;
+	uint32_t contents;
+	uint32_t clearValueCount;
+};
+
+// Followed by the command buffer ids
+struct CapturedExecuteCommands {
+	uint32_t commandBufferCount;
+};
+
+struct CapturedBindPipeline {
+	uint32_t bindPoint;
+	uint32_t pipeline;
+};
+
+// Followed by the buffer ids, then the 64-bit offsets
+struct CapturedBindVertexBuffers {
+	uint32_t firstBinding;
+	uint32_t bindingCount;
+};
+
+struct CapturedBindIndexBuffer {
+	uint32_t buffer;
+	uint32_t indexType;
+	uint64_t offset;
+};
+
+// Followed by the descriptor set ids, then the dynamic offsets
+struct CapturedBindDescriptorSets {
+	uint32_t bindPoint;
+	uint32_t layout;
+	uint32_t firstSet;
+	uint32_t descriptorSetCount;
+	uint32_t dynamicOffsetCount;
+};
+
+// Followed by size bytes of values
+struct CapturedPushConstants {
+	uint32_t layout;
+	uint32_t stageFlags;
+	uint32_t offset;
+	uint32_t size;
+};
+
+struct CapturedDraw {
+	uint32_t vertexCount;
+	uint32_t instanceCount;
+	uint32_t firstVertex;
+	uint32_t firstInstance;
+};
+
+struct CapturedDrawIndexed {
+	uint32_t indexCount;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t firstInstance;
+};
+
+struct CapturedDispatch {
+	uint32_t groupCountX;
+	uint32_t groupCountY;
+	uint32_t groupCountZ;
+};
+
+// Followed by the viewports or the scissors
+struct CapturedSetViewport {
+	uint32_t first;
+	uint32_t count;
+};
+
+struct CapturedMemoryBarrier {
+	uint32_t srcAccessMask;
+	uint32_t dstAccessMask;
+};
+
+struct CapturedBufferBarrier {
+	uint32_t srcAccessMask;
+	uint32_t dstAccessMask;
+	uint32_t srcQueueFamilyIndex;
+	uint32_t dstQueueFamilyIndex;
+	uint32_t buffer;
+	uint32_t reserved;
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct CapturedImageBarrier {
+	uint32_t srcAccessMask;
+	uint32_t dstAccessMask;
+	uint32_t oldLayout;
+	uint32_t newLayout;
+	uint32_t srcQueueFamilyIndex;
+	uint32_t dstQueueFamilyIndex;
+	uint32_t image;
+	VkImageSubresourceRange subresourceRange;
+};
+
+// Followed by the memory, buffer and image barriers
+struct CapturedPipelineBarrier {
+	uint32_t srcStageMask;
+	uint32_t dstStageMask;
+	uint32_t dependencyFlags;
+	uint32_t memoryBarrierCount;
+	uint32_t bufferBarrierCount;
+	uint32_t imageBarrierCount;
+};
+
+// Followed by the regions, VkBufferImageCopy, VkImageCopy or VkImageBlit
+struct CapturedCopy {
+	uint32_t src;
+	uint32_t srcLayout;
+	uint32_t dst;
+	uint32_t dstLayout;
+	uint32_t regionCount;
+	uint32_t filter;
+};
+
+// Followed by the color attachments, the engine renders without depth or resolve attachments
+struct CapturedBeginRendering {
+	uint32_t flags;
+	VkRect2D renderArea;
+	uint32_t layerCount;
+	uint32_t viewMask;
+	uint32_t colorAttachmentCount;
+};
+
+struct CapturedRenderingAttachment {
+	uint32_t imageView;
+	uint32_t imageLayout;
+	uint32_t loadOp;
+	uint32_t storeOp;
+	VkClearValue clearValue;
+};
+
+struct CapturedMemoryBarrier2 {
+	uint64_t srcStageMask;
+	uint64_t srcAccessMask;
+	uint64_t dstStageMask;
+	uint64_t dstAccessMask;
+};
+
+struct CapturedBufferBarrier2 {
+	CapturedMemoryBarrier2 masks;
+	uint32_t srcQueueFamilyIndex;
+	uint32_t dstQueueFamilyIndex;
+	uint32_t buffer;
+	uint32_t reserved;
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct CapturedImageBarrier2 {
+	CapturedMemoryBarrier2 masks;
+	uint32_t oldLayout;
+	uint32_t newLayout;
+	uint32_t srcQueueFamilyIndex;
+	uint32_t dstQueueFamilyIndex;
+	uint32_t image;
+	VkImageSubresourceRange subresourceRange;
+};
+
+// Synchronization2, stages are per barrier. Followed by the memory, buffer and image barriers
+struct CapturedPipelineBarrier2 {
+	uint32_t dependencyFlags;
+	uint32_t memoryBarrierCount;
+	uint32_t bufferBarrierCount;
+	uint32_t imageBarrierCount;
+};
+
+struct CapturedQuery {
+	uint32_t queryPool;
+	uint32_t first;
+	uint32_t count;
+	uint32_t stage;
+};
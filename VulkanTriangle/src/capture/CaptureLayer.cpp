@@ -0,0 +1,713 @@
+#include "CaptureLayer.h"
+
+#include <stdexcept>
+
+#include "../VulkanDispatch.h"
+
+CaptureLayer& CaptureLayer::instance() {
+    static CaptureLayer capture;
+    return capture;
+}
+
+void CaptureLayer::trackHandle(CaptureObjectType type, uint64_t handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    addObject(type, handle);
+}
+
+void CaptureLayer::untrackHandle(CaptureObjectType type, uint64_t handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unordered_map<uint64_t, uint32_t>& typeIds = ids[static_cast<uint32_t>(type)];
+    auto found = typeIds.find(handle);
+    if (found == typeIds.end()) {
+        return;
+    }
+
+    // The driver may hand the same handle out again, the id stays unused
+    handles[static_cast<uint32_t>(type)][found->second] = 0;
+    recreatedImages.erase(found->second);
+    typeIds.erase(found);
+}
+
+void CaptureLayer::replaceHandle(CaptureObjectType type, uint64_t oldHandle, uint64_t newHandle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unordered_map<uint64_t, uint32_t>& typeIds = ids[static_cast<uint32_t>(type)];
+    std::vector<uint64_t>& typeHandles = handles[static_cast<uint32_t>(type)];
+    auto found = typeIds.find(oldHandle);
+    if (found == typeIds.end()) {
+        return;
+    }
+
+    uint32_t id = found->second;
+    typeIds.erase(found);
+    // The new object was tracked when created, its own id stays unused
+    auto tracked = typeIds.find(newHandle);
+    if (tracked != typeIds.end()) {
+        typeHandles[tracked->second] = 0;
+    }
+    typeHandles[id] = newHandle;
+    typeIds[newHandle] = id;
+}
+
+void CaptureLayer::trackImage(VkImage image, const VkImageCreateInfo& imageInfo, CaptureObjectType type) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t id = addObject(type, (uint64_t)image);
+    if (type != CaptureObjectType::SwapchainImage && !initialized) {
+        return;
+    }
+
+    CapturedImage capturedImage{ type, id, static_cast<uint32_t>(imageInfo.format), imageInfo.extent.width, imageInfo.extent.height,
+        imageInfo.mipLevels, imageInfo.arrayLayers, static_cast<uint32_t>(imageInfo.usage) };
+    recreatedImages[id] = capturedImage;
+    if (isCapturing()) {
+        writeImage(capturedImage);
+    }
+}
+
+void CaptureLayer::trackMapping(VkBuffer buffer, void* mapped) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t id = getId(CaptureObjectType::Buffer, buffer);
+    if (id == CAPTURE_NO_OBJECT) {
+        throw std::runtime_error("failed to track the mapping of an untracked buffer!");
+    }
+    mappings[id] = static_cast<uint8_t*>(mapped);
+}
+
+void CaptureLayer::endInitialization() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (uint32_t type = 0; type < CAPTURE_OBJECT_TYPE_COUNT; type++) {
+        initialObjectCounts[type] = static_cast<uint32_t>(handles[type].size());
+    }
+    initialized = true;
+}
+
+uint64_t CaptureLayer::resolve(CaptureObjectType type, uint32_t id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    const std::vector<uint64_t>& typeHandles = handles[static_cast<uint32_t>(type)];
+    if (id == CAPTURE_NO_OBJECT) {
+        return 0;
+    }
+    if (id >= typeHandles.size() || typeHandles[id] == 0) {
+        throw std::runtime_error("capture refers to an object the replay does not have!");
+    }
+    return typeHandles[id];
+}
+
+uint8_t* CaptureLayer::resolveMapping(uint32_t buffer) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = mappings.find(buffer);
+    if (found == mappings.end()) {
+        throw std::runtime_error("capture writes to a buffer the replay has not mapped!");
+    }
+    return found->second;
+}
+
+void CaptureLayer::start(const std::string& path, const CaptureHeader& header, const std::vector<std::string>& meshPaths) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (isCapturing()) {
+        return;
+    }
+
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open capture file!");
+    }
+
+    CaptureHeader fileHeader = header;
+    for (uint32_t type = 0; type < CAPTURE_OBJECT_TYPE_COUNT; type++) {
+        fileHeader.objectCounts[type] = initialObjectCounts[type];
+    }
+    file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+
+    for (const std::string& meshPath : meshPaths) {
+        CaptureRecord record{ CaptureOp::MeshPath, static_cast<uint32_t>(meshPath.size()) };
+        file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        file.write(meshPath.data(), meshPath.size());
+    }
+
+    // Images the replay creates before the first frame
+    for (const auto& image : recreatedImages) {
+        writeImage(image.second);
+    }
+
+    // Command buffers get their ids as they are recorded
+    uint32_t commandBufferType = static_cast<uint32_t>(CaptureObjectType::CommandBuffer);
+    ids[commandBufferType].clear();
+    handles[commandBufferType].clear();
+    streams.clear();
+
+    capturing = true;
+}
+
+void CaptureLayer::stop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    capturing = false;
+    streams.clear();
+    if (file.is_open()) {
+        file.close();
+    }
+}
+
+void CaptureLayer::captureWrite(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size) {
+    if (!isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t id = getId(CaptureObjectType::Buffer, buffer);
+    if (id == CAPTURE_NO_OBJECT) {
+        return;
+    }
+    writeRecord(CaptureOp::Write, CapturedWrite{ id, 0, offset, size }, data, static_cast<size_t>(size));
+}
+
+uint32_t CaptureLayer::addObject(CaptureObjectType type, uint64_t handle) {
+    std::vector<uint64_t>& typeHandles = handles[static_cast<uint32_t>(type)];
+    uint32_t id = static_cast<uint32_t>(typeHandles.size());
+    typeHandles.push_back(handle);
+    ids[static_cast<uint32_t>(type)][handle] = id;
+    return id;
+}
+
+uint32_t CaptureLayer::getId(CaptureObjectType type, uint64_t handle) const {
+    if (handle == 0) {
+        return CAPTURE_NO_OBJECT;
+    }
+    const std::unordered_map<uint64_t, uint32_t>& typeIds = ids[static_cast<uint32_t>(type)];
+    auto found = typeIds.find(handle);
+    return found == typeIds.end() ? CAPTURE_NO_OBJECT : found->second;
+}
+
+uint32_t CaptureLayer::getImageId(VkImage image) const {
+    uint32_t id = getId(CaptureObjectType::Image, image);
+    if (id != CAPTURE_NO_OBJECT) {
+        return id;
+    }
+    id = getId(CaptureObjectType::SwapchainImage, image);
+    return id != CAPTURE_NO_OBJECT ? id | CAPTURE_SWAPCHAIN_IMAGE_BIT : CAPTURE_NO_OBJECT;
+}
+
+CaptureCommandStream* CaptureLayer::findStream(VkCommandBuffer commandBuffer) {
+    auto found = streams.find(commandBuffer);
+    return found == streams.end() ? nullptr : &found->second;
+}
+
+void CaptureLayer::writeImage(const CapturedImage& image) {
+    writeRecord(CaptureOp::CreateImage, image);
+}
+
+VkResult CaptureLayer::beginCommandBuffer(VkCommandBuffer commandBuffer, const VkCommandBufferBeginInfo* beginInfo) {
+    VkResult result = vkd.vkBeginCommandBuffer(commandBuffer, beginInfo);
+    CaptureLayer& capture = instance();
+    if (result != VK_SUCCESS || !capture.isCapturing()) {
+        return result;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    uint32_t id = capture.getId(CaptureObjectType::CommandBuffer, commandBuffer);
+    if (id == CAPTURE_NO_OBJECT) {
+        id = capture.addObject(CaptureObjectType::CommandBuffer, (uint64_t)commandBuffer);
+    }
+
+    // Only secondary command buffers are begun with inheritance info in the engine
+    const VkCommandBufferInheritanceInfo* inheritance = beginInfo->pInheritanceInfo;
+    CaptureCommandStream& stream = capture.streams[commandBuffer];
+    stream.data.clear();
+    stream.header.id = id;
+    stream.header.level = inheritance != nullptr ? VK_COMMAND_BUFFER_LEVEL_SECONDARY : VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    stream.header.flags = beginInfo->flags;
+    stream.header.renderPass = inheritance != nullptr ? capture.getId(CaptureObjectType::RenderPass, inheritance->renderPass) : CAPTURE_NO_OBJECT;
+    stream.header.subpass = inheritance != nullptr ? inheritance->subpass : 0;
+    stream.header.colorFormat = VK_FORMAT_UNDEFINED;
+    stream.header.viewMask = 0;
+    for (const VkBaseInStructure* next = inheritance != nullptr ? static_cast<const VkBaseInStructure*>(inheritance->pNext) : nullptr; next != nullptr; next = next->pNext) {
+        if (next->sType == VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO) {
+            const VkCommandBufferInheritanceRenderingInfo* rendering = reinterpret_cast<const VkCommandBufferInheritanceRenderingInfo*>(next);
+            stream.header.colorFormat = rendering->colorAttachmentCount > 0 ? rendering->pColorAttachmentFormats[0] : VK_FORMAT_UNDEFINED;
+            stream.header.viewMask = rendering->viewMask;
+        }
+    }
+    return result;
+}
+
+VkResult CaptureLayer::endCommandBuffer(VkCommandBuffer commandBuffer) {
+    VkResult result = vkd.vkEndCommandBuffer(commandBuffer);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return result;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    auto found = capture.streams.find(commandBuffer);
+    if (found != capture.streams.end()) {
+        const CaptureCommandStream& stream = found->second;
+        capture.writeRecord(CaptureOp::CommandBuffer, stream.header, stream.data.data(), stream.data.size());
+        capture.streams.erase(found);
+    }
+    return result;
+}
+
+void CaptureLayer::cmdBeginRenderPass(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo* renderPassBegin, VkSubpassContents contents) {
+    vkd.vkCmdBeginRenderPass(commandBuffer, renderPassBegin, contents);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::BeginRenderPass);
+    stream->write(CapturedBeginRenderPass{ capture.getId(CaptureObjectType::RenderPass, renderPassBegin->renderPass),
+        capture.getId(CaptureObjectType::Framebuffer, renderPassBegin->framebuffer), renderPassBegin->renderArea,
+        static_cast<uint32_t>(contents), renderPassBegin->clearValueCount });
+    stream->writeBytes(renderPassBegin->pClearValues, renderPassBegin->clearValueCount * sizeof(VkClearValue));
+    stream->end();
+}
+
+void CaptureLayer::cmdEndRenderPass(VkCommandBuffer commandBuffer) {
+    vkd.vkCmdEndRenderPass(commandBuffer);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::EndRenderPass);
+    stream->end();
+}
+
+void CaptureLayer::cmdExecuteCommands(VkCommandBuffer commandBuffer, uint32_t commandBufferCount, const VkCommandBuffer* commandBuffers) {
+    vkd.vkCmdExecuteCommands(commandBuffer, commandBufferCount, commandBuffers);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::ExecuteCommands);
+    stream->write(CapturedExecuteCommands{ commandBufferCount });
+    for (uint32_t i = 0; i < commandBufferCount; i++) {
+        stream->write(capture.getId(CaptureObjectType::CommandBuffer, commandBuffers[i]));
+    }
+    stream->end();
+}
+
+void CaptureLayer::cmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipeline pipeline) {
+    vkd.vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::BindPipeline);
+    stream->write(CapturedBindPipeline{ static_cast<uint32_t>(bindPoint), capture.getId(CaptureObjectType::Pipeline, pipeline) });
+    stream->end();
+}
+
+void CaptureLayer::cmdBindVertexBuffers(VkCommandBuffer commandBuffer, uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* buffers, const VkDeviceSize* offsets) {
+    vkd.vkCmdBindVertexBuffers(commandBuffer, firstBinding, bindingCount, buffers, offsets);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::BindVertexBuffers);
+    stream->write(CapturedBindVertexBuffers{ firstBinding, bindingCount });
+    for (uint32_t i = 0; i < bindingCount; i++) {
+        stream->write(capture.getId(CaptureObjectType::Buffer, buffers[i]));
+    }
+    stream->writeBytes(offsets, bindingCount * sizeof(VkDeviceSize));
+    stream->end();
+}
+
+void CaptureLayer::cmdBindIndexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType) {
+    vkd.vkCmdBindIndexBuffer(commandBuffer, buffer, offset, indexType);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::BindIndexBuffer);
+    stream->write(CapturedBindIndexBuffer{ capture.getId(CaptureObjectType::Buffer, buffer), static_cast<uint32_t>(indexType), offset });
+    stream->end();
+}
+
+void CaptureLayer::cmdBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet,
+    uint32_t descriptorSetCount, const VkDescriptorSet* descriptorSets, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) {
+    vkd.vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, firstSet, descriptorSetCount, descriptorSets, dynamicOffsetCount, dynamicOffsets);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::BindDescriptorSets);
+    stream->write(CapturedBindDescriptorSets{ static_cast<uint32_t>(bindPoint), capture.getId(CaptureObjectType::PipelineLayout, layout),
+        firstSet, descriptorSetCount, dynamicOffsetCount });
+    for (uint32_t i = 0; i < descriptorSetCount; i++) {
+        stream->write(capture.getId(CaptureObjectType::DescriptorSet, descriptorSets[i]));
+    }
+    stream->writeBytes(dynamicOffsets, dynamicOffsetCount * sizeof(uint32_t));
+    stream->end();
+}
+
+void CaptureLayer::cmdPushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* values) {
+    vkd.vkCmdPushConstants(commandBuffer, layout, stageFlags, offset, size, values);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::PushConstants);
+    stream->write(CapturedPushConstants{ capture.getId(CaptureObjectType::PipelineLayout, layout), stageFlags, offset, size });
+    stream->writeBytes(values, size);
+    stream->end();
+}
+
+void CaptureLayer::cmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
+    vkd.vkCmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::Draw);
+    stream->write(CapturedDraw{ vertexCount, instanceCount, firstVertex, firstInstance });
+    stream->end();
+}
+
+void CaptureLayer::cmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) {
+    vkd.vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::DrawIndexed);
+    stream->write(CapturedDrawIndexed{ indexCount, instanceCount, firstIndex, vertexOffset, firstInstance });
+    stream->end();
+}
+
+void CaptureLayer::cmdDispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+    vkd.vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::Dispatch);
+    stream->write(CapturedDispatch{ groupCountX, groupCountY, groupCountZ });
+    stream->end();
+}
+
+void CaptureLayer::cmdSetViewport(VkCommandBuffer commandBuffer, uint32_t firstViewport, uint32_t viewportCount, const VkViewport* viewports) {
+    vkd.vkCmdSetViewport(commandBuffer, firstViewport, viewportCount, viewports);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::SetViewport);
+    stream->write(CapturedSetViewport{ firstViewport, viewportCount });
+    stream->writeBytes(viewports, viewportCount * sizeof(VkViewport));
+    stream->end();
+}
+
+void CaptureLayer::cmdSetScissor(VkCommandBuffer commandBuffer, uint32_t firstScissor, uint32_t scissorCount, const VkRect2D* scissors) {
+    vkd.vkCmdSetScissor(commandBuffer, firstScissor, scissorCount, scissors);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::SetScissor);
+    stream->write(CapturedSetViewport{ firstScissor, scissorCount });
+    stream->writeBytes(scissors, scissorCount * sizeof(VkRect2D));
+    stream->end();
+}
+
+void CaptureLayer::cmdPipelineBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlags,
+    uint32_t memoryBarrierCount, const VkMemoryBarrier* memoryBarriers, uint32_t bufferBarrierCount, const VkBufferMemoryBarrier* bufferBarriers,
+    uint32_t imageBarrierCount, const VkImageMemoryBarrier* imageBarriers) {
+    vkd.vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, dependencyFlags, memoryBarrierCount, memoryBarriers,
+        bufferBarrierCount, bufferBarriers, imageBarrierCount, imageBarriers);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::PipelineBarrier);
+    stream->write(CapturedPipelineBarrier{ srcStageMask, dstStageMask, dependencyFlags, memoryBarrierCount, bufferBarrierCount, imageBarrierCount });
+    for (uint32_t i = 0; i < memoryBarrierCount; i++) {
+        stream->write(CapturedMemoryBarrier{ memoryBarriers[i].srcAccessMask, memoryBarriers[i].dstAccessMask });
+    }
+    for (uint32_t i = 0; i < bufferBarrierCount; i++) {
+        const VkBufferMemoryBarrier& barrier = bufferBarriers[i];
+        stream->write(CapturedBufferBarrier{ barrier.srcAccessMask, barrier.dstAccessMask, barrier.srcQueueFamilyIndex, barrier.dstQueueFamilyIndex,
+            capture.getId(CaptureObjectType::Buffer, barrier.buffer), 0, barrier.offset, barrier.size });
+    }
+    for (uint32_t i = 0; i < imageBarrierCount; i++) {
+        const VkImageMemoryBarrier& barrier = imageBarriers[i];
+        stream->write(CapturedImageBarrier{ barrier.srcAccessMask, barrier.dstAccessMask, static_cast<uint32_t>(barrier.oldLayout),
+            static_cast<uint32_t>(barrier.newLayout), barrier.srcQueueFamilyIndex, barrier.dstQueueFamilyIndex,
+            capture.getImageId(barrier.image), barrier.subresourceRange });
+    }
+    stream->end();
+}
+
+void CaptureLayer::cmdBeginRendering(VkCommandBuffer commandBuffer, const VkRenderingInfo* renderingInfo) {
+    vkd.vkCmdBeginRendering(commandBuffer, renderingInfo);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::BeginRendering);
+    stream->write(CapturedBeginRendering{ renderingInfo->flags, renderingInfo->renderArea, renderingInfo->layerCount, renderingInfo->viewMask, renderingInfo->colorAttachmentCount });
+    for (uint32_t i = 0; i < renderingInfo->colorAttachmentCount; i++) {
+        const VkRenderingAttachmentInfo& attachment = renderingInfo->pColorAttachments[i];
+        stream->write(CapturedRenderingAttachment{ capture.getId(CaptureObjectType::ImageView, attachment.imageView), static_cast<uint32_t>(attachment.imageLayout),
+            static_cast<uint32_t>(attachment.loadOp), static_cast<uint32_t>(attachment.storeOp), attachment.clearValue });
+    }
+    stream->end();
+}
+
+void CaptureLayer::cmdEndRendering(VkCommandBuffer commandBuffer) {
+    vkd.vkCmdEndRendering(commandBuffer);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::EndRendering);
+    stream->end();
+}
+
+void CaptureLayer::cmdPipelineBarrier2(VkCommandBuffer commandBuffer, const VkDependencyInfo* dependencyInfo) {
+    vkd.vkCmdPipelineBarrier2(commandBuffer, dependencyInfo);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::PipelineBarrier2);
+    stream->write(CapturedPipelineBarrier2{ dependencyInfo->dependencyFlags, dependencyInfo->memoryBarrierCount,
+        dependencyInfo->bufferMemoryBarrierCount, dependencyInfo->imageMemoryBarrierCount });
+    for (uint32_t i = 0; i < dependencyInfo->memoryBarrierCount; i++) {
+        const VkMemoryBarrier2& barrier = dependencyInfo->pMemoryBarriers[i];
+        stream->write(CapturedMemoryBarrier2{ barrier.srcStageMask, barrier.srcAccessMask, barrier.dstStageMask, barrier.dstAccessMask });
+    }
+    for (uint32_t i = 0; i < dependencyInfo->bufferMemoryBarrierCount; i++) {
+        const VkBufferMemoryBarrier2& barrier = dependencyInfo->pBufferMemoryBarriers[i];
+        stream->write(CapturedBufferBarrier2{ { barrier.srcStageMask, barrier.srcAccessMask, barrier.dstStageMask, barrier.dstAccessMask },
+            barrier.srcQueueFamilyIndex, barrier.dstQueueFamilyIndex, capture.getId(CaptureObjectType::Buffer, barrier.buffer), 0, barrier.offset, barrier.size });
+    }
+    for (uint32_t i = 0; i < dependencyInfo->imageMemoryBarrierCount; i++) {
+        const VkImageMemoryBarrier2& barrier = dependencyInfo->pImageMemoryBarriers[i];
+        stream->write(CapturedImageBarrier2{ { barrier.srcStageMask, barrier.srcAccessMask, barrier.dstStageMask, barrier.dstAccessMask },
+            static_cast<uint32_t>(barrier.oldLayout), static_cast<uint32_t>(barrier.newLayout), barrier.srcQueueFamilyIndex, barrier.dstQueueFamilyIndex,
+            capture.getImageId(barrier.image), barrier.subresourceRange });
+    }
+    stream->end();
+}
+
+void CaptureLayer::cmdCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkImage dstImage, VkImageLayout dstLayout, uint32_t regionCount, const VkBufferImageCopy* regions) {
+    vkd.vkCmdCopyBufferToImage(commandBuffer, srcBuffer, dstImage, dstLayout, regionCount, regions);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::CopyBufferToImage);
+    stream->write(CapturedCopy{ capture.getId(CaptureObjectType::Buffer, srcBuffer), 0, capture.getImageId(dstImage),
+        static_cast<uint32_t>(dstLayout), regionCount, 0 });
+    stream->writeBytes(regions, regionCount * sizeof(VkBufferImageCopy));
+    stream->end();
+}
+
+void CaptureLayer::cmdCopyImage(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout srcLayout, VkImage dstImage, VkImageLayout dstLayout, uint32_t regionCount, const VkImageCopy* regions) {
+    vkd.vkCmdCopyImage(commandBuffer, srcImage, srcLayout, dstImage, dstLayout, regionCount, regions);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::CopyImage);
+    stream->write(CapturedCopy{ capture.getImageId(srcImage), static_cast<uint32_t>(srcLayout), capture.getImageId(dstImage),
+        static_cast<uint32_t>(dstLayout), regionCount, 0 });
+    stream->writeBytes(regions, regionCount * sizeof(VkImageCopy));
+    stream->end();
+}
+
+void CaptureLayer::cmdBlitImage(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout srcLayout, VkImage dstImage, VkImageLayout dstLayout,
+    uint32_t regionCount, const VkImageBlit* regions, VkFilter filter) {
+    vkd.vkCmdBlitImage(commandBuffer, srcImage, srcLayout, dstImage, dstLayout, regionCount, regions, filter);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::BlitImage);
+    stream->write(CapturedCopy{ capture.getImageId(srcImage), static_cast<uint32_t>(srcLayout), capture.getImageId(dstImage),
+        static_cast<uint32_t>(dstLayout), regionCount, static_cast<uint32_t>(filter) });
+    stream->writeBytes(regions, regionCount * sizeof(VkImageBlit));
+    stream->end();
+}
+
+void CaptureLayer::cmdResetQueryPool(VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount) {
+    vkd.vkCmdResetQueryPool(commandBuffer, queryPool, firstQuery, queryCount);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::ResetQueryPool);
+    stream->write(CapturedQuery{ capture.getId(CaptureObjectType::QueryPool, queryPool), firstQuery, queryCount, 0 });
+    stream->end();
+}
+
+void CaptureLayer::cmdWriteTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage, VkQueryPool queryPool, uint32_t query) {
+    vkd.vkCmdWriteTimestamp(commandBuffer, stage, queryPool, query);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    CaptureCommandStream* stream = capture.findStream(commandBuffer);
+    if (stream == nullptr) {
+        return;
+    }
+    stream->begin(CaptureOp::WriteTimestamp);
+    stream->write(CapturedQuery{ capture.getId(CaptureObjectType::QueryPool, queryPool), query, 1, static_cast<uint32_t>(stage) });
+    stream->end();
+}
+
+VkResult CaptureLayer::queueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence) {
+    VkResult result = vkd.vkQueueSubmit(queue, submitCount, submits, fence);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return result;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    for (uint32_t i = 0; i < submitCount; i++) {
+        capture.scratchIds.clear();
+        for (uint32_t j = 0; j < submits[i].commandBufferCount; j++) {
+            capture.scratchIds.push_back(capture.getId(CaptureObjectType::CommandBuffer, submits[i].pCommandBuffers[j]));
+        }
+        capture.writeRecord(CaptureOp::Submit, CapturedSubmit{ submits[i].commandBufferCount }, capture.scratchIds.data(), capture.scratchIds.size() * sizeof(uint32_t));
+    }
+    return result;
+}
+
+VkResult CaptureLayer::queuePresent(VkQueue queue, const VkPresentInfoKHR* presentInfo) {
+    VkResult result = vkd.vkQueuePresentKHR(queue, presentInfo);
+    CaptureLayer& capture = instance();
+    if (!capture.isCapturing()) {
+        return result;
+    }
+
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    capture.writeRecord(CaptureOp::Present, CapturedPresent{ presentInfo->swapchainCount });
+    return result;
+}
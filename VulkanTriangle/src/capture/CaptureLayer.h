@@ -0,0 +1,165 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CaptureFormat.h"
+
+// Commands recorded into a command buffer since it began, written out as one record when it ends
+struct CaptureCommandStream {
+	CapturedCommandBuffer header{};
+	std::vector<uint8_t> data;
+	size_t recordBegin = 0;
+
+	void begin(CaptureOp op) {
+		recordBegin = data.size();
+		write(CaptureRecord{ op, 0 });
+	}
+
+	template<typename T>
+	void write(const T& value) {
+		writeBytes(&value, sizeof(T));
+	}
+
+	void writeBytes(const void* bytes, size_t size) {
+		const uint8_t* begin = static_cast<const uint8_t*>(bytes);
+		data.insert(data.end(), begin, begin + size);
+	}
+
+	void end() {
+		uint32_t size = static_cast<uint32_t>(data.size() - recordBegin - sizeof(CaptureRecord));
+		memcpy(data.data() + recordBegin + offsetof(CaptureRecord, size), &size, sizeof(size));
+	}
+};
+
+/**
+    * Capture of what the engine submits, see CaptureFormat.h. The engine records its frames
+    * through the entry points below instead of calling Vulkan directly: they forward the call
+    * and, while a capture runs, encode it. Objects the commands refer to are tracked from their
+    * creation on, capturing or not, so the same initialization yields the same object ids in the
+    * replaying process. Outside of a capture the cost is a relaxed atomic load per call.
+    **/
+class CaptureLayer {
+public:
+	static CaptureLayer& instance();
+
+	template<typename T>
+	void track(CaptureObjectType type, T handle) {
+		trackHandle(type, (uint64_t)handle);
+	}
+	template<typename T>
+	void untrack(CaptureObjectType type, T handle) {
+		untrackHandle(type, (uint64_t)handle);
+	}
+	// An object created again at run time takes over the id of the one it replaces
+	template<typename T>
+	void replace(CaptureObjectType type, T oldHandle, T newHandle) {
+		replaceHandle(type, (uint64_t)oldHandle, (uint64_t)newHandle);
+	}
+	// Images created after initialization, and swap chain ones, are created again by the replay
+	void trackImage(VkImage image, const VkImageCreateInfo& imageInfo, CaptureObjectType type = CaptureObjectType::Image);
+	// Host writes to mapped buffers are captured by captureWrite, the replay writes to the same mapping
+	void trackMapping(VkBuffer buffer, void* mapped);
+	// Object counts of the initialization, objects created afterwards are captured along with the frames
+	void endInitialization();
+
+	// Replay side, VK_NULL_HANDLE for CAPTURE_NO_OBJECT
+	uint64_t resolve(CaptureObjectType type, uint32_t id) const;
+	uint8_t* resolveMapping(uint32_t buffer) const;
+	const uint32_t* getInitialObjectCounts() const {
+		return initialObjectCounts;
+	}
+
+	void start(const std::string& path, const CaptureHeader& header, const std::vector<std::string>& meshPaths);
+	void stop();
+	bool isCapturing() const {
+		return capturing.load(std::memory_order_relaxed);
+	}
+
+	// After the host wrote size bytes at offset of the tracked mapping of buffer
+	void captureWrite(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+
+	// Vulkan entry points of the frame
+	static VkResult beginCommandBuffer(VkCommandBuffer commandBuffer, const VkCommandBufferBeginInfo* beginInfo);
+	static VkResult endCommandBuffer(VkCommandBuffer commandBuffer);
+	static void cmdBeginRenderPass(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo* renderPassBegin, VkSubpassContents contents);
+	static void cmdEndRenderPass(VkCommandBuffer commandBuffer);
+	static void cmdExecuteCommands(VkCommandBuffer commandBuffer, uint32_t commandBufferCount, const VkCommandBuffer* commandBuffers);
+	static void cmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipeline pipeline);
+	static void cmdBindVertexBuffers(VkCommandBuffer commandBuffer, uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* buffers, const VkDeviceSize* offsets);
+	static void cmdBindIndexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+	static void cmdBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet,
+		uint32_t descriptorSetCount, const VkDescriptorSet* descriptorSets, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets);
+	static void cmdPushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* values);
+	static void cmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance);
+	static void cmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+	static void cmdDispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
+	static void cmdSetViewport(VkCommandBuffer commandBuffer, uint32_t firstViewport, uint32_t viewportCount, const VkViewport* viewports);
+	static void cmdSetScissor(VkCommandBuffer commandBuffer, uint32_t firstScissor, uint32_t scissorCount, const VkRect2D* scissors);
+	static void cmdBeginRendering(VkCommandBuffer commandBuffer, const VkRenderingInfo* renderingInfo);
+	static void cmdEndRendering(VkCommandBuffer commandBuffer);
+	static void cmdPipelineBarrier2(VkCommandBuffer commandBuffer, const VkDependencyInfo* dependencyInfo);
+	static void cmdPipelineBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlags,
+		uint32_t memoryBarrierCount, const VkMemoryBarrier* memoryBarriers, uint32_t bufferBarrierCount, const VkBufferMemoryBarrier* bufferBarriers,
+		uint32_t imageBarrierCount, const VkImageMemoryBarrier* imageBarriers);
+	static void cmdCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkImage dstImage, VkImageLayout dstLayout, uint32_t regionCount, const VkBufferImageCopy* regions);
+	static void cmdCopyImage(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout srcLayout, VkImage dstImage, VkImageLayout dstLayout, uint32_t regionCount, const VkImageCopy* regions);
+	static void cmdBlitImage(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout srcLayout, VkImage dstImage, VkImageLayout dstLayout,
+		uint32_t regionCount, const VkImageBlit* regions, VkFilter filter);
+	static void cmdResetQueryPool(VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount);
+	static void cmdWriteTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage, VkQueryPool queryPool, uint32_t query);
+	static VkResult queueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence);
+	// Ends the captured frame
+	static VkResult queuePresent(VkQueue queue, const VkPresentInfoKHR* presentInfo);
+
+private:
+	void trackHandle(CaptureObjectType type, uint64_t handle);
+	void untrackHandle(CaptureObjectType type, uint64_t handle);
+	void replaceHandle(CaptureObjectType type, uint64_t oldHandle, uint64_t newHandle);
+	// Expect mutex to be held
+	uint32_t addObject(CaptureObjectType type, uint64_t handle);
+	uint32_t getId(CaptureObjectType type, uint64_t handle) const;
+	uint32_t getImageId(VkImage image) const;
+	CaptureCommandStream* findStream(VkCommandBuffer commandBuffer);
+	void writeImage(const CapturedImage& image);
+
+	template<typename T>
+	uint32_t getId(CaptureObjectType type, T handle) const {
+		return getId(type, (uint64_t)handle);
+	}
+
+	template<typename T>
+	void writeRecord(CaptureOp op, const T& payload, const void* extra = nullptr, size_t extraSize = 0) {
+		CaptureRecord record{ op, static_cast<uint32_t>(sizeof(T) + extraSize) };
+		file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+		file.write(reinterpret_cast<const char*>(&payload), sizeof(T));
+		if (extraSize > 0) {
+			file.write(static_cast<const char*>(extra), extraSize);
+		}
+	}
+
+	mutable std::mutex mutex;
+	std::atomic<bool> capturing{ false };
+	bool initialized = false;
+	std::ofstream file;
+
+	// Per type, handle to id and id to handle, ids are never reused
+	std::unordered_map<uint64_t, uint32_t> ids[CAPTURE_OBJECT_TYPE_COUNT];
+	std::vector<uint64_t> handles[CAPTURE_OBJECT_TYPE_COUNT];
+	uint32_t initialObjectCounts[CAPTURE_OBJECT_TYPE_COUNT] = {};
+	// Live images the replay has to create, by id
+	std::unordered_map<uint32_t, CapturedImage> recreatedImages;
+	// Mapped pointers by buffer id
+	std::unordered_map<uint32_t, uint8_t*> mappings;
+
+	std::unordered_map<VkCommandBuffer, CaptureCommandStream> streams;
+	std::vector<uint32_t> scratchIds;
+};
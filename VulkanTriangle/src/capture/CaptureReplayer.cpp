@@ -0,0 +1,590 @@
+#include "CaptureReplayer.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "../Utils.h"
+
+// The replaying device has no swap chain extension, presented images are left in the general layout
+static VkImageLayout getReplayLayout(uint32_t layout) {
+    return layout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR ? VK_IMAGE_LAYOUT_GENERAL : static_cast<VkImageLayout>(layout);
+}
+
+void CaptureReplayer::open(const std::string& path) {
+    file = std::make_unique<MappedFile>(path);
+    CaptureReader reader(file->data(), file->size());
+
+    header = reader.read<CaptureHeader>();
+    if (header.magic != CAPTURE_MAGIC || header.version != CAPTURE_VERSION) {
+        throw std::runtime_error("unsupported capture file!");
+    }
+
+    // The mesh paths come first, the frames start after them
+    meshPaths.clear();
+    streamBegin = reader.position();
+    while (!reader.done()) {
+        CaptureRecord record = reader.read<CaptureRecord>();
+        if (record.op != CaptureOp::MeshPath) {
+            break;
+        }
+        const uint8_t* meshPath = reader.readBytes(record.size);
+        meshPaths.emplace_back(reinterpret_cast<const char*>(meshPath), record.size);
+        streamBegin = reader.position();
+    }
+}
+
+void CaptureReplayer::run(VulkanEngine& vkEngine, bool frameByFrame) {
+    this->vkEngine = &vkEngine;
+
+    // Ids are creation indices, they only match when the initialization created the same objects
+    const uint32_t* objectCounts = CaptureLayer::instance().getInitialObjectCounts();
+    for (uint32_t type = 0; type < CAPTURE_OBJECT_TYPE_COUNT; type++) {
+        bool replaced = type == static_cast<uint32_t>(CaptureObjectType::SwapchainImage) || type == static_cast<uint32_t>(CaptureObjectType::CommandBuffer);
+        if (!replaced && objectCounts[type] != header.objectCounts[type]) {
+            throw std::runtime_error("capture was made by a different engine initialization!");
+        }
+    }
+
+    QueueFamilyIndices queueFamilyIndices = Utils::findQueueFamilies(vkEngine, vkEngine.physicalDevice);
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    if (vkd.vkCreateCommandPool(vkEngine.device, &poolInfo, nullptr, commandPool.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create replay command pool!");
+    }
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    fences.resize(std::max(header.framesInFlight, 1u));
+    semaphores.resize(fences.size());
+    for (UniqueFence& fence : fences) {
+        if (vkd.vkCreateFence(vkEngine.device, &fenceInfo, nullptr, fence.put(vkEngine.device)) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create replay fence!");
+        }
+    }
+
+    CaptureReader reader(file->data() + streamBegin, file->size() - streamBegin);
+    auto start = std::chrono::high_resolution_clock::now();
+    while (!reader.done()) {
+        CaptureRecord record = reader.read<CaptureRecord>();
+        CaptureReader payload(reader.readBytes(record.size), record.size);
+
+        switch (record.op) {
+        case CaptureOp::CreateImage:
+            createImage(payload.read<CapturedImage>());
+            break;
+        case CaptureOp::Write: {
+            // After the fence of the frame slot, as the captured engine did
+            beginFrame();
+            CapturedWrite write = payload.read<CapturedWrite>();
+            const uint8_t* data = payload.readBytes(static_cast<size_t>(write.size));
+            memcpy(CaptureLayer::instance().resolveMapping(write.buffer) + write.offset, data, static_cast<size_t>(write.size));
+            break;
+        }
+        case CaptureOp::CommandBuffer:
+            beginFrame();
+            recordCommandBuffer(payload);
+            break;
+        case CaptureOp::Submit:
+            beginFrame();
+            submit(payload);
+            break;
+        case CaptureOp::Present:
+            endFrame(frameByFrame);
+            break;
+        default:
+            throw std::runtime_error("unexpected capture record!");
+        }
+    }
+
+    vkd.vkQueueWaitIdle(vkEngine.graphicsQueue);
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "replayed " << frameCount << " frames in " << seconds << " s, " << frameCount / seconds << " frames/s" << "\n";
+}
+
+void CaptureReplayer::destroy() {
+    images.clear();
+    imageMemories.clear();
+    fences.clear();
+    semaphores.clear();
+    commandBuffers.clear();
+    // Frees the command buffers
+    commandPool.reset();
+}
+
+void CaptureReplayer::beginFrame() {
+    if (frameStarted) {
+        return;
+    }
+
+    // The GPU is done with the command buffers and the mapped regions of this frame slot
+    vkd.vkWaitForFences(vkEngine->device, 1, fences[frameSlot].address(), VK_TRUE, UINT64_MAX);
+    frameStarted = true;
+    submitIndex = 0;
+    frameStart = std::chrono::high_resolution_clock::now();
+}
+
+void CaptureReplayer::endFrame(bool frameByFrame) {
+    beginFrame();
+
+    // Signals the fence once the last submission of the frame is done
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    if (submitIndex > 0) {
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = semaphores[frameSlot][submitIndex - 1].address();
+        submitInfo.pWaitDstStageMask = &waitStage;
+    }
+
+    vkd.vkResetFences(vkEngine->device, 1, fences[frameSlot].address());
+    if (vkd.vkQueueSubmit(vkEngine->graphicsQueue, 1, &submitInfo, fences[frameSlot]) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit replayed frame!");
+    }
+
+    if (frameByFrame) {
+        vkd.vkWaitForFences(vkEngine->device, 1, fences[frameSlot].address(), VK_TRUE, UINT64_MAX);
+        double frameMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count();
+        std::cout << "frame " << frameCount << ": " << frameMs << " ms" << "\n";
+    }
+
+    frameCount++;
+    frameSlot = (frameSlot + 1) % fences.size();
+    frameStarted = false;
+}
+
+void CaptureReplayer::createImage(const CapturedImage& image) {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = image.width;
+    imageInfo.extent.height = image.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = image.mipLevels;
+    imageInfo.arrayLayers = image.arrayLayers;
+    imageInfo.format = static_cast<VkFormat>(image.format);
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = image.usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    UniqueImage replayImage;
+    if (vkd.vkCreateImage(vkEngine->device, &imageInfo, nullptr, replayImage.put(vkEngine->device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create replay image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkd.vkGetImageMemoryRequirements(vkEngine->device, replayImage, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = Utils::findMemoryType(*vkEngine, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    UniqueDeviceMemory memory;
+    if (vkd.vkAllocateMemory(vkEngine->device, &allocInfo, nullptr, memory.put(vkEngine->device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate replay image memory!");
+    }
+    vkd.vkBindImageMemory(vkEngine->device, replayImage, memory, 0);
+
+    uint32_t id = image.type == CaptureObjectType::SwapchainImage ? image.id | CAPTURE_SWAPCHAIN_IMAGE_BIT : image.id;
+    images[id] = std::move(replayImage);
+    imageMemories.push_back(std::move(memory));
+}
+
+void CaptureReplayer::recordCommandBuffer(CaptureReader& reader) {
+    CapturedCommandBuffer captured = reader.read<CapturedCommandBuffer>();
+    VkCommandBufferLevel level = static_cast<VkCommandBufferLevel>(captured.level);
+    VkCommandBuffer commandBuffer = getCommandBuffer(captured.id, level);
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = resolve<VkRenderPass>(CaptureObjectType::RenderPass, captured.renderPass);
+    inheritanceInfo.subpass = captured.subpass;
+
+    VkFormat colorFormat = static_cast<VkFormat>(captured.colorFormat);
+    VkCommandBufferInheritanceRenderingInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &colorFormat;
+    renderingInfo.viewMask = captured.viewMask;
+    renderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    if (inheritanceInfo.renderPass == VK_NULL_HANDLE && colorFormat != VK_FORMAT_UNDEFINED) {
+        inheritanceInfo.pNext = &renderingInfo;
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = captured.flags;
+    beginInfo.pInheritanceInfo = level == VK_COMMAND_BUFFER_LEVEL_SECONDARY ? &inheritanceInfo : nullptr;
+
+    if (vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording replayed command buffer!");
+    }
+
+    while (!reader.done()) {
+        CaptureRecord record = reader.read<CaptureRecord>();
+        CaptureReader command(reader.readBytes(record.size), record.size);
+        recordCommand(commandBuffer, record.op, command);
+    }
+
+    if (vkd.vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record replayed command buffer!");
+    }
+}
+
+void CaptureReplayer::recordCommand(VkCommandBuffer commandBuffer, CaptureOp op, CaptureReader& reader) {
+    switch (op) {
+    case CaptureOp::BeginRenderPass: {
+        CapturedBeginRenderPass command = reader.read<CapturedBeginRenderPass>();
+        reader.readArray(command.clearValueCount, scratchClearValues);
+
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = resolve<VkRenderPass>(CaptureObjectType::RenderPass, command.renderPass);
+        renderPassInfo.framebuffer = resolve<VkFramebuffer>(CaptureObjectType::Framebuffer, command.framebuffer);
+        renderPassInfo.renderArea = command.renderArea;
+        renderPassInfo.clearValueCount = command.clearValueCount;
+        renderPassInfo.pClearValues = scratchClearValues.data();
+        vkd.vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, static_cast<VkSubpassContents>(command.contents));
+        break;
+    }
+    case CaptureOp::EndRenderPass:
+        vkd.vkCmdEndRenderPass(commandBuffer);
+        break;
+    case CaptureOp::ExecuteCommands: {
+        CapturedExecuteCommands command = reader.read<CapturedExecuteCommands>();
+        scratchCommandBuffers.clear();
+        for (uint32_t i = 0; i < command.commandBufferCount; i++) {
+            auto found = commandBuffers.find(reader.read<uint32_t>());
+            if (found == commandBuffers.end()) {
+                throw std::runtime_error("capture executes a command buffer it did not record!");
+            }
+            scratchCommandBuffers.push_back(found->second);
+        }
+        vkd.vkCmdExecuteCommands(commandBuffer, command.commandBufferCount, scratchCommandBuffers.data());
+        break;
+    }
+    case CaptureOp::BindPipeline: {
+        CapturedBindPipeline command = reader.read<CapturedBindPipeline>();
+        vkd.vkCmdBindPipeline(commandBuffer, static_cast<VkPipelineBindPoint>(command.bindPoint), resolve<VkPipeline>(CaptureObjectType::Pipeline, command.pipeline));
+        break;
+    }
+    case CaptureOp::BindVertexBuffers: {
+        CapturedBindVertexBuffers command = reader.read<CapturedBindVertexBuffers>();
+        scratchBuffers.clear();
+        for (uint32_t i = 0; i < command.bindingCount; i++) {
+            scratchBuffers.push_back(resolve<VkBuffer>(CaptureObjectType::Buffer, reader.read<uint32_t>()));
+        }
+        reader.readArray(command.bindingCount, scratchOffsets);
+        vkd.vkCmdBindVertexBuffers(commandBuffer, command.firstBinding, command.bindingCount, scratchBuffers.data(), scratchOffsets.data());
+        break;
+    }
+    case CaptureOp::BindIndexBuffer: {
+        CapturedBindIndexBuffer command = reader.read<CapturedBindIndexBuffer>();
+        vkd.vkCmdBindIndexBuffer(commandBuffer, resolve<VkBuffer>(CaptureObjectType::Buffer, command.buffer), command.offset, static_cast<VkIndexType>(command.indexType));
+        break;
+    }
+    case CaptureOp::BindDescriptorSets: {
+        CapturedBindDescriptorSets command = reader.read<CapturedBindDescriptorSets>();
+        scratchDescriptorSets.clear();
+        for (uint32_t i = 0; i < command.descriptorSetCount; i++) {
+            scratchDescriptorSets.push_back(resolve<VkDescriptorSet>(CaptureObjectType::DescriptorSet, reader.read<uint32_t>()));
+        }
+        reader.readArray(command.dynamicOffsetCount, scratchDynamicOffsets);
+        vkd.vkCmdBindDescriptorSets(commandBuffer, static_cast<VkPipelineBindPoint>(command.bindPoint), resolve<VkPipelineLayout>(CaptureObjectType::PipelineLayout, command.layout),
+            command.firstSet, command.descriptorSetCount, scratchDescriptorSets.data(), command.dynamicOffsetCount, scratchDynamicOffsets.data());
+        break;
+    }
+    case CaptureOp::PushConstants: {
+        CapturedPushConstants command = reader.read<CapturedPushConstants>();
+        const uint8_t* values = reader.readBytes(command.size);
+        vkd.vkCmdPushConstants(commandBuffer, resolve<VkPipelineLayout>(CaptureObjectType::PipelineLayout, command.layout), command.stageFlags, command.offset, command.size, values);
+        break;
+    }
+    case CaptureOp::Draw: {
+        CapturedDraw command = reader.read<CapturedDraw>();
+        vkd.vkCmdDraw(commandBuffer, command.vertexCount, command.instanceCount, command.firstVertex, command.firstInstance);
+        break;
+    }
+    case CaptureOp::DrawIndexed: {
+        CapturedDrawIndexed command = reader.read<CapturedDrawIndexed>();
+        vkd.vkCmdDrawIndexed(commandBuffer, command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
+        break;
+    }
+    case CaptureOp::Dispatch: {
+        CapturedDispatch command = reader.read<CapturedDispatch>();
+        vkd.vkCmdDispatch(commandBuffer, command.groupCountX, command.groupCountY, command.groupCountZ);
+        break;
+    }
+    case CaptureOp::SetViewport: {
+        CapturedSetViewport command = reader.read<CapturedSetViewport>();
+        reader.readArray(command.count, scratchViewports);
+        vkd.vkCmdSetViewport(commandBuffer, command.first, command.count, scratchViewports.data());
+        break;
+    }
+    case CaptureOp::SetScissor: {
+        CapturedSetViewport command = reader.read<CapturedSetViewport>();
+        reader.readArray(command.count, scratchScissors);
+        vkd.vkCmdSetScissor(commandBuffer, command.first, command.count, scratchScissors.data());
+        break;
+    }
+    case CaptureOp::PipelineBarrier: {
+        CapturedPipelineBarrier command = reader.read<CapturedPipelineBarrier>();
+
+        scratchMemoryBarriers.clear();
+        for (uint32_t i = 0; i < command.memoryBarrierCount; i++) {
+            CapturedMemoryBarrier captured = reader.read<CapturedMemoryBarrier>();
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = captured.srcAccessMask;
+            barrier.dstAccessMask = captured.dstAccessMask;
+            scratchMemoryBarriers.push_back(barrier);
+        }
+
+        scratchBufferBarriers.clear();
+        for (uint32_t i = 0; i < command.bufferBarrierCount; i++) {
+            CapturedBufferBarrier captured = reader.read<CapturedBufferBarrier>();
+            VkBufferMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = captured.srcAccessMask;
+            barrier.dstAccessMask = captured.dstAccessMask;
+            barrier.srcQueueFamilyIndex = captured.srcQueueFamilyIndex;
+            barrier.dstQueueFamilyIndex = captured.dstQueueFamilyIndex;
+            barrier.buffer = resolve<VkBuffer>(CaptureObjectType::Buffer, captured.buffer);
+            barrier.offset = captured.offset;
+            barrier.size = captured.size;
+            scratchBufferBarriers.push_back(barrier);
+        }
+
+        scratchImageBarriers.clear();
+        for (uint32_t i = 0; i < command.imageBarrierCount; i++) {
+            CapturedImageBarrier captured = reader.read<CapturedImageBarrier>();
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = captured.srcAccessMask;
+            barrier.dstAccessMask = captured.dstAccessMask;
+            barrier.oldLayout = getReplayLayout(captured.oldLayout);
+            barrier.newLayout = getReplayLayout(captured.newLayout);
+            barrier.srcQueueFamilyIndex = captured.srcQueueFamilyIndex;
+            barrier.dstQueueFamilyIndex = captured.dstQueueFamilyIndex;
+            barrier.image = resolveImage(captured.image);
+            barrier.subresourceRange = captured.subresourceRange;
+            scratchImageBarriers.push_back(barrier);
+        }
+
+        vkd.vkCmdPipelineBarrier(commandBuffer, command.srcStageMask, command.dstStageMask, command.dependencyFlags,
+            command.memoryBarrierCount, scratchMemoryBarriers.data(), command.bufferBarrierCount, scratchBufferBarriers.data(),
+            command.imageBarrierCount, scratchImageBarriers.data());
+        break;
+    }
+    case CaptureOp::CopyBufferToImage: {
+        CapturedCopy command = reader.read<CapturedCopy>();
+        reader.readArray(command.regionCount, scratchBufferImageCopies);
+        vkd.vkCmdCopyBufferToImage(commandBuffer, resolve<VkBuffer>(CaptureObjectType::Buffer, command.src), resolveImage(command.dst),
+            getReplayLayout(command.dstLayout), command.regionCount, scratchBufferImageCopies.data());
+        break;
+    }
+    case CaptureOp::CopyImage: {
+        CapturedCopy command = reader.read<CapturedCopy>();
+        reader.readArray(command.regionCount, scratchImageCopies);
+        vkd.vkCmdCopyImage(commandBuffer, resolveImage(command.src), getReplayLayout(command.srcLayout), resolveImage(command.dst),
+            getReplayLayout(command.dstLayout), command.regionCount, scratchImageCopies.data());
+        break;
+    }
+    case CaptureOp::BlitImage: {
+        CapturedCopy command = reader.read<CapturedCopy>();
+        reader.readArray(command.regionCount, scratchImageBlits);
+        vkd.vkCmdBlitImage(commandBuffer, resolveImage(command.src), getReplayLayout(command.srcLayout), resolveImage(command.dst),
+            getReplayLayout(command.dstLayout), command.regionCount, scratchImageBlits.data(), static_cast<VkFilter>(command.filter));
+        break;
+    }
+    case CaptureOp::ResetQueryPool: {
+        CapturedQuery command = reader.read<CapturedQuery>();
+        vkd.vkCmdResetQueryPool(commandBuffer, resolve<VkQueryPool>(CaptureObjectType::QueryPool, command.queryPool), command.first, command.count);
+        break;
+    }
+    case CaptureOp::WriteTimestamp: {
+        CapturedQuery command = reader.read<CapturedQuery>();
+        vkd.vkCmdWriteTimestamp(commandBuffer, static_cast<VkPipelineStageFlagBits>(command.stage), resolve<VkQueryPool>(CaptureObjectType::QueryPool, command.queryPool), command.first);
+        break;
+    }
+    case CaptureOp::BeginRendering: {
+        CapturedBeginRendering command = reader.read<CapturedBeginRendering>();
+
+        scratchRenderingAttachments.clear();
+        for (uint32_t i = 0; i < command.colorAttachmentCount; i++) {
+            CapturedRenderingAttachment captured = reader.read<CapturedRenderingAttachment>();
+            VkRenderingAttachmentInfo attachment{};
+            attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+            attachment.imageView = resolve<VkImageView>(CaptureObjectType::ImageView, captured.imageView);
+            attachment.imageLayout = getReplayLayout(captured.imageLayout);
+            attachment.loadOp = static_cast<VkAttachmentLoadOp>(captured.loadOp);
+            attachment.storeOp = static_cast<VkAttachmentStoreOp>(captured.storeOp);
+            attachment.clearValue = captured.clearValue;
+            scratchRenderingAttachments.push_back(attachment);
+        }
+
+        VkRenderingInfo renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.flags = command.flags;
+        renderingInfo.renderArea = command.renderArea;
+        renderingInfo.layerCount = command.layerCount;
+        renderingInfo.viewMask = command.viewMask;
+        renderingInfo.colorAttachmentCount = command.colorAttachmentCount;
+        renderingInfo.pColorAttachments = scratchRenderingAttachments.data();
+        vkd.vkCmdBeginRendering(commandBuffer, &renderingInfo);
+        break;
+    }
+    case CaptureOp::EndRendering:
+        vkd.vkCmdEndRendering(commandBuffer);
+        break;
+    case CaptureOp::PipelineBarrier2: {
+        CapturedPipelineBarrier2 command = reader.read<CapturedPipelineBarrier2>();
+
+        scratchMemoryBarriers2.clear();
+        for (uint32_t i = 0; i < command.memoryBarrierCount; i++) {
+            CapturedMemoryBarrier2 captured = reader.read<CapturedMemoryBarrier2>();
+            VkMemoryBarrier2 barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+            barrier.srcStageMask = captured.srcStageMask;
+            barrier.srcAccessMask = captured.srcAccessMask;
+            barrier.dstStageMask = captured.dstStageMask;
+            barrier.dstAccessMask = captured.dstAccessMask;
+            scratchMemoryBarriers2.push_back(barrier);
+        }
+
+        scratchBufferBarriers2.clear();
+        for (uint32_t i = 0; i < command.bufferBarrierCount; i++) {
+            CapturedBufferBarrier2 captured = reader.read<CapturedBufferBarrier2>();
+            VkBufferMemoryBarrier2 barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+            barrier.srcStageMask = captured.masks.srcStageMask;
+            barrier.srcAccessMask = captured.masks.srcAccessMask;
+            barrier.dstStageMask = captured.masks.dstStageMask;
+            barrier.dstAccessMask = captured.masks.dstAccessMask;
+            barrier.srcQueueFamilyIndex = captured.srcQueueFamilyIndex;
+            barrier.dstQueueFamilyIndex = captured.dstQueueFamilyIndex;
+            barrier.buffer = resolve<VkBuffer>(CaptureObjectType::Buffer, captured.buffer);
+            barrier.offset = captured.offset;
+            barrier.size = captured.size;
+            scratchBufferBarriers2.push_back(barrier);
+        }
+
+        scratchImageBarriers2.clear();
+        for (uint32_t i = 0; i < command.imageBarrierCount; i++) {
+            CapturedImageBarrier2 captured = reader.read<CapturedImageBarrier2>();
+            VkImageMemoryBarrier2 barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+            barrier.srcStageMask = captured.masks.srcStageMask;
+            barrier.srcAccessMask = captured.masks.srcAccessMask;
+            barrier.dstStageMask = captured.masks.dstStageMask;
+            barrier.dstAccessMask = captured.masks.dstAccessMask;
+            barrier.oldLayout = getReplayLayout(captured.oldLayout);
+            barrier.newLayout = getReplayLayout(captured.newLayout);
+            barrier.srcQueueFamilyIndex = captured.srcQueueFamilyIndex;
+            barrier.dstQueueFamilyIndex = captured.dstQueueFamilyIndex;
+            barrier.image = resolveImage(captured.image);
+            barrier.subresourceRange = captured.subresourceRange;
+            scratchImageBarriers2.push_back(barrier);
+        }
+
+        VkDependencyInfo dependencyInfo{};
+        dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependencyInfo.dependencyFlags = command.dependencyFlags;
+        dependencyInfo.memoryBarrierCount = command.memoryBarrierCount;
+        dependencyInfo.pMemoryBarriers = scratchMemoryBarriers2.data();
+        dependencyInfo.bufferMemoryBarrierCount = command.bufferBarrierCount;
+        dependencyInfo.pBufferMemoryBarriers = scratchBufferBarriers2.data();
+        dependencyInfo.imageMemoryBarrierCount = command.imageBarrierCount;
+        dependencyInfo.pImageMemoryBarriers = scratchImageBarriers2.data();
+        vkd.vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+        break;
+    }
+    default:
+        throw std::runtime_error("unexpected capture command!");
+    }
+}
+
+void CaptureReplayer::submit(CaptureReader& reader) {
+    CapturedSubmit captured = reader.read<CapturedSubmit>();
+    scratchCommandBuffers.clear();
+    for (uint32_t i = 0; i < captured.commandBufferCount; i++) {
+        auto found = commandBuffers.find(reader.read<uint32_t>());
+        if (found == commandBuffers.end()) {
+            throw std::runtime_error("capture submits a command buffer it did not record!");
+        }
+        scratchCommandBuffers.push_back(found->second);
+    }
+
+    std::vector<UniqueSemaphore>& frameSemaphores = semaphores[frameSlot];
+    if (submitIndex == frameSemaphores.size()) {
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        UniqueSemaphore semaphore;
+        if (vkd.vkCreateSemaphore(vkEngine->device, &semaphoreInfo, nullptr, semaphore.put(vkEngine->device)) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create replay semaphore!");
+        }
+        frameSemaphores.push_back(std::move(semaphore));
+    }
+
+    // Waits for the previous submission of the frame, the captured engine used several queues
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    if (submitIndex > 0) {
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = frameSemaphores[submitIndex - 1].address();
+        submitInfo.pWaitDstStageMask = &waitStage;
+    }
+    submitInfo.commandBufferCount = captured.commandBufferCount;
+    submitInfo.pCommandBuffers = scratchCommandBuffers.data();
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = frameSemaphores[submitIndex].address();
+
+    if (vkd.vkQueueSubmit(vkEngine->graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit replayed command buffers!");
+    }
+    submitIndex++;
+}
+
+VkCommandBuffer CaptureReplayer::getCommandBuffer(uint32_t id, VkCommandBufferLevel level) {
+    auto found = commandBuffers.find(id);
+    if (found != commandBuffers.end()) {
+        return found->second;
+    }
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = level;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    if (vkd.vkAllocateCommandBuffers(vkEngine->device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate replay command buffer!");
+    }
+    commandBuffers[id] = commandBuffer;
+    return commandBuffer;
+}
+
+VkImage CaptureReplayer::resolveImage(uint32_t id) const {
+    if (id == CAPTURE_NO_OBJECT) {
+        return VK_NULL_HANDLE;
+    }
+    auto found = images.find(id);
+    if (found != images.end()) {
+        return found->second;
+    }
+    if (id & CAPTURE_SWAPCHAIN_IMAGE_BIT) {
+        throw std::runtime_error("capture refers to a swap chain image it did not create!");
+    }
+    return resolve<VkImage>(CaptureObjectType::Image, id);
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CaptureFormat.h"
+#include "CaptureLayer.h"
+#include "../io/MappedFile.h"
+#include "../VulkanHandle.h"
+
+class VulkanEngine;
+
+// Bounds checked reads of a capture, records are not aligned
+class CaptureReader {
+public:
+	CaptureReader(const uint8_t* data, size_t size) : bytes(data), byteCount(size) {}
+
+	template<typename T>
+	T read() {
+		T value;
+		memcpy(&value, readBytes(sizeof(T)), sizeof(T));
+		return value;
+	}
+
+	template<typename T>
+	void readArray(size_t count, std::vector<T>& values) {
+		values.resize(count);
+		if (count > 0) {
+			memcpy(values.data(), readBytes(count * sizeof(T)), count * sizeof(T));
+		}
+	}
+
+	const uint8_t* readBytes(size_t count) {
+		if (count > byteCount - offset) {
+			throw std::runtime_error("truncated capture file!");
+		}
+		const uint8_t* begin = bytes + offset;
+		offset += count;
+		return begin;
+	}
+
+	bool done() const {
+		return offset == byteCount;
+	}
+
+	size_t position() const {
+		return offset;
+	}
+
+private:
+	const uint8_t* bytes;
+	size_t byteCount;
+	size_t offset = 0;
+};
+
+/**
+    * Replays a capture on a headless engine initialized like the captured one, see open. The
+    * captured commands are recorded again into command buffers of the replay and submitted in
+    * order to the graphics queue, each submission waiting for the previous one of its frame as
+    * the captured queues did. Host writes are copied to the same mappings before the frame is
+    * submitted. Swap chain images are replaced by images of the replay, presents end the frame.
+    **/
+class CaptureReplayer {
+public:
+	// Reads what the engine needs to be initialized like the captured one: header and meshes
+	void open(const std::string& path);
+	// Full speed, or waiting for every frame and reporting its time
+	void run(VulkanEngine& vkEngine, bool frameByFrame);
+	void destroy();
+
+	CaptureHeader header;
+	std::vector<std::string> meshPaths;
+
+private:
+	void beginFrame();
+	void endFrame(bool frameByFrame);
+	void createImage(const CapturedImage& image);
+	void recordCommandBuffer(CaptureReader& reader);
+	void recordCommand(VkCommandBuffer commandBuffer, CaptureOp op, CaptureReader& reader);
+	void submit(CaptureReader& reader);
+	VkCommandBuffer getCommandBuffer(uint32_t id, VkCommandBufferLevel level);
+	VkImage resolveImage(uint32_t id) const;
+
+	template<typename T>
+	T resolve(CaptureObjectType type, uint32_t id) const {
+		return (T)CaptureLayer::instance().resolve(type, id);
+	}
+
+	std::unique_ptr<MappedFile> file;
+	size_t streamBegin = 0;
+
+	VulkanEngine* vkEngine = nullptr;
+	UniqueCommandPool commandPool;
+	std::unordered_map<uint32_t, VkCommandBuffer> commandBuffers;
+	// Images the replay created, swap chain ones with CAPTURE_SWAPCHAIN_IMAGE_BIT
+	std::unordered_map<uint32_t, UniqueImage> images;
+	std::vector<UniqueDeviceMemory> imageMemories;
+
+	// Per frame in flight, semaphores are signaled by the submissions of the frame in order
+	std::vector<UniqueFence> fences;
+	std::vector<std::vector<UniqueSemaphore>> semaphores;
+	size_t frameSlot = 0;
+	uint32_t submitIndex = 0;
+	bool frameStarted = false;
+	uint64_t frameCount = 0;
+	std::chrono::high_resolution_clock::time_point frameStart;
+
+	std::vector<VkCommandBuffer> scratchCommandBuffers;
+	std::vector<VkBuffer> scratchBuffers;
+	std::vector<VkDeviceSize> scratchOffsets;
+	std::vector<VkDescriptorSet> scratchDescriptorSets;
+	std::vector<uint32_t> scratchDynamicOffsets;
+	std::vector<VkClearValue> scratchClearValues;
+	std::vector<VkViewport> scratchViewports;
+	std::vector<VkRect2D> scratchScissors;
+	std::vector<VkMemoryBarrier> scratchMemoryBarriers;
+	std::vector<VkBufferMemoryBarrier> scratchBufferBarriers;
+	std::vector<VkImageMemoryBarrier> scratchImageBarriers;
+	std::vector<VkBufferImageCopy> scratchBufferImageCopies;
+	std::vector<VkImageCopy> scratchImageCopies;
+	std::vector<VkImageBlit> scratchImageBlits;
+	std::vector<VkRenderingAttachmentInfo> scratchRenderingAttachments;
+	std::vector<VkMemoryBarrier2> scratchMemoryBarriers2;
+	std::vector<VkBufferMemoryBarrier2> scratchBufferBarriers2;
+	std::vector<VkImageMemoryBarrier2> scratchImageBarriers2;
+};
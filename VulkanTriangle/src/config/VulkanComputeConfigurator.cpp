@@ -0,0 +1,246 @@
+#include "VulkanComputeConfigurator.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#include "VulkanGraphicPipeline.h"
+
+void VulkanComputeConfigurator::configureCompute(VulkanEngine& vkEngine) {
+    createParticleBuffers(vkEngine);
+    createComputeDescriptorSetLayout(vkEngine);
+    createComputeDescriptorSets(vkEngine);
+    createComputePipeline(vkEngine);
+    createComputeCommandBuffers(vkEngine);
+    createComputeSyncObjects(vkEngine);
+    createTimestampQueryPool(vkEngine);
+}
+
+/**
+    * One particle buffer per frame in flight: frame i simulates from the buffer of frame i - 1
+    * into its own buffer, so the next simulation step never writes what is being drawn
+    **/
+void VulkanComputeConfigurator::createParticleBuffers(VulkanEngine& vkEngine) {
+    std::default_random_engine rndEngine(0);
+    std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
+
+    std::vector<Particle> particles(PARTICLE_COUNT);
+    for (auto& particle : particles) {
+        float r = 0.25f * sqrt(rndDist(rndEngine));
+        float theta = rndDist(rndEngine) * 2.0f * 3.14159265358979f;
+        particle.position = glm::vec2(r * cos(theta), r * sin(theta));
+        particle.velocity = glm::normalize(particle.position) * 0.25f;
+        particle.color = glm::vec4(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine), 1.0f);
+    }
+
+    VkDeviceSize bufferSize = sizeof(Particle) * PARTICLE_COUNT;
+
+    UniqueBuffer stagingBuffer;
+    UniqueDeviceMemory stagingBufferMemory;
+    Utils::createBuffer(vkEngine, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, *stagingBuffer.put(vkEngine.device), *stagingBufferMemory.put(vkEngine.device));
+
+    void* data;
+    vkd.vkMapMemory(vkEngine.device, stagingBufferMemory, 0, bufferSize, 0, &data);
+    memcpy(data, particles.data(), (size_t)bufferSize);
+    vkd.vkUnmapMemory(vkEngine.device, stagingBufferMemory);
+
+    QueueFamilyIndices indices = Utils::findQueueFamilies(vkEngine, vkEngine.physicalDevice);
+    std::vector<uint32_t> queueFamilies = { indices.graphicsFamily.value() };
+    if (indices.computeFamily != indices.graphicsFamily) {
+        queueFamilies.push_back(indices.computeFamily.value());
+    }
+
+    vkEngine.particleBuffers.resize(vkEngine.MAX_FRAMES_IN_FLIGHT);
+    vkEngine.particleBuffersMemory.resize(vkEngine.MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < vkEngine.MAX_FRAMES_IN_FLIGHT; i++) {
+        VkBuffer particleBuffer;
+        VkDeviceMemory particleBufferMemory;
+        Utils::createBuffer(vkEngine, bufferSize,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, particleBuffer, particleBufferMemory, queueFamilies);
+        vkEngine.particleBuffers[i] = UniqueBuffer(vkEngine.device, particleBuffer);
+        vkEngine.particleBuffersMemory[i] = UniqueDeviceMemory(vkEngine.device, particleBufferMemory);
+        Utils::copyBuffer(vkEngine, stagingBuffer, vkEngine.particleBuffers[i], bufferSize);
+    }
+}
+
+void VulkanComputeConfigurator::createComputeDescriptorSetLayout(VulkanEngine& vkEngine) {
+    VkDescriptorSetLayoutBinding layoutBindings[2]{};
+    for (uint32_t i = 0; i < 2; i++) {
+        layoutBindings[i].binding = i;
+        layoutBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layoutBindings[i].descriptorCount = 1;
+        layoutBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = layoutBindings;
+
+    if (vkd.vkCreateDescriptorSetLayout(vkEngine.device, &layoutInfo, nullptr, vkEngine.computeDescriptorSetLayout.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute descriptor set layout!");
+    }
+}
+
+void VulkanComputeConfigurator::createComputeDescriptorSets(VulkanEngine& vkEngine) {
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = static_cast<uint32_t>(vkEngine.MAX_FRAMES_IN_FLIGHT) * 2;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = static_cast<uint32_t>(vkEngine.MAX_FRAMES_IN_FLIGHT);
+
+    if (vkd.vkCreateDescriptorPool(vkEngine.device, &poolInfo, nullptr, vkEngine.computeDescriptorPool.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(vkEngine.MAX_FRAMES_IN_FLIGHT, vkEngine.computeDescriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = vkEngine.computeDescriptorPool;
+    allocInfo.descriptorSetCount = static_cast<uint32_t>(vkEngine.MAX_FRAMES_IN_FLIGHT);
+    allocInfo.pSetLayouts = layouts.data();
+
+    vkEngine.computeDescriptorSets.resize(vkEngine.MAX_FRAMES_IN_FLIGHT);
+    if (vkd.vkAllocateDescriptorSets(vkEngine.device, &allocInfo, vkEngine.computeDescriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate compute descriptor sets!");
+    }
+    for (VkDescriptorSet set : vkEngine.computeDescriptorSets) {
+        CaptureLayer::instance().track(CaptureObjectType::DescriptorSet, set);
+    }
+
+    for (size_t i = 0; i < vkEngine.MAX_FRAMES_IN_FLIGHT; i++) {
+        size_t previous = (i + vkEngine.MAX_FRAMES_IN_FLIGHT - 1) % vkEngine.MAX_FRAMES_IN_FLIGHT;
+
+        VkDescriptorBufferInfo bufferInfos[2]{};
+        bufferInfos[0].buffer = vkEngine.particleBuffers[previous];
+        bufferInfos[0].offset = 0;
+        bufferInfos[0].range = sizeof(Particle) * PARTICLE_COUNT;
+        bufferInfos[1].buffer = vkEngine.particleBuffers[i];
+        bufferInfos[1].offset = 0;
+        bufferInfos[1].range = sizeof(Particle) * PARTICLE_COUNT;
+
+        VkWriteDescriptorSet descriptorWrites[2]{};
+        for (uint32_t binding = 0; binding < 2; binding++) {
+            descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[binding].dstSet = vkEngine.computeDescriptorSets[i];
+            descriptorWrites[binding].dstBinding = binding;
+            descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[binding].descriptorCount = 1;
+            descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+        }
+
+        vkd.vkUpdateDescriptorSets(vkEngine.device, 2, descriptorWrites, 0, nullptr);
+    }
+}
+
+void VulkanComputeConfigurator::createComputePipeline(VulkanEngine& vkEngine) {
+    auto compShaderCode = Utils::readFile("shaders/particle_comp.spv");
+    VkShaderModule compShaderModule = VulkanGraphicPipeline::createShaderModule(vkEngine, compShaderCode);
+
+    VkPipelineShaderStageCreateInfo compShaderStageInfo{};
+    compShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    compShaderStageInfo.module = compShaderModule;
+    compShaderStageInfo.pName = "main";
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(ParticlePushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = vkEngine.computeDescriptorSetLayout.address();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkd.vkCreatePipelineLayout(vkEngine.device, &pipelineLayoutInfo, nullptr, vkEngine.computePipelineLayout.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline layout!");
+    }
+    CaptureLayer::instance().track(CaptureObjectType::PipelineLayout, vkEngine.computePipelineLayout.get());
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.layout = vkEngine.computePipelineLayout;
+    pipelineInfo.stage = compShaderStageInfo;
+
+    if (vkd.vkCreateComputePipelines(vkEngine.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, vkEngine.computePipeline.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline!");
+    }
+    CaptureLayer::instance().track(CaptureObjectType::Pipeline, vkEngine.computePipeline.get());
+
+    vkd.vkDestroyShaderModule(vkEngine.device, compShaderModule, nullptr);
+}
+
+void VulkanComputeConfigurator::createComputeCommandBuffers(VulkanEngine& vkEngine) {
+    QueueFamilyIndices queueFamilyIndices = Utils::findQueueFamilies(vkEngine, vkEngine.physicalDevice);
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily.value();
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    if (vkd.vkCreateCommandPool(vkEngine.device, &poolInfo, nullptr, vkEngine.computeCommandPool.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute command pool!");
+    }
+
+    vkEngine.computeCommandBuffers.resize(vkEngine.MAX_FRAMES_IN_FLIGHT);
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = vkEngine.computeCommandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = (uint32_t)vkEngine.computeCommandBuffers.size();
+
+    if (vkd.vkAllocateCommandBuffers(vkEngine.device, &allocInfo, vkEngine.computeCommandBuffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate compute command buffers!");
+    }
+}
+
+void VulkanComputeConfigurator::createComputeSyncObjects(VulkanEngine& vkEngine) {
+    vkEngine.computeFinishedSemaphores.resize(vkEngine.MAX_FRAMES_IN_FLIGHT);
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    for (size_t i = 0; i < vkEngine.MAX_FRAMES_IN_FLIGHT; i++) {
+        if (vkd.vkCreateSemaphore(vkEngine.device, &semaphoreInfo, nullptr, vkEngine.computeFinishedSemaphores[i].put(vkEngine.device)) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute semaphores for a frame!");
+        }
+    }
+}
+
+void VulkanComputeConfigurator::createTimestampQueryPool(VulkanEngine& vkEngine) {
+    VkPhysicalDeviceProperties properties;
+    vki.vkGetPhysicalDeviceProperties(vkEngine.physicalDevice, &properties);
+
+    uint32_t queueFamilyCount = 0;
+    vki.vkGetPhysicalDeviceQueueFamilyProperties(vkEngine.physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vki.vkGetPhysicalDeviceQueueFamilyProperties(vkEngine.physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    // The benchmark is optional: without timestamps on both queues the simulation still runs
+    QueueFamilyIndices indices = Utils::findQueueFamilies(vkEngine, vkEngine.physicalDevice);
+    if (queueFamilies[indices.graphicsFamily.value()].timestampValidBits == 0 || queueFamilies[indices.computeFamily.value()].timestampValidBits == 0) {
+        std::cout << "Timestamps not supported, compute overlap benchmark disabled" << "\n";
+        return;
+    }
+
+    vkEngine.timestampPeriod = properties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = static_cast<uint32_t>(vkEngine.MAX_FRAMES_IN_FLIGHT) * 4;
+
+    if (vkd.vkCreateQueryPool(vkEngine.device, &queryPoolInfo, nullptr, vkEngine.timestampQueryPool.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timestamp query pool!");
+    }
+    CaptureLayer::instance().track(CaptureObjectType::QueryPool, vkEngine.timestampQueryPool.get());
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdexcept>
+
+#include "../Utils.h"
+#include "../VulkanEngine.h"
+
+class VulkanComputeConfigurator {
+public:
+	static void configureCompute(VulkanEngine& vkEngine);
+private:
+	static void createParticleBuffers(VulkanEngine& vkEngine);
+	static void createComputeDescriptorSetLayout(VulkanEngine& vkEngine);
+	static void createComputeDescriptorSets(VulkanEngine& vkEngine);
+	static void createComputePipeline(VulkanEngine& vkEngine);
+	static void createComputeCommandBuffers(VulkanEngine& vkEngine);
+	static void createComputeSyncObjects(VulkanEngine& vkEngine);
+	static void createTimestampQueryPool(VulkanEngine& vkEngine);
+};
\ No newline at end of file
@@ -1,28 +1,30 @@
 #include "VulkanDeviceInitializer.h"
 
 void VulkanDeviceInitializer::initializeDevice(VulkanEngine& vkEngine) {
-	createSurface(vkEngine);
+	createSurfaces(vkEngine);
 	pickPhysicalDevice(vkEngine);
 	createLogicalDevice(vkEngine);
 }
 
-void VulkanDeviceInitializer::createSurface(VulkanEngine& vkEngine) {
-	if (glfwCreateWindowSurface(vkEngine.instance, vkEngine.window, nullptr, &vkEngine.surface) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create window surface!");
+void VulkanDeviceInitializer::createSurfaces(VulkanEngine& vkEngine) {
+	for (WindowOutput& output : vkEngine.outputs) {
+		if (glfwCreateWindowSurface(vkEngine.instance, output.window, nullptr, &output.surface) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create window surface!");
+		}
 	}
 }
 
 void VulkanDeviceInitializer::pickPhysicalDevice(VulkanEngine& vkEngine) {
     // Query number of graphic cards
     uint32_t deviceCount = 0;
-    vkEnumeratePhysicalDevices(vkEngine.instance, &deviceCount, nullptr);
+    vki.vkEnumeratePhysicalDevices(vkEngine.instance, &deviceCount, nullptr);
     if (deviceCount == 0) {
         throw std::runtime_error("failed to find GPUs with Vulkan support!");
     }
 
     // Store all the devices in an array
     std::vector<VkPhysicalDevice> devices(deviceCount);
-    vkEnumeratePhysicalDevices(vkEngine.instance, &deviceCount, devices.data());
+    vki.vkEnumeratePhysicalDevices(vkEngine.instance, &deviceCount, devices.data());
 
     // Evaluate the devices
     for (const auto& device : devices) {
@@ -42,7 +44,7 @@ void VulkanDeviceInitializer::createLogicalDevice(VulkanEngine& vkEngine) {
     QueueFamilyIndices indices = Utils::findQueueFamilies(vkEngine, vkEngine.physicalDevice);
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.computeFamily.value() };
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -54,19 +56,79 @@ void VulkanDeviceInitializer::createLogicalDevice(VulkanEngine& vkEngine) {
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
-    // Logical device features
+    // Logical device features, compressed texture formats can only be sampled when their feature is enabled
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vki.vkGetPhysicalDeviceFeatures(vkEngine.physicalDevice, &supportedFeatures);
+
     VkPhysicalDeviceFeatures deviceFeatures{};
+    deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+    deviceFeatures.textureCompressionETC2 = supportedFeatures.textureCompressionETC2;
+    deviceFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
 
     // Create logical device struct
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
-    createInfo.queueCreateInfoCount = 1;
     createInfo.pEnabledFeatures = &deviceFeatures;
 
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    // Render without render pass and framebuffer objects when the instance and the device are 1.3
+    VkPhysicalDeviceProperties properties;
+    vki.vkGetPhysicalDeviceProperties(vkEngine.physicalDevice, &properties);
+
+    VkPhysicalDeviceVulkan13Features enabledVulkan13Features{};
+    enabledVulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    if (vkEngine.allowDynamicRendering && vkEngine.apiVersion >= VK_API_VERSION_1_3 && properties.apiVersion >= VK_API_VERSION_1_3) {
+        VkPhysicalDeviceVulkan13Features vulkan13Features{};
+        vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &vulkan13Features;
+        vki.vkGetPhysicalDeviceFeatures2(vkEngine.physicalDevice, &features2);
+
+        if (vulkan13Features.dynamicRendering && vulkan13Features.synchronization2) {
+            enabledVulkan13Features.dynamicRendering = VK_TRUE;
+            enabledVulkan13Features.synchronization2 = VK_TRUE;
+            createInfo.pNext = &enabledVulkan13Features;
+            vkEngine.dynamicRendering = true;
+        }
+    }
+
+    // Multiview is core in 1.1, required rather than optional since the views were asked for
+    VkPhysicalDeviceMultiviewFeatures enabledMultiviewFeatures{};
+    enabledMultiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES;
+    if (vkEngine.viewCount > 1) {
+        if (vkEngine.apiVersion < VK_API_VERSION_1_1 || properties.apiVersion < VK_API_VERSION_1_1) {
+            throw std::runtime_error("multiple views need Vulkan 1.1!");
+        }
+        VkPhysicalDeviceMultiviewFeatures multiviewFeatures{};
+        multiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &multiviewFeatures;
+        vki.vkGetPhysicalDeviceFeatures2(vkEngine.physicalDevice, &features2);
+        if (!multiviewFeatures.multiview) {
+            throw std::runtime_error("physical device does not support multiview!");
+        }
+
+        enabledMultiviewFeatures.multiview = VK_TRUE;
+        enabledMultiviewFeatures.pNext = const_cast<void*>(createInfo.pNext);
+        createInfo.pNext = &enabledMultiviewFeatures;
+    }
+
+    // Optional, texture streaming only tracks its own allocations without it. Headless engines need no swap chain
+    std::vector<const char*> enabledExtensions;
+    if (!vkEngine.outputs.empty()) {
+        enabledExtensions = deviceExtensions;
+    }
+    if (VulkanInstanceCreator::isExtensionAvailable(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)
+        && isDeviceExtensionAvailable(vkEngine.physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+        enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        vkEngine.memoryBudgetSupported = true;
+    }
+
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     if (vkEngine.enableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(vkEngine.validationLayers.size());
@@ -76,12 +138,15 @@ void VulkanDeviceInitializer::createLogicalDevice(VulkanEngine& vkEngine) {
         createInfo.enabledLayerCount = 0;
     }
 
-    if (vkCreateDevice(vkEngine.physicalDevice, &createInfo, nullptr, &vkEngine.device) != VK_SUCCESS) {
+    if (vki.vkCreateDevice(vkEngine.physicalDevice, &createInfo, nullptr, &vkEngine.device) != VK_SUCCESS) {
         throw std::runtime_error("failed to create logical device!");
     }
+    // Everything from here on calls the driver through vkd, without the loader trampolines
+    vkd.load(vkEngine.device);
 
-    vkGetDeviceQueue(vkEngine.device, indices.graphicsFamily.value(), 0, &vkEngine.graphicsQueue);
-    vkGetDeviceQueue(vkEngine.device, indices.presentFamily.value(), 0, &vkEngine.presentQueue);
+    vkd.vkGetDeviceQueue(vkEngine.device, indices.graphicsFamily.value(), 0, &vkEngine.graphicsQueue);
+    vkd.vkGetDeviceQueue(vkEngine.device, indices.presentFamily.value(), 0, &vkEngine.presentQueue);
+    vkd.vkGetDeviceQueue(vkEngine.device, indices.computeFamily.value(), 0, &vkEngine.computeQueue);
 }
 
 /**
@@ -90,12 +155,14 @@ void VulkanDeviceInitializer::createLogicalDevice(VulkanEngine& vkEngine) {
 bool VulkanDeviceInitializer::isDeviceSuitable(VulkanEngine& vkEngine, VkPhysicalDevice device) {
     QueueFamilyIndices indices = Utils::findQueueFamilies(vkEngine, device);
 
-    bool extensionsSupported = checkDeviceExtensionSupport(device);
+    bool extensionsSupported = vkEngine.outputs.empty() || checkDeviceExtensionSupport(device);
 
-    bool swapChainAdequate = false;
+    bool swapChainAdequate = extensionsSupported;
     if (extensionsSupported) {
-        SwapChainSupportDetails swapChainSupport = VulkanEngine::querySwapChainSupport(vkEngine, device);
-        swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+        for (const WindowOutput& output : vkEngine.outputs) {
+            SwapChainSupportDetails swapChainSupport = VulkanEngine::querySwapChainSupport(device, output.surface);
+            swapChainAdequate = swapChainAdequate && !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+        }
     }
 
     return indices.isComplete() && extensionsSupported && swapChainAdequate;
@@ -103,10 +170,10 @@ bool VulkanDeviceInitializer::isDeviceSuitable(VulkanEngine& vkEngine, VkPhysica
 
 bool VulkanDeviceInitializer::checkDeviceExtensionSupport(VkPhysicalDevice device) {
     uint32_t extensionCount;
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+    vki.vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
     std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+    vki.vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
     std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 
@@ -116,3 +183,19 @@ bool VulkanDeviceInitializer::checkDeviceExtensionSupport(VkPhysicalDevice devic
 
     return requiredExtensions.empty();
 }
+
+bool VulkanDeviceInitializer::isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName) {
+    uint32_t extensionCount;
+    vki.vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vki.vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto& extension : availableExtensions) {
+        if (strcmp(extensionName, extension.extensionName) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
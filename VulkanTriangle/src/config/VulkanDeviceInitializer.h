@@ -9,15 +9,17 @@
 
 #include "../Utils.h"
 #include "../VulkanEngine.h"
+#include "VulkanInstanceCreator.h"
 
 class VulkanDeviceInitializer {
 
 public:
 	static void initializeDevice(VulkanEngine& vkEngine);
 private:
-	static void createSurface(VulkanEngine& vkEngine);
+	static void createSurfaces(VulkanEngine& vkEngine);
 	static void pickPhysicalDevice(VulkanEngine& vkEngine);
 	static void createLogicalDevice(VulkanEngine& vkEngine);
 	static bool isDeviceSuitable(VulkanEngine& vkEngine, VkPhysicalDevice device);
 	static bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+	static bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName);
 };
\ No newline at end of file
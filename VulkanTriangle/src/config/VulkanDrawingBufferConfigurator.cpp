@@ -7,26 +7,11 @@ void VulkanDrawingBuffersConfigurator::configureDrawingBuffers(VulkanEngine& vkE
     createSyncObjects(vkEngine);
 }
 
+// The scene is rendered to offscreen targets, the swap chain images only receive the upscale
 void VulkanDrawingBuffersConfigurator::createFramebuffers(VulkanEngine& vkEngine) {
-    vkEngine.swapChainFramebuffers.resize(vkEngine.swapChainImageViews.size());
-
-    for (size_t i = 0; i < vkEngine.swapChainImageViews.size(); i++) {
-        VkImageView attachments[] = {
-            vkEngine.swapChainImageViews[i]
-        };
-
-        VkFramebufferCreateInfo framebufferInfo{};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = vkEngine.renderPass;
-        framebufferInfo.attachmentCount = 1;
-        framebufferInfo.pAttachments = attachments;
-        framebufferInfo.width = vkEngine.swapChainExtent.width;
-        framebufferInfo.height = vkEngine.swapChainExtent.height;
-        framebufferInfo.layers = 1;
-
-        if (vkCreateFramebuffer(vkEngine.device, &framebufferInfo, nullptr, &vkEngine.swapChainFramebuffers[i]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create framebuffer!");
-        }
+    // Headless engines render to the targets of their render jobs, unless given an offscreen extent
+    if (!vkEngine.outputs.empty() || vkEngine.offscreenExtent.width != 0) {
+        vkEngine.dynamicResolution.create(vkEngine);
     }
 }
 
@@ -36,64 +21,51 @@ void VulkanDrawingBuffersConfigurator::createCommandPool(VulkanEngine& vkEngine)
     VkCommandPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-    poolInfo.flags = 0; // Optional
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-    if (vkCreateCommandPool(vkEngine.device, &poolInfo, nullptr, &vkEngine.commandPool) != VK_SUCCESS) {
+    if (vkd.vkCreateCommandPool(vkEngine.device, &poolInfo, nullptr, vkEngine.commandPool.put(vkEngine.device)) != VK_SUCCESS) {
         throw std::runtime_error("failed to create command pool!");
     }
 }
 
 void VulkanDrawingBuffersConfigurator::createCommandBuffers(VulkanEngine& vkEngine) {
-    vkEngine.commandBuffers.resize(vkEngine.swapChainFramebuffers.size());
+    // One command buffer per frame in flight, recorded every frame in VulkanEngine::drawFrame
+    vkEngine.commandBuffers.resize(vkEngine.MAX_FRAMES_IN_FLIGHT);
+    vkEngine.drawLists.resize(vkEngine.MAX_FRAMES_IN_FLIGHT);
+    vkEngine.inputTimestamps.resize(vkEngine.MAX_FRAMES_IN_FLIGHT, 0.0);
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.commandPool = vkEngine.commandPool;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     allocInfo.commandBufferCount = (uint32_t)vkEngine.commandBuffers.size();
 
-    if (vkAllocateCommandBuffers(vkEngine.device, &allocInfo, vkEngine.commandBuffers.data()) != VK_SUCCESS) {
+    if (vkd.vkAllocateCommandBuffers(vkEngine.device, &allocInfo, vkEngine.commandBuffers.data()) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate command buffers!");
     }
 
-    for (size_t i = 0; i < vkEngine.commandBuffers.size(); i++) {
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = 0; // Optional
-        beginInfo.pInheritanceInfo = nullptr; // Optional
-
-        if (vkBeginCommandBuffer(vkEngine.commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-            throw std::runtime_error("failed to begin recording command buffer!");
-        }
-
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = vkEngine.renderPass;
-        renderPassInfo.framebuffer = vkEngine.swapChainFramebuffers[i];
-
-        renderPassInfo.renderArea.offset = { 0, 0 };
-        renderPassInfo.renderArea.extent = vkEngine.swapChainExtent;
-
-        VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
+    // Recorded by VulkanEngine::recordParticleCommandBuffer whenever the render extent changes
+    vkEngine.particleCommandBuffers.resize(vkEngine.MAX_FRAMES_IN_FLIGHT);
+    vkEngine.particleCommandExtents.resize(vkEngine.MAX_FRAMES_IN_FLIGHT, VkExtent2D{ 0, 0 });
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocInfo.commandBufferCount = (uint32_t)vkEngine.particleCommandBuffers.size();
 
-        vkCmdBeginRenderPass(vkEngine.commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(vkEngine.commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, vkEngine.graphicsPipeline);
-        vkCmdDraw(vkEngine.commandBuffers[i], 3, 1, 0, 0);
-        vkCmdEndRenderPass(vkEngine.commandBuffers[i]);
+    if (vkd.vkAllocateCommandBuffers(vkEngine.device, &allocInfo, vkEngine.particleCommandBuffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate particle command buffers!");
+    }
 
-        if (vkEndCommandBuffer(vkEngine.commandBuffers[i]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to record command buffer!");
-        }
+    // Recorded by VulkanEngine::recordImmediateCommandBuffer every frame drawing primitives
+    vkEngine.immediateCommandBuffers.resize(vkEngine.MAX_FRAMES_IN_FLIGHT);
+    vkEngine.overlayFrameTimes.resize(OVERLAY_HISTORY_SIZE, 0.0f);
+    allocInfo.commandBufferCount = (uint32_t)vkEngine.immediateCommandBuffers.size();
 
+    if (vkd.vkAllocateCommandBuffers(vkEngine.device, &allocInfo, vkEngine.immediateCommandBuffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate immediate command buffers!");
     }
 }
 
 void VulkanDrawingBuffersConfigurator::createSyncObjects(VulkanEngine& vkEngine) {
-    vkEngine.imageAvailableSemaphores.resize(vkEngine.MAX_FRAMES_IN_FLIGHT);
     vkEngine.renderFinishedSemaphores.resize(vkEngine.MAX_FRAMES_IN_FLIGHT);
     vkEngine.inFlightFences.resize(vkEngine.MAX_FRAMES_IN_FLIGHT);
-    vkEngine.imagesInFlight.resize(vkEngine.swapChainImages.size(), VK_NULL_HANDLE);
 
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -103,11 +75,22 @@ void VulkanDrawingBuffersConfigurator::createSyncObjects(VulkanEngine& vkEngine)
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
     for (size_t i = 0; i < vkEngine.MAX_FRAMES_IN_FLIGHT; i++) {
-        if (vkCreateSemaphore(vkEngine.device, &semaphoreInfo, nullptr, &vkEngine.imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(vkEngine.device, &semaphoreInfo, nullptr, &vkEngine.renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(vkEngine.device, &fenceInfo, nullptr, &vkEngine.inFlightFences[i]) != VK_SUCCESS) {
+        if (vkd.vkCreateSemaphore(vkEngine.device, &semaphoreInfo, nullptr, vkEngine.renderFinishedSemaphores[i].put(vkEngine.device)) != VK_SUCCESS ||
+            vkd.vkCreateFence(vkEngine.device, &fenceInfo, nullptr, vkEngine.inFlightFences[i].put(vkEngine.device)) != VK_SUCCESS) {
 
             throw std::runtime_error("failed to create semaphores for a frame!");
         }
     }
+
+    // Every output acquires its own image each frame
+    for (WindowOutput& output : vkEngine.outputs) {
+        output.imageAvailableSemaphores.resize(vkEngine.MAX_FRAMES_IN_FLIGHT);
+        output.imagesInFlight.resize(output.swapChainImages.size(), VK_NULL_HANDLE);
+
+        for (size_t i = 0; i < vkEngine.MAX_FRAMES_IN_FLIGHT; i++) {
+            if (vkd.vkCreateSemaphore(vkEngine.device, &semaphoreInfo, nullptr, output.imageAvailableSemaphores[i].put(vkEngine.device)) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create semaphores for a frame!");
+            }
+        }
+    }
 }
\ No newline at end of file
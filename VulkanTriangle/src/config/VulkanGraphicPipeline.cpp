@@ -1,19 +1,36 @@
 #include "VulkanGraphicPipeline.h"
 
+#include <cstddef>
 
 void VulkanGraphicPipeline::initialize(VulkanEngine& vkEngine) {
-    VulkanGraphicPipeline::createRenderPass(vkEngine);
+    // Dynamic rendering needs no render pass, pipelines declare the attachment formats instead
+    if (!vkEngine.dynamicRendering) {
+        VulkanGraphicPipeline::createRenderPass(vkEngine);
+    }
+    VulkanGraphicPipeline::createPipelines(vkEngine);
+}
+
+void VulkanGraphicPipeline::createPipelines(VulkanEngine& vkEngine) {
     VulkanGraphicPipeline::createGraphicsPipeline(vkEngine);
+    VulkanGraphicPipeline::createParticlePipeline(vkEngine);
+    // Only engines drawing meshes need the mesh shaders
+    if (!vkEngine.meshPaths.empty()) {
+        VulkanGraphicPipeline::createMeshPipeline(vkEngine);
+    }
+    VulkanGraphicPipeline::createImmediatePipeline(vkEngine);
 }
 
 void VulkanGraphicPipeline::createRenderPass(VulkanEngine& vkEngine) {
     VkAttachmentDescription colorAttachment{};
-    colorAttachment.format = vkEngine.swapChainImageFormat;
+    colorAttachment.format = vkEngine.colorFormat;
     colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
     colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    // The scene target is cleared every frame and then scaled into the swap chain image
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment = 0;
@@ -24,13 +41,21 @@ void VulkanGraphicPipeline::createRenderPass(VulkanEngine& vkEngine) {
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
 
-    VkSubpassDependency dependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    // The previous upscale of this frame slot's target has to be done reading it before it is cleared
+    VkSubpassDependency dependencies[2]{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[0].srcAccessMask = 0;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 
     VkRenderPassCreateInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -38,16 +63,40 @@ void VulkanGraphicPipeline::createRenderPass(VulkanEngine& vkEngine) {
     renderPassInfo.pAttachments = &colorAttachment;
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
+    renderPassInfo.dependencyCount = 2;
+    renderPassInfo.pDependencies = dependencies;
+
+    // Every draw of the subpass renders all the views, each one into its layer of the scene target
+    uint32_t viewMask = vkEngine.getViewMask();
+    VkRenderPassMultiviewCreateInfo multiviewInfo{};
+    multiviewInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+    multiviewInfo.subpassCount = 1;
+    multiviewInfo.pViewMasks = &viewMask;
+    // The views are close to each other, the implementation may share work between them
+    multiviewInfo.correlationMaskCount = 1;
+    multiviewInfo.pCorrelationMasks = &viewMask;
+    if (viewMask != 0) {
+        renderPassInfo.pNext = &multiviewInfo;
+    }
 
-    if (vkCreateRenderPass(vkEngine.device, &renderPassInfo, nullptr, &vkEngine.renderPass) != VK_SUCCESS) {
+    if (vkd.vkCreateRenderPass(vkEngine.device, &renderPassInfo, nullptr, vkEngine.renderPass.put(vkEngine.device)) != VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass!");
     }
+    CaptureLayer::instance().track(CaptureObjectType::RenderPass, vkEngine.renderPass.get());
+}
+
+VkPipelineRenderingCreateInfo VulkanGraphicPipeline::getRenderingInfo(VulkanEngine& vkEngine) {
+    VkPipelineRenderingCreateInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &vkEngine.colorFormat;
+    renderingInfo.viewMask = vkEngine.getViewMask();
+    return renderingInfo;
 }
 
 void VulkanGraphicPipeline::createGraphicsPipeline(VulkanEngine& vkEngine) {
-    auto vertShaderCode = Utils::readFile("shaders/vert.spv");
+    // Variant indexing the camera matrices with gl_ViewIndex, single view devices may lack multiview
+    auto vertShaderCode = Utils::readFile(vkEngine.viewCount > 1 ? "shaders/multiview_vert.spv" : "shaders/vert.spv");
     auto fragShaderCode = Utils::readFile("shaders/frag.spv");
 
     VkShaderModule vertShaderModule = createShaderModule(vkEngine, vertShaderCode);
@@ -79,24 +128,17 @@ void VulkanGraphicPipeline::createGraphicsPipeline(VulkanEngine& vkEngine) {
     inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)vkEngine.swapChainExtent.width;
-    viewport.height = (float)vkEngine.swapChainExtent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor{};
-    scissor.offset = { 0, 0 };
-    scissor.extent = vkEngine.swapChainExtent;
-
+    // Viewport and scissor follow the dynamic render resolution and are set when recording
     VkPipelineViewportStateCreateInfo viewportState{};
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
+
+    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
 
     VkPipelineRasterizationStateCreateInfo rasterizer{};
     rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -139,16 +181,22 @@ void VulkanGraphicPipeline::createGraphicsPipeline(VulkanEngine& vkEngine) {
     colorBlending.blendConstants[2] = 0.0f; // Optional
     colorBlending.blendConstants[3] = 0.0f; // Optional
 
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(DrawPushConstants);
+
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0; // Optional
-    pipelineLayoutInfo.pSetLayouts = nullptr; // Optional
-    pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-    pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = vkEngine.descriptorSetLayout.address();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-    if (vkCreatePipelineLayout(vkEngine.device, &pipelineLayoutInfo, nullptr, &vkEngine.pipelineLayout) != VK_SUCCESS) {
+    if (vkd.vkCreatePipelineLayout(vkEngine.device, &pipelineLayoutInfo, nullptr, vkEngine.pipelineLayout.put(vkEngine.device)) != VK_SUCCESS) {
         throw std::runtime_error("failed to create pipeline layout!");
     }
+    CaptureLayer::instance().track(CaptureObjectType::PipelineLayout, vkEngine.pipelineLayout.get());
 
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -157,23 +205,406 @@ void VulkanGraphicPipeline::createGraphicsPipeline(VulkanEngine& vkEngine) {
     pipelineInfo.pVertexInputState = &vertexInputInfo;
     pipelineInfo.pInputAssemblyState = &inputAssembly;
     pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
     pipelineInfo.pDepthStencilState = nullptr; // Optional
     pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.pDynamicState = nullptr; // Optional
     pipelineInfo.layout = vkEngine.pipelineLayout;
     pipelineInfo.renderPass = vkEngine.renderPass;
+    VkPipelineRenderingCreateInfo renderingInfo = getRenderingInfo(vkEngine);
+    pipelineInfo.pNext = vkEngine.dynamicRendering ? &renderingInfo : nullptr;
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
     pipelineInfo.basePipelineIndex = -1; // Optional
 
-    if (vkCreateGraphicsPipelines(vkEngine.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &vkEngine.graphicsPipeline) != VK_SUCCESS) {
+    if (vkd.vkCreateGraphicsPipelines(vkEngine.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, vkEngine.graphicsPipeline.put(vkEngine.device)) != VK_SUCCESS) {
         throw std::runtime_error("failed to create graphics pipeline!");
     }
+    CaptureLayer::instance().track(CaptureObjectType::Pipeline, vkEngine.graphicsPipeline.get());
+
+    vkd.vkDestroyShaderModule(vkEngine.device, fragShaderModule, nullptr);
+    vkd.vkDestroyShaderModule(vkEngine.device, vertShaderModule, nullptr);
+}
+
+/**
+    * Points pipeline reading the particle buffers written by the compute queue as vertex input
+    **/
+void VulkanGraphicPipeline::createParticlePipeline(VulkanEngine& vkEngine) {
+    auto vertShaderCode = Utils::readFile("shaders/particle_vert.spv");
+    auto fragShaderCode = Utils::readFile("shaders/frag.spv");
+
+    VkShaderModule vertShaderModule = createShaderModule(vkEngine, vertShaderCode);
+    VkShaderModule fragShaderModule = createShaderModule(vkEngine, fragShaderCode);
+
+    VkPipelineShaderStageCreateInfo shaderStages[2]{};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertShaderModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragShaderModule;
+    shaderStages[1].pName = "main";
+
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof(Particle);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    VkVertexInputAttributeDescription attributeDescriptions[3]{};
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[0].offset = offsetof(Particle, position);
+    attributeDescriptions[1].binding = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    attributeDescriptions[1].offset = offsetof(Particle, color);
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexAttributeDescriptionCount = 2;
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    // Viewport and scissor follow the dynamic render resolution and are set when recording
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+
+    if (vkd.vkCreatePipelineLayout(vkEngine.device, &pipelineLayoutInfo, nullptr, vkEngine.particlePipelineLayout.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle pipeline layout!");
+    }
+    CaptureLayer::instance().track(CaptureObjectType::PipelineLayout, vkEngine.particlePipelineLayout.get());
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.layout = vkEngine.particlePipelineLayout;
+    pipelineInfo.renderPass = vkEngine.renderPass;
+    VkPipelineRenderingCreateInfo renderingInfo = getRenderingInfo(vkEngine);
+    pipelineInfo.pNext = vkEngine.dynamicRendering ? &renderingInfo : nullptr;
+    pipelineInfo.subpass = 0;
+
+    if (vkd.vkCreateGraphicsPipelines(vkEngine.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, vkEngine.particlePipeline.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle pipeline!");
+    }
+    CaptureLayer::instance().track(CaptureObjectType::Pipeline, vkEngine.particlePipeline.get());
+
+    vkd.vkDestroyShaderModule(vkEngine.device, fragShaderModule, nullptr);
+    vkd.vkDestroyShaderModule(vkEngine.device, vertShaderModule, nullptr);
+}
+
+/**
+    * Indexed pipeline for the quantized MeshVertex layout, sharing the layout and descriptors
+    * of the graphics pipeline. The attributes are normalized by the fixed function vertex
+    * fetch, the model matrix of every draw maps the unorm positions back to the mesh bounds.
+    **/
+void VulkanGraphicPipeline::createMeshPipeline(VulkanEngine& vkEngine) {
+    auto vertShaderCode = Utils::readFile(vkEngine.viewCount > 1 ? "shaders/mesh_multiview_vert.spv" : "shaders/mesh_vert.spv");
+    auto fragShaderCode = Utils::readFile("shaders/frag.spv");
+
+    VkShaderModule vertShaderModule = createShaderModule(vkEngine, vertShaderCode);
+    VkShaderModule fragShaderModule = createShaderModule(vkEngine, fragShaderCode);
+
+    VkPipelineShaderStageCreateInfo shaderStages[2]{};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertShaderModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragShaderModule;
+    shaderStages[1].pName = "main";
+
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof(MeshVertex);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    VkVertexInputAttributeDescription attributeDescriptions[3]{};
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+    attributeDescriptions[0].offset = offsetof(MeshVertex, position);
+    attributeDescriptions[1].binding = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_SNORM;
+    attributeDescriptions[1].offset = offsetof(MeshVertex, normal);
+    attributeDescriptions[2].binding = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(MeshVertex, uv);
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexAttributeDescriptionCount = 3;
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    // Viewport and scissor follow the dynamic render resolution and are set when recording
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    // There is no depth buffer, culling the back faces keeps closed meshes correct on their own
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.layout = vkEngine.pipelineLayout;
+    pipelineInfo.renderPass = vkEngine.renderPass;
+    VkPipelineRenderingCreateInfo renderingInfo = getRenderingInfo(vkEngine);
+    pipelineInfo.pNext = vkEngine.dynamicRendering ? &renderingInfo : nullptr;
+    pipelineInfo.subpass = 0;
+
+    if (vkd.vkCreateGraphicsPipelines(vkEngine.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, vkEngine.meshPipeline.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create mesh pipeline!");
+    }
+    CaptureLayer::instance().track(CaptureObjectType::Pipeline, vkEngine.meshPipeline.get());
+
+    vkd.vkDestroyShaderModule(vkEngine.device, fragShaderModule, nullptr);
+    vkd.vkDestroyShaderModule(vkEngine.device, vertShaderModule, nullptr);
+}
+
+/**
+    * Blended triangle lists of the ImmediateRenderer overlays, in pixels mapped to the target
+    * by push constants. Primitives are drawn in submission order over the scene, so there is
+    * no culling and no depth. The textured variant differs only by its shaders, the texture
+    * coordinates attribute and the image descriptor set.
+    **/
+void VulkanGraphicPipeline::createImmediatePipeline(VulkanEngine& vkEngine) {
+    auto vertShaderCode = Utils::readFile("shaders/immediate_vert.spv");
+    auto fragShaderCode = Utils::readFile("shaders/immediate_frag.spv");
+
+    VkShaderModule vertShaderModule = createShaderModule(vkEngine, vertShaderCode);
+    VkShaderModule fragShaderModule = createShaderModule(vkEngine, fragShaderCode);
+
+    VkPipelineShaderStageCreateInfo shaderStages[2]{};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertShaderModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragShaderModule;
+    shaderStages[1].pName = "main";
+
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof(ImmediateVertex);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    VkVertexInputAttributeDescription attributeDescriptions[3]{};
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[0].offset = offsetof(ImmediateVertex, x);
+    attributeDescriptions[1].binding = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+    attributeDescriptions[1].offset = offsetof(ImmediateVertex, color);
+    attributeDescriptions[2].binding = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(ImmediateVertex, u);
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexAttributeDescriptionCount = 2;
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    // Viewport and scissor follow the dynamic render resolution, the scissor also clips every run of primitives
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_TRUE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(ImmediatePushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkd.vkCreatePipelineLayout(vkEngine.device, &pipelineLayoutInfo, nullptr, vkEngine.immediatePipelineLayout.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create immediate pipeline layout!");
+    }
+    CaptureLayer::instance().track(CaptureObjectType::PipelineLayout, vkEngine.immediatePipelineLayout.get());
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.layout = vkEngine.immediatePipelineLayout;
+    pipelineInfo.renderPass = vkEngine.renderPass;
+    VkPipelineRenderingCreateInfo renderingInfo = getRenderingInfo(vkEngine);
+    pipelineInfo.pNext = vkEngine.dynamicRendering ? &renderingInfo : nullptr;
+    pipelineInfo.subpass = 0;
+
+    if (vkd.vkCreateGraphicsPipelines(vkEngine.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, vkEngine.immediatePipeline.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create immediate pipeline!");
+    }
+    CaptureLayer::instance().track(CaptureObjectType::Pipeline, vkEngine.immediatePipeline.get());
+
+    vkd.vkDestroyShaderModule(vkEngine.device, fragShaderModule, nullptr);
+    vkd.vkDestroyShaderModule(vkEngine.device, vertShaderModule, nullptr);
+
+    auto texturedVertShaderCode = Utils::readFile("shaders/immediate_textured_vert.spv");
+    auto texturedFragShaderCode = Utils::readFile("shaders/immediate_textured_frag.spv");
+    vertShaderModule = createShaderModule(vkEngine, texturedVertShaderCode);
+    fragShaderModule = createShaderModule(vkEngine, texturedFragShaderCode);
+    shaderStages[0].module = vertShaderModule;
+    shaderStages[1].module = fragShaderModule;
+    vertexInputInfo.vertexAttributeDescriptionCount = 3;
+
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = vkEngine.imageDescriptorSetLayout.address();
+    if (vkd.vkCreatePipelineLayout(vkEngine.device, &pipelineLayoutInfo, nullptr, vkEngine.immediateTexturedPipelineLayout.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create textured immediate pipeline layout!");
+    }
+    CaptureLayer::instance().track(CaptureObjectType::PipelineLayout, vkEngine.immediateTexturedPipelineLayout.get());
+
+    pipelineInfo.layout = vkEngine.immediateTexturedPipelineLayout;
+    if (vkd.vkCreateGraphicsPipelines(vkEngine.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, vkEngine.immediateTexturedPipeline.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create textured immediate pipeline!");
+    }
+    CaptureLayer::instance().track(CaptureObjectType::Pipeline, vkEngine.immediateTexturedPipeline.get());
 
-    vkDestroyShaderModule(vkEngine.device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(vkEngine.device, vertShaderModule, nullptr);
+    vkd.vkDestroyShaderModule(vkEngine.device, fragShaderModule, nullptr);
+    vkd.vkDestroyShaderModule(vkEngine.device, vertShaderModule, nullptr);
 }
 
 VkShaderModule VulkanGraphicPipeline::createShaderModule(VulkanEngine& vkEngine, const std::vector<char>& code) {
@@ -183,7 +614,7 @@ VkShaderModule VulkanGraphicPipeline::createShaderModule(VulkanEngine& vkEngine,
     createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
     VkShaderModule shaderModule;
-    if (vkCreateShaderModule(vkEngine.device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+    if (vkd.vkCreateShaderModule(vkEngine.device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
         throw std::runtime_error("failed to create shader module!");
     }
 
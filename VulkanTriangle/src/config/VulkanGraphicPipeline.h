@@ -6,8 +6,15 @@
 class VulkanGraphicPipeline {
 public:
 	static void initialize(VulkanEngine& vkEngine);
+	// Graphics, particle, mesh (with meshPaths only) and immediate pipelines, called again at run time to reload the shaders
+	static void createPipelines(VulkanEngine& vkEngine);
+	static VkShaderModule createShaderModule(VulkanEngine& vkEngine, const std::vector<char>& code);
 private:
 	static void createGraphicsPipeline(VulkanEngine& vkEngine);
+	static void createParticlePipeline(VulkanEngine& vkEngine);
+	static void createMeshPipeline(VulkanEngine& vkEngine);
+	static void createImmediatePipeline(VulkanEngine& vkEngine);
 	static void createRenderPass(VulkanEngine& vkEngine);
-	static VkShaderModule createShaderModule(VulkanEngine& vkEngine, const std::vector<char>& code);
+	// Chained to the pipelines with dynamic rendering, the scene renders to a single colorFormat target with viewCount layers
+	static VkPipelineRenderingCreateInfo getRenderingInfo(VulkanEngine& vkEngine);
 };
\ No newline at end of file
@@ -3,30 +3,112 @@
 int VulkanInitializer::initialize(VulkanEngine& vkEngine) {
     VulkanInitializer vkInitializer;
 
-    vkEngine.window = vkInitializer.initWindow();
+    vkInitializer.initWindows(vkEngine);
     vkInitializer.initializeVulkan(vkEngine);
 
     VulkanDeviceInitializer::initializeDevice(vkEngine);
-    VulkanSwapChainConfigurer::createSwapChain(vkEngine);
-    VulkanSwapChainConfigurer::createImageViews(vkEngine);
+    VulkanSwapChainConfigurer::createSwapChains(vkEngine);
+    VulkanUniformConfigurator::createDescriptorSetLayout(vkEngine);
     VulkanGraphicPipeline::initialize(vkEngine);
     
     VulkanDrawingBuffersConfigurator::configureDrawingBuffers(vkEngine);
+    VulkanUniformConfigurator::configureUniforms(vkEngine);
+    VulkanComputeConfigurator::configureCompute(vkEngine);
+    vkEngine.commandBatches.create(vkEngine, vkEngine.drawBatchCapacity);
+    vkEngine.immediate.create(vkEngine, IMMEDIATE_VERTEX_CAPACITY, vkEngine.MAX_FRAMES_IN_FLIGHT);
+    vkEngine.textures.create(vkEngine);
+    // Loaded on the job system once the first frame records its uploads
+    for (const std::string& path : vkEngine.texturePaths) {
+        vkEngine.panelTextures.push_back(vkEngine.textures.load(path));
+    }
+
+    // The hardcoded triangle is the only scene object, its vertices fit in a 0.71 radius sphere
+    uint32_t triangle = vkEngine.scene.addObject();
+    vkEngine.scene.setBounds(triangle, 0.0f, 0.0f, 0.0f, 0.71f);
+
+    // Meshes are scaled to fit side by side in front of the triangle
+    uint32_t meshCount = static_cast<uint32_t>(vkEngine.meshPaths.size());
+    for (uint32_t i = 0; i < meshCount; i++) {
+        vkEngine.meshes.push_back(MeshLoader::load(vkEngine, vkEngine.meshPaths[i]));
+        const Mesh& mesh = vkEngine.meshes.back();
+
+        float scale = 0.9f / (meshCount * mesh.radius);
+        float x = -1.0f + (2.0f * i + 1.0f) / meshCount;
+        uint32_t object = vkEngine.scene.addObject();
+        vkEngine.scene.setMesh(object, i);
+        vkEngine.scene.setBounds(object, mesh.center[0], mesh.center[1], mesh.center[2], mesh.radius);
+        vkEngine.scene.setScale(object, scale, scale, scale);
+        vkEngine.scene.setPosition(object, x - mesh.center[0] * scale, -mesh.center[1] * scale, 0.5f - mesh.center[2] * scale);
+    }
+
+    // Spread along their orbit, simulateScene moves them from the first frame on
+    vkEngine.firstMovingObject = vkEngine.scene.size();
+    for (uint32_t i = 0; i < vkEngine.movingObjectCount; i++) {
+        uint32_t object = vkEngine.scene.addObject();
+        vkEngine.scene.setBounds(object, 0.0f, 0.0f, 0.0f, 0.71f);
+        vkEngine.scene.setScale(object, MOVING_OBJECT_SCALE, MOVING_OBJECT_SCALE, MOVING_OBJECT_SCALE);
+    }
+
+    vkEngine.scene.updateTransforms();
+    vkEngine.sceneBvh.build(vkEngine.scene);
+
+    InputPump::attach(vkEngine);
+
+    // Objects created from now on are created again by a replay, the others by its own initialization
+    CaptureLayer::instance().endInitialization();
 
     return 0;
 }
 
-GLFWwindow* VulkanInitializer::initWindow() {
+void VulkanInitializer::initWindows(VulkanEngine& vkEngine) {
+    if (vkEngine.windowCount > MAX_WINDOW_OUTPUTS) {
+        throw std::runtime_error("unsupported window count!");
+    }
+    // No window, no swap chain: headless engines only render offscreen
+    if (vkEngine.windowCount == 0) {
+        return;
+    }
+
     glfwInit();
 
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
-    return glfwCreateWindow(width, height, "Vulkan", nullptr, nullptr);
+    // One window per display when there are enough of them, cascaded on the first one otherwise
+    int monitorCount = 0;
+    GLFWmonitor** monitors = glfwGetMonitors(&monitorCount);
+    vkEngine.outputs.resize(vkEngine.windowCount);
+    for (uint32_t i = 0; i < vkEngine.windowCount; i++) {
+        std::string title = i == 0 ? "Vulkan" : "Vulkan " + std::to_string(i + 1);
+        GLFWwindow* window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+        if (window == nullptr) {
+            throw std::runtime_error("failed to create window!");
+        }
+
+        int x = 0, y = 0;
+        if (static_cast<int>(i) < monitorCount) {
+            glfwGetMonitorPos(monitors[i], &x, &y);
+        }
+        else if (monitorCount > 0) {
+            glfwGetMonitorPos(monitors[0], &x, &y);
+            x += WINDOW_CASCADE_OFFSET * i;
+            y += WINDOW_CASCADE_OFFSET * i;
+        }
+        glfwSetWindowPos(window, x + WINDOW_CASCADE_OFFSET, y + WINDOW_CASCADE_OFFSET);
+
+        vkEngine.outputs[i].window = window;
+    }
 }
 
 void VulkanInitializer::initializeVulkan(VulkanEngine& vkEngine) {
-    vkEngine.instance = VulkanInstanceCreator::createInstance(vkEngine.enableValidationLayers, vkEngine.validationLayers);
+    // Validation output is formatted in the callback and written by the logger thread
+    if (vkEngine.enableValidationLayers) {
+        AsyncLogger::instance().start();
+    }
+
+    vkEngine.apiVersion = VulkanInstanceCreator::getApiVersion();
+    vkEngine.instance = VulkanInstanceCreator::createInstance(vkEngine.enableValidationLayers, vkEngine.validationLayers, vkEngine.apiVersion);
+    vki.load(vkEngine.instance);
     DebugMessenger::setupDebugMessenger(vkEngine);
 }
 
@@ -1,16 +1,23 @@
 #pragma once
 #include <GLFW/glfw3.h>
 #include <cstdint>
+#include <string>
 #include "../VulkanEngine.h"
+#include "../input/InputPump.h"
+#include "../log/AsyncLogger.h"
 #include "VulkanInstanceCreator.h"
 #include "DebugMessenger.h"
 #include "VulkanDeviceInitializer.h"
 #include "VulkanSwapChainConfigurer.h"
 #include "VulkanGraphicPipeline.h"
 #include "VulkanDrawingBufferConfigurator.h"
+#include "VulkanUniformConfigurator.h"
+#include "VulkanComputeConfigurator.h"
 
 const uint32_t DEFAULT_WIDTH = 800;
 const uint32_t DEFAULT_HEIGHT = 600;
+// Pixels between the windows sharing a display
+const int WINDOW_CASCADE_OFFSET = 40;
 
 class VulkanInitializer {
 public:
@@ -27,7 +34,7 @@ public:
 private:
 	uint32_t width;
 	uint32_t height;
-	GLFWwindow* initWindow();
+	void initWindows(VulkanEngine& vkEngine);
 	void initializeVulkan(VulkanEngine& vkEngine);
 
 };
\ No newline at end of file
@@ -1,6 +1,10 @@
 #include "VulkanInstanceCreator.h"
 
-VkInstance VulkanInstanceCreator::createInstance(bool enableValidationLayers, std::vector<const char*> validationLayers) {
+#include <algorithm>
+
+#include "../log/AsyncLogger.h"
+
+VkInstance VulkanInstanceCreator::createInstance(bool enableValidationLayers, std::vector<const char*> validationLayers, uint32_t apiVersion) {
     VkInstance instance;
 
     if (enableValidationLayers && !checkValidationLayerSupport(validationLayers)) {
@@ -13,7 +17,7 @@ VkInstance VulkanInstanceCreator::createInstance(bool enableValidationLayers, st
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = apiVersion;
 
     VkInstanceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -32,6 +36,16 @@ VkInstance VulkanInstanceCreator::createInstance(bool enableValidationLayers, st
     return instance;
 }
 
+uint32_t VulkanInstanceCreator::getApiVersion() {
+    // vkEnumerateInstanceVersion is missing from 1.0 loaders
+    PFN_vkEnumerateInstanceVersion enumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+    uint32_t version = VK_API_VERSION_1_0;
+    if (enumerateInstanceVersion == nullptr || enumerateInstanceVersion(&version) != VK_SUCCESS) {
+        return VK_API_VERSION_1_0;
+    }
+    return std::min(version, VK_API_VERSION_1_3);
+}
+
 bool VulkanInstanceCreator::checkValidationLayerSupport(std::vector<const char*> validationLayers) {
     uint32_t layerCount;
     vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
@@ -62,15 +76,40 @@ std::vector<const char*> VulkanInstanceCreator::getRequiredExtensions(bool enabl
     const char** glfwExtensions;
     glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    // Headless engines never initialize GLFW and need no surface extension
+    std::vector<const char*> extensions;
+    if (glfwExtensions != nullptr) {
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     if (enableValidationLayers) {
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
     }
 
+    // Needed to query VK_EXT_memory_budget on a 1.0 instance
+    if (isExtensionAvailable(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+        extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    }
+
     return extensions;
 }
 
+bool VulkanInstanceCreator::isExtensionAvailable(const char* extensionName) {
+    uint32_t extensionCount = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto& extension : availableExtensions) {
+        if (strcmp(extensionName, extension.extensionName) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 void VulkanInstanceCreator::setupValidationLayers(bool enableValidationLayers, VkInstanceCreateInfo createInfo, std::vector<const char*> validationLayers) {
     if (enableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -78,7 +117,8 @@ void VulkanInstanceCreator::setupValidationLayers(bool enableValidationLayers, V
 
         VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo = {};
         debugCreateInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-        debugCreateInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+        debugCreateInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT
+            | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
         debugCreateInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
         debugCreateInfo.pfnUserCallback = debugCallback;
 
@@ -92,7 +132,7 @@ void VulkanInstanceCreator::setupValidationLayers(bool enableValidationLayers, V
 }
 
 VKAPI_ATTR VkBool32 VKAPI_CALL VulkanInstanceCreator::debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData) {
-    std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
+    AsyncLogger::instance().log(messageSeverity, pCallbackData);
 
     return VK_FALSE;
 }
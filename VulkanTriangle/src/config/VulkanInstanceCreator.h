@@ -8,7 +8,10 @@
 
 class VulkanInstanceCreator {
 public:
-	static VkInstance createInstance(bool enableValidationLayers, std::vector<const char*> validationLayers);
+	static VkInstance createInstance(bool enableValidationLayers, std::vector<const char*> validationLayers, uint32_t apiVersion);
+	// Highest version supported by the loader, up to 1.3
+	static uint32_t getApiVersion();
+	static bool isExtensionAvailable(const char* extensionName);
 private:
 	static std::vector<const char*> getRequiredExtensions(bool enableValidationLayers);
 	static bool checkValidationLayerSupport(std::vector<const char*> validationLayers);
@@ -1,12 +1,24 @@
 #include "VulkanSwapChainConfigurer.h"
 
 
-void VulkanSwapChainConfigurer::createSwapChain(VulkanEngine& vkEngine) {
-    SwapChainSupportDetails swapChainSupport = querySwapChainSupport(vkEngine, vkEngine.physicalDevice);
+void VulkanSwapChainConfigurer::createSwapChains(VulkanEngine& vkEngine) {
+    for (WindowOutput& output : vkEngine.outputs) {
+        createSwapChain(vkEngine, output);
+        createImageViews(vkEngine, output);
+    }
+
+    // The scene is rendered in the primary output format, headless engines keep the default one
+    if (!vkEngine.outputs.empty()) {
+        vkEngine.colorFormat = vkEngine.outputs[0].swapChainImageFormat;
+    }
+}
+
+void VulkanSwapChainConfigurer::createSwapChain(VulkanEngine& vkEngine, WindowOutput& output) {
+    SwapChainSupportDetails swapChainSupport = VulkanEngine::querySwapChainSupport(vkEngine.physicalDevice, output.surface);
 
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
     VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
-    VkExtent2D extent = chooseSwapExtent(vkEngine, swapChainSupport.capabilities);
+    VkExtent2D extent = chooseSwapExtent(output.window, swapChainSupport.capabilities);
 
     uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
     if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
@@ -15,14 +27,18 @@ void VulkanSwapChainConfigurer::createSwapChain(VulkanEngine& vkEngine) {
 
     VkSwapchainCreateInfoKHR createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    createInfo.surface = vkEngine.surface;
+    createInfo.surface = output.surface;
 
     createInfo.minImageCount = imageCount;
     createInfo.imageFormat = surfaceFormat.format;
     createInfo.imageColorSpace = surfaceFormat.colorSpace;
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1;
-    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // The scene is rendered offscreen and scaled into the swap chain images, which the surface must allow
+    if (!(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+        throw std::runtime_error("swap chain images cannot be transfer destinations!");
+    }
+    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 
     QueueFamilyIndices indices = Utils::findQueueFamilies(vkEngine, vkEngine.physicalDevice);
     uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
@@ -44,27 +60,39 @@ void VulkanSwapChainConfigurer::createSwapChain(VulkanEngine& vkEngine) {
     createInfo.clipped = VK_TRUE;
     createInfo.oldSwapchain = VK_NULL_HANDLE;
 
-    if (vkCreateSwapchainKHR(vkEngine.device, &createInfo, nullptr, &vkEngine.swapChain) != VK_SUCCESS) {
+    if (vkd.vkCreateSwapchainKHR(vkEngine.device, &createInfo, nullptr, output.swapChain.put(vkEngine.device)) != VK_SUCCESS) {
         throw std::runtime_error("failed to create swap chain!");
     }
 
-    vkGetSwapchainImagesKHR(vkEngine.device, vkEngine.swapChain, &imageCount, nullptr);
-    vkEngine.swapChainImages.resize(imageCount);
-    vkGetSwapchainImagesKHR(vkEngine.device, vkEngine.swapChain, &imageCount, vkEngine.swapChainImages.data());
+    vkd.vkGetSwapchainImagesKHR(vkEngine.device, output.swapChain, &imageCount, nullptr);
+    output.swapChainImages.resize(imageCount);
+    vkd.vkGetSwapchainImagesKHR(vkEngine.device, output.swapChain, &imageCount, output.swapChainImages.data());
+
+    // A replay has no swap chain, it creates images like these in their place
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.format = createInfo.imageFormat;
+    imageInfo.extent = { createInfo.imageExtent.width, createInfo.imageExtent.height, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = createInfo.imageArrayLayers;
+    imageInfo.usage = createInfo.imageUsage;
+    for (VkImage image : output.swapChainImages) {
+        CaptureLayer::instance().trackImage(image, imageInfo, CaptureObjectType::SwapchainImage);
+    }
 
-    vkEngine.swapChainImageFormat = surfaceFormat.format;
-    vkEngine.swapChainExtent = extent;
+    output.swapChainImageFormat = surfaceFormat.format;
+    output.swapChainExtent = extent;
 }
 
-void VulkanSwapChainConfigurer::createImageViews(VulkanEngine& vkEngine) {
-    vkEngine.swapChainImageViews.resize(vkEngine.swapChainImages.size());
+void VulkanSwapChainConfigurer::createImageViews(VulkanEngine& vkEngine, WindowOutput& output) {
+    output.swapChainImageViews.resize(output.swapChainImages.size());
 
-    for (size_t i = 0; i < vkEngine.swapChainImages.size(); i++) {
+    for (size_t i = 0; i < output.swapChainImages.size(); i++) {
         VkImageViewCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        createInfo.image = vkEngine.swapChainImages[i];
+        createInfo.image = output.swapChainImages[i];
         createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        createInfo.format = vkEngine.swapChainImageFormat;
+        createInfo.format = output.swapChainImageFormat;
         createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
         createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
         createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -75,35 +103,13 @@ void VulkanSwapChainConfigurer::createImageViews(VulkanEngine& vkEngine) {
         createInfo.subresourceRange.baseArrayLayer = 0;
         createInfo.subresourceRange.layerCount = 1;
 
-        if (vkCreateImageView(vkEngine.device, &createInfo, nullptr, &vkEngine.swapChainImageViews[i]) != VK_SUCCESS) {
+        if (vkd.vkCreateImageView(vkEngine.device, &createInfo, nullptr, output.swapChainImageViews[i].put(vkEngine.device)) != VK_SUCCESS) {
             throw std::runtime_error("failed to create image views!");
         }
     }
 
 }
 
-SwapChainSupportDetails VulkanSwapChainConfigurer::querySwapChainSupport(VulkanEngine& vkEngine, VkPhysicalDevice device) {
-    SwapChainSupportDetails details;
-
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, vkEngine.surface, &details.capabilities);
-
-    uint32_t formatCount;
-    vkGetPhysicalDeviceSurfaceFormatsKHR(device, vkEngine.surface, &formatCount, nullptr);
-    if (formatCount != 0) {
-        details.formats.resize(formatCount);
-        vkGetPhysicalDeviceSurfaceFormatsKHR(device, vkEngine.surface, &formatCount, details.formats.data());
-    }
-
-    uint32_t presentModeCount;
-    vkGetPhysicalDeviceSurfacePresentModesKHR(device, vkEngine.surface, &presentModeCount, nullptr);
-    if (presentModeCount != 0) {
-        details.presentModes.resize(presentModeCount);
-        vkGetPhysicalDeviceSurfacePresentModesKHR(device, vkEngine.surface, &presentModeCount, details.presentModes.data());
-    }
-
-    return details;
-}
-
 VkSurfaceFormatKHR VulkanSwapChainConfigurer::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
     for (const auto& availableFormat : availableFormats) {
         if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
@@ -124,13 +130,13 @@ VkPresentModeKHR VulkanSwapChainConfigurer::chooseSwapPresentMode(const std::vec
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
-VkExtent2D VulkanSwapChainConfigurer::chooseSwapExtent(VulkanEngine& vkEngine, const VkSurfaceCapabilitiesKHR& capabilities) {
+VkExtent2D VulkanSwapChainConfigurer::chooseSwapExtent(GLFWwindow* window, const VkSurfaceCapabilitiesKHR& capabilities) {
     if (capabilities.currentExtent.width != UINT32_MAX) {
         return capabilities.currentExtent;
     }
     else {
         int width, height;
-        glfwGetFramebufferSize(vkEngine.window, &width, &height);
+        glfwGetFramebufferSize(window, &width, &height);
 
         VkExtent2D actualExtent = {
             static_cast<uint32_t>(width),
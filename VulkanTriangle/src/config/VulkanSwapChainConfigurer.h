@@ -5,11 +5,12 @@
 
 class VulkanSwapChainConfigurer {
 public:
-	static void createSwapChain(VulkanEngine& vkEngine);
-	static void createImageViews(VulkanEngine& vkEngine);
+	// One swap chain per window output, on the shared device
+	static void createSwapChains(VulkanEngine& vkEngine);
 private:
-	static SwapChainSupportDetails querySwapChainSupport(VulkanEngine& vkEngine, VkPhysicalDevice device);
+	static void createSwapChain(VulkanEngine& vkEngine, WindowOutput& output);
+	static void createImageViews(VulkanEngine& vkEngine, WindowOutput& output);
 	static VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 	static VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
-	static VkExtent2D chooseSwapExtent(VulkanEngine& vkEngine, const VkSurfaceCapabilitiesKHR& capabilities);
+	static VkExtent2D chooseSwapExtent(GLFWwindow* window, const VkSurfaceCapabilitiesKHR& capabilities);
 };
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "VulkanUniformConfigurator.h"
+
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+void VulkanUniformConfigurator::createDescriptorSetLayout(VulkanEngine& vkEngine) {
+    // Both bindings are dynamic: the offset into the ring buffer is given at bind time
+    VkDescriptorSetLayoutBinding cameraBinding{};
+    cameraBinding.binding = 0;
+    cameraBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    cameraBinding.descriptorCount = 1;
+    cameraBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutBinding drawBinding{};
+    drawBinding.binding = 1;
+    drawBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    drawBinding.descriptorCount = 1;
+    drawBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutBinding bindings[] = { cameraBinding, drawBinding };
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+
+    if (vkd.vkCreateDescriptorSetLayout(vkEngine.device, &layoutInfo, nullptr, vkEngine.descriptorSetLayout.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    // Streamed texture sampled by the image primitives of the immediate renderer
+    VkDescriptorSetLayoutBinding imageBinding{};
+    imageBinding.binding = 0;
+    imageBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    imageBinding.descriptorCount = 1;
+    imageBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo imageLayoutInfo{};
+    imageLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    imageLayoutInfo.bindingCount = 1;
+    imageLayoutInfo.pBindings = &imageBinding;
+
+    if (vkd.vkCreateDescriptorSetLayout(vkEngine.device, &imageLayoutInfo, nullptr, vkEngine.imageDescriptorSetLayout.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image descriptor set layout!");
+    }
+}
+
+void VulkanUniformConfigurator::configureUniforms(VulkanEngine& vkEngine) {
+    vkEngine.uniformRing.create(vkEngine, UNIFORM_RING_FRAME_SIZE, vkEngine.MAX_FRAMES_IN_FLIGHT);
+    createDescriptorPool(vkEngine);
+    createDescriptorSet(vkEngine);
+    configureViews(vkEngine);
+}
+
+/**
+    * Derives the views of a multiview engine from the camera, once, the camera does not move.
+    * With a window per view they turn around the vertical axis by the horizontal field of view,
+    * side by side like monitors around the viewer. Views sharing the windows are stereo eyes
+    * instead, VIEW_EYE_SEPARATION apart. Either way they are centered on the camera.
+    **/
+void VulkanUniformConfigurator::configureViews(VulkanEngine& vkEngine) {
+    CameraUniforms& camera = vkEngine.camera;
+    glm::mat4 view = camera.view[0];
+    glm::mat4 proj = camera.proj[0];
+    float fieldOfView = 2.0f * std::atan(1.0f / std::abs(proj[0][0]));
+    bool viewPerOutput = vkEngine.outputs.size() == vkEngine.viewCount;
+
+    for (uint32_t v = 0; v < vkEngine.viewCount; v++) {
+        float offset = static_cast<float>(v) - (vkEngine.viewCount - 1) * 0.5f;
+        if (viewPerOutput) {
+            camera.view[v] = glm::rotate(glm::mat4(1.0f), offset * fieldOfView, glm::vec3(0.0f, 1.0f, 0.0f)) * view;
+        }
+        else {
+            camera.view[v] = glm::translate(glm::mat4(1.0f), glm::vec3(-offset * VIEW_EYE_SEPARATION, 0.0f, 0.0f)) * view;
+        }
+        camera.proj[v] = proj;
+    }
+}
+
+void VulkanUniformConfigurator::createDescriptorPool(VulkanEngine& vkEngine) {
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSize.descriptorCount = 2;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    if (vkd.vkCreateDescriptorPool(vkEngine.device, &poolInfo, nullptr, vkEngine.descriptorPool.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+}
+
+void VulkanUniformConfigurator::createDescriptorSet(VulkanEngine& vkEngine) {
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = vkEngine.descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = vkEngine.descriptorSetLayout.address();
+
+    if (vkd.vkAllocateDescriptorSets(vkEngine.device, &allocInfo, &vkEngine.descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor set!");
+    }
+    CaptureLayer::instance().track(CaptureObjectType::DescriptorSet, vkEngine.descriptorSet);
+
+    // A single set covers every frame: the frame region is selected through the dynamic offset
+    VkDescriptorBufferInfo cameraInfo{};
+    cameraInfo.buffer = vkEngine.uniformRing.buffer;
+    cameraInfo.offset = 0;
+    cameraInfo.range = sizeof(CameraUniforms);
+
+    VkDescriptorBufferInfo drawInfo{};
+    drawInfo.buffer = vkEngine.uniformRing.buffer;
+    drawInfo.offset = 0;
+    drawInfo.range = sizeof(DrawUniforms);
+
+    VkWriteDescriptorSet descriptorWrites[2]{};
+    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[0].dstSet = vkEngine.descriptorSet;
+    descriptorWrites[0].dstBinding = 0;
+    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorWrites[0].descriptorCount = 1;
+    descriptorWrites[0].pBufferInfo = &cameraInfo;
+
+    descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[1].dstSet = vkEngine.descriptorSet;
+    descriptorWrites[1].dstBinding = 1;
+    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorWrites[1].descriptorCount = 1;
+    descriptorWrites[1].pBufferInfo = &drawInfo;
+
+    vkd.vkUpdateDescriptorSets(vkEngine.device, 2, descriptorWrites, 0, nullptr);
+}
\ No newline at end of file
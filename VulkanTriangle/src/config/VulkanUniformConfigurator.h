@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdexcept>
+
+#include "../Utils.h"
+#include "../VulkanEngine.h"
+
+class VulkanUniformConfigurator {
+public:
+	static void createDescriptorSetLayout(VulkanEngine& vkEngine);
+	static void configureUniforms(VulkanEngine& vkEngine);
+private:
+	static void createDescriptorPool(VulkanEngine& vkEngine);
+	static void createDescriptorSet(VulkanEngine& vkEngine);
+	static void configureViews(VulkanEngine& vkEngine);
+};
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+enum class InputEventType {
+	Key,
+	MouseButton,
+	CursorPosition
+};
+
+struct InputEvent {
+	InputEventType type;
+	// Index in VulkanEngine::outputs of the window that received the event
+	uint32_t window;
+	// GLFW key or mouse button, with its action and modifiers
+	int code;
+	int action;
+	int mods;
+	// Cursor position
+	double x;
+	double y;
+	// Utils::getTime() when the main thread received the event
+	double timestamp;
+};
\ No newline at end of file
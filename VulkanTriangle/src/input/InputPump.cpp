@@ -0,0 +1,59 @@
+#include "InputPump.h"
+
+#include "../VulkanEngine.h"
+#include "../Utils.h"
+
+void InputPump::attach(VulkanEngine& vkEngine) {
+    // Every window feeds the same queue
+    for (const WindowOutput& output : vkEngine.outputs) {
+        glfwSetWindowUserPointer(output.window, &vkEngine);
+        glfwSetKeyCallback(output.window, keyCallback);
+        glfwSetMouseButtonCallback(output.window, mouseButtonCallback);
+        glfwSetCursorPosCallback(output.window, cursorPositionCallback);
+    }
+}
+
+void InputPump::pushEvent(GLFWwindow* window, InputEvent event) {
+    auto vkEngine = reinterpret_cast<VulkanEngine*>(glfwGetWindowUserPointer(window));
+    // A handful of outputs at most, outputs is not resized once the windows exist
+    for (uint32_t i = 0; i < vkEngine->outputs.size(); i++) {
+        if (vkEngine->outputs[i].window == window) {
+            event.window = i;
+            break;
+        }
+    }
+
+    // Never block the event pump: a full queue means the render thread is stalled anyway
+    if (!vkEngine->inputQueue.push(event)) {
+        vkEngine->droppedInputEvents++;
+    }
+}
+
+void InputPump::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    InputEvent event{};
+    event.type = InputEventType::Key;
+    event.code = key;
+    event.action = action;
+    event.mods = mods;
+    event.timestamp = Utils::getTime();
+    pushEvent(window, event);
+}
+
+void InputPump::mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+    InputEvent event{};
+    event.type = InputEventType::MouseButton;
+    event.code = button;
+    event.action = action;
+    event.mods = mods;
+    event.timestamp = Utils::getTime();
+    pushEvent(window, event);
+}
+
+void InputPump::cursorPositionCallback(GLFWwindow* window, double x, double y) {
+    InputEvent event{};
+    event.type = InputEventType::CursorPosition;
+    event.x = x;
+    event.y = y;
+    event.timestamp = Utils::getTime();
+    pushEvent(window, event);
+}
\ No newline at end of file
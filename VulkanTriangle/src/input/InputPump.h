@@ -0,0 +1,21 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+class VulkanEngine;
+struct InputEvent;
+
+/**
+    * GLFW callbacks, run on the main thread while it pumps events. They only timestamp the
+    * event and push it to VulkanEngine::inputQueue, consumed by the render thread.
+    **/
+class InputPump {
+public:
+	static void attach(VulkanEngine& vkEngine);
+private:
+	// Fills in the index of the window, the callbacks leave it out
+	static void pushEvent(GLFWwindow* window, InputEvent event);
+	static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+	static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+	static void cursorPositionCallback(GLFWwindow* window, double x, double y);
+};
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/**
+    * Bounded lock-free single-producer single-consumer ring. The producer only writes tail,
+    * the consumer only writes head, each on its own cache line.
+    **/
+template<typename T, size_t Capacity>
+class SpscQueue {
+	static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+	// Producer side, returns false when the queue is full
+	bool push(const T& item) {
+		size_t tail = tailIndex.load(std::memory_order_relaxed);
+		if (tail - headIndex.load(std::memory_order_acquire) == Capacity) {
+			return false;
+		}
+
+		items[tail & (Capacity - 1)] = item;
+		tailIndex.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side, returns false when the queue is empty
+	bool pop(T& item) {
+		size_t head = headIndex.load(std::memory_order_relaxed);
+		if (head == tailIndex.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		item = items[head & (Capacity - 1)];
+		headIndex.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	alignas(64) std::atomic<size_t> headIndex{ 0 };
+	alignas(64) std::atomic<size_t> tailIndex{ 0 };
+	alignas(64) std::array<T, Capacity> items;
+};
\ No newline at end of file
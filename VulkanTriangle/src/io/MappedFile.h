@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+    * Read-only memory mapping of a whole file. Pages are loaded by the OS on first access,
+    * so data can be copied straight from the mapping without reading the file up front.
+    **/
+class MappedFile {
+public:
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const uint8_t* data() const {
+		return mapped;
+	}
+
+	size_t size() const {
+		return mappedSize;
+	}
+
+private:
+	const uint8_t* mapped = nullptr;
+	size_t mappedSize = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int descriptor = -1;
+#endif
+};
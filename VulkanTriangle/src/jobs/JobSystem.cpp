@@ -0,0 +1,197 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+// Index of the queue owned by the calling thread, workers and render thread only
+static thread_local uint32_t threadQueueIndex = UINT32_MAX;
+
+void JobSystem::start(uint32_t workerCount) {
+    threadQueueIndex = workerCount;
+
+    for (uint32_t i = 0; i <= workerCount; i++) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    running = true;
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+void JobSystem::stop() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        running = false;
+    }
+    sleepCondition.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    queues.clear();
+}
+
+JobHandle JobSystem::createJob(std::function<void()> function) {
+    JobHandle job = std::make_shared<Job>();
+    job->function = std::move(function);
+    return job;
+}
+
+void JobSystem::addDependency(const JobHandle& job, const JobHandle& dependency) {
+    if (!dependency) return;
+
+    std::lock_guard<std::mutex> lock(dependency->mutex);
+    if (dependency->finished) {
+        if (dependency->exception) {
+            std::lock_guard<std::mutex> jobLock(job->mutex);
+            job->exception = dependency->exception;
+        }
+        return;
+    }
+
+    job->pendingDependencies++;
+    dependency->continuations.push_back(job);
+}
+
+void JobSystem::submit(const JobHandle& job) {
+    if (--job->pendingDependencies == 0) {
+        schedule(job);
+    }
+}
+
+void JobSystem::wait(const JobHandle& job) {
+    if (!job) return;
+
+    while (!job->finished) {
+        if (!tryRunJob()) {
+            std::this_thread::yield();
+        }
+    }
+
+    if (job->exception) {
+        std::rethrow_exception(job->exception);
+    }
+}
+
+void JobSystem::parallelFor(size_t count, size_t batchSize, const std::function<void(size_t, size_t)>& function) {
+    std::vector<JobHandle> batches;
+    for (size_t begin = 0; begin < count; begin += batchSize) {
+        size_t end = std::min(begin + batchSize, count);
+        JobHandle batch = createJob([&function, begin, end]() { function(begin, end); });
+        batches.push_back(batch);
+        submit(batch);
+    }
+
+    // Batches reference function and the caller's captures, all of them must be done before leaving
+    std::exception_ptr exception;
+    for (const auto& batch : batches) {
+        try {
+            wait(batch);
+        }
+        catch (...) {
+            if (!exception) {
+                exception = std::current_exception();
+            }
+        }
+    }
+
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+void JobSystem::workerLoop(uint32_t queueIndex) {
+    threadQueueIndex = queueIndex;
+
+    while (running) {
+        JobHandle job = popOrSteal(queueIndex);
+        if (job) {
+            execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepCondition.wait(lock, [this]() { return queuedJobs > 0 || !running; });
+    }
+}
+
+void JobSystem::schedule(const JobHandle& job) {
+    // Threads that do not own a queue inject into the render thread one, workers steal from it
+    uint32_t queueIndex = threadQueueIndex < queues.size() ? threadQueueIndex : static_cast<uint32_t>(queues.size() - 1);
+    {
+        std::lock_guard<std::mutex> lock(queues[queueIndex]->mutex);
+        queues[queueIndex]->jobs.push_back(job);
+    }
+
+    queuedJobs++;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    sleepCondition.notify_one();
+}
+
+void JobSystem::execute(const JobHandle& job) {
+    // A failed dependency fails the whole chain without running it
+    if (!job->exception) {
+        try {
+            job->function();
+        }
+        catch (...) {
+            job->exception = std::current_exception();
+        }
+    }
+
+    std::vector<JobHandle> continuations;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        continuations.swap(job->continuations);
+        job->finished = true;
+    }
+
+    for (const auto& continuation : continuations) {
+        if (job->exception) {
+            std::lock_guard<std::mutex> lock(continuation->mutex);
+            continuation->exception = job->exception;
+        }
+        submit(continuation);
+    }
+}
+
+bool JobSystem::tryRunJob() {
+    uint32_t queueIndex = threadQueueIndex < queues.size() ? threadQueueIndex : static_cast<uint32_t>(queues.size() - 1);
+    JobHandle job = popOrSteal(queueIndex);
+    if (job) {
+        execute(job);
+        return true;
+    }
+    return false;
+}
+
+JobHandle JobSystem::popOrSteal(uint32_t queueIndex) {
+    JobHandle job;
+
+    // Own queue first, newest job: its data is most likely still in cache
+    {
+        std::lock_guard<std::mutex> lock(queues[queueIndex]->mutex);
+        if (!queues[queueIndex]->jobs.empty()) {
+            job = queues[queueIndex]->jobs.back();
+            queues[queueIndex]->jobs.pop_back();
+        }
+    }
+
+    // Steal the oldest job of the other queues
+    for (size_t i = 1; !job && i < queues.size(); i++) {
+        WorkQueue& victim = *queues[(queueIndex + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+        }
+    }
+
+    if (job) {
+        queuedJobs--;
+    }
+    return job;
+}
\ No newline at end of file
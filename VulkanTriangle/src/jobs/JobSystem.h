@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Job {
+	std::function<void()> function;
+
+	// Unfinished dependencies, plus one held until the job is submitted
+	std::atomic<int> pendingDependencies{ 1 };
+	std::atomic<bool> finished{ false };
+
+	// Jobs scheduled when this one finishes, guarded by mutex
+	std::mutex mutex;
+	std::vector<std::shared_ptr<Job>> continuations;
+	std::exception_ptr exception;
+};
+
+typedef std::shared_ptr<Job> JobHandle;
+
+/**
+    * Work-stealing job system. Every worker owns a deque: it pops its own jobs LIFO and steals
+    * from the other deques FIFO when empty. Dependencies are continuations: a finished job
+    * schedules the jobs waiting on it, nobody blocks a worker waiting for a dependency.
+    * Threads calling wait() help executing jobs until the awaited one is done.
+    **/
+class JobSystem {
+public:
+	void start(uint32_t workerCount);
+	void stop();
+
+	JobHandle createJob(std::function<void()> function);
+	// Must be called before job is submitted
+	void addDependency(const JobHandle& job, const JobHandle& dependency);
+	void submit(const JobHandle& job);
+	void wait(const JobHandle& job);
+
+	// Splits [0, count) in batches run in parallel, returns once all of them are done
+	void parallelFor(size_t count, size_t batchSize, const std::function<void(size_t, size_t)>& function);
+
+	uint32_t getWorkerCount() const {
+		return static_cast<uint32_t>(workers.size());
+	}
+
+private:
+	struct WorkQueue {
+		std::mutex mutex;
+		std::deque<JobHandle> jobs;
+	};
+
+	void workerLoop(uint32_t queueIndex);
+	void schedule(const JobHandle& job);
+	void execute(const JobHandle& job);
+	bool tryRunJob();
+	JobHandle popOrSteal(uint32_t queueIndex);
+
+	std::vector<std::thread> workers;
+	// One queue per worker plus a last one owned by the render thread
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+
+	std::atomic<bool> running{ false };
+	std::atomic<int> queuedJobs{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+};
\ No newline at end of file
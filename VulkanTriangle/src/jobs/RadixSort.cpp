@@ -0,0 +1,76 @@
+#include "RadixSort.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void RadixSort::sort(JobSystem& jobSystem, std::vector<uint64_t>& keys, std::vector<uint32_t>& values) {
+    if (keys.size() != values.size()) {
+        throw std::runtime_error("radix sort keys and values must have the same size!");
+    }
+
+    size_t count = keys.size();
+    if (count < 2) {
+        return;
+    }
+
+    // Bytes where keys differ, the other passes would not move anything
+    uint64_t firstKey = keys[0];
+    uint64_t differingBits = 0;
+    for (uint64_t key : keys) {
+        differingBits |= key ^ firstKey;
+    }
+
+    size_t chunkCount = (count + RADIX_SORT_CHUNK_SIZE - 1) / RADIX_SORT_CHUNK_SIZE;
+    scratchKeys.resize(count);
+    scratchValues.resize(count);
+    histograms.resize(chunkCount * 256);
+
+    uint64_t* sourceKeys = keys.data();
+    uint32_t* sourceValues = values.data();
+    uint64_t* targetKeys = scratchKeys.data();
+    uint32_t* targetValues = scratchValues.data();
+    uint32_t* chunkHistograms = histograms.data();
+
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+        if (((differingBits >> shift) & 0xFF) == 0) {
+            continue;
+        }
+
+        jobSystem.parallelFor(count, RADIX_SORT_CHUNK_SIZE, [=](size_t begin, size_t end) {
+            uint32_t* histogram = chunkHistograms + begin / RADIX_SORT_CHUNK_SIZE * 256;
+            std::fill(histogram, histogram + 256, 0);
+            for (size_t i = begin; i < end; i++) {
+                histogram[(sourceKeys[i] >> shift) & 0xFF]++;
+            }
+        });
+
+        // Exclusive prefix sum in digit major order: digit d of chunk c lands after every smaller
+        // digit and after digit d of the previous chunks
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < 256; digit++) {
+            for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+                uint32_t digitCount = chunkHistograms[chunk * 256 + digit];
+                chunkHistograms[chunk * 256 + digit] = offset;
+                offset += digitCount;
+            }
+        }
+
+        jobSystem.parallelFor(count, RADIX_SORT_CHUNK_SIZE, [=](size_t begin, size_t end) {
+            uint32_t* offsets = chunkHistograms + begin / RADIX_SORT_CHUNK_SIZE * 256;
+            for (size_t i = begin; i < end; i++) {
+                uint32_t target = offsets[(sourceKeys[i] >> shift) & 0xFF]++;
+                targetKeys[target] = sourceKeys[i];
+                targetValues[target] = sourceValues[i];
+            }
+        });
+
+        std::swap(sourceKeys, targetKeys);
+        std::swap(sourceValues, targetValues);
+    }
+
+    // An odd number of passes leaves the result in the scratch buffers
+    if (sourceKeys != keys.data()) {
+        keys.swap(scratchKeys);
+        values.swap(scratchValues);
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "JobSystem.h"
+
+// Elements per job, each job histograms and scatters its own chunk
+const size_t RADIX_SORT_CHUNK_SIZE = 4096;
+
+/**
+    * Parallel LSD radix sort of 64-bit keys, 8 bits per pass. Every pass histograms the chunks
+    * in parallel, turns the histograms into per-chunk scatter offsets and scatters the chunks in
+    * parallel. Chunks scatter in order, so the sort is stable. Passes over a byte that is the
+    * same in every key are skipped, short keys only cost the passes over their used bytes.
+    **/
+class RadixSort {
+public:
+	// Sorts keys ascending, values are permuted along with them
+	void sort(JobSystem& jobSystem, std::vector<uint64_t>& keys, std::vector<uint32_t>& values);
+
+private:
+	// Kept between calls so sorting every frame does not allocate
+	std::vector<uint64_t> scratchKeys;
+	std::vector<uint32_t> scratchValues;
+	std::vector<uint32_t> histograms;
+};
@@ -0,0 +1,211 @@
+#include "AsyncLogger.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+static int64_t steadyMilliseconds() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const char* severityName(VkDebugUtilsMessageSeverityFlagBitsEXT severity) {
+    if (severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) return "error";
+    if (severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) return "warning";
+    if (severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) return "info";
+    return "verbose";
+}
+
+AsyncLogger& AsyncLogger::instance() {
+    static AsyncLogger logger;
+    return logger;
+}
+
+AsyncLogger::~AsyncLogger() {
+    stop();
+}
+
+void AsyncLogger::start() {
+    if (running) {
+        return;
+    }
+
+    if (!slots) {
+        slots = std::make_unique<Slot[]>(LOG_QUEUE_CAPACITY);
+        for (size_t i = 0; i < LOG_QUEUE_CAPACITY; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    running = true;
+    drainThread = std::thread(&AsyncLogger::drainLoop, this);
+}
+
+void AsyncLogger::stop() {
+    if (!running) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        running = false;
+    }
+    wakeCondition.notify_one();
+    drainThread.join();
+}
+
+void AsyncLogger::log(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData) {
+    if (static_cast<int>(messageSeverity) < minimumSeverity.load(std::memory_order_relaxed)
+        || isMuted(pCallbackData->messageIdNumber)) {
+        return;
+    }
+
+    // Nothing to write into before the first start()
+    if (!slots || !acquireRateToken()) {
+        droppedRecords.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &slots[position & (LOG_QUEUE_CAPACITY - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+        if (difference == 0) {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (difference < 0) {
+            // Ring full, the drain thread is behind
+            droppedRecords.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->record.messageId = pCallbackData->messageIdNumber;
+    snprintf(slot->record.text, LOG_RECORD_TEXT_SIZE, "validation layer (%s): %s",
+        severityName(messageSeverity), pCallbackData->pMessage != nullptr ? pCallbackData->pMessage : "");
+    slot->sequence.store(position + 1, std::memory_order_release);
+
+    // Errors are worth waking up for, anything else is picked up on the next poll
+    if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            pendingError = true;
+        }
+        wakeCondition.notify_one();
+    }
+}
+
+void AsyncLogger::setMinimumSeverity(VkDebugUtilsMessageSeverityFlagBitsEXT severity) {
+    minimumSeverity.store(static_cast<int>(severity), std::memory_order_relaxed);
+}
+
+void AsyncLogger::setMaxRecordsPerSecond(uint32_t maxRecords) {
+    maxRecordsPerSecond.store(maxRecords, std::memory_order_relaxed);
+}
+
+void AsyncLogger::muteMessageId(int32_t messageId) {
+    if (messageId == 0 || isMuted(messageId)) {
+        return;
+    }
+
+    for (auto& mutedId : mutedIds) {
+        int32_t expected = 0;
+        if (mutedId.compare_exchange_strong(expected, messageId)) {
+            return;
+        }
+    }
+    throw std::runtime_error("too many muted validation message ids!");
+}
+
+bool AsyncLogger::isMuted(int32_t messageId) const {
+    if (messageId == 0) {
+        return false;
+    }
+
+    for (auto& mutedId : mutedIds) {
+        if (mutedId.load(std::memory_order_relaxed) == messageId) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AsyncLogger::acquireRateToken() {
+    // Fixed one second window, resetting it may race with a few increments which is fine for a limit
+    int64_t now = steadyMilliseconds();
+    int64_t windowStart = rateWindowStart.load(std::memory_order_relaxed);
+    if (now - windowStart >= 1000 && rateWindowStart.compare_exchange_strong(windowStart, now, std::memory_order_relaxed)) {
+        rateWindowCount.store(0, std::memory_order_relaxed);
+    }
+
+    return rateWindowCount.fetch_add(1, std::memory_order_relaxed) < maxRecordsPerSecond.load(std::memory_order_relaxed);
+}
+
+bool AsyncLogger::dequeue(LogRecord& record) {
+    Slot& slot = slots[dequeuePosition & (LOG_QUEUE_CAPACITY - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeuePosition + 1) {
+        return false;
+    }
+
+    record = slot.record;
+    slot.sequence.store(dequeuePosition + LOG_QUEUE_CAPACITY, std::memory_order_release);
+    dequeuePosition++;
+    return true;
+}
+
+void AsyncLogger::drainLoop() {
+    LogRecord record;
+    int64_t repeatWindowStart = steadyMilliseconds();
+    bool stopping = false;
+
+    while (!stopping) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wakeCondition.wait_for(lock, std::chrono::milliseconds(50), [this] { return pendingError || !running; });
+            pendingError = false;
+            stopping = !running;
+        }
+
+        bool wrote = false;
+        while (dequeue(record)) {
+            if (repeats[record.text]++ == 0) {
+                std::cerr << record.text << '\n';
+                wrote = true;
+            }
+        }
+
+        if (stopping || steadyMilliseconds() - repeatWindowStart >= 1000) {
+            flushRepeats();
+            repeatWindowStart = steadyMilliseconds();
+            wrote = true;
+        }
+
+        if (wrote) {
+            std::cerr.flush();
+        }
+    }
+}
+
+void AsyncLogger::flushRepeats() {
+    for (auto& entry : repeats) {
+        if (entry.second > 1) {
+            std::cerr << "validation layer: previous message repeated " << entry.second - 1 << " times: "
+                << entry.first.substr(0, 120) << '\n';
+        }
+    }
+    repeats.clear();
+
+    uint32_t dropped = droppedRecords.load(std::memory_order_relaxed);
+    if (dropped != reportedDrops) {
+        std::cerr << "validation layer: " << dropped - reportedDrops << " messages dropped by rate limit or full queue\n";
+        reportedDrops = dropped;
+    }
+}
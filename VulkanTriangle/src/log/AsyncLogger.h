@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+const size_t LOG_QUEUE_CAPACITY = 1024;
+const size_t LOG_RECORD_TEXT_SIZE = 1024;
+const size_t LOG_MUTED_ID_CAPACITY = 32;
+
+struct LogRecord {
+	int32_t messageId;
+	char text[LOG_RECORD_TEXT_SIZE];
+};
+
+/**
+    * Validation messages are formatted in the debug callback straight into a slot of a bounded
+    * lock-free MPSC ring, and written to std::cerr by a background thread. Filtering happens
+    * before any formatting, and every setter can be called at any time from any thread.
+    * The messengers subscribe to every severity, minimumSeverity decides what is kept.
+    **/
+class AsyncLogger {
+public:
+	static AsyncLogger& instance();
+	// Joins the drain thread when the engine did not get to stop() it, on an exception during initialization
+	~AsyncLogger();
+
+	void start();
+	void stop();
+
+	void log(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData);
+
+	void setMinimumSeverity(VkDebugUtilsMessageSeverityFlagBitsEXT severity);
+	void setMaxRecordsPerSecond(uint32_t maxRecords);
+	void muteMessageId(int32_t messageId);
+
+private:
+	struct Slot {
+		std::atomic<size_t> sequence;
+		LogRecord record;
+	};
+
+	bool isMuted(int32_t messageId) const;
+	bool acquireRateToken();
+	void drainLoop();
+	bool dequeue(LogRecord& record);
+	void flushRepeats();
+
+	// Bounded MPSC ring, a slot is free for position p when its sequence equals p
+	std::unique_ptr<Slot[]> slots;
+	std::atomic<size_t> enqueuePosition{ 0 };
+	size_t dequeuePosition = 0;
+
+	// Filters
+	std::atomic<int> minimumSeverity{ VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT };
+	std::atomic<uint32_t> maxRecordsPerSecond{ 200 };
+	std::atomic<int64_t> rateWindowStart{ 0 };
+	std::atomic<uint32_t> rateWindowCount{ 0 };
+	// Muted ids, 0 marks a free entry
+	std::atomic<int32_t> mutedIds[LOG_MUTED_ID_CAPACITY] = {};
+	std::atomic<uint32_t> droppedRecords{ 0 };
+
+	// Owned by the drain thread: identical messages within a second are printed once with a count
+	std::unordered_map<std::string, uint32_t> repeats;
+	uint32_t reportedDrops = 0;
+
+	std::thread drainThread;
+	std::atomic<bool> running{ false };
+	std::mutex wakeMutex;
+	std::condition_variable wakeCondition;
+	// An error was queued since the drain thread last woke up, guarded by wakeMutex
+	bool pendingError = false;
+};
\ No newline at end of file
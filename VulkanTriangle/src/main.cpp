@@ -2,6 +2,7 @@
 
 #include <GLFW/glfw3.h>
 
+#include <atomic>
 #include <cstdint> // Necessary for UINT32_MAX
 #include <cstdlib>
 #include <cstring>
@@ -9,9 +10,17 @@
 #include <iostream>
 #include <optional>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 
+#include "capture/CaptureReplayer.h"
 #include "config/VulkanInitializer.h"
+#include "log/AsyncLogger.h"
+#include "mesh/MeshProcessor.h"
+#include "scene/SceneBenchmark.h"
+#include "server/RenderJobBenchmark.h"
+#include "server/RenderServer.h"
+#include "textures/TextureConverter.h"
 
 class HelloTriangleApplication {
 public:
@@ -21,15 +30,212 @@ public:
         vkEngine.mainLoop();
     }
 
+    // Headless, renders the jobs of local clients until Enter is pressed
+    void serveRenderJobs() {
+        vkEngine.windowCount = 0;
+        // Jobs render a single view into their own targets
+        vkEngine.viewCount = 1;
+        VulkanInitializer vkInitializer;
+        vkInitializer.initialize(vkEngine);
+
+        RenderServer server;
+        server.create(vkEngine);
+        {
+            RenderChannel channel(true);
+            static std::atomic<bool> running{ true };
+            std::thread([]() {
+                std::cin.get();
+                running = false;
+            }).detach();
+
+            std::cout << "render server ready, press Enter to stop" << std::endl;
+            server.serve(channel, running);
+        }
+        server.destroy(vkEngine.device);
+        vkEngine.shutdown();
+    }
+
+    // Headless, a single job from a cold start, the per process baseline of the render server
+    void renderOnce() {
+        vkEngine.windowCount = 0;
+        // Jobs render a single view into their own targets
+        vkEngine.viewCount = 1;
+        VulkanInitializer vkInitializer;
+        vkInitializer.initialize(vkEngine);
+
+        RenderServer server;
+        server.create(vkEngine);
+
+        std::vector<uint8_t> pixels(RENDER_JOB_MAX_PIXEL_BYTES);
+        std::vector<RenderJob> jobs(1);
+        jobs[0].request = RenderJobBenchmark::defaultRequest();
+        jobs[0].pixels = pixels.data();
+        server.renderBatch(jobs);
+
+        server.destroy(vkEngine.device);
+        vkEngine.shutdown();
+        if (!jobs[0].success) {
+            throw std::runtime_error("failed to render job!");
+        }
+    }
+
+    // Headless, initialized like the captured engine, then replays its frames
+    void replay(const std::string& path, bool frameByFrame) {
+        CaptureReplayer replayer;
+        replayer.open(path);
+
+        vkEngine.windowCount = 0;
+        vkEngine.meshPaths = replayer.meshPaths;
+        vkEngine.colorFormat = static_cast<VkFormat>(replayer.header.colorFormat);
+        vkEngine.offscreenExtent = { replayer.header.width, replayer.header.height };
+        // Same rendering path as the captured engine, a capture without render pass used dynamic rendering
+        vkEngine.allowDynamicRendering = replayer.header.objectCounts[static_cast<uint32_t>(CaptureObjectType::RenderPass)] == 0;
+        vkEngine.viewCount = replayer.header.viewCount;
+        vkEngine.drawBatchCapacity = replayer.header.drawBatchCapacity;
+        VulkanInitializer vkInitializer;
+        vkInitializer.initialize(vkEngine);
+
+        replayer.run(vkEngine, frameByFrame);
+        replayer.destroy();
+        vkEngine.shutdown();
+    }
+
+    void setCapture(const std::string& path, uint32_t frames) {
+        vkEngine.capturePath = path;
+        vkEngine.captureFrames = frames;
+    }
+
+    // Render pass and framebuffer objects even where dynamic rendering is supported, to compare both paths
+    void disableDynamicRendering() {
+        vkEngine.allowDynamicRendering = false;
+    }
+
+    void addMesh(const std::string& path) {
+        vkEngine.meshPaths.push_back(path);
+    }
+
+    void addTexture(const std::string& path) {
+        vkEngine.texturePaths.push_back(path);
+    }
+
+    // Clamped to the draws the batch cache is meant to hold
+    void setMovingObjectCount(uint32_t count) {
+        vkEngine.movingObjectCount = count > MAX_MOVING_OBJECTS ? MAX_MOVING_OBJECTS : count;
+    }
+
+    void setWindowCount(uint32_t count) {
+        vkEngine.windowCount = count;
+    }
+
+    // Clamped to the views the camera uniforms hold
+    void setViewCount(uint32_t count) {
+        vkEngine.viewCount = count < 1 ? 1 : (count > MAX_VIEWS ? MAX_VIEWS : count);
+    }
+
 private:
     VulkanEngine vkEngine;
 };
 
-int main() {
+static VkDebugUtilsMessageSeverityFlagBitsEXT parseSeverity(const char* name) {
+    if (strcmp(name, "verbose") == 0) return VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+    if (strcmp(name, "info") == 0) return VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+    if (strcmp(name, "error") == 0) return VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    return VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--bench-scene") == 0) {
+        SceneBenchmark::run();
+        return EXIT_SUCCESS;
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-bvh") == 0) {
+        SceneBenchmark::runBvh();
+        return EXIT_SUCCESS;
+    }
+
+    // Offline conversion: --convert-texture <input.ppm> <output stem>
+    if (argc > 3 && strcmp(argv[1], "--convert-texture") == 0) {
+        try {
+            TextureConverter::convert(argv[2], argv[3]);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // Offline conversion: --convert-mesh <input.obj> <output.vmesh>
+    if (argc > 3 && strcmp(argv[1], "--convert-mesh") == 0) {
+        try {
+            MeshProcessor::convert(argv[2], argv[3]);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
     HelloTriangleApplication app;
 
+    // --mesh <file.vmesh>, repeatable; --texture <file.ktx2|file.ppm>, repeatable, shown at the bottom; --windows <count>, one swap chain each; --capture <file.vcap> <frames>, started by F12;
+    // --views <count>, rendered at once with multiview; --no-dynamic-rendering, render passes even on Vulkan 1.3; --moving <count>, objects moved every frame, at most MAX_MOVING_OBJECTS;
+    // --validation-severity <verbose|info|warning|error>; --validation-mute <message id>, repeatable; --validation-rate <messages per second>
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-dynamic-rendering") == 0) {
+            app.disableDynamicRendering();
+        }
+        else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc) {
+            app.addMesh(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--texture") == 0 && i + 1 < argc) {
+            app.addTexture(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--moving") == 0 && i + 1 < argc) {
+            app.setMovingObjectCount(static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10)));
+        }
+        else if (strcmp(argv[i], "--windows") == 0 && i + 1 < argc) {
+            app.setWindowCount(static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10)));
+        }
+        else if (strcmp(argv[i], "--views") == 0 && i + 1 < argc) {
+            app.setViewCount(static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10)));
+        }
+        else if (strcmp(argv[i], "--capture") == 0 && i + 2 < argc) {
+            app.setCapture(argv[i + 1], static_cast<uint32_t>(strtoul(argv[i + 2], nullptr, 10)));
+            i += 2;
+        }
+        // The logger filters can change at any time, they are set before the messenger exists
+        else if (strcmp(argv[i], "--validation-severity") == 0 && i + 1 < argc) {
+            AsyncLogger::instance().setMinimumSeverity(parseSeverity(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--validation-mute") == 0 && i + 1 < argc) {
+            // Message ids are printed in hexadecimal by the layers, strtoul takes both
+            AsyncLogger::instance().muteMessageId(static_cast<int32_t>(strtoul(argv[++i], nullptr, 0)));
+        }
+        else if (strcmp(argv[i], "--validation-rate") == 0 && i + 1 < argc) {
+            AsyncLogger::instance().setMaxRecordsPerSecond(static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10)));
+        }
+    }
+
     try {
-        app.run();
+        if (argc > 1 && strcmp(argv[1], "--render-server") == 0) {
+            app.serveRenderJobs();
+        }
+        else if (argc > 1 && strcmp(argv[1], "--render-once") == 0) {
+            app.renderOnce();
+        }
+        // --bench-render-jobs <clients> <jobs per client>, against a running --render-server
+        else if (argc > 3 && strcmp(argv[1], "--bench-render-jobs") == 0) {
+            RenderJobBenchmark::run(argv[0], static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)), static_cast<uint32_t>(strtoul(argv[3], nullptr, 10)));
+        }
+        // --replay <file.vcap> [--frame-by-frame]
+        else if (argc > 2 && strcmp(argv[1], "--replay") == 0) {
+            app.replay(argv[2], argc > 3 && strcmp(argv[3], "--frame-by-frame") == 0);
+        }
+        else {
+            app.run();
+        }
     }
     catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+    * On-disk layout of a .vmesh file, written by MeshProcessor and mapped as is by MeshLoader.
+    * Every section starts on a MESH_SECTION_ALIGNMENT boundary and can be copied to a GPU
+    * buffer without any parsing. The LODs share the vertex section, each one is a range of the
+    * index section.
+    **/
+const uint32_t MESH_MAGIC = 0x48534D56; // "VMSH"
+const uint32_t MESH_VERSION = 1;
+const uint32_t MESH_SECTION_ALIGNMENT = 16;
+const uint32_t MESH_MAX_LODS = 8;
+
+// Meshlet limits matching the common mesh shader recommendations
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// 16 bytes per vertex: position is unorm16 within the mesh bounds, normal snorm8, uv half floats
+struct MeshVertex {
+	uint16_t position[4];
+	int8_t normal[4];
+	uint16_t uv[2];
+};
+static_assert(sizeof(MeshVertex) == 16, "mesh vertices must stay 16 bytes");
+
+struct MeshFileLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	// Simplification grid cell size relative to the bounds diagonal, 0 for the full detail level
+	float error;
+	uint32_t padding;
+};
+
+struct MeshFileMeshlet {
+	// Bounding sphere and normal cone, the meshlet is back facing for a camera when
+	// dot(normalize(center - cameraPosition), coneAxis) >= coneCutoff
+	float center[3];
+	float radius;
+	float coneAxis[3];
+	float coneCutoff;
+	// Into the meshlet vertices (uint32 indices into the vertex section) and
+	// meshlet triangles (3 uint8 local indices per triangle) sections
+	uint32_t vertexOffset;
+	uint32_t triangleOffset;
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+};
+
+struct MeshFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexCount;
+	// 2 or 4 bytes
+	uint32_t indexSize;
+
+	// position = boundsMin + unorm position * (boundsMax - boundsMin)
+	float boundsMin[3];
+	uint32_t lodCount;
+	float boundsMax[3];
+	uint32_t meshletCount;
+
+	uint64_t vertexOffset;
+	uint64_t vertexBytes;
+	uint64_t indexOffset;
+	uint64_t indexBytes;
+	uint64_t lodOffset;
+	// Meshlets, meshlet vertices then meshlet triangles, uploaded as one range
+	uint64_t meshletOffset;
+	uint64_t meshletBytes;
+	uint64_t meshletVerticesOffset;
+	uint64_t meshletTrianglesOffset;
+};
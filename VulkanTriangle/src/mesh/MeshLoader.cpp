@@ -0,0 +1,87 @@
+#include "MeshLoader.h"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "../io/MappedFile.h"
+#include "../Utils.h"
+
+Mesh MeshLoader::load(VulkanEngine& vkEngine, const std::string& path) {
+    MappedFile file(path);
+
+    MeshFileHeader header;
+    if (file.size() < sizeof(header)) {
+        throw std::runtime_error("invalid mesh file!");
+    }
+    memcpy(&header, file.data(), sizeof(header));
+
+    if (header.magic != MESH_MAGIC || header.version != MESH_VERSION) {
+        throw std::runtime_error("unsupported mesh file version!");
+    }
+    if ((header.indexSize != 2 && header.indexSize != 4) || header.lodCount == 0 || header.lodCount > MESH_MAX_LODS) {
+        throw std::runtime_error("invalid mesh file!");
+    }
+
+    auto inFile = [&file](uint64_t offset, uint64_t size) {
+        return offset % MESH_SECTION_ALIGNMENT == 0 && offset <= file.size() && size <= file.size() - offset;
+    };
+    if (!inFile(header.vertexOffset, header.vertexBytes) || header.vertexBytes != static_cast<uint64_t>(header.vertexCount) * sizeof(MeshVertex)
+        || !inFile(header.indexOffset, header.indexBytes) || !inFile(header.lodOffset, header.lodCount * sizeof(MeshFileLod))
+        || !inFile(header.meshletOffset, header.meshletBytes)) {
+        throw std::runtime_error("truncated mesh file!");
+    }
+
+    Mesh mesh;
+    mesh.indexType = header.indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+    uint64_t indexCount = header.indexBytes / header.indexSize;
+    const MeshFileLod* lods = reinterpret_cast<const MeshFileLod*>(file.data() + header.lodOffset);
+    for (uint32_t i = 0; i < header.lodCount; i++) {
+        if (lods[i].indexCount == 0 || static_cast<uint64_t>(lods[i].firstIndex) + lods[i].indexCount > indexCount) {
+            throw std::runtime_error("invalid mesh LOD!");
+        }
+        mesh.lods.push_back({ lods[i].firstIndex, lods[i].indexCount, lods[i].error });
+    }
+
+    float squaredRadius = 0.0f;
+    for (int c = 0; c < 3; c++) {
+        mesh.boundsMin[c] = header.boundsMin[c];
+        mesh.boundsExtent[c] = header.boundsMax[c] > header.boundsMin[c] ? header.boundsMax[c] - header.boundsMin[c] : 1.0f;
+        mesh.center[c] = (header.boundsMin[c] + header.boundsMax[c]) * 0.5f;
+        squaredRadius += mesh.boundsExtent[c] * mesh.boundsExtent[c] * 0.25f;
+    }
+    mesh.radius = std::sqrt(squaredRadius);
+
+    uploadSection(vkEngine, file.data() + header.vertexOffset, header.vertexBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        mesh.vertexBuffer, mesh.vertexMemory);
+    uploadSection(vkEngine, file.data() + header.indexOffset, header.indexBytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        mesh.indexBuffer, mesh.indexMemory);
+
+    if (header.meshletCount > 0) {
+        mesh.meshletCount = header.meshletCount;
+        mesh.meshletVerticesOffset = header.meshletVerticesOffset - header.meshletOffset;
+        mesh.meshletTrianglesOffset = header.meshletTrianglesOffset - header.meshletOffset;
+        uploadSection(vkEngine, file.data() + header.meshletOffset, header.meshletBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            mesh.meshletBuffer, mesh.meshletMemory);
+    }
+
+    return mesh;
+}
+
+void MeshLoader::uploadSection(VulkanEngine& vkEngine, const uint8_t* data, VkDeviceSize size, VkBufferUsageFlags usage, UniqueBuffer& buffer, UniqueDeviceMemory& memory) {
+    UniqueBuffer stagingBuffer;
+    UniqueDeviceMemory stagingBufferMemory;
+    Utils::createBuffer(vkEngine, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, *stagingBuffer.put(vkEngine.device), *stagingBufferMemory.put(vkEngine.device));
+
+    // Straight from the mapping, the pages are read by the OS while copying
+    void* mapped;
+    vkd.vkMapMemory(vkEngine.device, stagingBufferMemory, 0, size, 0, &mapped);
+    memcpy(mapped, data, (size_t)size);
+    vkd.vkUnmapMemory(vkEngine.device, stagingBufferMemory);
+
+    Utils::createBuffer(vkEngine, size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, *buffer.put(vkEngine.device), *memory.put(vkEngine.device));
+    // Waits for the copy, the staging buffer is destroyed on return
+    Utils::copyBuffer(vkEngine, stagingBuffer, buffer, size);
+}
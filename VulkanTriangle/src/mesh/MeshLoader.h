@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MeshFormat.h"
+#include "../VulkanHandle.h"
+
+class VulkanEngine;
+
+struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;
+};
+
+// Move-only, the buffers are destroyed with the mesh
+struct Mesh {
+	UniqueBuffer vertexBuffer;
+	UniqueDeviceMemory vertexMemory;
+	UniqueBuffer indexBuffer;
+	UniqueDeviceMemory indexMemory;
+	VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+	std::vector<MeshLod> lods;
+
+	// Meshlets, meshlet vertices and meshlet triangles sections, for mesh shader or compute culling
+	UniqueBuffer meshletBuffer;
+	UniqueDeviceMemory meshletMemory;
+	uint32_t meshletCount = 0;
+	VkDeviceSize meshletVerticesOffset = 0;
+	VkDeviceSize meshletTrianglesOffset = 0;
+
+	// Dequantization: position = boundsMin + unorm position * boundsExtent
+	float boundsMin[3];
+	float boundsExtent[3];
+	// Bounding sphere in mesh space, used to pick the LOD
+	float center[3];
+	float radius;
+};
+
+/**
+    * Loads .vmesh files written by MeshProcessor. The file is mapped and every section is
+    * copied as is to the staging buffers, nothing is parsed or converted at load time.
+    **/
+class MeshLoader {
+public:
+	static Mesh load(VulkanEngine& vkEngine, const std::string& path);
+
+private:
+	static void uploadSection(VulkanEngine& vkEngine, const uint8_t* data, VkDeviceSize size, VkBufferUsageFlags usage, UniqueBuffer& buffer, UniqueDeviceMemory& memory);
+};
@@ -0,0 +1,711 @@
+#include "MeshProcessor.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+struct ObjCorner {
+    int position;
+    int uv;
+    int normal;
+};
+
+static void cross(const float* a, const float* b, float* out) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// Unnormalized, its length is twice the triangle area
+static void triangleNormal(const float* p0, const float* p1, const float* p2, float* out) {
+    float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    cross(e0, e1, out);
+}
+
+static void normalize(float* v) {
+    float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (length > 0.0f) {
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    }
+}
+
+static uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    // Denormals flush to zero, overflows go to infinity
+    if (exponent <= 0) {
+        return static_cast<uint16_t>(sign);
+    }
+    if (exponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7C00);
+    }
+
+    // Round to nearest, a carry into the exponent is still the right value
+    uint32_t half = sign | static_cast<uint32_t>(exponent) << 10 | mantissa >> 13;
+    if (mantissa & 0x1000) {
+        half++;
+    }
+    return static_cast<uint16_t>(half);
+}
+
+/**
+    * Triangulated corners of an OBJ file, polygons are split as fans. Corners without a normal
+    * get the average of the normals of the faces around their position.
+    **/
+static void parseObj(const std::string& path, std::vector<float>& positions, std::vector<float>& uvs, std::vector<float>& normals, std::vector<ObjCorner>& corners) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file!");
+    }
+
+    auto resolve = [](int index, size_t count) {
+        // OBJ indices are 1-based, negative ones are relative to the end
+        int resolved = index < 0 ? static_cast<int>(count) + index : index - 1;
+        if (index == 0 || resolved < 0 || resolved >= static_cast<int>(count)) {
+            throw std::runtime_error("invalid OBJ index!");
+        }
+        return resolved;
+    };
+
+    std::string line;
+    std::vector<ObjCorner> polygon;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string type;
+        stream >> type;
+
+        if (type == "v") {
+            float x, y, z;
+            stream >> x >> y >> z;
+            positions.insert(positions.end(), { x, y, z });
+        }
+        else if (type == "vt") {
+            float u, v;
+            stream >> u >> v;
+            uvs.insert(uvs.end(), { u, v });
+        }
+        else if (type == "vn") {
+            float x, y, z;
+            stream >> x >> y >> z;
+            normals.insert(normals.end(), { x, y, z });
+        }
+        else if (type == "f") {
+            polygon.clear();
+            std::string token;
+            while (stream >> token) {
+                ObjCorner corner = { -1, -1, -1 };
+                size_t firstSlash = token.find('/');
+                corner.position = resolve(std::stoi(token.substr(0, firstSlash)), positions.size() / 3);
+                if (firstSlash != std::string::npos) {
+                    size_t secondSlash = token.find('/', firstSlash + 1);
+                    std::string uv = token.substr(firstSlash + 1, secondSlash - firstSlash - 1);
+                    if (!uv.empty()) {
+                        corner.uv = resolve(std::stoi(uv), uvs.size() / 2);
+                    }
+                    if (secondSlash != std::string::npos && secondSlash + 1 < token.size()) {
+                        corner.normal = resolve(std::stoi(token.substr(secondSlash + 1)), normals.size() / 3);
+                    }
+                }
+                polygon.push_back(corner);
+            }
+
+            for (size_t i = 1; i + 1 < polygon.size(); i++) {
+                corners.insert(corners.end(), { polygon[0], polygon[i], polygon[i + 1] });
+            }
+        }
+    }
+
+    if (corners.empty()) {
+        throw std::runtime_error("OBJ file has no faces!");
+    }
+
+    bool missingNormals = std::any_of(corners.begin(), corners.end(), [](const ObjCorner& corner) { return corner.normal < 0; });
+    if (missingNormals) {
+        size_t firstGenerated = normals.size() / 3;
+        normals.resize(normals.size() + positions.size(), 0.0f);
+
+        for (size_t i = 0; i < corners.size(); i += 3) {
+            float normal[3];
+            triangleNormal(&positions[corners[i].position * 3], &positions[corners[i + 1].position * 3], &positions[corners[i + 2].position * 3], normal);
+            for (size_t k = 0; k < 3; k++) {
+                float* accumulated = &normals[(firstGenerated + corners[i + k].position) * 3];
+                accumulated[0] += normal[0];
+                accumulated[1] += normal[1];
+                accumulated[2] += normal[2];
+            }
+        }
+
+        for (auto& corner : corners) {
+            if (corner.normal < 0) {
+                corner.normal = static_cast<int>(firstGenerated) + corner.position;
+            }
+        }
+    }
+}
+
+void MeshProcessor::convert(const std::string& inputPath, const std::string& outputPath) {
+    std::vector<float> objPositions, objUvs, objNormals;
+    std::vector<ObjCorner> corners;
+    parseObj(inputPath, objPositions, objUvs, objNormals, corners);
+
+    float boundsMin[3] = { INFINITY, INFINITY, INFINITY };
+    float boundsMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (const auto& corner : corners) {
+        for (int c = 0; c < 3; c++) {
+            boundsMin[c] = std::min(boundsMin[c], objPositions[corner.position * 3 + c]);
+            boundsMax[c] = std::max(boundsMax[c], objPositions[corner.position * 3 + c]);
+        }
+    }
+    float extent[3];
+    for (int c = 0; c < 3; c++) {
+        extent[c] = boundsMax[c] > boundsMin[c] ? boundsMax[c] - boundsMin[c] : 1.0f;
+    }
+
+    // Quantize every corner, then deduplicate the 16 byte vertices
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::unordered_map<std::string, uint32_t> uniqueVertices;
+    for (const auto& corner : corners) {
+        MeshVertex vertex{};
+        for (int c = 0; c < 3; c++) {
+            float unorm = (objPositions[corner.position * 3 + c] - boundsMin[c]) / extent[c];
+            vertex.position[c] = static_cast<uint16_t>(std::lround(std::min(std::max(unorm, 0.0f), 1.0f) * 65535.0f));
+        }
+
+        float normal[3] = { objNormals[corner.normal * 3], objNormals[corner.normal * 3 + 1], objNormals[corner.normal * 3 + 2] };
+        normalize(normal);
+        for (int c = 0; c < 3; c++) {
+            vertex.normal[c] = static_cast<int8_t>(std::lround(normal[c] * 127.0f));
+        }
+
+        if (corner.uv >= 0) {
+            // OBJ textures have their origin at the bottom left
+            vertex.uv[0] = floatToHalf(objUvs[corner.uv * 2]);
+            vertex.uv[1] = floatToHalf(1.0f - objUvs[corner.uv * 2 + 1]);
+        }
+
+        std::string key(reinterpret_cast<const char*>(&vertex), sizeof(vertex));
+        auto inserted = uniqueVertices.emplace(key, static_cast<uint32_t>(vertices.size()));
+        if (inserted.second) {
+            vertices.push_back(vertex);
+        }
+        indices.push_back(inserted.first->second);
+    }
+
+    // Processing works on the positions the GPU will actually see
+    uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+    std::vector<float> positions(vertexCount * 3);
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        for (int c = 0; c < 3; c++) {
+            positions[i * 3 + c] = boundsMin[c] + vertices[i].position[c] / 65535.0f * extent[c];
+        }
+    }
+
+    // Triangles collapsed by the quantization
+    std::vector<uint32_t> triangles;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        if (indices[i] != indices[i + 1] && indices[i] != indices[i + 2] && indices[i + 1] != indices[i + 2]) {
+            triangles.insert(triangles.end(), { indices[i], indices[i + 1], indices[i + 2] });
+        }
+    }
+    float inputAcmr = computeAcmr(triangles, vertexCount);
+
+    std::vector<uint32_t> clusters;
+    std::vector<std::vector<uint32_t>> lods;
+    std::vector<float> lodErrors;
+    lods.push_back(optimizeVertexCache(triangles, vertexCount, clusters));
+    optimizeOverdraw(lods[0], clusters, positions);
+    lodErrors.push_back(0.0f);
+
+    // Each LOD aims at half the triangles of the previous one, the cell size is searched for
+    float diagonal = std::sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]);
+    while (lods.size() < MESH_MAX_LODS) {
+        size_t target = lods.back().size() / 3 / 2;
+        if (target < MESH_MIN_LOD_TRIANGLES) {
+            break;
+        }
+
+        std::vector<uint32_t> best;
+        float bestCellSize = 0.0f;
+        float low = diagonal / 4096.0f;
+        float high = diagonal;
+        for (int iteration = 0; iteration < 16; iteration++) {
+            float cellSize = std::sqrt(low * high);
+            std::vector<uint32_t> simplified = simplify(lods[0], positions, boundsMin, cellSize);
+            if (simplified.size() / 3 <= target) {
+                best = std::move(simplified);
+                bestCellSize = cellSize;
+                high = cellSize;
+            }
+            else {
+                low = cellSize;
+            }
+        }
+
+        if (best.empty() || best.size() * 10 > lods.back().size() * 9) {
+            break;
+        }
+        lods.push_back(optimizeVertexCache(best, vertexCount, clusters));
+        lodErrors.push_back(bestCellSize / diagonal);
+    }
+
+    // All LODs index the same vertices, order them by first use with LOD 0 first
+    std::vector<uint32_t> allIndices;
+    std::vector<MeshFileLod> fileLods;
+    for (size_t i = 0; i < lods.size(); i++) {
+        fileLods.push_back({ static_cast<uint32_t>(allIndices.size()), static_cast<uint32_t>(lods[i].size()), lodErrors[i], 0 });
+        allIndices.insert(allIndices.end(), lods[i].begin(), lods[i].end());
+    }
+    std::vector<uint32_t> remap = optimizeVertexFetch(allIndices, vertexCount);
+
+    std::vector<MeshVertex> orderedVertices(vertexCount);
+    std::vector<float> orderedPositions(vertexCount * 3);
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        orderedVertices[remap[i]] = vertices[i];
+        memcpy(&orderedPositions[remap[i] * 3], &positions[i * 3], 3 * sizeof(float));
+    }
+
+    std::vector<uint32_t> lod0(allIndices.begin(), allIndices.begin() + fileLods[0].indexCount);
+    MeshletData meshlets = buildMeshlets(lod0, orderedPositions);
+
+    // Sections
+    auto align = [](uint64_t offset) {
+        return (offset + MESH_SECTION_ALIGNMENT - 1) & ~static_cast<uint64_t>(MESH_SECTION_ALIGNMENT - 1);
+    };
+
+    MeshFileHeader header{};
+    header.magic = MESH_MAGIC;
+    header.version = MESH_VERSION;
+    header.vertexCount = vertexCount;
+    header.indexSize = vertexCount <= UINT16_MAX ? 2 : 4;
+    memcpy(header.boundsMin, boundsMin, sizeof(boundsMin));
+    memcpy(header.boundsMax, boundsMax, sizeof(boundsMax));
+    header.lodCount = static_cast<uint32_t>(fileLods.size());
+    header.meshletCount = static_cast<uint32_t>(meshlets.meshlets.size());
+
+    header.vertexOffset = align(sizeof(header));
+    header.vertexBytes = vertexCount * sizeof(MeshVertex);
+    header.indexOffset = align(header.vertexOffset + header.vertexBytes);
+    header.indexBytes = allIndices.size() * header.indexSize;
+    header.lodOffset = align(header.indexOffset + header.indexBytes);
+    header.meshletOffset = align(header.lodOffset + fileLods.size() * sizeof(MeshFileLod));
+    header.meshletVerticesOffset = align(header.meshletOffset + meshlets.meshlets.size() * sizeof(MeshFileMeshlet));
+    header.meshletTrianglesOffset = align(header.meshletVerticesOffset + meshlets.vertices.size() * sizeof(uint32_t));
+    header.meshletBytes = header.meshletTrianglesOffset + meshlets.triangles.size() - header.meshletOffset;
+
+    std::ofstream file(outputPath, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file!");
+    }
+
+    auto writeSection = [&file](uint64_t offset, const void* data, size_t size) {
+        const char padding[MESH_SECTION_ALIGNMENT] = {};
+        file.write(padding, offset - static_cast<uint64_t>(file.tellp()));
+        file.write(static_cast<const char*>(data), size);
+    };
+
+    std::vector<uint16_t> shortIndices;
+    if (header.indexSize == 2) {
+        shortIndices.assign(allIndices.begin(), allIndices.end());
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeSection(header.vertexOffset, orderedVertices.data(), header.vertexBytes);
+    writeSection(header.indexOffset, header.indexSize == 2 ? static_cast<const void*>(shortIndices.data()) : allIndices.data(), header.indexBytes);
+    writeSection(header.lodOffset, fileLods.data(), fileLods.size() * sizeof(MeshFileLod));
+    writeSection(header.meshletOffset, meshlets.meshlets.data(), meshlets.meshlets.size() * sizeof(MeshFileMeshlet));
+    writeSection(header.meshletVerticesOffset, meshlets.vertices.data(), meshlets.vertices.size() * sizeof(uint32_t));
+    writeSection(header.meshletTrianglesOffset, meshlets.triangles.data(), meshlets.triangles.size());
+
+    if (!file) {
+        throw std::runtime_error("failed to write mesh!");
+    }
+
+    std::cout << "converted " << inputPath << ": " << corners.size() << " corners to " << vertexCount << " vertices, "
+        << lods[0].size() / 3 << " triangles, ACMR " << inputAcmr << " -> " << computeAcmr(lods[0], vertexCount) << std::endl;
+    for (size_t i = 1; i < lods.size(); i++) {
+        std::cout << "  LOD " << i << ": " << lods[i].size() / 3 << " triangles" << std::endl;
+    }
+    std::cout << "  " << meshlets.meshlets.size() << " meshlets, " << header.meshletTrianglesOffset + meshlets.triangles.size() << " bytes" << std::endl;
+}
+
+std::vector<uint32_t> MeshProcessor::optimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& clusters) {
+    size_t triangleCount = indices.size() / 3;
+
+    // Triangles around every vertex
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (uint32_t index : indices) {
+        liveTriangles[index]++;
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (size_t k = 0; k < 3; k++) {
+            adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+        }
+    }
+
+    std::vector<int64_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    clusters.clear();
+
+    int64_t time = VERTEX_CACHE_SIZE + 1;
+    uint32_t cursor = 0;
+    int64_t fanning = triangleCount > 0 ? indices[0] : -1;
+    bool newCluster = true;
+
+    while (fanning >= 0) {
+        // Emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (uint32_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++) {
+            uint32_t t = adjacency[a];
+            if (emitted[t]) {
+                continue;
+            }
+            if (newCluster) {
+                clusters.push_back(static_cast<uint32_t>(result.size() / 3));
+                newCluster = false;
+            }
+
+            for (size_t k = 0; k < 3; k++) {
+                uint32_t v = indices[t * 3 + k];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (time - cacheTime[v] > VERTEX_CACHE_SIZE) {
+                    cacheTime[v] = time++;
+                }
+            }
+            emitted[t] = true;
+        }
+
+        // Next fanning vertex: the oldest candidate still in the cache once its own triangles are emitted
+        int64_t next = -1;
+        int64_t bestPriority = 0;
+        for (uint32_t v : candidates) {
+            if (liveTriangles[v] == 0) {
+                continue;
+            }
+            int64_t priority = 0;
+            if (time - cacheTime[v] + 2 * static_cast<int64_t>(liveTriangles[v]) <= VERTEX_CACHE_SIZE) {
+                priority = time - cacheTime[v];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+
+        if (next == -1) {
+            // Dead end, continue from a recently used vertex or the next one in order, the cache is lost
+            newCluster = true;
+            while (!deadEnd.empty()) {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveTriangles[v] > 0) {
+                    next = v;
+                    break;
+                }
+            }
+            while (next == -1 && cursor < vertexCount) {
+                if (liveTriangles[cursor] > 0) {
+                    next = cursor;
+                }
+                cursor++;
+            }
+        }
+
+        fanning = next;
+    }
+
+    return result;
+}
+
+void MeshProcessor::optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<uint32_t>& clusters, const std::vector<float>& positions) {
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+    struct Cluster {
+        uint32_t begin;
+        uint32_t end;
+        float sortKey;
+    };
+    std::vector<Cluster> sortedClusters;
+
+    // Area weighted centroids
+    float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+    float meshArea = 0.0f;
+    std::vector<float> clusterData(clusters.size() * 7, 0.0f);
+    for (size_t c = 0; c < clusters.size(); c++) {
+        uint32_t begin = clusters[c];
+        uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        float* centroid = &clusterData[c * 7];
+        float* normal = &clusterData[c * 7 + 3];
+        float& area = clusterData[c * 7 + 6];
+
+        for (uint32_t t = begin; t < end; t++) {
+            const float* p0 = &positions[indices[t * 3] * 3];
+            const float* p1 = &positions[indices[t * 3 + 1] * 3];
+            const float* p2 = &positions[indices[t * 3 + 2] * 3];
+            float triangle[3];
+            triangleNormal(p0, p1, p2, triangle);
+            float triangleArea = std::sqrt(triangle[0] * triangle[0] + triangle[1] * triangle[1] + triangle[2] * triangle[2]);
+
+            for (int k = 0; k < 3; k++) {
+                centroid[k] += (p0[k] + p1[k] + p2[k]) / 3.0f * triangleArea;
+                normal[k] += triangle[k];
+            }
+            area += triangleArea;
+        }
+
+        for (int k = 0; k < 3; k++) {
+            meshCentroid[k] += centroid[k];
+        }
+        meshArea += area;
+        sortedClusters.push_back({ begin, end, 0.0f });
+    }
+
+    for (int k = 0; k < 3; k++) {
+        meshCentroid[k] = meshArea > 0.0f ? meshCentroid[k] / meshArea : 0.0f;
+    }
+
+    for (size_t c = 0; c < clusters.size(); c++) {
+        float* centroid = &clusterData[c * 7];
+        float* normal = &clusterData[c * 7 + 3];
+        float area = clusterData[c * 7 + 6];
+        normalize(normal);
+
+        float key = 0.0f;
+        for (int k = 0; k < 3; k++) {
+            float clusterCentroid = area > 0.0f ? centroid[k] / area : 0.0f;
+            key += (clusterCentroid - meshCentroid[k]) * normal[k];
+        }
+        sortedClusters[c].sortKey = key;
+    }
+
+    std::stable_sort(sortedClusters.begin(), sortedClusters.end(), [](const Cluster& a, const Cluster& b) {
+        return a.sortKey > b.sortKey;
+    });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (const auto& cluster : sortedClusters) {
+        result.insert(result.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+    }
+    indices.swap(result);
+}
+
+std::vector<uint32_t> MeshProcessor::optimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t vertexCount) {
+    std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+    uint32_t next = 0;
+
+    for (uint32_t& index : indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = next++;
+        }
+        index = remap[index];
+    }
+
+    // Unreferenced vertices go last
+    for (uint32_t& target : remap) {
+        if (target == UINT32_MAX) {
+            target = next++;
+        }
+    }
+
+    return remap;
+}
+
+std::vector<uint32_t> MeshProcessor::simplify(const std::vector<uint32_t>& indices, const std::vector<float>& positions, const float boundsMin[3], float cellSize) {
+    uint32_t vertexCount = static_cast<uint32_t>(positions.size() / 3);
+
+    // 21 bits per axis is plenty for the cell sizes searched by convert
+    std::unordered_map<uint64_t, uint32_t> cellIds;
+    std::vector<uint32_t> vertexCells(vertexCount);
+    std::vector<float> cellSums;
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        uint64_t key = 0;
+        for (int c = 0; c < 3; c++) {
+            uint64_t cell = std::min(static_cast<uint64_t>((positions[v * 3 + c] - boundsMin[c]) / cellSize), static_cast<uint64_t>((1 << 21) - 1));
+            key |= cell << (c * 21);
+        }
+
+        auto inserted = cellIds.emplace(key, static_cast<uint32_t>(cellIds.size()));
+        if (inserted.second) {
+            cellSums.insert(cellSums.end(), { 0.0f, 0.0f, 0.0f, 0.0f });
+        }
+        uint32_t cell = inserted.first->second;
+        vertexCells[v] = cell;
+        for (int c = 0; c < 3; c++) {
+            cellSums[cell * 4 + c] += positions[v * 3 + c];
+        }
+        cellSums[cell * 4 + 3] += 1.0f;
+    }
+
+    // Existing vertices represent the cells so every LOD shares the vertex buffer
+    std::vector<uint32_t> representatives(cellIds.size(), UINT32_MAX);
+    std::vector<float> representativeDistances(cellIds.size(), INFINITY);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        uint32_t cell = vertexCells[v];
+        float distance = 0.0f;
+        for (int c = 0; c < 3; c++) {
+            float difference = positions[v * 3 + c] - cellSums[cell * 4 + c] / cellSums[cell * 4 + 3];
+            distance += difference * difference;
+        }
+        if (distance < representativeDistances[cell]) {
+            representativeDistances[cell] = distance;
+            representatives[cell] = v;
+        }
+    }
+
+    std::vector<uint32_t> result;
+    std::set<std::array<uint32_t, 3>> emitted;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        uint32_t a = representatives[vertexCells[indices[i]]];
+        uint32_t b = representatives[vertexCells[indices[i + 1]]];
+        uint32_t c = representatives[vertexCells[indices[i + 2]]];
+        if (a == b || a == c || b == c) {
+            continue;
+        }
+
+        // Same triangle with the same winding, whatever its first vertex
+        std::array<uint32_t, 3> key = { a, b, c };
+        std::rotate(key.begin(), std::min_element(key.begin(), key.end()), key.end());
+        if (emitted.insert(key).second) {
+            result.insert(result.end(), { a, b, c });
+        }
+    }
+
+    return result;
+}
+
+MeshletData MeshProcessor::buildMeshlets(const std::vector<uint32_t>& indices, const std::vector<float>& positions) {
+    MeshletData data;
+    std::vector<int> localIndices(positions.size() / 3, -1);
+
+    MeshFileMeshlet current{};
+    auto finish = [&]() {
+        if (current.triangleCount == 0) {
+            return;
+        }
+
+        // Sphere around the bounding box, cone around the average normal
+        float minimum[3] = { INFINITY, INFINITY, INFINITY };
+        float maximum[3] = { -INFINITY, -INFINITY, -INFINITY };
+        for (uint32_t i = 0; i < current.vertexCount; i++) {
+            const float* position = &positions[data.vertices[current.vertexOffset + i] * 3];
+            for (int c = 0; c < 3; c++) {
+                minimum[c] = std::min(minimum[c], position[c]);
+                maximum[c] = std::max(maximum[c], position[c]);
+            }
+        }
+        float radius = 0.0f;
+        for (int c = 0; c < 3; c++) {
+            current.center[c] = (minimum[c] + maximum[c]) * 0.5f;
+        }
+        for (uint32_t i = 0; i < current.vertexCount; i++) {
+            const float* position = &positions[data.vertices[current.vertexOffset + i] * 3];
+            float distance = 0.0f;
+            for (int c = 0; c < 3; c++) {
+                distance += (position[c] - current.center[c]) * (position[c] - current.center[c]);
+            }
+            radius = std::max(radius, distance);
+        }
+        current.radius = std::sqrt(radius);
+
+        std::vector<std::array<float, 3>> normals;
+        float axis[3] = { 0.0f, 0.0f, 0.0f };
+        for (uint32_t t = 0; t < current.triangleCount; t++) {
+            const uint8_t* triangle = &data.triangles[current.triangleOffset + t * 3];
+            std::array<float, 3> normal;
+            triangleNormal(&positions[data.vertices[current.vertexOffset + triangle[0]] * 3], &positions[data.vertices[current.vertexOffset + triangle[1]] * 3],
+                &positions[data.vertices[current.vertexOffset + triangle[2]] * 3], normal.data());
+            normalize(normal.data());
+            normals.push_back(normal);
+            for (int c = 0; c < 3; c++) {
+                axis[c] += normal[c];
+            }
+        }
+        normalize(axis);
+
+        float minimumDot = 1.0f;
+        for (const auto& normal : normals) {
+            minimumDot = std::min(minimumDot, axis[0] * normal[0] + axis[1] * normal[1] + axis[2] * normal[2]);
+        }
+        memcpy(current.coneAxis, axis, sizeof(axis));
+        // Normals spreading over more than a half space can not be back facing all at once, the test never passes
+        current.coneCutoff = minimumDot <= 0.0f ? 2.0f : std::sqrt(1.0f - minimumDot * minimumDot);
+
+        for (uint32_t i = 0; i < current.vertexCount; i++) {
+            localIndices[data.vertices[current.vertexOffset + i]] = -1;
+        }
+        data.meshlets.push_back(current);
+
+        current = MeshFileMeshlet{};
+        current.vertexOffset = static_cast<uint32_t>(data.vertices.size());
+        current.triangleOffset = static_cast<uint32_t>(data.triangles.size());
+    };
+
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        uint32_t newVertices = 0;
+        for (size_t k = 0; k < 3; k++) {
+            newVertices += localIndices[indices[i + k]] < 0 ? 1 : 0;
+        }
+        if (current.vertexCount + newVertices > MESHLET_MAX_VERTICES || current.triangleCount + 1 > MESHLET_MAX_TRIANGLES) {
+            finish();
+        }
+
+        for (size_t k = 0; k < 3; k++) {
+            int& local = localIndices[indices[i + k]];
+            if (local < 0) {
+                local = static_cast<int>(current.vertexCount++);
+                data.vertices.push_back(indices[i + k]);
+            }
+            data.triangles.push_back(static_cast<uint8_t>(local));
+        }
+        current.triangleCount++;
+    }
+    finish();
+
+    return data;
+}
+
+float MeshProcessor::computeAcmr(const std::vector<uint32_t>& indices, uint32_t vertexCount) {
+    if (indices.empty()) {
+        return 0.0f;
+    }
+
+    // FIFO cache, a vertex is cached while fewer than VERTEX_CACHE_SIZE misses happened since its own
+    std::vector<int64_t> missTime(vertexCount, -static_cast<int64_t>(VERTEX_CACHE_SIZE) - 1);
+    int64_t misses = 0;
+    for (uint32_t index : indices) {
+        if (misses - missTime[index] > VERTEX_CACHE_SIZE) {
+            missTime[index] = misses++;
+        }
+    }
+
+    return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MeshFormat.h"
+
+const uint32_t VERTEX_CACHE_SIZE = 16;
+// LODs stop once the next one would have fewer triangles than this
+const size_t MESH_MIN_LOD_TRIANGLES = 32;
+
+struct MeshletData {
+	std::vector<MeshFileMeshlet> meshlets;
+	std::vector<uint32_t> vertices;
+	std::vector<uint8_t> triangles;
+};
+
+/**
+    * Offline mesh preprocessing to the .vmesh format: vertex deduplication on the quantized
+    * vertices, Tipsify vertex cache and overdraw ordering (Sander, Nehab and Barczak 2007),
+    * vertex fetch ordering, vertex clustering LODs sharing the vertex buffer and meshlets.
+    **/
+class MeshProcessor {
+public:
+	// Wavefront OBJ to .vmesh
+	static void convert(const std::string& inputPath, const std::string& outputPath);
+
+	// Returns the reordered triangles, clusters receives the first triangle of every cluster
+	static std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& clusters);
+	// Draws the clusters facing away from the mesh center first, they tend to occlude the others
+	static void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<uint32_t>& clusters, const std::vector<float>& positions);
+	// Renumbers vertices in order of first use, returns the old to new index remap
+	static std::vector<uint32_t> optimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t vertexCount);
+	// Merges the vertices of every grid cell into the one closest to their average
+	static std::vector<uint32_t> simplify(const std::vector<uint32_t>& indices, const std::vector<float>& positions, const float boundsMin[3], float cellSize);
+	static MeshletData buildMeshlets(const std::vector<uint32_t>& indices, const std::vector<float>& positions);
+
+	// Average cache misses per triangle with a FIFO cache of VERTEX_CACHE_SIZE entries
+	static float computeAcmr(const std::vector<uint32_t>& indices, uint32_t vertexCount);
+};
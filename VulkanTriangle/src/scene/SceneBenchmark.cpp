@@ -0,0 +1,235 @@
+#include "SceneBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include "SceneBvh.h"
+#include "SceneStore.h"
+#include "../jobs/JobSystem.h"
+
+const int SCENE_BENCHMARK_ITERATIONS = 10;
+const uint32_t BVH_BENCHMARK_RAYS = 1000;
+// One object in this many moves between two refits
+const uint32_t BVH_BENCHMARK_MOVED_RATIO = 100;
+const size_t BVH_BENCHMARK_JOB_BATCH_SIZE = 16384;
+
+/**
+    * Objects spread over a 200 units wide cube with random rotations, a quarter of them being
+    * children of an earlier object, near their parent
+    **/
+static void createScene(SceneStore& scene, uint32_t objectCount, std::default_random_engine& rndEngine) {
+    std::uniform_real_distribution<float> rndDist(-1.0f, 1.0f);
+    for (uint32_t i = 0; i < objectCount; i++) {
+        int32_t parent = (i > 0 && i % 4 == 0) ? static_cast<int32_t>(rndEngine() % i) : -1;
+        uint32_t index = scene.addObject(parent);
+        float spread = parent < 0 ? 100.0f : 2.0f;
+        scene.setPosition(index, rndDist(rndEngine) * spread, rndDist(rndEngine) * spread, rndDist(rndEngine) * spread);
+
+        float qx = rndDist(rndEngine), qy = rndDist(rndEngine), qz = rndDist(rndEngine), qw = rndDist(rndEngine);
+        float length = std::sqrt(qx * qx + qy * qy + qz * qz + qw * qw);
+        if (length < 1e-6f) {
+            qx = qy = qz = 0.0f;
+            qw = length = 1.0f;
+        }
+        scene.setRotation(index, qx / length, qy / length, qz / length, qw / length);
+        scene.setBounds(index, 0.0f, 0.0f, 0.0f, 1.0f);
+    }
+}
+
+// Perspective (60 degrees, zero-to-one depth) looking down -z from z = cameraZ
+static void createViewProj(float cameraZ, float viewProj[16]) {
+    const float fovScale = 1.0f / std::tan(3.14159265f / 6.0f);
+    const float nearPlane = 0.1f;
+    const float farPlane = 500.0f;
+    std::fill(viewProj, viewProj + 16, 0.0f);
+    viewProj[0] = fovScale;
+    viewProj[5] = fovScale;
+    viewProj[10] = farPlane / (nearPlane - farPlane);
+    viewProj[11] = -1.0f;
+    viewProj[14] = -cameraZ * viewProj[10] + nearPlane * farPlane / (nearPlane - farPlane);
+    viewProj[15] = cameraZ;
+}
+
+/**
+    * Times transform update and frustum culling for growing object counts, a quarter of the
+    * objects being children of an earlier object. Time per object should stay flat.
+    **/
+void SceneBenchmark::run() {
+    std::default_random_engine rndEngine(0);
+
+    float viewProj[16];
+    createViewProj(150.0f, viewProj);
+
+    std::cout << "Scene benchmark, " << getSceneKernels().name << " kernels, SIMD width " << getSceneKernels().width << "\n";
+
+    for (uint32_t objectCount : { 10000u, 100000u, 1000000u, 4000000u }) {
+        SceneStore scene;
+        createScene(scene, objectCount, rndEngine);
+
+        double updateMs = 0.0;
+        double cullMs = 0.0;
+        for (int iteration = 0; iteration < SCENE_BENCHMARK_ITERATIONS; iteration++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            scene.updateTransforms();
+            auto updated = std::chrono::high_resolution_clock::now();
+            scene.cull(viewProj);
+            auto culled = std::chrono::high_resolution_clock::now();
+
+            updateMs += std::chrono::duration<double, std::milli>(updated - start).count();
+            cullMs += std::chrono::duration<double, std::milli>(culled - updated).count();
+        }
+        updateMs /= SCENE_BENCHMARK_ITERATIONS;
+        cullMs /= SCENE_BENCHMARK_ITERATIONS;
+
+        std::cout << objectCount << " objects: update " << updateMs << " ms, cull " << cullMs << " ms, "
+            << (updateMs + cullMs) * 1000000.0 / objectCount << " ns/object, "
+            << scene.visibleInstances.size() << " visible" << "\n";
+    }
+}
+
+/**
+    * Times the BVH build, its refit after moving one object in BVH_BENCHMARK_MOVED_RATIO (and
+    * their children), and frustum and picking queries against the linear scans. The camera
+    * stands at the center of the objects and sees a part of them. Queries are timed on one
+    * thread then split over a job system, the culling by subtree of the root as the engine does.
+    **/
+void SceneBenchmark::runBvh() {
+    std::default_random_engine rndEngine(0);
+    std::uniform_real_distribution<float> rndDist(-1.0f, 1.0f);
+
+    float viewProj[16];
+    createViewProj(0.0f, viewProj);
+    float planes[6][4];
+    SceneStore::extractFrustumPlanes(viewProj, planes);
+
+    JobSystem jobSystem;
+    jobSystem.start(std::max(2u, std::thread::hardware_concurrency()) - 1);
+
+    std::cout << "BVH benchmark, " << getSceneKernels().name << " kernels, SIMD width " << getSceneKernels().width << ", " << jobSystem.getWorkerCount() + 1 << " threads" << "\n";
+
+    std::vector<float> rays(BVH_BENCHMARK_RAYS * 3);
+    for (float& component : rays) {
+        component = rndDist(rndEngine);
+    }
+    const float origin[3] = { 0.0f, 0.0f, 0.0f };
+
+    for (uint32_t objectCount : { 10000u, 100000u, 1000000u }) {
+        SceneStore scene;
+        createScene(scene, objectCount, rndEngine);
+        scene.updateTransforms();
+
+        SceneBvh bvh;
+        auto start = std::chrono::high_resolution_clock::now();
+        bvh.build(scene);
+        double buildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        // Moved objects drift a little every iteration, their children follow
+        double refitMs = 0.0;
+        uint32_t rebuilds = 0;
+        std::vector<uint8_t> moved(objectCount);
+        std::vector<uint32_t> movedObjects;
+        for (int iteration = 0; iteration < SCENE_BENCHMARK_ITERATIONS; iteration++) {
+            movedObjects.clear();
+            for (uint32_t i = 0; i < objectCount; i++) {
+                int32_t parent = scene.parents[i];
+                moved[i] = rndEngine() % BVH_BENCHMARK_MOVED_RATIO == 0 || (parent >= 0 && moved[parent]);
+                if (moved[i]) {
+                    if (rndEngine() % BVH_BENCHMARK_MOVED_RATIO == 0) {
+                        scene.setPosition(i, scene.positionX[i] + rndDist(rndEngine) * 5.0f, scene.positionY[i] + rndDist(rndEngine) * 5.0f,
+                            scene.positionZ[i] + rndDist(rndEngine) * 5.0f);
+                    }
+                    movedObjects.push_back(i);
+                }
+            }
+            scene.updateTransforms();
+
+            start = std::chrono::high_resolution_clock::now();
+            rebuilds += bvh.update(scene, movedObjects) ? 1 : 0;
+            refitMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+        refitMs /= SCENE_BENCHMARK_ITERATIONS;
+
+        double linearCullMs = 0.0;
+        double bvhCullMs = 0.0;
+        double parallelLinearCullMs = 0.0;
+        double parallelBvhCullMs = 0.0;
+        std::vector<uint32_t> linearVisible;
+        std::vector<uint32_t> bvhVisible;
+        std::vector<std::vector<uint32_t>> batches(std::max<size_t>(BVH_WIDTH, (objectCount + BVH_BENCHMARK_JOB_BATCH_SIZE - 1) / BVH_BENCHMARK_JOB_BATCH_SIZE));
+        for (int iteration = 0; iteration < SCENE_BENCHMARK_ITERATIONS; iteration++) {
+            start = std::chrono::high_resolution_clock::now();
+            linearVisible.clear();
+            scene.cullRange(planes, 0, objectCount, linearVisible);
+            auto linearCulled = std::chrono::high_resolution_clock::now();
+            bvhVisible.clear();
+            bvh.cull(planes, bvhVisible);
+            auto bvhCulled = std::chrono::high_resolution_clock::now();
+
+            jobSystem.parallelFor(objectCount, BVH_BENCHMARK_JOB_BATCH_SIZE, [&scene, &planes, &batches](size_t begin, size_t end) {
+                std::vector<uint32_t>& visible = batches[begin / BVH_BENCHMARK_JOB_BATCH_SIZE];
+                visible.clear();
+                scene.cullRange(planes, begin, end, visible);
+            });
+            auto parallelLinearCulled = std::chrono::high_resolution_clock::now();
+            jobSystem.parallelFor(bvh.getRootChildCount(), 1, [&bvh, &planes, &batches](size_t begin, size_t end) {
+                for (size_t child = begin; child < end; child++) {
+                    batches[child].clear();
+                    bvh.cullSubtree(planes, static_cast<uint32_t>(child), batches[child]);
+                }
+            });
+            auto parallelBvhCulled = std::chrono::high_resolution_clock::now();
+
+            linearCullMs += std::chrono::duration<double, std::milli>(linearCulled - start).count();
+            bvhCullMs += std::chrono::duration<double, std::milli>(bvhCulled - linearCulled).count();
+            parallelLinearCullMs += std::chrono::duration<double, std::milli>(parallelLinearCulled - bvhCulled).count();
+            parallelBvhCullMs += std::chrono::duration<double, std::milli>(parallelBvhCulled - parallelLinearCulled).count();
+        }
+        linearCullMs /= SCENE_BENCHMARK_ITERATIONS;
+        bvhCullMs /= SCENE_BENCHMARK_ITERATIONS;
+        parallelLinearCullMs /= SCENE_BENCHMARK_ITERATIONS;
+        parallelBvhCullMs /= SCENE_BENCHMARK_ITERATIONS;
+
+        // Rays from the center of the objects, the linear scan gives the reference hits
+        std::vector<uint32_t> linearHits(BVH_BENCHMARK_RAYS);
+        std::vector<uint32_t> bvhHits(BVH_BENCHMARK_RAYS);
+        start = std::chrono::high_resolution_clock::now();
+        for (uint32_t ray = 0; ray < BVH_BENCHMARK_RAYS; ray++) {
+            float distance;
+            linearHits[ray] = bvh.pickLinear(origin, &rays[ray * 3], distance);
+        }
+        auto linearPicked = std::chrono::high_resolution_clock::now();
+        for (uint32_t ray = 0; ray < BVH_BENCHMARK_RAYS; ray++) {
+            float distance;
+            bvhHits[ray] = bvh.pick(origin, &rays[ray * 3], distance);
+        }
+        auto bvhPicked = std::chrono::high_resolution_clock::now();
+        jobSystem.parallelFor(BVH_BENCHMARK_RAYS, 16, [&bvh, &origin, &rays, &bvhHits](size_t begin, size_t end) {
+            for (size_t ray = begin; ray < end; ray++) {
+                float distance;
+                bvhHits[ray] = bvh.pick(origin, &rays[ray * 3], distance);
+            }
+        });
+        auto parallelBvhPicked = std::chrono::high_resolution_clock::now();
+
+        uint32_t mismatches = 0;
+        for (uint32_t ray = 0; ray < BVH_BENCHMARK_RAYS; ray++) {
+            mismatches += linearHits[ray] != bvhHits[ray] ? 1 : 0;
+        }
+        double linearPickUs = std::chrono::duration<double, std::micro>(linearPicked - start).count() / BVH_BENCHMARK_RAYS;
+        double bvhPickUs = std::chrono::duration<double, std::micro>(bvhPicked - linearPicked).count() / BVH_BENCHMARK_RAYS;
+        double parallelBvhPickUs = std::chrono::duration<double, std::micro>(parallelBvhPicked - bvhPicked).count() / BVH_BENCHMARK_RAYS;
+
+        std::cout << objectCount << " objects: build " << buildMs << " ms, " << bvh.getNodeCount() << " nodes, refit " << refitMs << " ms ("
+            << movedObjects.size() << " moved, cost ratio " << bvh.getCostRatio() << ", " << rebuilds << " rebuilds)" << "\n";
+        std::cout << "  cull: linear " << linearCullMs << " ms, bvh " << bvhCullMs << " ms, parallel linear " << parallelLinearCullMs
+            << " ms, parallel bvh " << parallelBvhCullMs << " ms, " << linearVisible.size() << "/" << bvhVisible.size() << " visible" << "\n";
+        std::cout << "  pick: linear " << linearPickUs << " us/ray, bvh " << bvhPickUs << " us/ray, parallel bvh " << parallelBvhPickUs
+            << " us/ray, " << mismatches << " mismatches" << "\n";
+    }
+
+    jobSystem.stop();
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+class SceneBenchmark {
+public:
+	static void run();
+	// BVH build, refit and queries against the linear scans
+	static void runBvh();
+};
\ No newline at end of file
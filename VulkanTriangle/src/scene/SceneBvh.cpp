@@ -0,0 +1,581 @@
+#include "SceneBvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+#include "SceneKernels.h"
+
+const uint32_t BVH_BIN_COUNT = 16;
+// SAH costs of visiting a node and of testing a primitive
+const float BVH_NODE_COST = 1.0f;
+const float BVH_PRIMITIVE_COST = 1.0f;
+// Deeper ranges are split at the median, which bounds the depth and the traversal stacks
+const uint32_t BVH_MAX_BUILD_DEPTH = 40;
+const uint32_t BVH_STACK_SIZE = 512;
+
+static float surfaceArea(const float min[3], const float max[3]) {
+    float dx = max[0] - min[0];
+    float dy = max[1] - min[1];
+    float dz = max[2] - min[2];
+    return std::max(dx * dy + dy * dz + dz * dx, std::numeric_limits<float>::min());
+}
+
+static bool isSphereVisible(const float planes[6][4], float x, float y, float z, float radius) {
+    for (size_t p = 0; p < 6; p++) {
+        if (planes[p][0] * x + planes[p][1] * y + planes[p][2] * z + planes[p][3] <= -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Distance along the unit direction to the sphere, 0 from within it
+static bool intersectSphere(float x, float y, float z, float radius, const float origin[3], const float direction[3], float& distance) {
+    float ox = x - origin[0];
+    float oy = y - origin[1];
+    float oz = z - origin[2];
+    float along = ox * direction[0] + oy * direction[1] + oz * direction[2];
+    float distanceSquared = ox * ox + oy * oy + oz * oz - along * along;
+    if (distanceSquared > radius * radius) {
+        return false;
+    }
+
+    float halfChord = std::sqrt(radius * radius - distanceSquared);
+    if (along + halfChord < 0.0f) {
+        return false;
+    }
+    distance = std::max(along - halfChord, 0.0f);
+    return true;
+}
+
+void SceneBvh::build(const SceneStore& scene) {
+    objectCount = scene.size();
+    nodes.clear();
+    primitives.clear();
+    spheres.clear();
+    leafNodes.clear();
+    slots.clear();
+    laneCostSum = 0.0;
+    builtCost = 0.0f;
+    if (objectCount == 0) {
+        return;
+    }
+
+    size_t paddedCount = scene.positionX.size();
+    for (auto* component : { &worldX, &worldY, &worldZ, &worldRadius }) {
+        component->resize(paddedCount);
+    }
+    scene.computeWorldSpheres(0, objectCount, worldX.data(), worldY.data(), worldZ.data(), worldRadius.data());
+
+    primitives.resize(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) {
+        primitives[i] = i;
+    }
+    buildNodes.clear();
+    buildNodes.reserve(2 * static_cast<size_t>(objectCount));
+    buildRange(0, objectCount, 0);
+
+    leafNodes.resize(objectCount);
+    collapse(0, BVH_NO_OBJECT);
+    buildNodes.clear();
+
+    // Leaves read their spheres in the BVH order, next to each other
+    spheres.resize(objectCount);
+    slots.resize(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) {
+        uint32_t object = primitives[i];
+        spheres[i] = { worldX[object], worldY[object], worldZ[object], worldRadius[object] };
+        slots[object] = i;
+    }
+    dirtyNodes.assign(nodes.size(), 0);
+
+    for (const SceneBvhNode& node : nodes) {
+        for (uint32_t lane = 0; lane < node.childCount; lane++) {
+            laneCostSum += getLaneCost(node, lane);
+        }
+    }
+    float min[3], max[3];
+    getNodeBounds(nodes[0], min, max);
+    builtCost = static_cast<float>(laneCostSum / surfaceArea(min, max));
+}
+
+/**
+    * Refits the leaves of the moved objects and the nodes above them, bottom up. Ranges of the
+    * SIMD kernel start on a vector boundary, the neighbours of a moved object are recomputed too.
+    **/
+bool SceneBvh::update(const SceneStore& scene, const std::vector<uint32_t>& movedObjects) {
+    // Added objects need a new tree
+    if (scene.size() != objectCount) {
+        build(scene);
+        return true;
+    }
+    if (movedObjects.empty() || nodes.empty()) {
+        return false;
+    }
+
+    if (movedObjects.size() * SCENE_KERNEL_MAX_WIDTH >= objectCount) {
+        scene.computeWorldSpheres(0, objectCount, worldX.data(), worldY.data(), worldZ.data(), worldRadius.data());
+    }
+    else {
+        for (uint32_t object : movedObjects) {
+            scene.computeWorldSpheres(object - object % SCENE_KERNEL_MAX_WIDTH, object + 1, worldX.data(), worldY.data(), worldZ.data(), worldRadius.data());
+        }
+    }
+
+    for (uint32_t object : movedObjects) {
+        uint32_t slot = slots[object];
+        spheres[slot] = { worldX[object], worldY[object], worldZ[object], worldRadius[object] };
+        for (uint32_t node = leafNodes[slot]; node != BVH_NO_OBJECT && !dirtyNodes[node]; node = nodes[node].parent) {
+            dirtyNodes[node] = 1;
+            refitNodes.push_back(node);
+        }
+    }
+
+    // Children are stored after their parent, decreasing indices refit them first
+    std::sort(refitNodes.begin(), refitNodes.end(), std::greater<uint32_t>());
+    for (uint32_t node : refitNodes) {
+        refitNode(node);
+        dirtyNodes[node] = 0;
+    }
+    refitNodes.clear();
+
+    if (getCostRatio() > BVH_REBUILD_COST_RATIO) {
+        build(scene);
+        return true;
+    }
+    return false;
+}
+
+float SceneBvh::getCostRatio() const {
+    if (nodes.empty() || builtCost <= 0.0f) {
+        return 1.0f;
+    }
+    float min[3], max[3];
+    getNodeBounds(nodes[0], min, max);
+    return static_cast<float>(laneCostSum / surfaceArea(min, max)) / builtCost;
+}
+
+/**
+    * Binary node of [first, first + count) split at the cheapest of BVH_BIN_COUNT planes along
+    * the largest centroid axis, or at the median when no plane separates the centroids
+    **/
+uint32_t SceneBvh::buildRange(uint32_t first, uint32_t count, uint32_t depth) {
+    const float infinity = std::numeric_limits<float>::infinity();
+    const float* centers[3] = { worldX.data(), worldY.data(), worldZ.data() };
+
+    float min[3] = { infinity, infinity, infinity };
+    float max[3] = { -infinity, -infinity, -infinity };
+    float centroidMin[3] = { infinity, infinity, infinity };
+    float centroidMax[3] = { -infinity, -infinity, -infinity };
+    for (uint32_t i = first; i < first + count; i++) {
+        uint32_t object = primitives[i];
+        for (size_t axis = 0; axis < 3; axis++) {
+            float center = centers[axis][object];
+            min[axis] = std::min(min[axis], center - worldRadius[object]);
+            max[axis] = std::max(max[axis], center + worldRadius[object]);
+            centroidMin[axis] = std::min(centroidMin[axis], center);
+            centroidMax[axis] = std::max(centroidMax[axis], center);
+        }
+    }
+
+    uint32_t index = static_cast<uint32_t>(buildNodes.size());
+    buildNodes.push_back({ { min[0], min[1], min[2] }, { max[0], max[1], max[2] }, BVH_NO_OBJECT, BVH_NO_OBJECT, first, count });
+    if (count == 1) {
+        return index;
+    }
+
+    size_t axis = 0;
+    for (size_t k = 1; k < 3; k++) {
+        if (centroidMax[k] - centroidMin[k] > centroidMax[axis] - centroidMin[axis]) {
+            axis = k;
+        }
+    }
+    float extent = centroidMax[axis] - centroidMin[axis];
+    const float* axisCenters = centers[axis];
+
+    uint32_t leftCount = 0;
+    if (extent > 0.0f && depth < BVH_MAX_BUILD_DEPTH) {
+        float scale = BVH_BIN_COUNT / extent;
+        auto getBin = [&](uint32_t object) {
+            return std::min(static_cast<uint32_t>((axisCenters[object] - centroidMin[axis]) * scale), BVH_BIN_COUNT - 1);
+        };
+
+        float binMin[BVH_BIN_COUNT][3];
+        float binMax[BVH_BIN_COUNT][3];
+        uint32_t binCounts[BVH_BIN_COUNT] = {};
+        for (uint32_t bin = 0; bin < BVH_BIN_COUNT; bin++) {
+            for (size_t k = 0; k < 3; k++) {
+                binMin[bin][k] = infinity;
+                binMax[bin][k] = -infinity;
+            }
+        }
+        for (uint32_t i = first; i < first + count; i++) {
+            uint32_t object = primitives[i];
+            uint32_t bin = getBin(object);
+            binCounts[bin]++;
+            for (size_t k = 0; k < 3; k++) {
+                binMin[bin][k] = std::min(binMin[bin][k], centers[k][object] - worldRadius[object]);
+                binMax[bin][k] = std::max(binMax[bin][k], centers[k][object] + worldRadius[object]);
+            }
+        }
+
+        // Right side costs of every plane, then a sweep from the left picks the cheapest one
+        float rightCosts[BVH_BIN_COUNT] = {};
+        float sideMin[3] = { infinity, infinity, infinity };
+        float sideMax[3] = { -infinity, -infinity, -infinity };
+        uint32_t sideCount = 0;
+        for (uint32_t bin = BVH_BIN_COUNT - 1; bin > 0; bin--) {
+            for (size_t k = 0; k < 3; k++) {
+                sideMin[k] = std::min(sideMin[k], binMin[bin][k]);
+                sideMax[k] = std::max(sideMax[k], binMax[bin][k]);
+            }
+            sideCount += binCounts[bin];
+            rightCosts[bin - 1] = sideCount == 0 ? 0.0f : surfaceArea(sideMin, sideMax) * sideCount;
+        }
+
+        float bestCost = infinity;
+        uint32_t bestBin = BVH_BIN_COUNT;
+        std::fill(sideMin, sideMin + 3, infinity);
+        std::fill(sideMax, sideMax + 3, -infinity);
+        sideCount = 0;
+        for (uint32_t bin = 0; bin + 1 < BVH_BIN_COUNT; bin++) {
+            for (size_t k = 0; k < 3; k++) {
+                sideMin[k] = std::min(sideMin[k], binMin[bin][k]);
+                sideMax[k] = std::max(sideMax[k], binMax[bin][k]);
+            }
+            sideCount += binCounts[bin];
+            if (sideCount == 0 || sideCount == count) {
+                continue;
+            }
+            float cost = surfaceArea(sideMin, sideMax) * sideCount + rightCosts[bin];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestBin = bin;
+            }
+        }
+
+        if (bestBin < BVH_BIN_COUNT) {
+            float area = surfaceArea(min, max);
+            float splitCost = BVH_NODE_COST * area + BVH_PRIMITIVE_COST * bestCost;
+            if (count <= BVH_MAX_LEAF_SIZE && BVH_PRIMITIVE_COST * area * count <= splitCost) {
+                return index;
+            }
+            auto middle = std::partition(primitives.begin() + first, primitives.begin() + first + count,
+                [&](uint32_t object) { return getBin(object) <= bestBin; });
+            leftCount = static_cast<uint32_t>(middle - (primitives.begin() + first));
+        }
+    }
+
+    if (leftCount == 0 || leftCount == count) {
+        if (count <= BVH_MAX_LEAF_SIZE) {
+            return index;
+        }
+        leftCount = count / 2;
+        std::nth_element(primitives.begin() + first, primitives.begin() + first + leftCount, primitives.begin() + first + count,
+            [&](uint32_t a, uint32_t b) { return axisCenters[a] < axisCenters[b]; });
+    }
+
+    uint32_t left = buildRange(first, leftCount, depth + 1);
+    uint32_t right = buildRange(first + leftCount, count - leftCount, depth + 1);
+    buildNodes[index].left = left;
+    buildNodes[index].right = right;
+    return index;
+}
+
+/**
+    * Wide node of a binary subtree: the child with the largest surface area is replaced by its
+    * two children until BVH_WIDTH children are reached or only leaves are left
+    **/
+uint32_t SceneBvh::collapse(uint32_t buildIndex, uint32_t parent) {
+    const float infinity = std::numeric_limits<float>::infinity();
+    const BuildNode& root = buildNodes[buildIndex];
+
+    uint32_t lanes[BVH_WIDTH];
+    uint32_t laneCount = 0;
+    if (root.left == BVH_NO_OBJECT) {
+        lanes[laneCount++] = buildIndex;
+    }
+    else {
+        lanes[laneCount++] = root.left;
+        lanes[laneCount++] = root.right;
+        while (laneCount < BVH_WIDTH) {
+            uint32_t largest = BVH_NO_OBJECT;
+            float largestArea = 0.0f;
+            for (uint32_t lane = 0; lane < laneCount; lane++) {
+                const BuildNode& child = buildNodes[lanes[lane]];
+                float area = surfaceArea(child.min, child.max);
+                if (child.left != BVH_NO_OBJECT && (largest == BVH_NO_OBJECT || area > largestArea)) {
+                    largest = lane;
+                    largestArea = area;
+                }
+            }
+            if (largest == BVH_NO_OBJECT) {
+                break;
+            }
+            const BuildNode& opened = buildNodes[lanes[largest]];
+            lanes[largest] = opened.left;
+            lanes[laneCount++] = opened.right;
+        }
+    }
+
+    uint32_t nodeIndex = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    SceneBvhNode& node = nodes.back();
+    for (uint32_t lane = 0; lane < BVH_WIDTH; lane++) {
+        node.minX[lane] = node.minY[lane] = node.minZ[lane] = infinity;
+        node.maxX[lane] = node.maxY[lane] = node.maxZ[lane] = -infinity;
+        node.children[lane] = 0;
+        node.counts[lane] = 0;
+    }
+    node.firstPrimitive = root.first;
+    node.primitiveCount = root.count;
+    node.childCount = laneCount;
+    node.parent = parent;
+
+    for (uint32_t lane = 0; lane < laneCount; lane++) {
+        const BuildNode& child = buildNodes[lanes[lane]];
+        uint32_t childIndex = child.first;
+        bool leaf = child.left == BVH_NO_OBJECT;
+        if (leaf) {
+            for (uint32_t i = child.first; i < child.first + child.count; i++) {
+                leafNodes[i] = nodeIndex;
+            }
+        }
+        else {
+            childIndex = collapse(lanes[lane], nodeIndex);
+        }
+
+        // The recursion may have moved the nodes
+        SceneBvhNode& current = nodes[nodeIndex];
+        current.minX[lane] = child.min[0];
+        current.minY[lane] = child.min[1];
+        current.minZ[lane] = child.min[2];
+        current.maxX[lane] = child.max[0];
+        current.maxY[lane] = child.max[1];
+        current.maxZ[lane] = child.max[2];
+        current.children[lane] = childIndex;
+        current.counts[lane] = leaf ? child.count : 0;
+    }
+
+    return nodeIndex;
+}
+
+void SceneBvh::refitNode(uint32_t nodeIndex) {
+    const float infinity = std::numeric_limits<float>::infinity();
+    SceneBvhNode& node = nodes[nodeIndex];
+    for (uint32_t lane = 0; lane < node.childCount; lane++) {
+        laneCostSum -= getLaneCost(node, lane);
+
+        float min[3] = { infinity, infinity, infinity };
+        float max[3] = { -infinity, -infinity, -infinity };
+        if (node.counts[lane] > 0) {
+            for (uint32_t i = node.children[lane]; i < node.children[lane] + node.counts[lane]; i++) {
+                const Sphere& sphere = spheres[i];
+                min[0] = std::min(min[0], sphere.x - sphere.radius);
+                min[1] = std::min(min[1], sphere.y - sphere.radius);
+                min[2] = std::min(min[2], sphere.z - sphere.radius);
+                max[0] = std::max(max[0], sphere.x + sphere.radius);
+                max[1] = std::max(max[1], sphere.y + sphere.radius);
+                max[2] = std::max(max[2], sphere.z + sphere.radius);
+            }
+        }
+        else {
+            getNodeBounds(nodes[node.children[lane]], min, max);
+        }
+
+        node.minX[lane] = min[0];
+        node.minY[lane] = min[1];
+        node.minZ[lane] = min[2];
+        node.maxX[lane] = max[0];
+        node.maxY[lane] = max[1];
+        node.maxZ[lane] = max[2];
+        laneCostSum += getLaneCost(node, lane);
+    }
+}
+
+void SceneBvh::getNodeBounds(const SceneBvhNode& node, float min[3], float max[3]) const {
+    const float infinity = std::numeric_limits<float>::infinity();
+    min[0] = min[1] = min[2] = infinity;
+    max[0] = max[1] = max[2] = -infinity;
+    for (uint32_t lane = 0; lane < node.childCount; lane++) {
+        min[0] = std::min(min[0], node.minX[lane]);
+        min[1] = std::min(min[1], node.minY[lane]);
+        min[2] = std::min(min[2], node.minZ[lane]);
+        max[0] = std::max(max[0], node.maxX[lane]);
+        max[1] = std::max(max[1], node.maxY[lane]);
+        max[2] = std::max(max[2], node.maxZ[lane]);
+    }
+}
+
+float SceneBvh::getLaneCost(const SceneBvhNode& node, uint32_t lane) const {
+    float min[3] = { node.minX[lane], node.minY[lane], node.minZ[lane] };
+    float max[3] = { node.maxX[lane], node.maxY[lane], node.maxZ[lane] };
+    float cost = node.counts[lane] > 0 ? BVH_PRIMITIVE_COST * node.counts[lane] : BVH_NODE_COST;
+    return surfaceArea(min, max) * cost;
+}
+
+/**
+    * Children of node whose box intersects the frustum, and in insideMask those lying entirely
+    * within it
+    **/
+uint32_t SceneBvh::testFrustum(const SceneBvhNode& node, const float planes[6][4], uint32_t& insideMask) const {
+    SceneKernelBoxes boxes = { node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ };
+    uint32_t visibleMask = getSceneKernels().testBoxesFrustum(boxes, planes, insideMask);
+
+    uint32_t childMask = (1u << node.childCount) - 1;
+    insideMask &= childMask;
+    return visibleMask & childMask;
+}
+
+/**
+    * Slab test of the children of node, distances receives where the ray enters each box
+    **/
+uint32_t SceneBvh::testRay(const SceneBvhNode& node, const float origin[3], const float inverseDirection[3], float maxDistance, float distances[BVH_WIDTH]) const {
+    SceneKernelBoxes boxes = { node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ };
+    return getSceneKernels().testBoxesRay(boxes, origin, inverseDirection, maxDistance, distances) & ((1u << node.childCount) - 1);
+}
+
+void SceneBvh::cull(const float planes[6][4], std::vector<uint32_t>& visible) const {
+    for (uint32_t child = 0; child < getRootChildCount(); child++) {
+        cullSubtree(planes, child, visible);
+    }
+}
+
+void SceneBvh::cullSubtree(const float planes[6][4], uint32_t rootChild, std::vector<uint32_t>& visible) const {
+    if (rootChild >= getRootChildCount()) {
+        return;
+    }
+
+    uint32_t insideMask;
+    uint32_t mask = testFrustum(nodes[0], planes, insideMask);
+    if ((mask >> rootChild & 1) == 0) {
+        return;
+    }
+
+    uint32_t stack[BVH_STACK_SIZE];
+    uint32_t stackSize = 0;
+    cullChild(nodes[0], rootChild, (insideMask >> rootChild & 1) != 0, planes, visible, stack, stackSize);
+    while (stackSize > 0) {
+        const SceneBvhNode& node = nodes[stack[--stackSize]];
+        mask = testFrustum(node, planes, insideMask);
+        for (uint32_t lane = 0; mask != 0; lane++, mask >>= 1, insideMask >>= 1) {
+            if (mask & 1) {
+                cullChild(node, lane, (insideMask & 1) != 0, planes, visible, stack, stackSize);
+            }
+        }
+    }
+}
+
+/**
+    * A visible child: subtrees inside the frustum are appended whole, leaves intersecting it test
+    * their spheres, other child nodes are pushed
+    **/
+void SceneBvh::cullChild(const SceneBvhNode& node, uint32_t lane, bool inside, const float planes[6][4], std::vector<uint32_t>& visible,
+    uint32_t* stack, uint32_t& stackSize) const {
+    if (node.counts[lane] > 0) {
+        uint32_t first = node.children[lane];
+        if (inside) {
+            appendPrimitives(first, node.counts[lane], visible);
+            return;
+        }
+        for (uint32_t i = first; i < first + node.counts[lane]; i++) {
+            const Sphere& sphere = spheres[i];
+            if (isSphereVisible(planes, sphere.x, sphere.y, sphere.z, sphere.radius)) {
+                visible.push_back(primitives[i]);
+            }
+        }
+        return;
+    }
+
+    if (inside) {
+        const SceneBvhNode& child = nodes[node.children[lane]];
+        appendPrimitives(child.firstPrimitive, child.primitiveCount, visible);
+        return;
+    }
+    stack[stackSize++] = node.children[lane];
+}
+
+void SceneBvh::appendPrimitives(uint32_t first, uint32_t count, std::vector<uint32_t>& visible) const {
+    visible.insert(visible.end(), primitives.begin() + first, primitives.begin() + first + count);
+}
+
+uint32_t SceneBvh::pick(const float origin[3], const float direction[3], float& distance) const {
+    distance = std::numeric_limits<float>::infinity();
+    uint32_t closest = BVH_NO_OBJECT;
+    float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+    if (nodes.empty() || length == 0.0f) {
+        return closest;
+    }
+
+    float unitDirection[3];
+    float inverseDirection[3];
+    for (size_t k = 0; k < 3; k++) {
+        unitDirection[k] = direction[k] / length;
+        inverseDirection[k] = 1.0f / unitDirection[k];
+    }
+
+    uint32_t stack[BVH_STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    float distances[BVH_WIDTH];
+    while (stackSize > 0) {
+        const SceneBvhNode& node = nodes[stack[--stackSize]];
+        uint32_t mask = testRay(node, origin, inverseDirection, distance, distances);
+
+        // Leaves are tested right away, child nodes pushed farthest first so the nearest one shortens the ray first
+        uint32_t order[BVH_WIDTH];
+        uint32_t orderCount = 0;
+        for (uint32_t lane = 0; mask != 0; lane++, mask >>= 1) {
+            if ((mask & 1) == 0) {
+                continue;
+            }
+            if (node.counts[lane] > 0) {
+                for (uint32_t i = node.children[lane]; i < node.children[lane] + node.counts[lane]; i++) {
+                    const Sphere& sphere = spheres[i];
+                    float hitDistance;
+                    if (intersectSphere(sphere.x, sphere.y, sphere.z, sphere.radius, origin, unitDirection, hitDistance) && hitDistance < distance) {
+                        distance = hitDistance;
+                        closest = primitives[i];
+                    }
+                }
+                continue;
+            }
+
+            uint32_t position = orderCount++;
+            while (position > 0 && distances[order[position - 1]] < distances[lane]) {
+                order[position] = order[position - 1];
+                position--;
+            }
+            order[position] = lane;
+        }
+
+        for (uint32_t i = 0; i < orderCount; i++) {
+            if (distances[order[i]] < distance) {
+                stack[stackSize++] = node.children[order[i]];
+            }
+        }
+    }
+
+    return closest;
+}
+
+uint32_t SceneBvh::pickLinear(const float origin[3], const float direction[3], float& distance) const {
+    distance = std::numeric_limits<float>::infinity();
+    uint32_t closest = BVH_NO_OBJECT;
+    float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+    if (length == 0.0f) {
+        return closest;
+    }
+
+    float unitDirection[3] = { direction[0] / length, direction[1] / length, direction[2] / length };
+    for (uint32_t object = 0; object < objectCount; object++) {
+        float hitDistance;
+        if (intersectSphere(worldX[object], worldY[object], worldZ[object], worldRadius[object], origin, unitDirection, hitDistance) && hitDistance < distance) {
+            distance = hitDistance;
+            closest = object;
+        }
+    }
+    return closest;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "SceneStore.h"
+
+const uint32_t BVH_WIDTH = SCENE_KERNEL_BOX_LANES;
+const uint32_t BVH_MAX_LEAF_SIZE = 4;
+const uint32_t BVH_NO_OBJECT = UINT32_MAX;
+// A refit tree whose SAH cost grew past this ratio of the built one is rebuilt
+const float BVH_REBUILD_COST_RATIO = 1.5f;
+
+/**
+    * Node of BVH_WIDTH children with their boxes stored as structure of arrays, the boxes of all
+    * children are tested together by the SceneKernels. Unused lanes hold an empty box.
+    * Nodes are stored depth first, a parent always comes before its children.
+    **/
+struct SceneBvhNode {
+	float minX[BVH_WIDTH];
+	float minY[BVH_WIDTH];
+	float minZ[BVH_WIDTH];
+	float maxX[BVH_WIDTH];
+	float maxY[BVH_WIDTH];
+	float maxZ[BVH_WIDTH];
+	// Child node index, or first primitive of a leaf child
+	uint32_t children[BVH_WIDTH];
+	// Primitives of a leaf child, 0 for a child node
+	uint32_t counts[BVH_WIDTH];
+	// Primitives of the whole subtree, contiguous in the BVH order
+	uint32_t firstPrimitive;
+	uint32_t primitiveCount;
+	uint32_t childCount;
+	uint32_t parent;
+};
+
+/**
+    * Bounding volume hierarchy over the world bounding spheres of the scene objects, built with
+    * the binned surface area heuristic then collapsed into BVH_WIDTH wide nodes. Moving objects
+    * only refits the nodes above them; the SAH cost is tracked along the way and a tree degraded
+    * past BVH_REBUILD_COST_RATIO is built again. Queries are const and may run concurrently,
+    * cullSubtree splits a frustum query over the children of the root.
+    **/
+class SceneBvh {
+public:
+	void build(const SceneStore& scene);
+	// Objects whose world transform changed since the last update, children of a moved parent included. True when rebuilt
+	bool update(const SceneStore& scene, const std::vector<uint32_t>& movedObjects);
+
+	// Appends the objects whose world bounding sphere intersects the frustum planes, see SceneStore::extractFrustumPlanes
+	void cull(const float planes[6][4], std::vector<uint32_t>& visible) const;
+	void cullSubtree(const float planes[6][4], uint32_t rootChild, std::vector<uint32_t>& visible) const;
+	// Closest object whose world bounding sphere the ray hits, BVH_NO_OBJECT when none
+	uint32_t pick(const float origin[3], const float direction[3], float& distance) const;
+	// Same query testing every object, the reference of the benchmark
+	uint32_t pickLinear(const float origin[3], const float direction[3], float& distance) const;
+
+	uint32_t getRootChildCount() const {
+		return nodes.empty() ? 0 : nodes[0].childCount;
+	}
+	size_t getNodeCount() const {
+		return nodes.size();
+	}
+	// SAH cost of the tree relative to the one it had when built
+	float getCostRatio() const;
+
+private:
+	struct BuildNode {
+		float min[3];
+		float max[3];
+		// Binary children, left is BVH_NO_OBJECT for a leaf
+		uint32_t left;
+		uint32_t right;
+		uint32_t first;
+		uint32_t count;
+	};
+
+	struct Sphere {
+		float x, y, z, radius;
+	};
+
+	uint32_t buildRange(uint32_t first, uint32_t count, uint32_t depth);
+	uint32_t collapse(uint32_t buildIndex, uint32_t parent);
+	void refitNode(uint32_t nodeIndex);
+	void getNodeBounds(const SceneBvhNode& node, float min[3], float max[3]) const;
+	float getLaneCost(const SceneBvhNode& node, uint32_t lane) const;
+	uint32_t testFrustum(const SceneBvhNode& node, const float planes[6][4], uint32_t& insideMask) const;
+	uint32_t testRay(const SceneBvhNode& node, const float origin[3], const float inverseDirection[3], float maxDistance, float distances[BVH_WIDTH]) const;
+	void cullChild(const SceneBvhNode& node, uint32_t lane, bool inside, const float planes[6][4], std::vector<uint32_t>& visible,
+		uint32_t* stack, uint32_t& stackSize) const;
+	void appendPrimitives(uint32_t first, uint32_t count, std::vector<uint32_t>& visible) const;
+
+	std::vector<SceneBvhNode> nodes;
+	// Object of every primitive in the BVH order, its world sphere, and the node of its leaf
+	std::vector<uint32_t> primitives;
+	std::vector<Sphere> spheres;
+	std::vector<uint32_t> leafNodes;
+	// BVH order position of every object
+	std::vector<uint32_t> slots;
+	uint32_t objectCount = 0;
+
+	// World spheres in object order, padded like the scene arrays for the SIMD kernel
+	std::vector<float> worldX, worldY, worldZ, worldRadius;
+
+	// Sum over the children of every node of their area times their cost, and its value once built
+	double laneCostSum = 0.0;
+	float builtCost = 0.0f;
+
+	std::vector<BuildNode> buildNodes;
+	std::vector<uint8_t> dirtyNodes;
+	std::vector<uint32_t> refitNodes;
+};
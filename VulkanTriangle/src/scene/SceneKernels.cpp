@@ -0,0 +1,42 @@
+#include "SceneKernels.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+#define SCENE_KERNELS_TABLE PORTABLE_SCENE_KERNELS
+#define SCENE_KERNELS_NAME "portable"
+#include "SceneKernels.inl"
+
+/**
+    * AVX2 and FMA on the CPU, and the AVX registers saved by the OS (OSXSAVE set and XCR0
+    * holding the SSE and AVX state bits)
+    **/
+static bool isAvx2Supported() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int registers[4];
+    __cpuid(registers, 0);
+    if (registers[0] < 7) {
+        return false;
+    }
+    __cpuid(registers, 1);
+    bool fma = (registers[2] & (1 << 12)) != 0;
+    bool osxsave = (registers[2] & (1 << 27)) != 0;
+    bool avx = (registers[2] & (1 << 28)) != 0;
+    if (!fma || !osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(registers, 7, 0);
+    return (registers[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+}
+
+const SceneKernels& getSceneKernels() {
+    static const SceneKernels* kernels = getAvx2SceneKernels() != nullptr && isAvx2Supported() ? getAvx2SceneKernels() : &PORTABLE_SCENE_KERNELS;
+    return *kernels;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Scene arrays are padded to the widest kernel and ranges start on a multiple of it
+const uint32_t SCENE_KERNEL_MAX_WIDTH = 8;
+// Children of a BVH node, see SceneBvhNode
+const uint32_t SCENE_KERNEL_BOX_LANES = 8;
+
+// Component arrays of a SceneStore, padded to SCENE_KERNEL_MAX_WIDTH
+struct SceneKernelArrays {
+	const float* positionX;
+	const float* positionY;
+	const float* positionZ;
+	const float* rotationX;
+	const float* rotationY;
+	const float* rotationZ;
+	const float* rotationW;
+	const float* scaleX;
+	const float* scaleY;
+	const float* scaleZ;
+	const float* boundsX;
+	const float* boundsY;
+	const float* boundsZ;
+	const float* boundsRadius;
+	const float* world[12];
+};
+
+// SCENE_KERNEL_BOX_LANES boxes as structure of arrays
+struct SceneKernelBoxes {
+	const float* minX;
+	const float* minY;
+	const float* minZ;
+	const float* maxX;
+	const float* maxY;
+	const float* maxZ;
+};
+
+/**
+    * SIMD kernels of the scene store and the BVH, built once per instruction set. Only their
+    * own translation unit is compiled for AVX2 and getSceneKernels picks it at run time, so the
+    * rest of the binary runs on any x64 CPU. The kernels take raw arrays, nothing compiled for
+    * AVX2 is shared with the other translation units.
+    **/
+struct SceneKernels {
+	const char* name;
+	uint32_t width;
+	// Local transforms of [begin, end) composed into the world rows
+	void (*composeTransforms)(const SceneKernelArrays& arrays, float* const world[12], size_t begin, size_t end);
+	// Indices of [begin, end) whose world bounding sphere intersects the frustum, written to visible. Returns their count
+	size_t (*cullSpheres)(const SceneKernelArrays& arrays, const float planes[6][4], size_t begin, size_t end, uint32_t* visible);
+	// World bounding spheres of [begin, end), written at the same indices
+	void (*worldSpheres)(const SceneKernelArrays& arrays, size_t begin, size_t end, float* x, float* y, float* z, float* radius);
+	// Boxes intersecting the frustum, and in insideMask those lying entirely within it
+	uint32_t (*testBoxesFrustum)(const SceneKernelBoxes& boxes, const float planes[6][4], uint32_t& insideMask);
+	// Boxes the ray hits before maxDistance, distances receives where it enters each one
+	uint32_t (*testBoxesRay)(const SceneKernelBoxes& boxes, const float origin[3], const float inverseDirection[3], float maxDistance,
+		float distances[SCENE_KERNEL_BOX_LANES]);
+};
+
+// Widest kernels the CPU runs, chosen on the first call
+const SceneKernels& getSceneKernels();
+
+// Compiled without instruction set flags, NEON on ARM64 and scalar on x86
+extern const SceneKernels PORTABLE_SCENE_KERNELS;
+// Null when the AVX2 translation unit was not compiled for AVX2
+const SceneKernels* getAvx2SceneKernels();
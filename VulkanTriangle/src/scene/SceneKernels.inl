@@ -0,0 +1,189 @@
+// Kernel bodies shared by the SceneKernels translation units, each one includes this file once
+// with SCENE_KERNELS_TABLE naming its table. Everything here has internal linkage.
+
+#include "SceneKernels.h"
+#include "SimdMath.h"
+
+static_assert(SIMD_WIDTH <= SCENE_KERNEL_MAX_WIDTH && SCENE_KERNEL_BOX_LANES % SIMD_WIDTH == 0, "SIMD width does not divide the padding");
+
+static float absolute(float value) {
+    return value < 0.0f ? -value : value;
+}
+
+/**
+    * Local bounding spheres of SIMD_WIDTH objects from index on, moved to world space
+    **/
+static void loadWorldSphere(const SceneKernelArrays& arrays, size_t index, SimdFloat& x, SimdFloat& y, SimdFloat& z, SimdFloat& radius) {
+    SimdFloat lx = simdLoad(&arrays.boundsX[index]);
+    SimdFloat ly = simdLoad(&arrays.boundsY[index]);
+    SimdFloat lz = simdLoad(&arrays.boundsZ[index]);
+
+    SimdFloat m[12];
+    for (size_t k = 0; k < 12; k++) {
+        m[k] = simdLoad(&arrays.world[k][index]);
+    }
+
+    x = simdMulAdd(m[0], lx, simdMulAdd(m[1], ly, simdMulAdd(m[2], lz, m[3])));
+    y = simdMulAdd(m[4], lx, simdMulAdd(m[5], ly, simdMulAdd(m[6], lz, m[7])));
+    z = simdMulAdd(m[8], lx, simdMulAdd(m[9], ly, simdMulAdd(m[10], lz, m[11])));
+
+    // The sphere grows with the largest axis scale of the world transform
+    SimdFloat scale0 = simdMulAdd(m[0], m[0], simdMulAdd(m[4], m[4], simdMul(m[8], m[8])));
+    SimdFloat scale1 = simdMulAdd(m[1], m[1], simdMulAdd(m[5], m[5], simdMul(m[9], m[9])));
+    SimdFloat scale2 = simdMulAdd(m[2], m[2], simdMulAdd(m[6], m[6], simdMul(m[10], m[10])));
+    radius = simdMul(simdLoad(&arrays.boundsRadius[index]), simdSqrt(simdMax(scale0, simdMax(scale1, scale2))));
+}
+
+static void composeTransforms(const SceneKernelArrays& arrays, float* const world[12], size_t begin, size_t end) {
+    const SimdFloat one = simdSet(1.0f);
+
+    // Compose translation * rotation * scale, SIMD_WIDTH objects at a time (the padding absorbs the tail)
+    for (size_t i = begin; i < end; i += SIMD_WIDTH) {
+        SimdFloat x = simdLoad(&arrays.rotationX[i]);
+        SimdFloat y = simdLoad(&arrays.rotationY[i]);
+        SimdFloat z = simdLoad(&arrays.rotationZ[i]);
+        SimdFloat w = simdLoad(&arrays.rotationW[i]);
+
+        SimdFloat x2 = simdAdd(x, x);
+        SimdFloat y2 = simdAdd(y, y);
+        SimdFloat z2 = simdAdd(z, z);
+
+        SimdFloat xx = simdMul(x, x2);
+        SimdFloat yy = simdMul(y, y2);
+        SimdFloat zz = simdMul(z, z2);
+        SimdFloat xy = simdMul(x, y2);
+        SimdFloat xz = simdMul(x, z2);
+        SimdFloat yz = simdMul(y, z2);
+        SimdFloat wx = simdMul(w, x2);
+        SimdFloat wy = simdMul(w, y2);
+        SimdFloat wz = simdMul(w, z2);
+
+        SimdFloat sx = simdLoad(&arrays.scaleX[i]);
+        SimdFloat sy = simdLoad(&arrays.scaleY[i]);
+        SimdFloat sz = simdLoad(&arrays.scaleZ[i]);
+
+        simdStore(&world[0][i], simdMul(simdSub(one, simdAdd(yy, zz)), sx));
+        simdStore(&world[1][i], simdMul(simdSub(xy, wz), sy));
+        simdStore(&world[2][i], simdMul(simdAdd(xz, wy), sz));
+        simdStore(&world[3][i], simdLoad(&arrays.positionX[i]));
+
+        simdStore(&world[4][i], simdMul(simdAdd(xy, wz), sx));
+        simdStore(&world[5][i], simdMul(simdSub(one, simdAdd(xx, zz)), sy));
+        simdStore(&world[6][i], simdMul(simdSub(yz, wx), sz));
+        simdStore(&world[7][i], simdLoad(&arrays.positionY[i]));
+
+        simdStore(&world[8][i], simdMul(simdSub(xz, wy), sx));
+        simdStore(&world[9][i], simdMul(simdAdd(yz, wx), sy));
+        simdStore(&world[10][i], simdMul(simdSub(one, simdAdd(xx, yy)), sz));
+        simdStore(&world[11][i], simdLoad(&arrays.positionZ[i]));
+    }
+}
+
+static size_t cullSpheres(const SceneKernelArrays& arrays, const float planes[6][4], size_t begin, size_t end, uint32_t* visible) {
+    const uint32_t allLanes = (1u << SIMD_WIDTH) - 1;
+    const SimdFloat zero = simdSet(0.0f);
+    size_t visibleCount = 0;
+    for (size_t i = begin; i < end; i += SIMD_WIDTH) {
+        SimdFloat cx, cy, cz, radius;
+        loadWorldSphere(arrays, i, cx, cy, cz, radius);
+        SimdFloat negativeRadius = simdSub(zero, radius);
+
+        uint32_t mask = allLanes;
+        for (size_t p = 0; p < 6; p++) {
+            SimdFloat distance = simdMulAdd(simdSet(planes[p][0]), cx, simdMulAdd(simdSet(planes[p][1]), cy, simdMulAdd(simdSet(planes[p][2]), cz, simdSet(planes[p][3]))));
+            mask &= simdGreaterMask(distance, negativeRadius);
+        }
+
+        for (uint32_t lane = 0; mask != 0; lane++, mask >>= 1) {
+            if ((mask & 1) && i + lane < end) {
+                visible[visibleCount++] = static_cast<uint32_t>(i + lane);
+            }
+        }
+    }
+    return visibleCount;
+}
+
+static void worldSpheres(const SceneKernelArrays& arrays, size_t begin, size_t end, float* x, float* y, float* z, float* radius) {
+    for (size_t i = begin; i < end; i += SIMD_WIDTH) {
+        SimdFloat cx, cy, cz, r;
+        loadWorldSphere(arrays, i, cx, cy, cz, r);
+        simdStore(&x[i], cx);
+        simdStore(&y[i], cy);
+        simdStore(&z[i], cz);
+        simdStore(&radius[i], r);
+    }
+}
+
+/**
+    * Boxes are tested as a center and the extent projected on the plane normal
+    **/
+static uint32_t testBoxesFrustum(const SceneKernelBoxes& boxes, const float planes[6][4], uint32_t& insideMask) {
+    const uint32_t allLanes = (1u << SIMD_WIDTH) - 1;
+    const SimdFloat half = simdSet(0.5f);
+    const SimdFloat zero = simdSet(0.0f);
+
+    uint32_t visibleMask = 0;
+    insideMask = 0;
+    for (uint32_t lane = 0; lane < SCENE_KERNEL_BOX_LANES; lane += SIMD_WIDTH) {
+        SimdFloat minX = simdLoad(&boxes.minX[lane]);
+        SimdFloat minY = simdLoad(&boxes.minY[lane]);
+        SimdFloat minZ = simdLoad(&boxes.minZ[lane]);
+        SimdFloat maxX = simdLoad(&boxes.maxX[lane]);
+        SimdFloat maxY = simdLoad(&boxes.maxY[lane]);
+        SimdFloat maxZ = simdLoad(&boxes.maxZ[lane]);
+
+        // Empty lanes get a NaN center and fail every test
+        SimdFloat cx = simdMul(simdAdd(minX, maxX), half);
+        SimdFloat cy = simdMul(simdAdd(minY, maxY), half);
+        SimdFloat cz = simdMul(simdAdd(minZ, maxZ), half);
+        SimdFloat ex = simdMul(simdSub(maxX, minX), half);
+        SimdFloat ey = simdMul(simdSub(maxY, minY), half);
+        SimdFloat ez = simdMul(simdSub(maxZ, minZ), half);
+
+        uint32_t visible = allLanes;
+        uint32_t inside = allLanes;
+        for (size_t p = 0; p < 6; p++) {
+            SimdFloat distance = simdMulAdd(simdSet(planes[p][0]), cx, simdMulAdd(simdSet(planes[p][1]), cy, simdMulAdd(simdSet(planes[p][2]), cz, simdSet(planes[p][3]))));
+            SimdFloat radius = simdMulAdd(simdSet(absolute(planes[p][0])), ex, simdMulAdd(simdSet(absolute(planes[p][1])), ey, simdMul(simdSet(absolute(planes[p][2])), ez)));
+            visible &= simdGreaterMask(distance, simdSub(zero, radius));
+            inside &= simdGreaterMask(distance, radius);
+        }
+        visibleMask |= visible << lane;
+        insideMask |= inside << lane;
+    }
+    return visibleMask;
+}
+
+/**
+    * Slab test, distances receives where the ray enters each box
+    **/
+static uint32_t testBoxesRay(const SceneKernelBoxes& boxes, const float origin[3], const float inverseDirection[3], float maxDistance,
+    float distances[SCENE_KERNEL_BOX_LANES]) {
+    const uint32_t allLanes = (1u << SIMD_WIDTH) - 1;
+    const SimdFloat zero = simdSet(0.0f);
+    const SimdFloat farthest = simdSet(maxDistance);
+    const SimdFloat ox = simdSet(origin[0]);
+    const SimdFloat oy = simdSet(origin[1]);
+    const SimdFloat oz = simdSet(origin[2]);
+    const SimdFloat ix = simdSet(inverseDirection[0]);
+    const SimdFloat iy = simdSet(inverseDirection[1]);
+    const SimdFloat iz = simdSet(inverseDirection[2]);
+
+    uint32_t hitMask = 0;
+    for (uint32_t lane = 0; lane < SCENE_KERNEL_BOX_LANES; lane += SIMD_WIDTH) {
+        SimdFloat t0x = simdMul(simdSub(simdLoad(&boxes.minX[lane]), ox), ix);
+        SimdFloat t0y = simdMul(simdSub(simdLoad(&boxes.minY[lane]), oy), iy);
+        SimdFloat t0z = simdMul(simdSub(simdLoad(&boxes.minZ[lane]), oz), iz);
+        SimdFloat t1x = simdMul(simdSub(simdLoad(&boxes.maxX[lane]), ox), ix);
+        SimdFloat t1y = simdMul(simdSub(simdLoad(&boxes.maxY[lane]), oy), iy);
+        SimdFloat t1z = simdMul(simdSub(simdLoad(&boxes.maxZ[lane]), oz), iz);
+
+        SimdFloat nearT = simdMax(simdMax(simdMin(t0x, t1x), simdMin(t0y, t1y)), simdMax(simdMin(t0z, t1z), zero));
+        SimdFloat farT = simdMin(simdMin(simdMax(t0x, t1x), simdMax(t0y, t1y)), simdMin(simdMax(t0z, t1z), farthest));
+        simdStore(&distances[lane], nearT);
+        hitMask |= (allLanes & ~simdGreaterMask(nearT, farT)) << lane;
+    }
+    return hitMask;
+}
+
+const SceneKernels SCENE_KERNELS_TABLE = { SCENE_KERNELS_NAME, SIMD_WIDTH, composeTransforms, cullSpheres, worldSpheres, testBoxesFrustum, testBoxesRay };
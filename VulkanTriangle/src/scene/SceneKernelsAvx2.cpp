@@ -0,0 +1,16 @@
+// Compiled with /arch:AVX2 on x64 (see the vcxproj), called only once getSceneKernels found AVX2 on the CPU
+#include "SceneKernels.h"
+
+#if defined(__AVX2__)
+#define SCENE_KERNELS_TABLE AVX2_SCENE_KERNELS
+#define SCENE_KERNELS_NAME "AVX2"
+#include "SceneKernels.inl"
+
+const SceneKernels* getAvx2SceneKernels() {
+    return &AVX2_SCENE_KERNELS;
+}
+#else
+const SceneKernels* getAvx2SceneKernels() {
+    return nullptr;
+}
+#endif
@@ -0,0 +1,185 @@
+#include "SceneStore.h"
+
+#include <cmath>
+
+#include "SceneKernels.h"
+
+// Arrays are padded to the widest SIMD width so kernels never need a scalar tail
+const uint32_t SCENE_PADDING = SCENE_KERNEL_MAX_WIDTH;
+
+uint32_t SceneStore::addObject(int32_t parent) {
+    if (parent >= static_cast<int32_t>(count)) {
+        throw std::runtime_error("scene object parent must be added before its children!");
+    }
+
+    uint32_t index = count++;
+    size_t paddedCount = (static_cast<size_t>(count) + SCENE_PADDING - 1) & ~static_cast<size_t>(SCENE_PADDING - 1);
+    if (paddedCount > positionX.size()) {
+        // Padding lanes hold an identity transform so the kernels never read garbage
+        for (auto* component : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ, &boundsX, &boundsY, &boundsZ, &boundsRadius }) {
+            component->resize(paddedCount, 0.0f);
+        }
+        for (auto* component : { &rotationW, &scaleX, &scaleY, &scaleZ }) {
+            component->resize(paddedCount, 1.0f);
+        }
+        for (auto& component : world) {
+            component.resize(paddedCount, 0.0f);
+        }
+    }
+
+    parents.push_back(parent);
+    meshes.push_back(NO_MESH);
+    if (parent >= 0) {
+        children.push_back(index);
+    }
+
+    return index;
+}
+
+void SceneStore::clear() {
+    for (auto* component : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ, &rotationW,
+        &scaleX, &scaleY, &scaleZ, &boundsX, &boundsY, &boundsZ, &boundsRadius }) {
+        component->clear();
+    }
+    for (auto& component : world) {
+        component.clear();
+    }
+    parents.clear();
+    children.clear();
+    meshes.clear();
+    visibleInstances.clear();
+    count = 0;
+}
+
+void SceneStore::setPosition(uint32_t index, float x, float y, float z) {
+    positionX[index] = x;
+    positionY[index] = y;
+    positionZ[index] = z;
+}
+
+void SceneStore::setRotation(uint32_t index, float x, float y, float z, float w) {
+    rotationX[index] = x;
+    rotationY[index] = y;
+    rotationZ[index] = z;
+    rotationW[index] = w;
+}
+
+void SceneStore::setScale(uint32_t index, float x, float y, float z) {
+    scaleX[index] = x;
+    scaleY[index] = y;
+    scaleZ[index] = z;
+}
+
+void SceneStore::setBounds(uint32_t index, float x, float y, float z, float radius) {
+    boundsX[index] = x;
+    boundsY[index] = y;
+    boundsZ[index] = z;
+    boundsRadius[index] = radius;
+}
+
+void SceneStore::setMesh(uint32_t index, uint32_t mesh) {
+    meshes[index] = mesh;
+}
+
+void SceneStore::updateTransforms() {
+    updateLocalTransforms(0, count);
+    resolveHierarchy();
+}
+
+void SceneStore::updateLocalTransforms(size_t begin, size_t end) {
+    float* const worldRows[12] = { world[0].data(), world[1].data(), world[2].data(), world[3].data(), world[4].data(), world[5].data(),
+        world[6].data(), world[7].data(), world[8].data(), world[9].data(), world[10].data(), world[11].data() };
+    getSceneKernels().composeTransforms(getKernelArrays(), worldRows, begin, end);
+}
+
+void SceneStore::resolveHierarchy() {
+    // Parents precede their children, so their world transform is final when a child is reached
+    for (uint32_t child : children) {
+        uint32_t parent = static_cast<uint32_t>(parents[child]);
+
+        float local[12];
+        float parentWorld[12];
+        for (size_t k = 0; k < 12; k++) {
+            local[k] = world[k][child];
+            parentWorld[k] = world[k][parent];
+        }
+
+        for (size_t row = 0; row < 3; row++) {
+            const float* p = &parentWorld[row * 4];
+            for (size_t column = 0; column < 4; column++) {
+                float value = p[0] * local[column] + p[1] * local[4 + column] + p[2] * local[8 + column];
+                world[row * 4 + column][child] = column == 3 ? value + p[3] : value;
+            }
+        }
+    }
+}
+
+void SceneStore::cull(const float viewProj[16]) {
+    float planes[6][4];
+    extractFrustumPlanes(viewProj, planes);
+
+    visibleInstances.clear();
+    visibleInstances.reserve(count);
+    cullRange(planes, 0, count, visibleInstances);
+}
+
+/**
+    * Planes of a column-major view-projection matrix with zero-to-one depth, pointing inwards
+    **/
+void SceneStore::extractFrustumPlanes(const float viewProj[16], float planes[6][4]) {
+    for (size_t i = 0; i < 4; i++) {
+        float row0 = viewProj[i * 4 + 0];
+        float row1 = viewProj[i * 4 + 1];
+        float row2 = viewProj[i * 4 + 2];
+        float row3 = viewProj[i * 4 + 3];
+        planes[0][i] = row3 + row0;
+        planes[1][i] = row3 - row0;
+        planes[2][i] = row3 + row1;
+        planes[3][i] = row3 - row1;
+        planes[4][i] = row2;
+        planes[5][i] = row3 - row2;
+    }
+    for (size_t p = 0; p < 6; p++) {
+        float length = std::sqrt(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+        for (size_t i = 0; i < 4; i++) {
+            planes[p][i] /= length;
+        }
+    }
+}
+
+/**
+    * Tests the world bounding spheres of [begin, end) against the frustum planes and appends
+    * the indices of the visible ones
+    **/
+void SceneStore::cullRange(const float planes[6][4], size_t begin, size_t end, std::vector<uint32_t>& visible) const {
+    if (begin >= end) {
+        return;
+    }
+    size_t first = visible.size();
+    visible.resize(first + (end - begin));
+    size_t visibleCount = getSceneKernels().cullSpheres(getKernelArrays(), planes, begin, end, visible.data() + first);
+    visible.resize(first + visibleCount);
+}
+
+void SceneStore::computeWorldSpheres(size_t begin, size_t end, float* x, float* y, float* z, float* radius) const {
+    getSceneKernels().worldSpheres(getKernelArrays(), begin, end, x, y, z, radius);
+}
+
+SceneKernelArrays SceneStore::getKernelArrays() const {
+    SceneKernelArrays arrays = { positionX.data(), positionY.data(), positionZ.data(), rotationX.data(), rotationY.data(), rotationZ.data(), rotationW.data(),
+        scaleX.data(), scaleY.data(), scaleZ.data(), boundsX.data(), boundsY.data(), boundsZ.data(), boundsRadius.data(), {} };
+    for (size_t k = 0; k < 12; k++) {
+        arrays.world[k] = world[k].data();
+    }
+    return arrays;
+}
+
+void SceneStore::writeWorldMatrix(uint32_t index, float out[16]) const {
+    // Column-major, matching glm::mat4
+    for (size_t column = 0; column < 4; column++) {
+        for (size_t row = 0; row < 3; row++) {
+            out[column * 4 + row] = world[row * 4 + column][index];
+        }
+        out[column * 4 + 3] = column == 3 ? 1.0f : 0.0f;
+    }
+}
\ No newline at end of file
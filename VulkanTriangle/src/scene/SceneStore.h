@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "SceneKernels.h"
+
+// Scene objects without a mesh draw the hardcoded triangle
+const uint32_t NO_MESH = UINT32_MAX;
+
+/**
+    * Structure-of-arrays store of scene object transforms and bounds. Objects are kept in
+    * topological order (a parent is always added before its children) so the hierarchy is
+    * resolved with a single forward pass after the SIMD local transform composition, see
+    * SceneKernels.
+    **/
+class SceneStore {
+public:
+	uint32_t addObject(int32_t parent = -1);
+	void clear();
+
+	void setPosition(uint32_t index, float x, float y, float z);
+	void setRotation(uint32_t index, float x, float y, float z, float w);
+	void setScale(uint32_t index, float x, float y, float z);
+	void setBounds(uint32_t index, float x, float y, float z, float radius);
+	void setMesh(uint32_t index, uint32_t mesh);
+
+	void updateTransforms();
+	void cull(const float viewProj[16]);
+	void writeWorldMatrix(uint32_t index, float out[16]) const;
+
+	// Range kernels used to split the work across jobs, ranges start on a multiple of 8
+	void updateLocalTransforms(size_t begin, size_t end);
+	void resolveHierarchy();
+	void cullRange(const float planes[6][4], size_t begin, size_t end, std::vector<uint32_t>& visible) const;
+	// World bounding spheres of [begin, end), written at the same indices of arrays padded like the store
+	void computeWorldSpheres(size_t begin, size_t end, float* x, float* y, float* z, float* radius) const;
+	static void extractFrustumPlanes(const float viewProj[16], float planes[6][4]);
+
+	uint32_t size() const {
+		return count;
+	}
+
+	// Local transform, rotation is a unit quaternion
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+
+	// Local bounding sphere
+	std::vector<float> boundsX, boundsY, boundsZ, boundsRadius;
+
+	// Index into VulkanEngine::meshes or NO_MESH, not padded since only the draw path reads it
+	std::vector<uint32_t> meshes;
+
+	std::vector<int32_t> parents;
+	std::vector<uint32_t> children;
+
+	// World transforms, the 3 rows of an affine matrix stored as 12 component arrays
+	std::array<std::vector<float>, 12> world;
+
+	// Output of cull(), consumed by the draw path
+	std::vector<uint32_t> visibleInstances;
+
+private:
+	SceneKernelArrays getKernelArrays() const;
+
+	uint32_t count = 0;
+};
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+    * Minimal float vector wrapper used by the scene kernels. AVX2 processes 8 lanes,
+    * NEON 4 lanes, and the scalar fallback 1 lane, behind the same inline functions.
+    * Each variant lives in its own inline namespace: translation units built for different
+    * instruction sets link together without their inline functions being merged.
+    **/
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+inline namespace SimdAvx2 {
+
+typedef __m256 SimdFloat;
+const uint32_t SIMD_WIDTH = 8;
+
+inline SimdFloat simdLoad(const float* p) { return _mm256_loadu_ps(p); }
+inline void simdStore(float* p, SimdFloat v) { _mm256_storeu_ps(p, v); }
+inline SimdFloat simdSet(float f) { return _mm256_set1_ps(f); }
+inline SimdFloat simdAdd(SimdFloat a, SimdFloat b) { return _mm256_add_ps(a, b); }
+inline SimdFloat simdSub(SimdFloat a, SimdFloat b) { return _mm256_sub_ps(a, b); }
+inline SimdFloat simdMul(SimdFloat a, SimdFloat b) { return _mm256_mul_ps(a, b); }
+inline SimdFloat simdMulAdd(SimdFloat a, SimdFloat b, SimdFloat c) { return _mm256_fmadd_ps(a, b, c); }
+inline SimdFloat simdMin(SimdFloat a, SimdFloat b) { return _mm256_min_ps(a, b); }
+inline SimdFloat simdMax(SimdFloat a, SimdFloat b) { return _mm256_max_ps(a, b); }
+inline SimdFloat simdSqrt(SimdFloat a) { return _mm256_sqrt_ps(a); }
+// One bit per lane, set where a > b
+inline uint32_t simdGreaterMask(SimdFloat a, SimdFloat b) { return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ))); }
+
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+
+inline namespace SimdNeon {
+
+typedef float32x4_t SimdFloat;
+const uint32_t SIMD_WIDTH = 4;
+
+inline SimdFloat simdLoad(const float* p) { return vld1q_f32(p); }
+inline void simdStore(float* p, SimdFloat v) { vst1q_f32(p, v); }
+inline SimdFloat simdSet(float f) { return vdupq_n_f32(f); }
+inline SimdFloat simdAdd(SimdFloat a, SimdFloat b) { return vaddq_f32(a, b); }
+inline SimdFloat simdSub(SimdFloat a, SimdFloat b) { return vsubq_f32(a, b); }
+inline SimdFloat simdMul(SimdFloat a, SimdFloat b) { return vmulq_f32(a, b); }
+inline SimdFloat simdMulAdd(SimdFloat a, SimdFloat b, SimdFloat c) { return vfmaq_f32(c, a, b); }
+inline SimdFloat simdMin(SimdFloat a, SimdFloat b) { return vminq_f32(a, b); }
+inline SimdFloat simdMax(SimdFloat a, SimdFloat b) { return vmaxq_f32(a, b); }
+inline SimdFloat simdSqrt(SimdFloat a) { return vsqrtq_f32(a); }
+inline uint32_t simdGreaterMask(SimdFloat a, SimdFloat b) {
+    const uint32x4_t laneBits = { 1, 2, 4, 8 };
+    return vaddvq_u32(vandq_u32(vcgtq_f32(a, b), laneBits));
+}
+
+}
+
+#else
+#include <cmath>
+
+inline namespace SimdScalar {
+
+typedef float SimdFloat;
+const uint32_t SIMD_WIDTH = 1;
+
+inline SimdFloat simdLoad(const float* p) { return *p; }
+inline void simdStore(float* p, SimdFloat v) { *p = v; }
+inline SimdFloat simdSet(float f) { return f; }
+inline SimdFloat simdAdd(SimdFloat a, SimdFloat b) { return a + b; }
+inline SimdFloat simdSub(SimdFloat a, SimdFloat b) { return a - b; }
+inline SimdFloat simdMul(SimdFloat a, SimdFloat b) { return a * b; }
+inline SimdFloat simdMulAdd(SimdFloat a, SimdFloat b, SimdFloat c) { return a * b + c; }
+inline SimdFloat simdMin(SimdFloat a, SimdFloat b) { return a < b ? a : b; }
+inline SimdFloat simdMax(SimdFloat a, SimdFloat b) { return a > b ? a : b; }
+inline SimdFloat simdSqrt(SimdFloat a) { return std::sqrt(a); }
+inline uint32_t simdGreaterMask(SimdFloat a, SimdFloat b) { return a > b ? 1u : 0u; }
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,234 @@
+#include "RenderChannel.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Yields before sleeping while waiting on a slot, most jobs are done within that many polls
+const uint32_t RENDER_CHANNEL_SPIN_COUNT = 256;
+const std::chrono::microseconds RENDER_CHANNEL_SLEEP(50);
+
+#ifdef _WIN32
+
+RenderChannel::RenderChannel(bool server) : server(server) {
+    std::string name = std::string("Local\\") + RENDER_CHANNEL_NAME;
+    if (server) {
+        uint64_t size = sizeof(RenderChannelLayout);
+        mappingHandle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), name.c_str());
+        if (mappingHandle != nullptr && GetLastError() == ERROR_ALREADY_EXISTS) {
+            CloseHandle(mappingHandle);
+            throw std::runtime_error("a render server is already running!");
+        }
+    }
+    else {
+        mappingHandle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+    }
+    if (mappingHandle == nullptr) {
+        throw std::runtime_error(server ? "failed to create render channel!" : "no render server running!");
+    }
+
+    mapped = static_cast<RenderChannelLayout*>(MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(RenderChannelLayout)));
+    if (mapped == nullptr) {
+        CloseHandle(mappingHandle);
+        throw std::runtime_error("failed to map render channel!");
+    }
+
+    if (server) {
+        new (mapped) RenderChannelLayout();
+        mapped->magic = RENDER_CHANNEL_MAGIC;
+        mapped->version = RENDER_CHANNEL_VERSION;
+        mapped->serverProcess = static_cast<uint32_t>(GetCurrentProcessId());
+        mapped->serverRunning.store(1, std::memory_order_release);
+    }
+    else if (mapped->magic != RENDER_CHANNEL_MAGIC || mapped->version != RENDER_CHANNEL_VERSION) {
+        UnmapViewOfFile(mapped);
+        CloseHandle(mappingHandle);
+        throw std::runtime_error("render channel version mismatch!");
+    }
+}
+
+RenderChannel::~RenderChannel() {
+    if (server) {
+        mapped->serverRunning.store(0, std::memory_order_release);
+    }
+    UnmapViewOfFile(mapped);
+    CloseHandle(mappingHandle);
+}
+
+#else
+
+/**
+    * A segment outlives a server that crashed. It is stale unless it names a live server process,
+    * segments too small to hold the header or of another version are stale as well
+    **/
+static bool isStaleChannel(const std::string& name) {
+    int existing = shm_open(name.c_str(), O_RDONLY, 0);
+    if (existing < 0) {
+        return errno == ENOENT;
+    }
+
+    bool stale = true;
+    struct stat status;
+    size_t headerSize = offsetof(RenderChannelLayout, serverRunning);
+    if (fstat(existing, &status) == 0 && static_cast<size_t>(status.st_size) >= headerSize) {
+        void* address = mmap(nullptr, headerSize, PROT_READ, MAP_SHARED, existing, 0);
+        if (address != MAP_FAILED) {
+            const RenderChannelLayout* header = static_cast<const RenderChannelLayout*>(address);
+            if (header->magic == RENDER_CHANNEL_MAGIC && header->version == RENDER_CHANNEL_VERSION && header->serverProcess != 0) {
+                pid_t process = static_cast<pid_t>(header->serverProcess);
+                stale = kill(process, 0) != 0 && errno == ESRCH;
+            }
+            munmap(address, headerSize);
+        }
+    }
+    close(existing);
+    return stale;
+}
+
+RenderChannel::RenderChannel(bool server) : server(server) {
+    std::string name = std::string("/") + RENDER_CHANNEL_NAME;
+    if (server) {
+        descriptor = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (descriptor < 0 && errno == EEXIST && isStaleChannel(name)) {
+            shm_unlink(name.c_str());
+            descriptor = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        }
+    }
+    else {
+        descriptor = shm_open(name.c_str(), O_RDWR, 0);
+    }
+    if (descriptor < 0) {
+        throw std::runtime_error(server ? "failed to create render channel, is a render server already running?" : "no render server running!");
+    }
+
+    if (server && ftruncate(descriptor, sizeof(RenderChannelLayout)) != 0) {
+        close(descriptor);
+        shm_unlink(name.c_str());
+        throw std::runtime_error("failed to size render channel!");
+    }
+
+    void* address = mmap(nullptr, sizeof(RenderChannelLayout), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    if (address == MAP_FAILED) {
+        close(descriptor);
+        if (server) {
+            shm_unlink(name.c_str());
+        }
+        throw std::runtime_error("failed to map render channel!");
+    }
+    mapped = static_cast<RenderChannelLayout*>(address);
+
+    if (server) {
+        new (mapped) RenderChannelLayout();
+        mapped->magic = RENDER_CHANNEL_MAGIC;
+        mapped->version = RENDER_CHANNEL_VERSION;
+        mapped->serverProcess = static_cast<uint32_t>(getpid());
+        mapped->serverRunning.store(1, std::memory_order_release);
+    }
+    else if (mapped->magic != RENDER_CHANNEL_MAGIC || mapped->version != RENDER_CHANNEL_VERSION) {
+        munmap(mapped, sizeof(RenderChannelLayout));
+        close(descriptor);
+        throw std::runtime_error("render channel version mismatch!");
+    }
+}
+
+RenderChannel::~RenderChannel() {
+    if (server) {
+        mapped->serverRunning.store(0, std::memory_order_release);
+        shm_unlink((std::string("/") + RENDER_CHANNEL_NAME).c_str());
+    }
+    munmap(mapped, sizeof(RenderChannelLayout));
+    close(descriptor);
+}
+
+#endif
+
+bool RenderChannel::render(const RenderJobRequest& request, std::vector<uint8_t>& pixels) {
+    if (request.width == 0 || request.height == 0 || request.width > RENDER_JOB_MAX_WIDTH || request.height > RENDER_JOB_MAX_HEIGHT) {
+        throw std::runtime_error("render job size out of range!");
+    }
+
+    // Claim any free slot, waiting for one when every slot is in flight
+    RenderSlot* slot = nullptr;
+    for (uint32_t attempt = 0;; attempt++) {
+        if (mapped->serverRunning.load(std::memory_order_acquire) == 0) {
+            throw std::runtime_error("render server stopped!");
+        }
+        for (RenderSlot& candidate : mapped->slots) {
+            uint32_t expected = static_cast<uint32_t>(RenderSlotState::Free);
+            if (candidate.state.compare_exchange_strong(expected, static_cast<uint32_t>(RenderSlotState::Writing), std::memory_order_acquire)) {
+                slot = &candidate;
+                break;
+            }
+        }
+        if (slot != nullptr) {
+            break;
+        }
+        if (attempt < RENDER_CHANNEL_SPIN_COUNT) {
+            std::this_thread::yield();
+        }
+        else {
+            std::this_thread::sleep_for(RENDER_CHANNEL_SLEEP);
+        }
+    }
+
+    slot->request = request;
+    slot->state.store(static_cast<uint32_t>(RenderSlotState::Submitted), std::memory_order_release);
+
+    uint32_t state;
+    for (uint32_t attempt = 0;; attempt++) {
+        state = slot->state.load(std::memory_order_acquire);
+        if (state == static_cast<uint32_t>(RenderSlotState::Done) || state == static_cast<uint32_t>(RenderSlotState::Failed)) {
+            break;
+        }
+        // The slot is abandoned if the server goes away, it recreates the channel anyway
+        if (mapped->serverRunning.load(std::memory_order_acquire) == 0) {
+            return false;
+        }
+        if (attempt < RENDER_CHANNEL_SPIN_COUNT) {
+            std::this_thread::yield();
+        }
+        else {
+            std::this_thread::sleep_for(RENDER_CHANNEL_SLEEP);
+        }
+    }
+
+    bool success = state == static_cast<uint32_t>(RenderSlotState::Done);
+    if (success) {
+        pixels.assign(slot->pixels, slot->pixels + static_cast<size_t>(request.width) * request.height * 4);
+    }
+    slot->state.store(static_cast<uint32_t>(RenderSlotState::Free), std::memory_order_release);
+    return success;
+}
+
+void RenderChannel::collect(std::vector<uint32_t>& slots) {
+    for (uint32_t i = 0; i < RENDER_CHANNEL_SLOTS; i++) {
+        uint32_t expected = static_cast<uint32_t>(RenderSlotState::Submitted);
+        if (mapped->slots[i].state.compare_exchange_strong(expected, static_cast<uint32_t>(RenderSlotState::Rendering), std::memory_order_acquire)) {
+            slots.push_back(i);
+        }
+    }
+}
+
+void RenderChannel::complete(uint32_t slot, bool success) {
+    if (success) {
+        mapped->completedJobs.fetch_add(1, std::memory_order_relaxed);
+    }
+    mapped->slots[slot].state.store(static_cast<uint32_t>(success ? RenderSlotState::Done : RenderSlotState::Failed), std::memory_order_release);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Shared memory object both the render server and its clients map
+const char* const RENDER_CHANNEL_NAME = "VulkanTriangleRenderJobs";
+const uint32_t RENDER_CHANNEL_MAGIC = 0x4A52544B; // "KTRJ"
+const uint32_t RENDER_CHANNEL_VERSION = 2;
+// Jobs in flight at most, also the largest batch the server submits at once
+const uint32_t RENDER_CHANNEL_SLOTS = 32;
+const uint32_t RENDER_JOB_MAX_WIDTH = 256;
+const uint32_t RENDER_JOB_MAX_HEIGHT = 256;
+// RGBA8 result of a job of the largest size
+const size_t RENDER_JOB_MAX_PIXEL_BYTES = RENDER_JOB_MAX_WIDTH * RENDER_JOB_MAX_HEIGHT * 4;
+
+// Column major matrices, as in CameraUniforms
+struct RenderJobRequest {
+	float view[16];
+	float proj[16];
+	float clearColor[4];
+	uint32_t width;
+	uint32_t height;
+};
+
+// Free -> Writing (client) -> Submitted (client) -> Rendering (server) -> Done or Failed (server) -> Free (client)
+enum class RenderSlotState : uint32_t {
+	Free,
+	Writing,
+	Submitted,
+	Rendering,
+	Done,
+	Failed
+};
+
+struct RenderSlot {
+	std::atomic<uint32_t> state;
+	RenderJobRequest request;
+	uint8_t pixels[RENDER_JOB_MAX_PIXEL_BYTES];
+};
+
+struct RenderChannelLayout {
+	uint32_t magic;
+	uint32_t version;
+	// Process id of the server, a segment left behind by a server that died is recreated
+	uint32_t serverProcess;
+	std::atomic<uint32_t> serverRunning;
+	std::atomic<uint64_t> completedJobs;
+	RenderSlot slots[RENDER_CHANNEL_SLOTS];
+};
+
+// The layout is shared between processes, its atomics can not rely on a lock
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free, "render channel atomics must be lock free");
+
+/**
+    * Render jobs and their results exchanged through shared memory between local processes.
+    * Clients claim a free slot, write their request and wait for the server to fill in the
+    * pixels; the server collects every submitted slot at once so concurrent jobs share a
+    * submission. Slot states are the only synchronization, no data is copied through the kernel.
+    **/
+class RenderChannel {
+public:
+	// The server creates the shared memory, clients open it and throw if there is no server
+	explicit RenderChannel(bool server);
+	~RenderChannel();
+
+	RenderChannel(const RenderChannel&) = delete;
+	RenderChannel& operator=(const RenderChannel&) = delete;
+
+	// Client side, blocks until the job is rendered. Returns false when the server failed it
+	bool render(const RenderJobRequest& request, std::vector<uint8_t>& pixels);
+
+	// Server side, moves every submitted slot to Rendering and appends its index
+	void collect(std::vector<uint32_t>& slots);
+	void complete(uint32_t slot, bool success);
+
+	RenderChannelLayout* layout() const {
+		return mapped;
+	}
+
+private:
+	bool server;
+	RenderChannelLayout* mapped = nullptr;
+#ifdef _WIN32
+	void* mappingHandle = nullptr;
+#else
+	int descriptor = -1;
+#endif
+};
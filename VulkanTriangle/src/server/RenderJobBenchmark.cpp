@@ -0,0 +1,67 @@
+#include "RenderJobBenchmark.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+const uint32_t RENDER_BENCHMARK_JOB_SIZE = 128;
+// Each baseline job pays a whole process start, engine initialization and teardown
+const uint32_t RENDER_BENCHMARK_BASELINE_RUNS = 10;
+
+RenderJobRequest RenderJobBenchmark::defaultRequest() {
+    RenderJobRequest request{};
+    for (int i = 0; i < 4; i++) {
+        request.view[i * 5] = 1.0f;
+        request.proj[i * 5] = 1.0f;
+    }
+    request.clearColor[3] = 1.0f;
+    request.width = RENDER_BENCHMARK_JOB_SIZE;
+    request.height = RENDER_BENCHMARK_JOB_SIZE;
+    return request;
+}
+
+/**
+    * Throughput of the render server against one process per job. Every client thread maps the
+    * channel on its own and keeps one job in flight, as separate client processes would.
+    **/
+void RenderJobBenchmark::run(const std::string& executable, uint32_t clientCount, uint32_t jobsPerClient) {
+    std::cout << "Render job benchmark, " << clientCount << " clients, " << jobsPerClient << " jobs each, "
+        << RENDER_BENCHMARK_JOB_SIZE << "x" << RENDER_BENCHMARK_JOB_SIZE << "\n";
+
+    std::atomic<uint32_t> failedJobs{ 0 };
+    std::vector<std::thread> clients;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < clientCount; i++) {
+        clients.emplace_back([jobsPerClient, &failedJobs]() {
+            RenderChannel channel(false);
+            RenderJobRequest request = defaultRequest();
+            std::vector<uint8_t> pixels;
+            for (uint32_t job = 0; job < jobsPerClient; job++) {
+                if (!channel.render(request, pixels)) {
+                    failedJobs++;
+                }
+            }
+        });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    double serverSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    double serverRate = clientCount * jobsPerClient / serverSeconds;
+    std::cout << "server: " << serverRate << " jobs/s (" << failedJobs.load() << " failed)" << "\n";
+
+    std::string command = "\"" + executable + "\" --render-once";
+    start = std::chrono::high_resolution_clock::now();
+    for (uint32_t run = 0; run < RENDER_BENCHMARK_BASELINE_RUNS; run++) {
+        if (std::system(command.c_str()) != 0) {
+            throw std::runtime_error("baseline render job failed!");
+        }
+    }
+    double baselineSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    double baselineRate = RENDER_BENCHMARK_BASELINE_RUNS / baselineSeconds;
+    std::cout << "process per job: " << baselineRate << " jobs/s, server is " << serverRate / baselineRate << "x faster" << "\n";
+}
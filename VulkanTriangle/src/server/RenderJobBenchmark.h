@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "RenderChannel.h"
+
+class RenderJobBenchmark {
+public:
+	// Needs a running render server, executable is started once per baseline job with --render-once
+	static void run(const std::string& executable, uint32_t clientCount, uint32_t jobsPerClient);
+	// Identity camera over the default scene, as the windowed engine draws it
+	static RenderJobRequest defaultRequest();
+};
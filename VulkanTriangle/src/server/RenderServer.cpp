@@ -0,0 +1,356 @@
+#include "RenderServer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#include "../Utils.h"
+
+void RenderServer::create(VulkanEngine& vkEngine) {
+    this->vkEngine = &vkEngine;
+    // Culls the scene of every job
+    vkEngine.jobSystem.start(std::max(2u, std::thread::hardware_concurrency()) - 1);
+
+    // Same format as the render pass, transfer source for the readback
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = RENDER_JOB_MAX_WIDTH;
+    imageInfo.extent.height = RENDER_JOB_MAX_HEIGHT;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = vkEngine.colorFormat;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkd.vkCreateImage(vkEngine.device, &imageInfo, nullptr, image.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render job target!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkd.vkGetImageMemoryRequirements(vkEngine.device, image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = Utils::findMemoryType(vkEngine, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if (vkd.vkAllocateMemory(vkEngine.device, &allocInfo, nullptr, imageMemory.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate render job target memory!");
+    }
+    vkd.vkBindImageMemory(vkEngine.device, image, imageMemory, 0);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = vkEngine.colorFormat;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkd.vkCreateImageView(vkEngine.device, &viewInfo, nullptr, imageView.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render job target view!");
+    }
+
+    if (!vkEngine.dynamicRendering) {
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = vkEngine.renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = imageView.address();
+        framebufferInfo.width = RENDER_JOB_MAX_WIDTH;
+        framebufferInfo.height = RENDER_JOB_MAX_HEIGHT;
+        framebufferInfo.layers = 1;
+
+        if (vkd.vkCreateFramebuffer(vkEngine.device, &framebufferInfo, nullptr, framebuffer.put(vkEngine.device)) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render job framebuffer!");
+        }
+    }
+
+    // One region per job of a batch, mapped once
+    Utils::createBuffer(vkEngine, RENDER_JOB_MAX_PIXEL_BYTES * RENDER_CHANNEL_SLOTS, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, *readbackBuffer.put(vkEngine.device), *readbackMemory.put(vkEngine.device));
+    if (vkd.vkMapMemory(vkEngine.device, readbackMemory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&readbackMapped)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map render job readback buffer!");
+    }
+
+    VkCommandBufferAllocateInfo commandBufferInfo{};
+    commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferInfo.commandPool = vkEngine.commandPool;
+    commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferInfo.commandBufferCount = 1;
+
+    if (vkd.vkAllocateCommandBuffers(vkEngine.device, &commandBufferInfo, &commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate render job command buffer!");
+    }
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    if (vkd.vkCreateFence(vkEngine.device, &fenceInfo, nullptr, fence.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render job fence!");
+    }
+}
+
+void RenderServer::destroy(VkDevice device) {
+    vkEngine->jobSystem.stop();
+    fence.reset();
+    vkd.vkFreeCommandBuffers(device, vkEngine->commandPool, 1, &commandBuffer);
+    vkd.vkUnmapMemory(device, readbackMemory);
+    readbackBuffer.reset();
+    readbackMemory.reset();
+    framebuffer.reset();
+    imageView.reset();
+    image.reset();
+    imageMemory.reset();
+}
+
+void RenderServer::serve(RenderChannel& channel, const std::atomic<bool>& running) {
+    statsStart = std::chrono::steady_clock::now();
+
+    while (running.load(std::memory_order_relaxed)) {
+        // Jobs submitted while the previous batch rendered all go in the next one
+        slots.clear();
+        channel.collect(slots);
+        if (slots.empty()) {
+            std::this_thread::sleep_for(RENDER_SERVER_IDLE_SLEEP);
+            continue;
+        }
+
+        batch.resize(slots.size());
+        for (size_t i = 0; i < slots.size(); i++) {
+            RenderSlot& slot = channel.layout()->slots[slots[i]];
+            batch[i].request = slot.request;
+            batch[i].pixels = slot.pixels;
+            batch[i].success = false;
+        }
+        renderBatch(batch);
+        for (size_t i = 0; i < slots.size(); i++) {
+            channel.complete(slots[i], batch[i].success);
+        }
+
+        statsJobs += batch.size();
+        if (statsJobs >= RENDER_SERVER_STATS_INTERVAL) {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - statsStart).count();
+            std::cout << "render server: " << statsJobs / seconds << " jobs/s, " << static_cast<double>(statsJobs) / statsSubmissions
+                << " jobs per submission" << "\n";
+            statsJobs = 0;
+            statsSubmissions = 0;
+            statsStart = std::chrono::steady_clock::now();
+        }
+    }
+}
+
+void RenderServer::renderBatch(std::vector<RenderJob>& jobs) {
+    if (jobs.size() > RENDER_CHANNEL_SLOTS) {
+        throw std::runtime_error("too many render jobs in a batch!");
+    }
+
+    pendingJobs.clear();
+    for (size_t i = 0; i < jobs.size(); i++) {
+        RenderJob& job = jobs[i];
+        const RenderJobRequest& request = job.request;
+        if (request.width == 0 || request.height == 0 || request.width > RENDER_JOB_MAX_WIDTH || request.height > RENDER_JOB_MAX_HEIGHT) {
+            job.success = false;
+            continue;
+        }
+
+        CameraUniforms view;
+        memcpy(&view.view[0][0][0], request.view, sizeof(request.view));
+        memcpy(&view.proj[0][0][0], request.proj, sizeof(request.proj));
+        vkEngine->buildDrawList(view, request.height, drawList);
+
+        // The camera and every draw take a push, submit what is recorded when the ring is full
+        if (!recording) {
+            beginCommands();
+        }
+        VkDeviceSize pushes = drawList.size() + 1;
+        if (vkEngine->uniformRing.available(sizeof(CameraUniforms)) < pushes && !pendingJobs.empty()) {
+            submitAndRead(jobs);
+            beginCommands();
+        }
+        if (vkEngine->uniformRing.available(sizeof(CameraUniforms)) < pushes) {
+            job.success = false;
+            continue;
+        }
+
+        recordJob(job, static_cast<uint32_t>(pendingJobs.size()));
+        pendingJobs.push_back(i);
+    }
+
+    if (recording) {
+        submitAndRead(jobs);
+    }
+}
+
+void RenderServer::beginCommands() {
+    // The fence was waited on after the previous submission, the ring region is free
+    vkEngine->uniformRing.beginFrame(0);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkd.vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording render job command buffer!");
+    }
+    recording = true;
+}
+
+void RenderServer::recordJob(const RenderJob& job, uint32_t readbackIndex) {
+    const RenderJobRequest& request = job.request;
+    VkExtent2D extent = { request.width, request.height };
+
+    VkRect2D renderArea{};
+    renderArea.offset = { 0, 0 };
+    renderArea.extent = extent;
+    VkClearValue clearColor = { { { request.clearColor[0], request.clearColor[1], request.clearColor[2], request.clearColor[3] } } };
+
+    if (vkEngine->dynamicRendering) {
+        // The previous job's readback has to be done before the target is cleared
+        recordTargetBarrier(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_NONE,
+            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+
+        VkRenderingAttachmentInfo colorAttachment{};
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        colorAttachment.imageView = imageView;
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.clearValue = clearColor;
+
+        VkRenderingInfo renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.renderArea = renderArea;
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+        vkd.vkCmdBeginRendering(commandBuffer, &renderingInfo);
+    }
+    else {
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = vkEngine->renderPass;
+        renderPassInfo.framebuffer = framebuffer;
+        renderPassInfo.renderArea = renderArea;
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearColor;
+        vkd.vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    }
+    Utils::setViewport(commandBuffer, extent);
+
+    CameraUniforms camera;
+    memcpy(&camera.view[0][0][0], request.view, sizeof(request.view));
+    memcpy(&camera.proj[0][0][0], request.proj, sizeof(request.proj));
+    uint32_t cameraOffset = vkEngine->uniformRing.push(camera);
+
+    VkDeviceSize offsets[] = { 0 };
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    uint32_t boundMesh = NO_MESH;
+    for (const DrawCommand& draw : drawList) {
+        VkPipeline pipeline = draw.mesh == NO_MESH ? vkEngine->graphicsPipeline : vkEngine->meshPipeline;
+        if (pipeline != boundPipeline) {
+            vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            boundPipeline = pipeline;
+        }
+        if (draw.mesh != NO_MESH && draw.mesh != boundMesh) {
+            const Mesh& mesh = vkEngine->meshes[draw.mesh];
+            vkd.vkCmdBindVertexBuffers(commandBuffer, 0, 1, mesh.vertexBuffer.address(), offsets);
+            vkd.vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, mesh.indexType);
+            boundMesh = draw.mesh;
+        }
+
+        uint32_t dynamicOffsets[] = { cameraOffset, vkEngine->uniformRing.push(draw.uniforms) };
+        vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkEngine->pipelineLayout, 0, 1, &vkEngine->descriptorSet, 2, dynamicOffsets);
+        vkd.vkCmdPushConstants(commandBuffer, vkEngine->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawPushConstants), &draw.pushConstants);
+        if (draw.mesh == NO_MESH) {
+            vkd.vkCmdDraw(commandBuffer, draw.vertexCount, 1, 0, 0);
+        }
+        else {
+            const MeshLod& lod = vkEngine->meshes[draw.mesh].lods[draw.lod];
+            vkd.vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, lod.firstIndex, 0, 0);
+        }
+    }
+
+    if (vkEngine->dynamicRendering) {
+        vkd.vkCmdEndRendering(commandBuffer);
+        recordTargetBarrier(VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+    }
+    else {
+        vkd.vkCmdEndRenderPass(commandBuffer);
+    }
+
+    // The target is left in TRANSFER_SRC_OPTIMAL, the next job waits for this copy
+    VkBufferImageCopy region{};
+    region.bufferOffset = static_cast<VkDeviceSize>(readbackIndex) * RENDER_JOB_MAX_PIXEL_BYTES;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageOffset = { 0, 0, 0 };
+    region.imageExtent = { request.width, request.height, 1 };
+    vkd.vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &region);
+}
+
+void RenderServer::recordTargetBarrier(VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess,
+    VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess) {
+    VkImageMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = srcStage;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstStageMask = dstStage;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    VkDependencyInfo dependencyInfo{};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.imageMemoryBarrierCount = 1;
+    dependencyInfo.pImageMemoryBarriers = &barrier;
+    vkd.vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+void RenderServer::submitAndRead(std::vector<RenderJob>& jobs) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    if (vkd.vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record render job command buffer!");
+    }
+    recording = false;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    if (vkd.vkQueueSubmit(vkEngine->graphicsQueue, 1, &submitInfo, fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit render jobs!");
+    }
+    vkd.vkWaitForFences(vkEngine->device, 1, fence.address(), VK_TRUE, UINT64_MAX);
+    vkd.vkResetFences(vkEngine->device, 1, fence.address());
+    statsSubmissions++;
+
+    for (size_t i = 0; i < pendingJobs.size(); i++) {
+        RenderJob& job = jobs[pendingJobs[i]];
+        memcpy(job.pixels, readbackMapped + i * RENDER_JOB_MAX_PIXEL_BYTES, static_cast<size_t>(job.request.width) * job.request.height * 4);
+        job.success = true;
+    }
+    pendingJobs.clear();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "RenderChannel.h"
+#include "../VulkanEngine.h"
+
+// Jobs completed between two throughput reports of the server
+const uint32_t RENDER_SERVER_STATS_INTERVAL = 1000;
+const std::chrono::microseconds RENDER_SERVER_IDLE_SLEEP(100);
+
+struct RenderJob {
+	// Copied out of the channel, clients can not change it while it renders
+	RenderJobRequest request;
+	uint8_t* pixels = nullptr;
+	bool success = false;
+};
+
+/**
+    * Renders jobs on a warm engine, typically a headless one: device, pipelines and meshes are
+    * created once and every job only costs its draws. A batch of jobs is recorded into a single
+    * command buffer and submission, each job rendering to the top left of the same target and
+    * being copied to its own region of a mapped readback buffer right after its render pass.
+    **/
+class RenderServer {
+public:
+	// Starts the engine job system on the calling thread, which has to be the one rendering
+	void create(VulkanEngine& vkEngine);
+	void destroy(VkDevice device);
+
+	// Serves the channel until running is cleared, batching every job submitted meanwhile
+	void serve(RenderChannel& channel, const std::atomic<bool>& running);
+	// At most RENDER_CHANNEL_SLOTS jobs, sets the success of each one
+	void renderBatch(std::vector<RenderJob>& jobs);
+
+private:
+	void beginCommands();
+	void recordJob(const RenderJob& job, uint32_t readbackIndex);
+	void submitAndRead(std::vector<RenderJob>& jobs);
+	// Layout transitions of the target done by the render pass on the other path
+	void recordTargetBarrier(VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess,
+		VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess);
+
+	VulkanEngine* vkEngine = nullptr;
+	UniqueImage image;
+	UniqueDeviceMemory imageMemory;
+	UniqueImageView imageView;
+	// Render pass path only
+	UniqueFramebuffer framebuffer;
+	UniqueBuffer readbackBuffer;
+	UniqueDeviceMemory readbackMemory;
+	uint8_t* readbackMapped = nullptr;
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	UniqueFence fence;
+	bool recording = false;
+
+	std::vector<DrawCommand> drawList;
+	// Indices in the batch of the jobs recorded since the last submission
+	std::vector<size_t> pendingJobs;
+	std::vector<RenderJob> batch;
+	std::vector<uint32_t> slots;
+
+	uint64_t statsJobs = 0;
+	uint64_t statsSubmissions = 0;
+	std::chrono::steady_clock::time_point statsStart;
+};
@@ -0,0 +1,197 @@
+#include "Ktx2.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+struct Ktx2Header {
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header must match the file layout");
+
+struct Ktx2LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+// Khronos Data Format Specification values used by the descriptors we write
+const uint32_t KHR_DF_MODEL_RGBSDA = 1;
+const uint32_t KHR_DF_MODEL_BC1A = 128;
+const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+const uint32_t KHR_DF_TRANSFER_SRGB = 2;
+const uint32_t KHR_DF_CHANNEL_ALPHA = 15;
+const uint32_t KHR_DF_SAMPLE_QUALIFIER_LINEAR = 1;
+
+static void appendSample(std::vector<uint32_t>& dfd, uint32_t bitOffset, uint32_t bitLength, uint32_t channel, uint32_t qualifiers, uint32_t upper) {
+    dfd.push_back(bitOffset | (bitLength - 1) << 16 | channel << 24 | qualifiers << 28);
+    dfd.push_back(0);
+    dfd.push_back(0);
+    dfd.push_back(upper);
+}
+
+// Basic data format descriptor block, mandatory in a KTX2 file
+static std::vector<uint32_t> basicDataFormatDescriptor(VkFormat format, const TextureFormatInfo& formatInfo) {
+    uint32_t colorModel;
+    uint32_t transfer;
+    bool srgb = format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+
+    std::vector<uint32_t> samples;
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        colorModel = KHR_DF_MODEL_RGBSDA;
+        for (uint32_t channel = 0; channel < 3; channel++) {
+            appendSample(samples, channel * 8, 8, channel, 0, 255);
+        }
+        appendSample(samples, 24, 8, KHR_DF_CHANNEL_ALPHA, srgb ? KHR_DF_SAMPLE_QUALIFIER_LINEAR : 0, 255);
+        break;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        colorModel = KHR_DF_MODEL_BC1A;
+        appendSample(samples, 0, 64, 0, 0, UINT32_MAX);
+        break;
+    default:
+        throw std::runtime_error("no KTX2 data format descriptor for this format!");
+    }
+    transfer = srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR;
+
+    uint32_t blockSize = static_cast<uint32_t>(24 + samples.size() * sizeof(uint32_t));
+    std::vector<uint32_t> dfd;
+    dfd.push_back(blockSize + 4);
+    // Khronos vendor, basic descriptor type
+    dfd.push_back(0);
+    dfd.push_back(2 | blockSize << 16);
+    dfd.push_back(colorModel | KHR_DF_PRIMARIES_BT709 << 8 | transfer << 16);
+    dfd.push_back((formatInfo.blockWidth - 1) | (formatInfo.blockHeight - 1) << 8);
+    dfd.push_back(formatInfo.blockSize);
+    dfd.push_back(0);
+    dfd.insert(dfd.end(), samples.begin(), samples.end());
+
+    return dfd;
+}
+
+void Ktx2::read(const std::string& path, TextureSource& source) {
+    auto mapping = std::make_unique<MappedFile>(path);
+    const uint8_t* data = mapping->data();
+    size_t size = mapping->size();
+
+    Ktx2Header header;
+    if (size < sizeof(header)) {
+        throw std::runtime_error("truncated KTX2 texture!");
+    }
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        throw std::runtime_error("texture is not a KTX2 file!");
+    }
+    if (header.supercompressionScheme != 0) {
+        throw std::runtime_error("supercompressed KTX2 textures are not supported!");
+    }
+    if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1) {
+        throw std::runtime_error("only 2D KTX2 textures are supported!");
+    }
+
+    VkFormat format = static_cast<VkFormat>(header.vkFormat);
+    TextureFormatInfo formatInfo = TextureStreamer::getFormatInfo(format);
+
+    // A level count of 0 asks for mips generated at load time, we only upload what the file holds
+    uint32_t levelCount = std::max(header.levelCount, 1u);
+    // A full chain has floor(log2(max(width, height))) + 1 levels, at most 32 so the shifts below stay defined
+    uint32_t maxLevelCount = 1;
+    for (uint32_t extent = std::max(header.pixelWidth, header.pixelHeight); extent > 1; extent >>= 1) {
+        maxLevelCount++;
+    }
+    if (levelCount > maxLevelCount) {
+        throw std::runtime_error("too many KTX2 mip levels!");
+    }
+    if (size < sizeof(header) + levelCount * sizeof(Ktx2LevelIndex)) {
+        throw std::runtime_error("truncated KTX2 texture!");
+    }
+
+    std::vector<TextureMip> mips;
+    for (uint32_t level = 0; level < levelCount; level++) {
+        Ktx2LevelIndex index;
+        memcpy(&index, data + sizeof(header) + level * sizeof(index), sizeof(index));
+
+        uint32_t width = std::max(header.pixelWidth >> level, 1u);
+        uint32_t height = std::max(header.pixelHeight >> level, 1u);
+        VkDeviceSize expectedSize = static_cast<VkDeviceSize>((width + formatInfo.blockWidth - 1) / formatInfo.blockWidth)
+            * ((height + formatInfo.blockHeight - 1) / formatInfo.blockHeight) * formatInfo.blockSize;
+
+        if (index.byteLength != expectedSize || index.byteOffset > size || size - index.byteOffset < index.byteLength) {
+            throw std::runtime_error("invalid KTX2 mip level!");
+        }
+        mips.push_back({ data + index.byteOffset, index.byteLength, width, height });
+    }
+
+    source.format = format;
+    source.mips = std::move(mips);
+    source.storage.clear();
+    source.mapping = std::move(mapping);
+}
+
+void Ktx2::write(const std::string& path, VkFormat format, const std::vector<TextureMip>& mips) {
+    TextureFormatInfo formatInfo = TextureStreamer::getFormatInfo(format);
+    std::vector<uint32_t> dfd = basicDataFormatDescriptor(format, formatInfo);
+
+    Ktx2Header header{};
+    memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    header.vkFormat = format;
+    header.typeSize = 1;
+    header.pixelWidth = mips[0].width;
+    header.pixelHeight = mips[0].height;
+    header.faceCount = 1;
+    header.levelCount = static_cast<uint32_t>(mips.size());
+
+    uint64_t offset = sizeof(header) + mips.size() * sizeof(Ktx2LevelIndex);
+    header.dfdByteOffset = static_cast<uint32_t>(offset);
+    header.dfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+    offset += header.dfdByteLength;
+
+    // Levels are stored smallest first, aligned to lcm(block size, 4) which is the block size of every supported format
+    std::vector<Ktx2LevelIndex> levels(mips.size());
+    for (size_t level = mips.size(); level-- > 0;) {
+        offset = (offset + formatInfo.blockSize - 1) / formatInfo.blockSize * formatInfo.blockSize;
+        levels[level] = { offset, mips[level].size, mips[level].size };
+        offset += mips[level].size;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file!");
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(Ktx2LevelIndex));
+    file.write(reinterpret_cast<const char*>(dfd.data()), dfd.size() * sizeof(uint32_t));
+
+    const char padding[16] = {};
+    for (size_t level = mips.size(); level-- > 0;) {
+        file.write(padding, levels[level].byteOffset - static_cast<uint64_t>(file.tellp()));
+        file.write(reinterpret_cast<const char*>(mips[level].data), mips[level].size);
+    }
+
+    if (!file) {
+        throw std::runtime_error("failed to write KTX2 texture!");
+    }
+}
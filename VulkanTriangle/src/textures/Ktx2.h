@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+
+#include "TextureStreamer.h"
+
+/**
+    * KTX 2.0 container holding a GPU-ready mip chain: 2D, single layer, no supercompression.
+    * Reading maps the file and points every mip of the source into the mapping, uploads copy
+    * them straight into the staging buffer.
+    **/
+class Ktx2 {
+public:
+	static void read(const std::string& path, TextureSource& source);
+	static void write(const std::string& path, VkFormat format, const std::vector<TextureMip>& mips);
+};
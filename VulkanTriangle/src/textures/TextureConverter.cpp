@@ -0,0 +1,219 @@
+#include "TextureConverter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <iostream>
+#include <stdexcept>
+
+#include "Ktx2.h"
+#include "../Utils.h"
+
+void TextureConverter::convert(const std::string& inputPath, const std::string& outputStem) {
+    TextureSource source;
+    decodePpm(Utils::readFile(inputPath), source);
+
+    Ktx2::write(outputStem + ".rgba8.ktx2", VK_FORMAT_R8G8B8A8_UNORM, source.mips);
+
+    std::vector<std::vector<uint8_t>> blocks;
+    std::vector<TextureMip> bc1Mips;
+    blocks.reserve(source.mips.size());
+    for (const TextureMip& mip : source.mips) {
+        blocks.push_back(encodeBc1(mip));
+        bc1Mips.push_back({ blocks.back().data(), blocks.back().size(), mip.width, mip.height });
+    }
+    Ktx2::write(outputStem + ".bc1.ktx2", VK_FORMAT_BC1_RGB_UNORM_BLOCK, bc1Mips);
+
+    std::cout << "converted " << inputPath << ": " << source.mips[0].width << "x" << source.mips[0].height
+        << ", " << source.mips.size() << " mips" << std::endl;
+}
+
+void TextureConverter::decodePpm(const std::vector<char>& file, TextureSource& source) {
+    size_t position = 0;
+    auto nextToken = [&]() {
+        while (position < file.size()) {
+            if (file[position] == '#') {
+                while (position < file.size() && file[position] != '\n') {
+                    position++;
+                }
+            }
+            else if (isspace(static_cast<unsigned char>(file[position]))) {
+                position++;
+            }
+            else {
+                break;
+            }
+        }
+
+        size_t begin = position;
+        while (position < file.size() && !isspace(static_cast<unsigned char>(file[position]))) {
+            position++;
+        }
+        return std::string(file.data() + begin, position - begin);
+    };
+
+    if (nextToken() != "P6") {
+        throw std::runtime_error("texture is not a binary PPM!");
+    }
+    uint32_t width = static_cast<uint32_t>(std::stoul(nextToken()));
+    uint32_t height = static_cast<uint32_t>(std::stoul(nextToken()));
+    if (std::stoul(nextToken()) != 255 || width == 0 || height == 0) {
+        throw std::runtime_error("unsupported PPM texture!");
+    }
+    // Single whitespace between the header and the pixels
+    position++;
+    if (file.size() < position || file.size() - position < static_cast<size_t>(width) * height * 3) {
+        throw std::runtime_error("truncated PPM texture!");
+    }
+
+    source.format = VK_FORMAT_R8G8B8A8_UNORM;
+    source.mips.clear();
+
+    std::vector<VkDeviceSize> offsets;
+    VkDeviceSize totalSize = 0;
+    for (uint32_t w = width, h = height;; w = std::max(w / 2, 1u), h = std::max(h / 2, 1u)) {
+        offsets.push_back(totalSize);
+        source.mips.push_back({ nullptr, static_cast<VkDeviceSize>(w) * h * 4, w, h });
+        totalSize += source.mips.back().size;
+        if (w == 1 && h == 1) {
+            break;
+        }
+    }
+    source.storage.resize(totalSize);
+
+    const uint8_t* rgb = reinterpret_cast<const uint8_t*>(file.data() + position);
+    uint8_t* rgba = source.storage.data();
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; i++) {
+        rgba[i * 4 + 0] = rgb[i * 3 + 0];
+        rgba[i * 4 + 1] = rgb[i * 3 + 1];
+        rgba[i * 4 + 2] = rgb[i * 3 + 2];
+        rgba[i * 4 + 3] = 255;
+    }
+
+    // Box filter, the last row/column is repeated for odd sizes
+    for (size_t mip = 1; mip < source.mips.size(); mip++) {
+        const TextureMip& parent = source.mips[mip - 1];
+        const TextureMip& child = source.mips[mip];
+        const uint8_t* src = source.storage.data() + offsets[mip - 1];
+        uint8_t* dst = source.storage.data() + offsets[mip];
+
+        for (uint32_t y = 0; y < child.height; y++) {
+            uint32_t y0 = std::min(y * 2, parent.height - 1);
+            uint32_t y1 = std::min(y * 2 + 1, parent.height - 1);
+            for (uint32_t x = 0; x < child.width; x++) {
+                uint32_t x0 = std::min(x * 2, parent.width - 1);
+                uint32_t x1 = std::min(x * 2 + 1, parent.width - 1);
+                for (uint32_t c = 0; c < 4; c++) {
+                    uint32_t sum = src[(y0 * parent.width + x0) * 4 + c] + src[(y0 * parent.width + x1) * 4 + c]
+                        + src[(y1 * parent.width + x0) * 4 + c] + src[(y1 * parent.width + x1) * 4 + c];
+                    dst[(y * child.width + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+    }
+
+    for (size_t mip = 0; mip < source.mips.size(); mip++) {
+        source.mips[mip].data = source.storage.data() + offsets[mip];
+    }
+}
+
+static uint16_t packRgb565(const uint8_t* color) {
+    return static_cast<uint16_t>((color[0] >> 3) << 11 | (color[1] >> 2) << 5 | color[2] >> 3);
+}
+
+static void unpackRgb565(uint16_t packed, int* color) {
+    int r = packed >> 11 & 31;
+    int g = packed >> 5 & 63;
+    int b = packed & 31;
+    color[0] = r << 3 | r >> 2;
+    color[1] = g << 2 | g >> 4;
+    color[2] = b << 3 | b >> 2;
+}
+
+/**
+    * BC1 in 4 colors mode. End points are the bounding box of the block inset by 1/16 of its size,
+    * which pulls them towards the colors actually used (van Waveren, Real-Time DXT Compression).
+    **/
+std::vector<uint8_t> TextureConverter::encodeBc1(const TextureMip& mip) {
+    uint32_t blocksWide = (mip.width + 3) / 4;
+    uint32_t blocksHigh = (mip.height + 3) / 4;
+    std::vector<uint8_t> blocks(static_cast<size_t>(blocksWide) * blocksHigh * 8);
+
+    for (uint32_t by = 0; by < blocksHigh; by++) {
+        for (uint32_t bx = 0; bx < blocksWide; bx++) {
+            // Border blocks repeat the last row/column
+            uint8_t texels[16][3];
+            for (uint32_t y = 0; y < 4; y++) {
+                for (uint32_t x = 0; x < 4; x++) {
+                    uint32_t sx = std::min(bx * 4 + x, mip.width - 1);
+                    uint32_t sy = std::min(by * 4 + y, mip.height - 1);
+                    const uint8_t* texel = mip.data + (static_cast<size_t>(sy) * mip.width + sx) * 4;
+                    texels[y * 4 + x][0] = texel[0];
+                    texels[y * 4 + x][1] = texel[1];
+                    texels[y * 4 + x][2] = texel[2];
+                }
+            }
+
+            uint8_t minColor[3] = { 255, 255, 255 };
+            uint8_t maxColor[3] = { 0, 0, 0 };
+            for (auto& texel : texels) {
+                for (int c = 0; c < 3; c++) {
+                    minColor[c] = std::min(minColor[c], texel[c]);
+                    maxColor[c] = std::max(maxColor[c], texel[c]);
+                }
+            }
+            for (int c = 0; c < 3; c++) {
+                uint8_t inset = static_cast<uint8_t>((maxColor[c] - minColor[c]) >> 4);
+                minColor[c] = static_cast<uint8_t>(minColor[c] + inset);
+                maxColor[c] = static_cast<uint8_t>(maxColor[c] - inset);
+            }
+
+            uint16_t color0 = packRgb565(maxColor);
+            uint16_t color1 = packRgb565(minColor);
+            // color0 > color1 selects the 4 colors mode
+            if (color0 < color1) {
+                std::swap(color0, color1);
+            }
+
+            uint32_t indices = 0;
+            if (color0 != color1) {
+                int palette[4][3];
+                unpackRgb565(color0, palette[0]);
+                unpackRgb565(color1, palette[1]);
+                for (int c = 0; c < 3; c++) {
+                    palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                    palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+                }
+
+                for (uint32_t i = 0; i < 16; i++) {
+                    uint32_t best = 0;
+                    int bestDistance = INT_MAX;
+                    for (uint32_t j = 0; j < 4; j++) {
+                        int distance = 0;
+                        for (int c = 0; c < 3; c++) {
+                            int difference = texels[i][c] - palette[j][c];
+                            distance += difference * difference;
+                        }
+                        if (distance < bestDistance) {
+                            bestDistance = distance;
+                            best = j;
+                        }
+                    }
+                    indices |= best << (i * 2);
+                }
+            }
+
+            uint8_t* block = blocks.data() + (static_cast<size_t>(by) * blocksWide + bx) * 8;
+            block[0] = static_cast<uint8_t>(color0);
+            block[1] = static_cast<uint8_t>(color0 >> 8);
+            block[2] = static_cast<uint8_t>(color1);
+            block[3] = static_cast<uint8_t>(color1 >> 8);
+            block[4] = static_cast<uint8_t>(indices);
+            block[5] = static_cast<uint8_t>(indices >> 8);
+            block[6] = static_cast<uint8_t>(indices >> 16);
+            block[7] = static_cast<uint8_t>(indices >> 24);
+        }
+    }
+
+    return blocks;
+}
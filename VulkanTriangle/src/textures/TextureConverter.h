@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "TextureStreamer.h"
+
+/**
+    * Offline texture conversion: decodes a source image, builds its mip chain and writes
+    * GPU-ready KTX2 variants the streamer picks from at runtime depending on device support.
+    **/
+class TextureConverter {
+public:
+	// Writes <outputStem>.bc1.ktx2 and <outputStem>.rgba8.ktx2
+	static void convert(const std::string& inputPath, const std::string& outputStem);
+
+	// Binary PPM (P6, 8 bits per channel) to an RGBA8 source with its whole mip chain
+	static void decodePpm(const std::vector<char>& file, TextureSource& source);
+	static std::vector<uint8_t> encodeBc1(const TextureMip& mip);
+};
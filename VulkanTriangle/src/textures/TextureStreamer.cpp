@@ -0,0 +1,603 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "Ktx2.h"
+#include "TextureConverter.h"
+#include "../Utils.h"
+
+// Multiple of every supported texel block size
+static const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+static void transitionImage(VkCommandBuffer commandBuffer, VkImage image, uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout,
+    VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = levelCount;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+
+    CaptureLayer::cmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+struct TextureVariant {
+    const char* suffix;
+    VkFormat format;
+};
+
+// Payloads a texture can be stored in, by preference. TextureConverter writes bc1 and rgba8,
+// the others come from external encoders
+static const TextureVariant TEXTURE_VARIANTS[] = {
+    { "bc7", VK_FORMAT_BC7_UNORM_BLOCK },
+    { "astc", VK_FORMAT_ASTC_4x4_UNORM_BLOCK },
+    { "etc2", VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK },
+    { "bc1", VK_FORMAT_BC1_RGB_UNORM_BLOCK },
+    { "rgba8", VK_FORMAT_R8G8B8A8_UNORM },
+};
+
+// Mips from the returned one on are small enough to be uploaded together
+static uint32_t findTailMip(const TextureSource& source) {
+    uint32_t mip = 0;
+    while (mip + 1 < source.mips.size() && source.mips[mip].size > TEXTURE_MIP_TAIL_SIZE) {
+        mip++;
+    }
+    return mip;
+}
+
+TextureFormatInfo TextureStreamer::getFormatInfo(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        return { 1, 1, 4 };
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+        return { 4, 4, 8 };
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+        return { 4, 4, 16 };
+    default:
+        throw std::runtime_error("unsupported streamed texture format!");
+    }
+}
+
+void TextureStreamer::create(VulkanEngine& vkEngine) {
+    this->vkEngine = &vkEngine;
+    textures = std::make_unique<StreamedTexture[]>(MAX_STREAMED_TEXTURES);
+
+    // One staging region per frame in flight, like the uniform ring
+    Utils::createBuffer(vkEngine, TEXTURE_UPLOAD_BUDGET * vkEngine.MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, *stagingBuffer.put(vkEngine.device), *stagingMemory.put(vkEngine.device));
+    if (vkd.vkMapMemory(vkEngine.device, stagingMemory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&stagingMapped)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map texture staging buffer!");
+    }
+    CaptureLayer::instance().trackMapping(stagingBuffer, stagingMapped);
+
+    for (const auto& variant : TEXTURE_VARIANTS) {
+        VkFormatProperties formatProperties;
+        vki.vkGetPhysicalDeviceFormatProperties(vkEngine.physicalDevice, variant.format, &formatProperties);
+        if (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) {
+            supportedFormats.push_back(variant.format);
+        }
+    }
+
+    vki.vkGetPhysicalDeviceMemoryProperties(vkEngine.physicalDevice, &memoryProperties);
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    if (vkd.vkCreateSampler(vkEngine.device, &samplerInfo, nullptr, sampler.put(vkEngine.device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create texture sampler!");
+    }
+}
+
+void TextureStreamer::destroy(VkDevice device) {
+    retiredImages.clear();
+
+    uint32_t count = textureCount.load();
+    for (uint32_t i = 0; i < count; i++) {
+        StreamedTexture& texture = textures[i];
+        texture.view.reset();
+        texture.image.reset();
+        texture.memory.reset();
+        texture.pendingImage.reset();
+        texture.pendingMemory.reset();
+    }
+
+    sampler.reset();
+    vkd.vkUnmapMemory(device, stagingMemory);
+    stagingBuffer.reset();
+    stagingMemory.reset();
+}
+
+TextureHandle TextureStreamer::load(const std::string& path) {
+    std::lock_guard<std::mutex> lock(loadMutex);
+
+    uint32_t handle = textureCount.load(std::memory_order_relaxed);
+    if (handle == MAX_STREAMED_TEXTURES) {
+        throw std::runtime_error("too many streamed textures!");
+    }
+
+    textures[handle].path = path;
+    pendingLoads.push_back(handle);
+    textureCount.store(handle + 1, std::memory_order_release);
+
+    return handle;
+}
+
+void TextureStreamer::touch(TextureHandle texture, uint32_t mip) {
+    StreamedTexture& streamed = textures[texture];
+    uint64_t frame = currentFrame.load(std::memory_order_relaxed);
+
+    // The first touch of a frame replaces the previous request, later ones can only ask for more detail
+    if (streamed.lastUsedFrame.exchange(frame, std::memory_order_relaxed) != frame) {
+        streamed.requestedMip.store(mip, std::memory_order_relaxed);
+        return;
+    }
+
+    uint32_t requested = streamed.requestedMip.load(std::memory_order_relaxed);
+    while (mip < requested && !streamed.requestedMip.compare_exchange_weak(requested, mip, std::memory_order_relaxed)) {
+    }
+}
+
+VkImageView TextureStreamer::getView(TextureHandle texture) const {
+    return textures[texture].view;
+}
+
+uint32_t TextureStreamer::findMip(TextureHandle texture, uint32_t size) const {
+    const StreamedTexture& streamed = textures[texture];
+    if (!streamed.loaded.load(std::memory_order_acquire)) {
+        return 0;
+    }
+
+    const std::vector<TextureMip>& mips = streamed.source.mips;
+    uint32_t mip = 0;
+    while (mip + 1 < mips.size() && std::max(mips[mip + 1].width, mips[mip + 1].height) >= size) {
+        mip++;
+    }
+    return mip;
+}
+
+void TextureStreamer::loadSource(StreamedTexture& texture) {
+    const std::string extension = ".ktx2";
+    if (texture.path.size() > extension.size() && texture.path.compare(texture.path.size() - extension.size(), extension.size(), extension) == 0) {
+        Ktx2::read(selectVariant(texture.path), texture.source);
+        if (!isFormatSupported(texture.source.format)) {
+            throw std::runtime_error("texture format not supported by the device!");
+        }
+    }
+    else {
+        TextureConverter::decodePpm(Utils::readFile(texture.path), texture.source);
+    }
+
+    texture.residentMip = static_cast<uint32_t>(texture.source.mips.size());
+    texture.loaded.store(true, std::memory_order_release);
+}
+
+std::string TextureStreamer::selectVariant(const std::string& path) const {
+    std::string stem = path.substr(0, path.size() - strlen(".ktx2"));
+
+    for (const auto& variant : TEXTURE_VARIANTS) {
+        std::string variantPath = stem + "." + variant.suffix + ".ktx2";
+        if (isFormatSupported(variant.format) && std::ifstream(variantPath, std::ios::binary).is_open()) {
+            return variantPath;
+        }
+    }
+
+    return path;
+}
+
+bool TextureStreamer::isFormatSupported(VkFormat format) const {
+    return std::find(supportedFormats.begin(), supportedFormats.end(), format) != supportedFormats.end();
+}
+
+void TextureStreamer::recordUploads(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint64_t frameNumber) {
+    currentFrame.store(frameNumber, std::memory_order_relaxed);
+    releaseRetired();
+
+    std::vector<TextureHandle> loads;
+    {
+        std::lock_guard<std::mutex> lock(loadMutex);
+        loads.swap(pendingLoads);
+    }
+    for (TextureHandle handle : loads) {
+        StreamedTexture* texture = &textures[handle];
+        vkEngine->jobSystem.submit(vkEngine->jobSystem.createJob([this, texture] {
+            try {
+                loadSource(*texture);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "failed to load texture " << texture->path << ": " << e.what() << '\n';
+            }
+        }));
+    }
+
+    stagingHead = TEXTURE_UPLOAD_BUDGET * frameIndex;
+    stagingEnd = stagingHead + TEXTURE_UPLOAD_BUDGET;
+
+    uint32_t count = textureCount.load(std::memory_order_acquire);
+    int64_t headroom = queryHeadroom();
+    std::vector<StreamedTexture*> candidates;
+
+    if (headroom < 0) {
+        // Over budget: cancel stream-ins and drop the largest mips of the least recently used textures
+        for (uint32_t i = 0; i < count; i++) {
+            StreamedTexture& texture = textures[i];
+            if (texture.loaded.load(std::memory_order_acquire)
+                && (texture.pendingImage != VK_NULL_HANDLE || (texture.image != VK_NULL_HANDLE && texture.residentMip < findTailMip(texture.source)))) {
+                candidates.push_back(&texture);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const StreamedTexture* a, const StreamedTexture* b) {
+            return a->lastUsedFrame.load(std::memory_order_relaxed) < b->lastUsedFrame.load(std::memory_order_relaxed);
+        });
+
+        for (StreamedTexture* texture : candidates) {
+            if (headroom >= 0) {
+                break;
+            }
+
+            if (texture->pendingImage != VK_NULL_HANDLE) {
+                headroom += static_cast<int64_t>(texture->pendingMemorySize);
+                cancelPending(*texture);
+            }
+            else {
+                VkDeviceSize previousSize = texture->memorySize;
+                evict(commandBuffer, *texture);
+                headroom += static_cast<int64_t>(previousSize) - static_cast<int64_t>(texture->memorySize);
+            }
+        }
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        StreamedTexture& texture = textures[i];
+        if (!texture.loaded.load(std::memory_order_acquire)) {
+            continue;
+        }
+
+        bool demanded = texture.lastUsedFrame.load(std::memory_order_relaxed) + TEXTURE_DEMAND_FRAMES >= frameNumber
+            && texture.requestedMip.load(std::memory_order_relaxed) < texture.residentMip;
+        if (texture.pendingImage != VK_NULL_HANDLE || texture.image == VK_NULL_HANDLE || demanded) {
+            candidates.push_back(&texture);
+        }
+    }
+    // Finish started uploads, then give every texture its mip tail, then the most recently used first
+    auto priority = [](const StreamedTexture* texture) {
+        return texture->pendingImage != VK_NULL_HANDLE ? 0 : texture->image == VK_NULL_HANDLE ? 1 : 2;
+    };
+    std::sort(candidates.begin(), candidates.end(), [&](const StreamedTexture* a, const StreamedTexture* b) {
+        if (priority(a) != priority(b)) {
+            return priority(a) < priority(b);
+        }
+        return a->lastUsedFrame.load(std::memory_order_relaxed) > b->lastUsedFrame.load(std::memory_order_relaxed);
+    });
+
+    for (StreamedTexture* texture : candidates) {
+        if (stagingHead >= stagingEnd) {
+            break;
+        }
+
+        if (texture->pendingImage == VK_NULL_HANDLE) {
+            uint32_t firstMip = texture->image == VK_NULL_HANDLE ? findTailMip(texture->source) : texture->residentMip - 1;
+            if (static_cast<int64_t>(estimateSize(*texture, firstMip)) > headroom || !beginStreamIn(commandBuffer, *texture, firstMip)) {
+                continue;
+            }
+            headroom -= static_cast<int64_t>(texture->pendingMemorySize);
+        }
+
+        uploadPending(commandBuffer, *texture);
+    }
+}
+
+int64_t TextureStreamer::queryHeadroom() {
+    VkDeviceSize budget = 0;
+    VkDeviceSize usage = 0;
+
+    if (vkEngine->memoryBudgetSupported) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+        VkPhysicalDeviceMemoryProperties2KHR properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+        properties.pNext = &budgetProperties;
+        vki.vkGetPhysicalDeviceMemoryProperties2KHR(vkEngine->physicalDevice, &properties);
+
+        for (uint32_t i = 0; i < properties.memoryProperties.memoryHeapCount; i++) {
+            if (properties.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                budget += static_cast<VkDeviceSize>(budgetProperties.heapBudget[i] * TEXTURE_BUDGET_FRACTION);
+                usage += budgetProperties.heapUsage[i];
+            }
+        }
+        // Retired images still count in the usage but are freed within MAX_FRAMES_IN_FLIGHT frames
+        usage -= std::min(usage, retiringBytes);
+    }
+    else {
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+            if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                budget += static_cast<VkDeviceSize>(memoryProperties.memoryHeaps[i].size * TEXTURE_FALLBACK_HEAP_FRACTION);
+            }
+        }
+        usage = stats.residentBytes;
+    }
+
+    return static_cast<int64_t>(budget) - static_cast<int64_t>(usage);
+}
+
+void TextureStreamer::evict(VkCommandBuffer commandBuffer, StreamedTexture& texture) {
+    uint32_t firstMip = texture.residentMip + 1;
+    uint32_t levelCount = static_cast<uint32_t>(texture.source.mips.size()) - firstMip;
+
+    UniqueImage image;
+    UniqueDeviceMemory memory;
+    VkDeviceSize size;
+    createImage(texture, firstMip, image, memory, size);
+    if (image == VK_NULL_HANDLE) {
+        return;
+    }
+
+    transitionImage(commandBuffer, image, levelCount, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    copyResidentMips(commandBuffer, texture, image, firstMip);
+    transitionImage(commandBuffer, image, levelCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+    retire(std::move(texture.image), std::move(texture.view), std::move(texture.memory), texture.memorySize);
+    texture.image = std::move(image);
+    texture.memory = std::move(memory);
+    texture.memorySize = size;
+    texture.view = createView(texture, texture.image, firstMip);
+    texture.residentMip = firstMip;
+    stats.evictedMips++;
+}
+
+bool TextureStreamer::beginStreamIn(VkCommandBuffer commandBuffer, StreamedTexture& texture, uint32_t firstMip) {
+    createImage(texture, firstMip, texture.pendingImage, texture.pendingMemory, texture.pendingMemorySize);
+    if (texture.pendingImage == VK_NULL_HANDLE) {
+        return false;
+    }
+
+    texture.pendingFirstMip = firstMip;
+    // Smallest missing mip first
+    texture.pendingMip = texture.residentMip - 1;
+    texture.pendingRow = 0;
+
+    transitionImage(commandBuffer, texture.pendingImage, static_cast<uint32_t>(texture.source.mips.size()) - firstMip,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    return true;
+}
+
+void TextureStreamer::uploadPending(VkCommandBuffer commandBuffer, StreamedTexture& texture) {
+    TextureFormatInfo formatInfo = getFormatInfo(texture.source.format);
+
+    for (;;) {
+        const TextureMip& mip = texture.source.mips[texture.pendingMip];
+        uint32_t blockRows = (mip.height + formatInfo.blockHeight - 1) / formatInfo.blockHeight;
+        VkDeviceSize rowPitch = static_cast<VkDeviceSize>((mip.width + formatInfo.blockWidth - 1) / formatInfo.blockWidth) * formatInfo.blockSize;
+
+        stagingHead = (stagingHead + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+        if (stagingHead >= stagingEnd) {
+            return;
+        }
+        // Whole rows of blocks only, the rest of the mip goes in the next frames
+        uint32_t rows = static_cast<uint32_t>(std::min<VkDeviceSize>(blockRows - texture.pendingRow, (stagingEnd - stagingHead) / rowPitch));
+        if (rows == 0) {
+            return;
+        }
+
+        memcpy(stagingMapped + stagingHead, mip.data + texture.pendingRow * rowPitch, rows * rowPitch);
+        CaptureLayer::instance().captureWrite(stagingBuffer, stagingHead, mip.data + texture.pendingRow * rowPitch, rows * rowPitch);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = stagingHead;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = texture.pendingMip - texture.pendingFirstMip;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = { 0, static_cast<int32_t>(texture.pendingRow * formatInfo.blockHeight), 0 };
+        region.imageExtent = { mip.width, std::min(rows * formatInfo.blockHeight, mip.height - texture.pendingRow * formatInfo.blockHeight), 1 };
+        CaptureLayer::cmdCopyBufferToImage(commandBuffer, stagingBuffer, texture.pendingImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        stagingHead += rows * rowPitch;
+        stats.uploadedBytes += rows * rowPitch;
+        texture.pendingRow += rows;
+        if (texture.pendingRow < blockRows) {
+            return;
+        }
+
+        texture.pendingRow = 0;
+        stats.streamedMips++;
+        if (texture.pendingMip == texture.pendingFirstMip) {
+            swapPending(commandBuffer, texture);
+            return;
+        }
+        texture.pendingMip--;
+    }
+}
+
+void TextureStreamer::swapPending(VkCommandBuffer commandBuffer, StreamedTexture& texture) {
+    uint32_t levelCount = static_cast<uint32_t>(texture.source.mips.size()) - texture.pendingFirstMip;
+
+    if (texture.image != VK_NULL_HANDLE) {
+        copyResidentMips(commandBuffer, texture, texture.pendingImage, texture.pendingFirstMip);
+    }
+    transitionImage(commandBuffer, texture.pendingImage, levelCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+    if (texture.image != VK_NULL_HANDLE) {
+        retire(std::move(texture.image), std::move(texture.view), std::move(texture.memory), texture.memorySize);
+    }
+    texture.image = std::move(texture.pendingImage);
+    texture.memory = std::move(texture.pendingMemory);
+    texture.memorySize = texture.pendingMemorySize;
+    texture.view = createView(texture, texture.image, texture.pendingFirstMip);
+    texture.residentMip = texture.pendingFirstMip;
+    texture.pendingMemorySize = 0;
+}
+
+void TextureStreamer::cancelPending(StreamedTexture& texture) {
+    retire(std::move(texture.pendingImage), UniqueImageView(), std::move(texture.pendingMemory), texture.pendingMemorySize);
+    texture.pendingMemorySize = 0;
+}
+
+/**
+    * Creates an image holding mips [firstMip, mipCount) of the texture.
+    * Leaves image to VK_NULL_HANDLE when device memory runs out, streaming just waits for more headroom.
+    **/
+void TextureStreamer::createImage(const StreamedTexture& texture, uint32_t firstMip, UniqueImage& image, UniqueDeviceMemory& memory, VkDeviceSize& size) {
+    const TextureMip& top = texture.source.mips[firstMip];
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = texture.source.format;
+    imageInfo.extent = { top.width, top.height, 1 };
+    imageInfo.mipLevels = static_cast<uint32_t>(texture.source.mips.size()) - firstMip;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkd.vkCreateImage(vkEngine->device, &imageInfo, nullptr, image.put(vkEngine->device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create streamed texture image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkd.vkGetImageMemoryRequirements(vkEngine->device, image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = Utils::findMemoryType(*vkEngine, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VkResult result = vkd.vkAllocateMemory(vkEngine->device, &allocInfo, nullptr, memory.put(vkEngine->device));
+    if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY) {
+        // Nothing was allocated, the handle left by the failed call is not ours to free
+        memory.release();
+        image.reset();
+        size = 0;
+        return;
+    }
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate streamed texture memory!");
+    }
+
+    vkd.vkBindImageMemory(vkEngine->device, image, memory, 0);
+    CaptureLayer::instance().trackImage(image, imageInfo);
+    size = memRequirements.size;
+    stats.residentBytes += size;
+}
+
+UniqueImageView TextureStreamer::createView(const StreamedTexture& texture, VkImage image, uint32_t firstMip) {
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = texture.source.format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = static_cast<uint32_t>(texture.source.mips.size()) - firstMip;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    UniqueImageView view;
+    if (vkd.vkCreateImageView(vkEngine->device, &viewInfo, nullptr, view.put(vkEngine->device)) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create streamed texture image view!");
+    }
+    return view;
+}
+
+void TextureStreamer::copyResidentMips(VkCommandBuffer commandBuffer, const StreamedTexture& texture, VkImage dstImage, uint32_t dstFirstMip) {
+    uint32_t mipCount = static_cast<uint32_t>(texture.source.mips.size());
+
+    // The old image is retired right after, it can stay in the transfer layout
+    transitionImage(commandBuffer, texture.image, mipCount - texture.residentMip, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+    std::vector<VkImageCopy> regions;
+    for (uint32_t mip = std::max(texture.residentMip, dstFirstMip); mip < mipCount; mip++) {
+        VkImageCopy region{};
+        region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - texture.residentMip, 0, 1 };
+        region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - dstFirstMip, 0, 1 };
+        region.extent = { texture.source.mips[mip].width, texture.source.mips[mip].height, 1 };
+        regions.push_back(region);
+    }
+
+    CaptureLayer::cmdCopyImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(regions.size()), regions.data());
+}
+
+void TextureStreamer::retire(UniqueImage&& image, UniqueImageView&& view, UniqueDeviceMemory&& memory, VkDeviceSize size) {
+    retiredImages.push_back({ std::move(memory), std::move(image), std::move(view), size, currentFrame.load(std::memory_order_relaxed) });
+    retiringBytes += size;
+    stats.residentBytes -= size;
+}
+
+void TextureStreamer::releaseRetired() {
+    uint64_t frame = currentFrame.load(std::memory_order_relaxed);
+
+    // Commands of the frame that retired an image are done once its slot comes back around
+    for (size_t i = 0; i < retiredImages.size();) {
+        RetiredImage& retired = retiredImages[i];
+        if (retired.frameNumber + vkEngine->MAX_FRAMES_IN_FLIGHT > frame) {
+            i++;
+            continue;
+        }
+
+        retired.view.reset();
+        CaptureLayer::instance().untrack(CaptureObjectType::Image, retired.image.get());
+        retired.image.reset();
+        retired.memory.reset();
+        retiringBytes -= retired.size;
+
+        retired = std::move(retiredImages.back());
+        retiredImages.pop_back();
+    }
+}
+
+VkDeviceSize TextureStreamer::estimateSize(const StreamedTexture& texture, uint32_t firstMip) const {
+    VkDeviceSize size = 0;
+    for (size_t mip = firstMip; mip < texture.source.mips.size(); mip++) {
+        size += texture.source.mips[mip].size;
+    }
+    return size;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../io/MappedFile.h"
+#include "../VulkanHandle.h"
+
+class VulkanEngine;
+
+const uint32_t MAX_STREAMED_TEXTURES = 4096;
+// Staging bytes uploaded per frame, large mips are uploaded in row bands over several frames
+const VkDeviceSize TEXTURE_UPLOAD_BUDGET = 8 * 1024 * 1024;
+// Mips up to this size are uploaded together the first time a texture becomes resident
+const VkDeviceSize TEXTURE_MIP_TAIL_SIZE = 64 * 1024;
+// Share of the device local heaps budget textures may push the usage up to
+const double TEXTURE_BUDGET_FRACTION = 0.9;
+// Without VK_EXT_memory_budget only our own allocations are known, stay well below the heap size
+const double TEXTURE_FALLBACK_HEAP_FRACTION = 0.5;
+// Textures touched within that many frames get their evicted mips streamed back
+const uint64_t TEXTURE_DEMAND_FRAMES = 60;
+
+typedef uint32_t TextureHandle;
+
+struct TextureFormatInfo {
+	uint32_t blockWidth;
+	uint32_t blockHeight;
+	uint32_t blockSize;
+};
+
+struct TextureMip {
+	const uint8_t* data;
+	VkDeviceSize size;
+	uint32_t width;
+	uint32_t height;
+};
+
+// CPU copy of every mip of a texture, evicted mips are streamed back from it
+struct TextureSource {
+	VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+	// Mip 0 is the largest
+	std::vector<TextureMip> mips;
+	// The mips point either in storage (decoded images) or in mapping (KTX2 files)
+	std::vector<uint8_t> storage;
+	std::unique_ptr<MappedFile> mapping;
+};
+
+struct StreamedTexture {
+	std::string path;
+	std::atomic<bool> loaded{ false };
+	TextureSource source;
+
+	std::atomic<uint32_t> requestedMip{ 0 };
+	std::atomic<uint64_t> lastUsedFrame{ 0 };
+
+	// Image holding mips [residentMip, mipCount), residentMip == mipCount when nothing is resident
+	uint32_t residentMip = 0;
+	UniqueImage image;
+	UniqueDeviceMemory memory;
+	UniqueImageView view;
+	VkDeviceSize memorySize = 0;
+
+	// Larger image being filled, swapped in once mips [pendingFirstMip, residentMip) are uploaded
+	UniqueImage pendingImage;
+	UniqueDeviceMemory pendingMemory;
+	VkDeviceSize pendingMemorySize = 0;
+	uint32_t pendingFirstMip = 0;
+	uint32_t pendingMip = 0;
+	uint32_t pendingRow = 0;
+};
+
+struct TextureStreamingStats {
+	uint64_t uploadedBytes = 0;
+	uint64_t streamedMips = 0;
+	uint64_t evictedMips = 0;
+	VkDeviceSize residentBytes = 0;
+};
+
+/**
+    * Streams textures in the background and keeps them within the device memory budget.
+    * Files are loaded on the job system (KTX2 files are mapped, other images decoded and their
+    * mip chains generated), then mips are uploaded
+    * smallest first through a per-frame staging region so a blurry version shows up early and
+    * no frame uploads more than TEXTURE_UPLOAD_BUDGET. When the budget reported by
+    * VK_EXT_memory_budget is exceeded, the largest mips of the least recently used textures are
+    * dropped; they are streamed back once the texture is touched again and memory is available.
+    **/
+class TextureStreamer {
+public:
+	void create(VulkanEngine& vkEngine);
+	void destroy(VkDevice device);
+
+	// .ktx2 paths load the best variant the device supports, <stem>.<variant>.ktx2, see TextureConverter
+	TextureHandle load(const std::string& path);
+	// Marks the texture as used by the current frame, wanting at least mip
+	void touch(TextureHandle texture, uint32_t mip = 0);
+	// Changes when mips are streamed in or evicted, VK_NULL_HANDLE until the first mips are resident.
+	// Only valid on the thread recording the frame
+	VkImageView getView(TextureHandle texture) const;
+	// Smallest mip still size texels wide or high, to touch a texture drawn size pixels big. 0 until it is loaded
+	uint32_t findMip(TextureHandle texture, uint32_t size) const;
+
+	// Records this frame's uploads and evictions, must be called outside of a render pass
+	void recordUploads(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint64_t frameNumber);
+
+	static TextureFormatInfo getFormatInfo(VkFormat format);
+
+	UniqueSampler sampler;
+	TextureStreamingStats stats;
+
+private:
+	// Members are destroyed in reverse order: the view, the image, then its memory
+	struct RetiredImage {
+		UniqueDeviceMemory memory;
+		UniqueImage image;
+		UniqueImageView view;
+		VkDeviceSize size;
+		uint64_t frameNumber;
+	};
+
+	void loadSource(StreamedTexture& texture);
+	std::string selectVariant(const std::string& path) const;
+	bool isFormatSupported(VkFormat format) const;
+	int64_t queryHeadroom();
+	void evict(VkCommandBuffer commandBuffer, StreamedTexture& texture);
+	bool beginStreamIn(VkCommandBuffer commandBuffer, StreamedTexture& texture, uint32_t firstMip);
+	void uploadPending(VkCommandBuffer commandBuffer, StreamedTexture& texture);
+	void swapPending(VkCommandBuffer commandBuffer, StreamedTexture& texture);
+	void cancelPending(StreamedTexture& texture);
+	void createImage(const StreamedTexture& texture, uint32_t firstMip, UniqueImage& image, UniqueDeviceMemory& memory, VkDeviceSize& size);
+	UniqueImageView createView(const StreamedTexture& texture, VkImage image, uint32_t firstMip);
+	void copyResidentMips(VkCommandBuffer commandBuffer, const StreamedTexture& texture, VkImage dstImage, uint32_t dstFirstMip);
+	void retire(UniqueImage&& image, UniqueImageView&& view, UniqueDeviceMemory&& memory, VkDeviceSize size);
+	void releaseRetired();
+	VkDeviceSize estimateSize(const StreamedTexture& texture, uint32_t firstMip) const;
+
+	VulkanEngine* vkEngine = nullptr;
+
+	std::unique_ptr<StreamedTexture[]> textures;
+	std::atomic<uint32_t> textureCount{ 0 };
+	std::mutex loadMutex;
+	std::vector<TextureHandle> pendingLoads;
+
+	UniqueBuffer stagingBuffer;
+	UniqueDeviceMemory stagingMemory;
+	uint8_t* stagingMapped = nullptr;
+	VkDeviceSize stagingHead = 0;
+	VkDeviceSize stagingEnd = 0;
+
+	// Sampled image formats of the physical device among the texture variants
+	std::vector<VkFormat> supportedFormats;
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+
+	std::vector<RetiredImage> retiredImages;
+	VkDeviceSize retiringBytes = 0;
+	std::atomic<uint64_t> currentFrame{ 0 };
+};